@@ -3,6 +3,7 @@
 
 #include <Arduino.h>
 #include "esp_camera.h"
+#include <KodakImageSource.h>
 
 // Camera pin definitions for AI-Thinker ESP32-CAM
 #define PWDN_GPIO_NUM     32
@@ -34,9 +35,18 @@ public:
     ESP32CameraHelper();
 
     // Initialization
-    bool begin(framesize_t frameSize = FRAMESIZE_UXGA, int jpegQuality = 10);
+    bool begin(framesize_t frameSize = FRAMESIZE_UXGA, int jpegQuality = 10, size_t fbCount = 1);
     void end();
 
+    // Power saving: sleep() stops the sensor clock, frees the frame buffers
+    // and holds the sensor in power-down through PWDN. XCLK shares GPIO0 with
+    // the boot button, which is free as a wake input until wake() brings the
+    // camera back with the same begin() settings. Sensor tweaks made through
+    // the setters are not kept.
+    bool sleep();
+    bool wake();
+    bool isSleeping() const;
+
     // Image capture
     camera_fb_t* captureImage();
     void releaseImage(camera_fb_t* fb);
@@ -53,13 +63,39 @@ public:
 
     // Status
     bool isInitialized();
+    size_t getFrameBufferCount() const;
     void printCameraInfo();
 
 private:
     bool initialized;
+    bool sleeping;
     camera_config_t config;
 
     void initConfig();
 };
 
+/**
+ * Zero-copy print source over a camera frame buffer
+ *
+ * Streams straight from fb->buf and returns the frame buffer to the camera
+ * driver as soon as the last byte is queued for Bluetooth (or when the source
+ * goes out of scope, if the print failed). Once released it cannot rewind,
+ * so a reconnect or resend after the last chunk fails instead of sending
+ * freed memory.
+ */
+class ESP32CameraFrameSource : public KodakMemorySource {
+public:
+    explicit ESP32CameraFrameSource(camera_fb_t* fb);
+    ~ESP32CameraFrameSource();
+
+    bool rewind() override;
+    void release() override;
+
+private:
+    camera_fb_t* fb;
+
+    ESP32CameraFrameSource(const ESP32CameraFrameSource&) = delete;
+    ESP32CameraFrameSource& operator=(const ESP32CameraFrameSource&) = delete;
+};
+
 #endif // ESP32_CAMERA_HELPER_H
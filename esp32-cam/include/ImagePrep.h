@@ -0,0 +1,118 @@
+#ifndef IMAGE_PREP_H
+#define IMAGE_PREP_H
+
+#include <Arduino.h>
+#include <JPEGENC.h>
+#include <KodakJobArena.h>
+
+// Output geometry, matching zinkwell/devices/kodak_step/image.py: a 2:3 crop
+// scaled to the printer's native 640x1616 raster
+#define PREP_OUTPUT_WIDTH 640
+#define PREP_OUTPUT_HEIGHT 1616
+#define PREP_ASPECT_WIDTH 2
+#define PREP_ASPECT_HEIGHT 3
+#define PREP_BYTE_BUDGET (200 * 1024)   // Re-encode at lower quality until it fits
+#define PREP_MCU_SIZE 16                // 4:2:0 encoder block; output dims are multiples of it
+#define PREP_MAX_STRIP_ROWS 16          // Tallest MCU row the decoder emits
+
+/**
+ * JPEG re-encode / resize stage
+ *
+ * Decodes a camera JPEG one MCU row at a time, center-crops it to 2:3,
+ * scales it to the printer raster and re-encodes it under a byte budget.
+ * Only one decoded strip and one output strip (16 rows each) live in PSRAM;
+ * the full frame is never expanded to RGB. If the result does not fit the
+ * budget the frame is decoded again at the next lower encoder quality.
+ *
+ * With setArena(), the strips and output images come from a KodakJobArena
+ * instead of the heap, and each output is trimmed to its encoded size.
+ *
+ * setSizeLimit() lowers the budget for the printer in hand, typically to
+ * KodakStepPrinter::getTargetImageSize(). Each prepare() also caps the
+ * budget at the arena's largest free run, so a busy arena gets a smaller
+ * image at a lower quality instead of an allocation failure.
+ *
+ * Not reentrant: use one instance per task. In pipelined mode it runs in
+ * the process task, on PIPELINE_PROCESS_CORE away from the Bluetooth stack.
+ *
+ * Usage:
+ *   ImagePrep prep;
+ *   prep.begin();
+ *   size_t len;
+ *   uint8_t* jpeg = prep.prepare(fb->buf, fb->len, &len);
+ *   ...
+ *   ImagePrep::freeImage(jpeg);
+ */
+class ImagePrep {
+public:
+    ImagePrep();
+    ~ImagePrep();
+
+    ImagePrep(const ImagePrep&) = delete;
+    ImagePrep& operator=(const ImagePrep&) = delete;
+
+    bool begin(uint16_t outputWidth = PREP_OUTPUT_WIDTH, uint16_t outputHeight = PREP_OUTPUT_HEIGHT,
+               size_t byteBudget = PREP_BYTE_BUDGET);
+    void end();
+    void setArena(KodakJobArena* arena);    // Call before begin(); nullptr uses the heap
+    // Upper bound on the byte budget from the next prepare() on; 0 removes it.
+    // May be called from any task.
+    void setSizeLimit(size_t limit);
+    size_t getByteBudget() const;           // The begin() budget, lowered to the size limit
+
+    // Returns a PSRAM buffer of *outLen bytes (free with freeImage), or nullptr on error
+    uint8_t* prepare(const uint8_t* jpeg, size_t len, size_t* outLen);
+    static void freeImage(uint8_t* image);
+
+    // Last run
+    uint32_t getLastDurationMs() const;
+    uint8_t getLastPasses() const;      // Decode/encode passes needed to meet the budget
+    const char* getLastError() const;
+
+private:
+    bool initialized;
+    KodakJobArena* arena;
+    uint16_t outWidth;
+    uint16_t outHeight;
+    size_t budget;
+    volatile size_t sizeLimit;
+    size_t passBudget;          // Output buffer size for the prepare() in progress
+
+    JPEGENC encoder;
+    JPEGENCODE encodeState;
+
+    // Strip buffers (PSRAM)
+    uint8_t* srcStrip;          // One decoded MCU row, RGB888
+    size_t srcStripWidth;       // Capacity in pixels
+    uint16_t* outStrip;         // One 16-row output band, RGB565
+    uint16_t* columnMap;        // Output column -> source column
+
+    // Per-pass state
+    const uint8_t* input;
+    size_t inputLen;
+    uint16_t srcWidth;
+    uint16_t srcHeight;
+    uint16_t cropX;
+    uint16_t cropY;
+    uint16_t cropWidth;
+    uint16_t cropHeight;
+    uint16_t nextOutRow;
+    bool passFailed;
+    bool overBudget;
+
+    uint32_t lastDurationMs;
+    uint8_t lastPasses;
+    const char* lastError;
+
+    void* allocate(size_t bytes);
+    size_t encodePass(uint8_t* output, uint8_t quality);
+    bool beginSource(uint16_t width, uint16_t height);
+    bool consumeBlock(uint16_t x, uint16_t y, uint16_t w, uint16_t h, const uint8_t* data);
+    void emitRow(const uint8_t* srcRow);
+    bool flushBand();
+
+    static size_t readInput(void* arg, size_t index, uint8_t* buf, size_t len);
+    static bool writeBlock(void* arg, uint16_t x, uint16_t y, uint16_t w, uint16_t h, uint8_t* data);
+};
+
+#endif // IMAGE_PREP_H
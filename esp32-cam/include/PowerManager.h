@@ -0,0 +1,110 @@
+#ifndef POWER_MANAGER_H
+#define POWER_MANAGER_H
+
+#include <Arduino.h>
+#include "driver/gpio.h"
+#include <KodakStep.h>
+#include "ESP32CameraHelper.h"
+#include "PrintPipeline.h"
+#include "PrintSpooler.h"
+#include "PrintServer.h"
+
+// Power configuration
+#define POWER_IDLE_MS 30000             // No activity for this long: clock down to POWER_IDLE_CPU_MHZ
+#define POWER_SLEEP_MS 120000           // ...and for this long: park camera and Bluetooth, light sleep
+#define POWER_ACTIVE_CPU_MHZ 240
+#define POWER_IDLE_CPU_MHZ 80           // Lowest clock Bluetooth and Wi-Fi still run at
+#define POWER_WAKE_GPIO GPIO_NUM_0      // Boot button, active low; the camera's XCLK while it runs
+
+enum PowerState : uint8_t {
+    POWER_ACTIVE,
+    POWER_IDLE,         // Link up, CPU clocked down
+    POWER_SLEEPING      // Inside poll(), in light sleep until the button
+};
+
+struct PowerStats {
+    uint32_t sleeps;
+    uint32_t last_sleep_ms;         // Time spent in the last light sleep
+    uint32_t total_sleep_ms;
+    uint32_t last_wake_to_ready_ms; // Light sleep exit to camera and printer ready
+    uint32_t max_wake_to_ready_ms;
+    uint32_t last_camera_wake_ms;
+    uint32_t last_printer_resume_ms;
+    uint32_t failed_resumes;        // Printer not back after resume() and the connectByName() fallback
+};
+
+/**
+ * Idle power saving for the camera and the printer link
+ *
+ * poll() watches for activity: a printer request, pipeline or spooler
+ * jobs, an upload in progress, or a noteActivity() call. After
+ * POWER_IDLE_MS without any, the CPU drops to POWER_IDLE_CPU_MHZ with the
+ * SPP link still up, so a print starts as quickly as before. After
+ * POWER_SLEEP_MS, the pipeline is stopped, the camera powered down through
+ * PWDN and the Bluetooth stack shut down. The chip then light-sleeps until
+ * the wake button pulls POWER_WAKE_GPIO low.
+ *
+ * On wake, the camera comes back with its begin() settings and the printer
+ * resumes straight to its last address, with no scan. setPrinterName()
+ * adds a connectByName() fallback for a printer that was switched off
+ * meanwhile. getStats() reports the wake-to-ready latency.
+ *
+ * A running print server keeps Wi-Fi up, so it rules out light sleep; only
+ * the clock drops. Serial input does not wake the chip.
+ *
+ * Call poll() from the task that calls pipeline.begin() (the Arduino loop).
+ *
+ * Usage:
+ *   power.setPipeline(&pipeline);
+ *   power.begin();
+ *   void loop() { if (power.poll()) { captureAndPrint(); } ... }
+ */
+class PowerManager {
+public:
+    PowerManager(KodakStepPrinter& printer, ESP32CameraHelper& camera);
+
+    PowerManager(const PowerManager&) = delete;
+    PowerManager& operator=(const PowerManager&) = delete;
+
+    bool begin(gpio_num_t wakePin = POWER_WAKE_GPIO);
+    void setPipeline(PrintPipeline* pipeline);  // Stopped for light sleep, restarted on wake
+    void setSpooler(PrintSpooler* spooler);     // Pending jobs keep the unit awake
+    void setPrintServer(PrintServer* server);   // Running: no light sleep
+    void setPrinterName(const char* name);      // connectByName() fallback on wake; nullptr for none
+    void setTimeouts(uint32_t idleMs, uint32_t sleepMs);
+
+    // Resets the idle timer and restores the full clock
+    void noteActivity();
+
+    // Call regularly. True after waking from light sleep, which only the
+    // button does: the press that woke the unit is handed to the caller.
+    bool poll();
+
+    // Status
+    PowerState getState() const;
+    uint32_t getIdleMs() const;
+    const PowerStats& getStats() const;
+
+private:
+    KodakStepPrinter& printer;
+    ESP32CameraHelper& camera;
+    PrintPipeline* pipeline;
+    PrintSpooler* spooler;
+    PrintServer* server;
+    const char* printerName;
+    gpio_num_t wakePin;
+    uint32_t idleMs;
+    uint32_t sleepMs;
+    uint32_t lastActivity;
+    PowerState state;
+    bool running;
+    PowerStats stats;
+
+    bool isBusy() const;
+    bool canSleep() const;
+    void setClock(PowerState newState);
+    void lightSleep();
+    bool wakeUp();
+};
+
+#endif // POWER_MANAGER_H
@@ -0,0 +1,185 @@
+#ifndef PRINT_PIPELINE_H
+#define PRINT_PIPELINE_H
+
+#include <Arduino.h>
+#include <atomic>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include <KodakStep.h>
+#include "ESP32CameraHelper.h"
+#include "ImagePrep.h"
+#include "PrintSpooler.h"
+
+// Pipeline configuration
+#define PIPELINE_FRAME_BUFFERS 2      // Camera fb_count for pipelined mode
+#define PIPELINE_QUEUE_DEPTH 2        // Captured frames waiting for the printer
+#define PIPELINE_MAX_QUEUE_DEPTH 8    // Upper bound for begin(queueDepth); a power of two
+#define PIPELINE_REQUEST_DEPTH 4      // Pending capture requests
+#define PIPELINE_CAPTURE_CORE 1       // Same core as the Arduino loop task
+#define PIPELINE_PROCESS_CORE 1       // Image prep, next to capture
+#define PIPELINE_TRANSFER_CORE 0      // Other core, alongside the Bluedroid stack
+#define PIPELINE_CAPTURE_PRIORITY 2
+#define PIPELINE_PROCESS_PRIORITY 1   // Below capture, so a frame is never held up by an encode
+#define PIPELINE_TRANSFER_PRIORITY 3
+#define PIPELINE_TASK_STACK_SIZE 8192
+#define PIPELINE_TASK_COUNT 4         // Capture, process, transfer and the Bluetooth writer
+
+// Where each pipeline task runs; -1 for no core affinity
+struct PipelineTopology {
+    int8_t capture_core;
+    UBaseType_t capture_priority;
+    int8_t process_core;
+    UBaseType_t process_priority;
+    int8_t transfer_core;
+    UBaseType_t transfer_priority;
+    bool bt_writer;             // Hand image chunks to the printer's writer task
+    int8_t writer_core;
+    UBaseType_t writer_priority;
+};
+
+// Called when a job finishes, from whichever pipeline task ended it (capture,
+// process or transfer): must be thread-safe and return quickly
+typedef void (*PipelineJobCallback)(uint32_t jobId, bool success, const char* error);
+
+/**
+ * Pipelined capture-and-print
+ *
+ * Four tasks, each pinned per PipelineTopology:
+ *   capture  (app core)       grabs frames into the camera's spare frame buffers
+ *   process  (app core)       image prep, then hands the job on
+ *   transfer (Bluedroid core) drives the printer engine through a bounded job queue
+ *   writer   (Bluedroid core) the printer's own task, inside write() for each chunk
+ * Requests, frames and jobs move between them through lock-free SPSC rings
+ * plus a task notification, so no task waits on a lock held by another core.
+ * Frames stream straight from the frame buffer to Bluetooth and are returned
+ * to the camera driver as soon as they are sent, so the next shot is already
+ * waiting when a transfer finishes. getTaskLoads() reports how busy each
+ * task kept its core.
+ *
+ * With setImagePrep(), the process task re-encodes each frame to the printer
+ * raster, within the printer's getTargetImageSize(), before queueing it. The
+ * frame buffer goes back to the camera as soon as the smaller PSRAM copy
+ * exists.
+ *
+ * With setSpooler(), processed jobs go to the spooler instead of the bounded
+ * queue: the process task copies (or hands over) the image and moves on, and
+ * the transfer task drains the spooler, retrying jobs the printer turned
+ * away. Job results are then reported through the spooler's callback.
+ *
+ * submitSource() prints from a source another task is still filling, such
+ * as an HTTP upload. The transfer task takes it ahead of the next queued
+ * job, or between spooled jobs, and reports back through its own callback.
+ *
+ * While the pipeline is running the transfer task owns the printer; other
+ * code only reads getStatus(). requestStatusRefresh() has the transfer task
+ * run refreshStatus() between jobs.
+ *
+ * Usage:
+ *   camera.begin(FRAMESIZE_VGA, 10, PIPELINE_FRAME_BUFFERS);
+ *   pipeline.begin();
+ *   pipeline.requestCapture(1);   // returns immediately
+ */
+class PrintPipeline {
+public:
+    PrintPipeline(ESP32CameraHelper& camera, KodakStepPrinter& printer);
+    ~PrintPipeline();
+
+    PrintPipeline(const PrintPipeline&) = delete;
+    PrintPipeline& operator=(const PrintPipeline&) = delete;
+
+    bool begin(size_t queueDepth = PIPELINE_QUEUE_DEPTH);
+    void end();
+
+    // Queue a capture; false if the request queue is full. Call from one task only.
+    bool requestCapture(uint8_t numCopies = 1);
+    // Print from a source that stays valid until the callback fires on the
+    // transfer task. One at a time; false while another is pending. Call
+    // from one task only.
+    bool submitSource(KodakImageSource& source, uint8_t numCopies,
+                      KodakCompletionCallback callback, void* context = nullptr);
+    // Refresh the printer status on the transfer task once it is between
+    // jobs; isStatusRefreshPending() until then
+    bool requestStatusRefresh();
+    bool isStatusRefreshPending() const;
+
+    void setJobCallback(PipelineJobCallback callback);
+    void setTopology(const PipelineTopology& topology);   // Call before begin()
+    const PipelineTopology& getTopology() const;
+    static PipelineTopology defaultTopology();
+    void setImagePrep(ImagePrep* prep);   // Call before begin(); nullptr sends frames as captured
+    void setSpooler(PrintSpooler* spooler); // Call before begin(); nullptr keeps the in-memory queue
+
+    // Status
+    bool isRunning() const;
+    bool isBusy() const;
+    size_t getQueuedJobs() const;
+    size_t getQueueDepth() const;       // As given to begin()
+    uint32_t getCompletedJobs() const;
+    uint32_t getFailedJobs() const;
+    // Fills up to maxLoads entries (PIPELINE_TASK_COUNT is enough) with the
+    // load since the previous call; call from one task only
+    size_t getTaskLoads(KodakTaskLoad* loads, size_t maxLoads);
+
+private:
+    struct Job {
+        uint32_t id;
+        camera_fb_t* fb;        // Raw frame, or nullptr when prepared
+        uint8_t* prepared;      // ImagePrep output (PSRAM), freed after transfer
+        size_t preparedLen;
+        uint8_t numCopies;
+    };
+
+    struct SourceJob {
+        KodakImageSource* source;
+        uint8_t numCopies;
+        KodakCompletionCallback callback;
+        void* context;
+    };
+
+    ESP32CameraHelper& camera;
+    KodakStepPrinter& printer;
+    PipelineTopology topology;
+
+    // Producer -> consumer: caller -> capture -> process -> transfer
+    KodakSpscQueue<uint8_t, PIPELINE_REQUEST_DEPTH> captureRequests;
+    KodakSpscQueue<Job, PIPELINE_FRAME_BUFFERS> frameQueue;
+    KodakSpscQueue<Job, PIPELINE_MAX_QUEUE_DEPTH> jobQueue;
+    KodakSpscQueue<SourceJob, 1> sourceJobs;   // submitSource() -> transfer
+    volatile bool sourceJobActive;
+    volatile bool statusRequested;  // requestStatusRefresh() -> transfer
+
+    TaskHandle_t captureTask;
+    TaskHandle_t processTask;
+    TaskHandle_t transferTask;
+    KodakTaskMeter captureMeter;
+    KodakTaskMeter processMeter;
+    KodakTaskMeter transferMeter;
+    bool startedWriter;
+    PipelineJobCallback jobCallback;
+    ImagePrep* imagePrep;
+    PrintSpooler* spooler;
+    volatile bool running;
+    volatile bool transferActive;
+    volatile uint32_t nextJobId;
+    volatile uint32_t completedJobs;
+    std::atomic<uint32_t> failedJobs;    // Bumped by every task and by end()
+
+    static void captureTaskEntry(void* arg);
+    static void processTaskEntry(void* arg);
+    static void transferTaskEntry(void* arg);
+    void captureLoop();
+    void processLoop();
+    void transferLoop();
+    void handOff(Job& job);
+    bool runSourceJob();
+    void runStatusRefresh();
+    void waitForPrinter();
+    static void notify(TaskHandle_t task);
+    static bool startTask(TaskFunction_t entry, const char* name, PrintPipeline* pipeline,
+                          UBaseType_t priority, int8_t core, TaskHandle_t* handle);
+    void releaseJob(Job& job);
+    bool spoolJob(Job& job);
+    void drainSpooler();
+};
+
+#endif // PRINT_PIPELINE_H
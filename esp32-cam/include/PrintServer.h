@@ -0,0 +1,140 @@
+#ifndef PRINT_SERVER_H
+#define PRINT_SERVER_H
+
+#include <Arduino.h>
+#include <WiFi.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/stream_buffer.h"
+#include <KodakStep.h>
+#include "PrintPipeline.h"
+#include "PrintSpooler.h"
+#include "ImagePrep.h"
+
+// Server configuration
+#define SERVER_PORT 80
+#define SERVER_STREAM_SIZE (32 * 1024)          // PSRAM between the socket and the transfer task
+#define SERVER_SCRATCH_SIZE BTP_CHUNK_SIZE      // Chunk handed to the printer per read
+#define SERVER_MAX_UPLOAD_SIZE BTP_MAX_IMAGE_SIZE
+#define SERVER_MAX_RESIZE_SIZE (4 * 1024 * 1024)  // Buffered for re-encoding; also bounded by free PSRAM
+#define SERVER_MAX_COPIES 10
+#define SERVER_IO_TIMEOUT_MS 5000               // Silence from either side before an upload is dropped
+#define SERVER_LINE_SIZE 192                    // Request line and header lines; longer ones are cut
+#define SERVER_TASK_CORE 1                      // App core, with capture and prep
+#define SERVER_TASK_PRIORITY 1
+#define SERVER_TASK_STACK_SIZE 6144
+
+struct PrintServerStats {
+    uint32_t uploads_printed;
+    uint32_t uploads_failed;        // Accepted, then the print or the upload failed
+    uint32_t requests_rejected;     // Bad request, wrong type, too large, busy
+    uint32_t bytes_received;        // Image bytes over all uploads
+    uint32_t uploads_resized;       // Over the printer's target size, re-encoded before printing
+    uint32_t last_upload_ms;        // Request accepted to print result, last upload
+};
+
+/**
+ * HTTP print endpoint
+ *
+ *   POST /print?copies=N   body is the JPEG itself (Content-Type: image/jpeg)
+ *   GET  /status           printer, job queue and server state as JSON
+ *
+ * The upload goes to the printer while it is still arriving. The server
+ * task reads the socket into a SERVER_STREAM_SIZE stream buffer and the
+ * pipeline's transfer task prints from the other end of it through a
+ * KodakCallbackSource, so Wi-Fi receive and SPP send overlap and no more
+ * than the stream buffer of the image is ever in memory. PRINT_READY needs
+ * the size up front, so the request must carry a Content-Length; chunked
+ * uploads are refused with 411.
+ *
+ * With setImagePrep(), an upload larger than the printer's
+ * getTargetImageSize() is re-encoded to fit instead of being sent as is or
+ * turned away. The decoder needs the whole file, so such uploads are
+ * buffered in PSRAM first (up to SERVER_MAX_RESIZE_SIZE) and printed from
+ * the smaller copy.
+ *
+ * The reply is sent once the printer has the last byte: 200 with the job
+ * result, or 503 with the printer's error. One upload prints at a time;
+ * further connections wait in the listen backlog.
+ *
+ * Usage:
+ *   WiFi.softAP("ESP32-Printer", "password");
+ *   server.begin();                 // After pipeline.begin()
+ *
+ *   curl --data-binary @photo.jpg -H "Content-Type: image/jpeg" http://192.168.4.1/print
+ */
+class PrintServer {
+public:
+    PrintServer(PrintPipeline& pipeline, KodakStepPrinter& printer);
+    ~PrintServer();
+
+    PrintServer(const PrintServer&) = delete;
+    PrintServer& operator=(const PrintServer&) = delete;
+
+    bool begin(uint16_t port = SERVER_PORT);
+    void end();
+    void setSpooler(PrintSpooler* spooler);     // Optional; adds spool state to /status
+    void setImagePrep(ImagePrep* prep);         // Optional; used only from the server task
+
+    // Status
+    bool isRunning() const;
+    bool isReceiving() const;
+    const PrintServerStats& getStats() const;
+    KodakTaskLoad getTaskLoad();
+
+private:
+    struct Request {
+        char method[8];
+        char path[32];
+        uint8_t copies;
+        size_t contentLength;
+        bool haveLength;
+        bool chunked;
+        bool expectContinue;
+    };
+
+    PrintPipeline& pipeline;
+    KodakStepPrinter& printer;
+    PrintSpooler* spooler;
+    ImagePrep* imagePrep;
+    WiFiServer server;
+    TaskHandle_t serverTask;
+    KodakTaskMeter meter;
+    volatile bool running;
+    volatile bool receiving;
+
+    // Upload path: socket -> stream -> transfer task
+    uint8_t* streamStorage;
+    StaticStreamBuffer_t streamState;
+    StreamBufferHandle_t stream;
+    uint8_t* scratch;               // KodakCallbackSource chunk, read on the transfer task
+    size_t uploadUnread;            // Bytes the transfer task has yet to take from the stream
+    volatile bool uploadAborted;    // Tells the transfer task to stop waiting for bytes
+    volatile bool printDone;
+    KodakRequestResult printResult;
+
+    PrintServerStats stats;
+
+    static void taskEntry(void* arg);
+    void serverLoop();
+    void handleClient(WiFiClient& client);
+    bool readRequest(WiFiClient& client, Request& request);
+    void handlePrint(WiFiClient& client, const Request& request);
+    void handleResize(WiFiClient& client, const Request& request, uint32_t startedAt);
+    void sendPrintResult(WiFiClient& client, const Request& request, size_t bytes, bool resized,
+                         bool complete, uint32_t startedAt);
+    bool pumpUpload(WiFiClient& client, size_t length);
+    bool readBody(WiFiClient& client, uint8_t* dest, size_t length);
+    void sendStatus(WiFiClient& client);
+    void sendJson(WiFiClient& client, int code, const char* body);
+    void sendError(WiFiClient& client, int code, const char* error);
+
+    static bool readLine(WiFiClient& client, char* line, size_t size);
+    static void parseQuery(const char* query, Request& request);
+    static const char* reasonPhrase(int code);
+    static void jsonEscape(const char* text, char* out, size_t size);
+    static size_t readUpload(uint8_t* dest, size_t maxLen, void* context);
+    static void onPrinted(const KodakRequestResult& result, void* context);
+};
+
+#endif // PRINT_SERVER_H
@@ -0,0 +1,151 @@
+#ifndef PRINT_SPOOLER_H
+#define PRINT_SPOOLER_H
+
+#include <Arduino.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include <KodakStep.h>
+
+// Spool configuration
+#define SPOOL_QUEUE_DEPTH 8                 // Jobs waiting for the printer
+#define SPOOL_PSRAM_RESERVE (512 * 1024)    // Free PSRAM left for capture/prep; beyond it jobs go to SD only
+#define SPOOL_DIR "/spool"                  // On the SD card; one file per job
+#define SPOOL_PATH_SIZE 32                  // "/spool/00000001-1.jpg"
+
+// Retry policy
+#define SPOOL_MAX_ATTEMPTS 5                // Unexplained failures (timeouts, transfer errors) before a job is dropped
+#define SPOOL_BUSY_BACKOFF_MS 2000          // Doubled per retry; unexplained failures too
+#define SPOOL_COOLING_BACKOFF_MS 30000      // Doubled per retry, once the scheduler gives up waiting
+#define SPOOL_ATTENTION_RETRY_MS 10000      // Paper, cover, battery: poll until the user fixes it
+#define SPOOL_LINK_RETRY_MS 5000            // Printer not connected
+#define SPOOL_MAX_BACKOFF_MS 120000
+
+// Called from the draining task when a job leaves the spool
+typedef void (*SpoolJobCallback)(uint32_t jobId, bool success, const char* error);
+
+/**
+ * Print job spooler
+ *
+ * Holds captured images with their copy counts until the printer takes them.
+ * Jobs live in PSRAM and, with the SD card enabled, are also written to
+ * SPOOL_DIR so they survive a reset; begin() re-queues whatever is left on
+ * the card. Once PSRAM runs low new jobs are kept on the card only.
+ *
+ * enqueue() copies the image and returns straight away, so capture never
+ * waits for the printer. poll() runs the job at the head of the spool when
+ * it is due, through a KodakPrintScheduler: busy and cooling pauses are
+ * waited out inside poll() with cheap status probes, and the job goes out
+ * the moment the printer reports ready. When the printer is out of paper,
+ * away, or still not ready after BTP_SCHED_MAX_WAIT_MS, the job stays at
+ * the head and is retried after a delay chosen from the error code (see
+ * retryDelayMs()). Only failures the printer gives no reason for count
+ * toward SPOOL_MAX_ATTEMPTS; a job waiting for paper waits as long as it
+ * takes.
+ *
+ * Each job's CRC-32 is taken at enqueue and checked by the printer as the
+ * job goes out (KodakStepPrinter::setIntegrityCheck()), so a copy damaged
+ * in PSRAM or on the card is dropped instead of printed. A job that fails
+ * the check is not retried.
+ *
+ * With setArena(), job copies, the card read buffer and the queue storage
+ * all come from a KodakJobArena, and "PSRAM runs low" means the arena has
+ * no run long enough for the image.
+ *
+ * enqueue() may be called from one task while another drives poll(); poll()
+ * owns the printer for the duration of each print.
+ *
+ * Usage:
+ *   spooler.begin(true);                      // PSRAM + SD card
+ *   spooler.enqueue(fb->buf, fb->len, 1);
+ *   camera.releaseImage(fb);
+ *   ...
+ *   spooler.poll();                           // From loop() or a transfer task
+ */
+class PrintSpooler {
+public:
+    explicit PrintSpooler(KodakStepPrinter& printer);
+    ~PrintSpooler();
+
+    PrintSpooler(const PrintSpooler&) = delete;
+    PrintSpooler& operator=(const PrintSpooler&) = delete;
+
+    bool begin(bool useSdCard = false, size_t queueDepth = SPOOL_QUEUE_DEPTH);
+    void end();                 // Jobs on the card stay there for the next begin()
+    void setArena(KodakJobArena* arena);    // Call before begin(); nullptr uses the heap
+
+    // Copy an image into the spool. Returns the job id, or 0 if the spool is full.
+    uint32_t enqueue(const uint8_t* jpeg, size_t len, uint8_t numCopies = 1);
+    // Take a heap_caps_malloc'd or arena buffer (e.g. ImagePrep output) instead of copying;
+    // it is freed by the spooler, also when this fails
+    uint32_t enqueueOwned(uint8_t* jpeg, size_t len, uint8_t numCopies = 1);
+
+    // Print the head job if it is due. Blocks for the print; true while jobs remain.
+    bool poll();
+
+    void setJobCallback(SpoolJobCallback callback);
+
+    // Status
+    bool isRunning() const;
+    bool isPrinting() const;
+    bool isUsingSdCard() const;
+    size_t getPendingJobs() const;
+    uint32_t getCompletedJobs() const;
+    uint32_t getFailedJobs() const;
+    uint32_t getRetries() const;
+    uint32_t getNextAttemptInMs() const;    // 0 when the head job is due or the spool is empty
+    const KodakSchedulerStats& getSchedulerStats() const;
+    const char* getLastError() const;
+
+    // Delay before retrying after a failed print with this printer error code
+    static uint32_t retryDelayMs(uint8_t errorCode, uint8_t retry);
+    // Whether the failure counts toward SPOOL_MAX_ATTEMPTS (states the printer reports never do)
+    static bool countsAsAttempt(uint8_t errorCode);
+
+private:
+    struct Job {
+        uint32_t id;
+        uint8_t* data;          // PSRAM copy, or nullptr when the job is on the card only
+        size_t len;
+        uint8_t numCopies;
+        bool onCard;
+        bool haveCrc;           // Taken at enqueue; not for jobs recovered from the card
+        uint32_t crc32;         // Checked by the printer before the last chunk goes out
+    };
+
+    KodakStepPrinter& printer;
+    KodakPrintScheduler scheduler;
+    KodakJobArena* arena;
+    QueueHandle_t jobQueue;
+    StaticQueue_t jobQueueState;
+    uint8_t* jobQueueStorage;   // Arena-backed queue items; nullptr for a heap queue
+    SpoolJobCallback jobCallback;
+    uint8_t* scratch;           // Read buffer for card-only jobs
+    volatile bool running;
+    volatile bool printing;
+    bool sdCard;
+    const char* lastError;
+
+    // Head job, owned by the task calling poll()
+    Job current;
+    volatile bool hasCurrent;
+    uint8_t retry;              // Failed attempts so far, for backoff
+    uint8_t attempts;           // Failures that count toward SPOOL_MAX_ATTEMPTS
+    volatile uint32_t nextAttemptMs;
+
+    volatile uint32_t nextJobId;
+    volatile uint32_t completedJobs;
+    volatile uint32_t failedJobs;
+    volatile uint32_t retries;
+
+    void* allocate(size_t bytes, KodakArenaRegion region);
+    uint32_t addJob(uint8_t* data, size_t len, uint8_t numCopies, const uint8_t* source);
+    bool printJob(const Job& job);
+    void finishJob(bool success, const char* error);
+    void scheduleRetry(uint8_t errorCode);
+    bool writeToCard(const Job& job, const uint8_t* data);
+    void recoverFromCard();
+    void releaseJob(Job& job, bool removeFromCard);
+    static void jobPath(const Job& job, char* path);
+};
+
+#endif // PRINT_SPOOLER_H
@@ -0,0 +1,88 @@
+#include "KodakImageSource.h"
+
+// =============================================================================
+// KodakMemorySource
+// =============================================================================
+
+KodakMemorySource::KodakMemorySource(const uint8_t* data, size_t size)
+    : data(data), dataSize(size), offset(0) {
+}
+
+size_t KodakMemorySource::size() const {
+    return dataSize;
+}
+
+size_t KodakMemorySource::next(const uint8_t** chunk, size_t maxLen) {
+    if (chunk == nullptr || data == nullptr || offset >= dataSize) {
+        return 0;
+    }
+
+    size_t remaining = dataSize - offset;
+    size_t len = (remaining < maxLen) ? remaining : maxLen;
+    *chunk = &data[offset];
+    offset += len;
+    return len;
+}
+
+bool KodakMemorySource::rewind() {
+    offset = 0;
+    return true;
+}
+
+const uint8_t* KodakMemorySource::contiguous() const {
+    return data;
+}
+
+void KodakMemorySource::forget() {
+    data = nullptr;
+    dataSize = 0;
+    offset = 0;
+}
+
+// =============================================================================
+// KodakCallbackSource
+// =============================================================================
+
+KodakCallbackSource::KodakCallbackSource(size_t totalSize, KodakReadCallback callback,
+                                         void* context, uint8_t* scratch, size_t scratchSize)
+    : totalSize(totalSize), callback(callback), context(context),
+      scratch(scratch), scratchSize(scratchSize) {
+}
+
+size_t KodakCallbackSource::size() const {
+    return totalSize;
+}
+
+size_t KodakCallbackSource::next(const uint8_t** chunk, size_t maxLen) {
+    if (chunk == nullptr || callback == nullptr || scratch == nullptr) {
+        return 0;
+    }
+
+    size_t len = callback(scratch, (maxLen < scratchSize) ? maxLen : scratchSize, context);
+    *chunk = scratch;
+    return len;
+}
+
+// =============================================================================
+// KodakStreamSource
+// =============================================================================
+
+KodakStreamSource::KodakStreamSource(Stream& stream, size_t totalSize,
+                                     uint8_t* scratch, size_t scratchSize)
+    : stream(stream), totalSize(totalSize), scratch(scratch), scratchSize(scratchSize) {
+}
+
+size_t KodakStreamSource::size() const {
+    return totalSize;
+}
+
+size_t KodakStreamSource::next(const uint8_t** chunk, size_t maxLen) {
+    if (chunk == nullptr || scratch == nullptr) {
+        return 0;
+    }
+
+    // readBytes() blocks up to the stream timeout for the remaining bytes
+    size_t len = stream.readBytes(scratch, (maxLen < scratchSize) ? maxLen : scratchSize);
+    *chunk = scratch;
+    return len;
+}
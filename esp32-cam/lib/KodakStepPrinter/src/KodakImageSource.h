@@ -0,0 +1,115 @@
+#ifndef KODAK_IMAGE_SOURCE_H
+#define KODAK_IMAGE_SOURCE_H
+
+#include <Arduino.h>
+
+// Pull callback for KodakCallbackSource: fill up to maxLen bytes, return count (0 = end/error)
+typedef size_t (*KodakReadCallback)(uint8_t* dest, size_t maxLen, void* context);
+
+/**
+ * Source of JPEG bytes for a streaming print
+ *
+ * The printer pulls the image a chunk at a time, so the data never has to
+ * exist as one contiguous buffer. Sources either lend pointers into memory
+ * they already own (zero-copy) or fill a scratch buffer of their own.
+ *
+ * The total size must be known up front because PRINT_READY carries it.
+ */
+class KodakImageSource {
+public:
+    KodakImageSource() : expectedCrc(0), haveExpectedCrc(false) {}
+    virtual ~KodakImageSource() {}
+
+    // Total image size in bytes
+    virtual size_t size() const = 0;
+
+    // Point *chunk at up to maxLen bytes of image data following the previous
+    // call. The bytes stay valid until the next call. Returns 0 on end or error.
+    virtual size_t next(const uint8_t** chunk, size_t maxLen) = 0;
+
+    // Restart from the first byte. Sources that cannot seek return false.
+    virtual bool rewind() { return false; }
+
+    // Called once every byte has been handed to the Bluetooth stack
+    virtual void release() {}
+
+    // The whole image as one buffer, for sources that hold it; nullptr otherwise
+    virtual const uint8_t* contiguous() const { return nullptr; }
+
+    // CRC-32 the bytes must have (KodakStepProtocol::crc32), e.g. taken when
+    // the image was spooled. A mismatch stops the print before its last chunk.
+    void setExpectedCrc32(uint32_t crc) { expectedCrc = crc; haveExpectedCrc = true; }
+    bool getExpectedCrc32(uint32_t* crc) const {
+        if (haveExpectedCrc && crc != nullptr) {
+            *crc = expectedCrc;
+        }
+        return haveExpectedCrc;
+    }
+
+private:
+    uint32_t expectedCrc;
+    bool haveExpectedCrc;
+};
+
+/**
+ * Zero-copy source over a buffer already in memory (frame buffer, PSRAM, flash)
+ */
+class KodakMemorySource : public KodakImageSource {
+public:
+    KodakMemorySource(const uint8_t* data, size_t size);
+
+    size_t size() const override;
+    size_t next(const uint8_t** chunk, size_t maxLen) override;
+    bool rewind() override;
+    const uint8_t* contiguous() const override;
+
+protected:
+    // For subclasses that give the memory back: the source is empty from here on
+    void forget();
+
+private:
+    const uint8_t* data;
+    size_t dataSize;
+    size_t offset;
+};
+
+/**
+ * Source that pulls bytes from a callback into a caller-provided scratch buffer
+ * (PSRAM ring, decoder output, custom transport)
+ */
+class KodakCallbackSource : public KodakImageSource {
+public:
+    KodakCallbackSource(size_t totalSize, KodakReadCallback callback, void* context,
+                        uint8_t* scratch, size_t scratchSize);
+
+    size_t size() const override;
+    size_t next(const uint8_t** chunk, size_t maxLen) override;
+
+private:
+    size_t totalSize;
+    KodakReadCallback callback;
+    void* context;
+    uint8_t* scratch;
+    size_t scratchSize;
+};
+
+/**
+ * Source that reads a known number of bytes from an Arduino Stream
+ * (SD card File, WiFiClient HTTP body) into a caller-provided scratch buffer.
+ * Waits up to the stream's timeout for data that has not arrived yet.
+ */
+class KodakStreamSource : public KodakImageSource {
+public:
+    KodakStreamSource(Stream& stream, size_t totalSize, uint8_t* scratch, size_t scratchSize);
+
+    size_t size() const override;
+    size_t next(const uint8_t** chunk, size_t maxLen) override;
+
+private:
+    Stream& stream;
+    size_t totalSize;
+    uint8_t* scratch;
+    size_t scratchSize;
+};
+
+#endif // KODAK_IMAGE_SOURCE_H
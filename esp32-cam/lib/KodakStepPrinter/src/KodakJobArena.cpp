@@ -0,0 +1,260 @@
+#include "KodakJobArena.h"
+#include "esp_heap_caps.h"
+
+#define BTP_ARENA_CONTINUATION 0xFFFF   // Run map entry for blocks after the first
+
+// One lock for every arena and the list of running ones; held only for
+// block map scans, never across a heap call
+static portMUX_TYPE arenaLock = portMUX_INITIALIZER_UNLOCKED;
+static KodakJobArena* runningArenas = nullptr;
+
+KodakJobArena::KodakJobArena() {
+    memset(regions, 0, sizeof(regions));
+    next = nullptr;
+}
+
+KodakJobArena::~KodakJobArena() {
+    end();
+}
+
+bool KodakJobArena::begin(size_t psramBytes, size_t internalBytes) {
+    if (isReady()) {
+        return true;
+    }
+
+    if (!reserve(regions[KODAK_ARENA_PSRAM], psramBytes, BTP_ARENA_PSRAM_BLOCK, MALLOC_CAP_SPIRAM) ||
+        !reserve(regions[KODAK_ARENA_INTERNAL], internalBytes, BTP_ARENA_INTERNAL_BLOCK,
+                 MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT)) {
+        end();
+        return false;
+    }
+
+    portENTER_CRITICAL(&arenaLock);
+    next = runningArenas;
+    runningArenas = this;
+    portEXIT_CRITICAL(&arenaLock);
+    return true;
+}
+
+void KodakJobArena::end() {
+    portENTER_CRITICAL(&arenaLock);
+    for (KodakJobArena** link = &runningArenas; *link != nullptr; link = &(*link)->next) {
+        if (*link == this) {
+            *link = next;
+            break;
+        }
+    }
+    next = nullptr;
+    portEXIT_CRITICAL(&arenaLock);
+
+    for (size_t i = 0; i < KODAK_ARENA_REGIONS; i++) {
+        heap_caps_free(regions[i].base);
+        heap_caps_free(regions[i].runs);
+    }
+    memset(regions, 0, sizeof(regions));
+}
+
+bool KodakJobArena::isReady() const {
+    return regions[KODAK_ARENA_PSRAM].base != nullptr;
+}
+
+bool KodakJobArena::reserve(Region& region, size_t bytes, size_t blockSize, uint32_t caps) {
+    region.blockSize = blockSize;
+    region.blockCount = bytes / blockSize;
+    if (region.blockCount == 0) {
+        return bytes == 0;  // An empty region is allowed; it just never fits anything
+    }
+
+    region.base = (uint8_t*)heap_caps_malloc(region.blockCount * blockSize, caps);
+    region.runs = (uint16_t*)heap_caps_malloc(region.blockCount * sizeof(uint16_t),
+                                              MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    if (region.base == nullptr || region.runs == nullptr) {
+        return false;
+    }
+    memset(region.runs, 0, region.blockCount * sizeof(uint16_t));
+    return true;
+}
+
+// =============================================================================
+// Allocation
+// =============================================================================
+
+void* KodakJobArena::allocate(size_t bytes, KodakArenaRegion regionId) {
+    if (regionId >= KODAK_ARENA_REGIONS || bytes == 0) {
+        return nullptr;
+    }
+
+    Region& region = regions[regionId];
+    size_t needed = (bytes + region.blockSize - 1) / region.blockSize;
+    void* ptr = nullptr;
+
+    portENTER_CRITICAL(&arenaLock);
+    if (region.base != nullptr && needed < BTP_ARENA_CONTINUATION) {
+        // First fit: skip allocated runs whole, restart past any block that is taken
+        size_t start = 0;
+        while (start + needed <= region.blockCount) {
+            size_t length = 0;
+            while (length < needed && region.runs[start + length] == 0) {
+                length++;
+            }
+            if (length == needed) {
+                region.runs[start] = (uint16_t)needed;
+                for (size_t i = 1; i < needed; i++) {
+                    region.runs[start + i] = BTP_ARENA_CONTINUATION;
+                }
+                region.usedBlocks += needed;
+                if (region.usedBlocks > region.highWaterBlocks) {
+                    region.highWaterBlocks = region.usedBlocks;
+                }
+                ptr = region.base + start * region.blockSize;
+                break;
+            }
+            size_t taken = start + length;
+            start = taken + region.runs[taken];
+        }
+    }
+    if (ptr != nullptr) {
+        region.allocations++;
+    } else {
+        region.failures++;
+    }
+    portEXIT_CRITICAL(&arenaLock);
+
+    return ptr;
+}
+
+void KodakJobArena::release(void* ptr) {
+    portENTER_CRITICAL(&arenaLock);
+    Region* region = regionFor(ptr);
+    if (region != nullptr) {
+        size_t start = ((uint8_t*)ptr - region->base) / region->blockSize;
+        size_t length = region->runs[start];
+        if (length != 0 && length != BTP_ARENA_CONTINUATION) {
+            memset(&region->runs[start], 0, length * sizeof(uint16_t));
+            region->usedBlocks -= length;
+        }
+    }
+    portEXIT_CRITICAL(&arenaLock);
+}
+
+bool KodakJobArena::shrink(void* ptr, size_t bytes) {
+    bool shrunk = false;
+
+    portENTER_CRITICAL(&arenaLock);
+    Region* region = regionFor(ptr);
+    if (region != nullptr) {
+        size_t start = ((uint8_t*)ptr - region->base) / region->blockSize;
+        size_t length = region->runs[start];
+        size_t keep = (bytes + region->blockSize - 1) / region->blockSize;
+        if (keep == 0) {
+            keep = 1;   // Still a live allocation; release() frees it
+        }
+        if (length != BTP_ARENA_CONTINUATION && keep < length) {
+            region->runs[start] = (uint16_t)keep;
+            memset(&region->runs[start + keep], 0, (length - keep) * sizeof(uint16_t));
+            region->usedBlocks -= length - keep;
+            shrunk = true;
+        }
+    }
+    portEXIT_CRITICAL(&arenaLock);
+
+    return shrunk;
+}
+
+bool KodakJobArena::owns(const void* ptr) const {
+    return regionFor(ptr) != nullptr;
+}
+
+void KodakJobArena::releaseAny(void* ptr) {
+    if (ptr == nullptr) {
+        return;
+    }
+
+    KodakJobArena* owner = nullptr;
+    portENTER_CRITICAL(&arenaLock);
+    for (KodakJobArena* arena = runningArenas; arena != nullptr; arena = arena->next) {
+        if (arena->owns(ptr)) {
+            owner = arena;
+            break;
+        }
+    }
+    portEXIT_CRITICAL(&arenaLock);
+
+    if (owner != nullptr) {
+        owner->release(ptr);
+    } else {
+        heap_caps_free(ptr);
+    }
+}
+
+KodakJobArena::Region* KodakJobArena::regionFor(const void* ptr) {
+    return const_cast<Region*>(static_cast<const KodakJobArena*>(this)->regionFor(ptr));
+}
+
+const KodakJobArena::Region* KodakJobArena::regionFor(const void* ptr) const {
+    const uint8_t* p = (const uint8_t*)ptr;
+    for (size_t i = 0; i < KODAK_ARENA_REGIONS; i++) {
+        const Region& region = regions[i];
+        if (region.base != nullptr && p >= region.base &&
+            p < region.base + region.blockCount * region.blockSize) {
+            return &region;
+        }
+    }
+    return nullptr;
+}
+
+// =============================================================================
+// Reporting
+// =============================================================================
+
+size_t KodakJobArena::largestFreeRun(const Region& region) {
+    size_t best = 0;
+    size_t run = 0;
+    for (size_t i = 0; i < region.blockCount; i++) {
+        run = (region.runs[i] == 0) ? run + 1 : 0;
+        if (run > best) {
+            best = run;
+        }
+    }
+    return best;
+}
+
+KodakArenaStats KodakJobArena::getStats(KodakArenaRegion regionId) const {
+    KodakArenaStats stats;
+    memset(&stats, 0, sizeof(stats));
+    if (regionId >= KODAK_ARENA_REGIONS) {
+        return stats;
+    }
+
+    const Region& region = regions[regionId];
+    portENTER_CRITICAL(&arenaLock);
+    stats.capacity = region.blockCount * region.blockSize;
+    stats.block_size = region.blockSize;
+    stats.in_use = region.usedBlocks * region.blockSize;
+    stats.high_water = region.highWaterBlocks * region.blockSize;
+    stats.largest_free = largestFreeRun(region) * region.blockSize;
+    stats.allocations = region.allocations;
+    stats.failures = region.failures;
+    portEXIT_CRITICAL(&arenaLock);
+    return stats;
+}
+
+void KodakJobArena::resetHighWater() {
+    portENTER_CRITICAL(&arenaLock);
+    for (size_t i = 0; i < KODAK_ARENA_REGIONS; i++) {
+        regions[i].highWaterBlocks = regions[i].usedBlocks;
+    }
+    portEXIT_CRITICAL(&arenaLock);
+}
+
+void KodakJobArena::printStats(Print& out) const {
+    static const char* const names[KODAK_ARENA_REGIONS] = {"PSRAM", "Internal"};
+
+    for (size_t i = 0; i < KODAK_ARENA_REGIONS; i++) {
+        KodakArenaStats stats = getStats((KodakArenaRegion)i);
+        out.printf("Arena %-8s %6u / %6u KB used, peak %6u KB, largest free %6u KB, %lu failed\n",
+                   names[i], (unsigned)(stats.in_use / 1024), (unsigned)(stats.capacity / 1024),
+                   (unsigned)(stats.high_water / 1024), (unsigned)(stats.largest_free / 1024),
+                   (unsigned long)stats.failures);
+    }
+}
@@ -0,0 +1,99 @@
+#ifndef KODAK_JOB_ARENA_H
+#define KODAK_JOB_ARENA_H
+
+#include <Arduino.h>
+
+// Arena configuration
+#define BTP_ARENA_PSRAM_SIZE (2 * 1024 * 1024)  // Job images and decode/encode strips
+#define BTP_ARENA_INTERNAL_SIZE (16 * 1024)     // Queue storage and small scratch buffers
+#define BTP_ARENA_PSRAM_BLOCK 4096              // Allocation granularity per region
+#define BTP_ARENA_INTERNAL_BLOCK 32
+
+enum KodakArenaRegion : uint8_t {
+    KODAK_ARENA_PSRAM,
+    KODAK_ARENA_INTERNAL,
+    KODAK_ARENA_REGIONS
+};
+
+// Per-region usage; byte counts are whole blocks
+struct KodakArenaStats {
+    size_t capacity;            // Bytes reserved at begin()
+    size_t block_size;
+    size_t in_use;
+    size_t high_water;          // Peak in_use since begin() or resetHighWater()
+    size_t largest_free;        // Longest free run: the biggest allocation that fits right now
+    uint32_t allocations;
+    uint32_t failures;          // Requests that did not fit
+};
+
+/**
+ * Fixed-capacity allocator for print jobs
+ *
+ * Reserves one PSRAM block and one internal RAM block at begin() and never
+ * gives them back to the heap, so image buffers that come and go all day
+ * cannot fragment PSRAM for the camera or anything else. Each region is cut
+ * into equal blocks and an allocation takes the first run of free blocks
+ * that is long enough.
+ *
+ * Job images, image prep strips and queue storage come from here. When the
+ * arena is full, allocate() returns nullptr and counts a failure; it never
+ * falls back to the heap. getStats() has the high-water mark to size
+ * BTP_ARENA_PSRAM_SIZE against a real workload.
+ *
+ * Safe to call from several tasks. releaseAny() frees a pointer from any
+ * running arena and passes anything else to heap_caps_free(), so code that
+ * hands buffers around does not need to know where they came from.
+ *
+ * Usage:
+ *   KodakJobArena arena;
+ *   arena.begin();                      // After camera.begin(), which wants PSRAM first
+ *   uint8_t* image = (uint8_t*)arena.allocate(len);
+ *   ...
+ *   KodakJobArena::releaseAny(image);
+ */
+class KodakJobArena {
+public:
+    KodakJobArena();
+    ~KodakJobArena();
+
+    KodakJobArena(const KodakJobArena&) = delete;
+    KodakJobArena& operator=(const KodakJobArena&) = delete;
+
+    bool begin(size_t psramBytes = BTP_ARENA_PSRAM_SIZE,
+               size_t internalBytes = BTP_ARENA_INTERNAL_SIZE);
+    void end();                 // Every allocation must have been released
+    bool isReady() const;
+
+    void* allocate(size_t bytes, KodakArenaRegion region = KODAK_ARENA_PSRAM);
+    void release(void* ptr);
+    bool shrink(void* ptr, size_t bytes);   // Give back the tail of an allocation
+    bool owns(const void* ptr) const;
+
+    static void releaseAny(void* ptr);
+
+    KodakArenaStats getStats(KodakArenaRegion region) const;
+    void resetHighWater();
+    void printStats(Print& out) const;
+
+private:
+    struct Region {
+        uint8_t* base;
+        size_t blockSize;
+        size_t blockCount;
+        uint16_t* runs;         // Run length at the first block of an allocation, 0 if free
+        size_t usedBlocks;
+        size_t highWaterBlocks;
+        uint32_t allocations;
+        uint32_t failures;
+    };
+
+    Region regions[KODAK_ARENA_REGIONS];
+    KodakJobArena* next;        // Running arenas, for releaseAny()
+
+    bool reserve(Region& region, size_t bytes, size_t blockSize, uint32_t caps);
+    Region* regionFor(const void* ptr);
+    const Region* regionFor(const void* ptr) const;
+    static size_t largestFreeRun(const Region& region);
+};
+
+#endif // KODAK_JOB_ARENA_H
@@ -0,0 +1,242 @@
+#include "KodakPrintScheduler.h"
+
+// printImage() sleep between polls while a job waits out a printer state
+#define BTP_SCHED_IDLE_POLL_MS 10
+
+// Result for a job that failed without the printer engine reporting one
+static KodakRequestResult schedulerFailure(uint8_t errorCode, const char* error) {
+    KodakRequestResult result;
+    result.type = KODAK_REQUEST_PRINT;
+    result.success = false;
+    result.errorCode = errorCode;
+    result.value = 0;
+    result.error = error;
+    return result;
+}
+
+KodakPrintScheduler::KodakPrintScheduler(KodakStepPrinter& printer) : printer(printer) {
+    memset(queue, 0, sizeof(queue));
+    queueHead = 0;
+    queueCount = 0;
+    state = SCHED_IDLE;
+    memset(&active, 0, sizeof(active));
+    waitingOn = BTP_ERR_SUCCESS;
+    waitStartedAt = 0;
+    nextProbeAt = 0;
+    maxWaitMs = BTP_SCHED_MAX_WAIT_MS;
+    memset(&stats, 0, sizeof(stats));
+    lastResult = schedulerFailure(BTP_ERR_SUCCESS, nullptr);
+    lastResult.type = KODAK_REQUEST_NONE;
+}
+
+bool KodakPrintScheduler::submit(KodakImageSource& source, uint8_t numCopies,
+                                 KodakCompletionCallback callback, void* context) {
+    if (queueCount >= BTP_SCHED_QUEUE_DEPTH) {
+        return false;
+    }
+
+    Job& job = queue[(queueHead + queueCount) % BTP_SCHED_QUEUE_DEPTH];
+    job.source = &source;
+    job.numCopies = numCopies;
+    job.callback = callback;
+    job.context = context;
+    queueCount++;
+    return true;
+}
+
+bool KodakPrintScheduler::printImage(KodakImageSource& source, uint8_t numCopies) {
+    if (isBusy()) {
+        lastResult = schedulerFailure(BTP_ERR_SUCCESS, "Scheduler busy with another job");
+        return false;
+    }
+    submit(source, numCopies);
+
+    while (poll()) {
+        // The engine paces itself; only sleep properly between probes
+        delay((state == SCHED_WAITING) ? BTP_SCHED_IDLE_POLL_MS : 1);
+    }
+    return lastResult.success;
+}
+
+bool KodakPrintScheduler::poll() {
+    // Drives the request in flight and supervises the link between jobs;
+    // completion callbacks move the schedule on from in here
+    bool printerBusy = printer.poll();
+
+    switch (state) {
+        case SCHED_PRINTING:
+        case SCHED_PROBING:
+            return true;
+
+        case SCHED_WAITING:
+            if (millis() - waitStartedAt >= maxWaitMs) {
+                finishJob(schedulerFailure(waitingOn, "Timed out waiting for printer"));
+                return isBusy();
+            }
+            if (printerBusy || (int32_t)(millis() - nextProbeAt) < 0) {
+                return true;
+            }
+            state = SCHED_PROBING;
+            stats.status_probes++;
+            if (!printer.checkPaperStatusAsync(onProbed, this)) {
+                // Reconnecting or not connected: look again next interval
+                state = SCHED_WAITING;
+                nextProbeAt = millis() + probeIntervalMs(waitingOn);
+            }
+            return true;
+
+        case SCHED_IDLE:
+            break;
+    }
+
+    if (queueCount == 0) {
+        return false;
+    }
+    if (printerBusy) {
+        return true;  // Reconnect or someone else's request; dispatch once it is done
+    }
+
+    active = queue[queueHead];
+    queueHead = (queueHead + 1) % BTP_SCHED_QUEUE_DEPTH;
+    queueCount--;
+    startPrint();
+    return true;
+}
+
+bool KodakPrintScheduler::isBusy() const {
+    return state != SCHED_IDLE || queueCount > 0;
+}
+
+bool KodakPrintScheduler::isWaiting() const {
+    return state == SCHED_WAITING || state == SCHED_PROBING;
+}
+
+uint8_t KodakPrintScheduler::getWaitingOn() const {
+    return waitingOn;
+}
+
+size_t KodakPrintScheduler::getQueuedJobs() const {
+    return queueCount;
+}
+
+const KodakRequestResult& KodakPrintScheduler::getLastResult() const {
+    return lastResult;
+}
+
+const KodakSchedulerStats& KodakPrintScheduler::getStats() const {
+    return stats;
+}
+
+void KodakPrintScheduler::resetStats() {
+    memset(&stats, 0, sizeof(stats));
+}
+
+void KodakPrintScheduler::setMaxWaitMs(uint32_t ms) {
+    maxWaitMs = ms;
+}
+
+uint32_t KodakPrintScheduler::probeIntervalMs(uint8_t errorCode) {
+    switch (errorCode) {
+        case BTP_ERR_COOLING: return BTP_SCHED_PROBE_COOLING_MS;
+        case BTP_ERR_OVERHEATING: return BTP_SCHED_PROBE_OVERHEAT_MS;
+        default: return BTP_SCHED_PROBE_BUSY_MS;
+    }
+}
+
+bool KodakPrintScheduler::shouldResend(const KodakRequestResult& result, KodakImageSource& source) {
+    if (result.success || KodakStepProtocol::classifyError(result.errorCode) != KODAK_ERROR_TRANSIENT) {
+        return false;
+    }
+    // An error mid-transfer leaves the source part read; resending from there
+    // would start the image without its SOI marker
+    return source.rewind();
+}
+
+// =============================================================================
+// Schedule
+// =============================================================================
+
+bool KodakPrintScheduler::startPrint() {
+    state = SCHED_PRINTING;
+    if (!printer.printImageAsync(*active.source, active.numCopies, nullptr, onPrinted, this)) {
+        // Refused outright: the image itself (never worth a retry), or no link
+        const KodakRequestResult& refused = printer.getLastResult();
+        bool badImage = refused.errorCode == BTP_ERR_BAD_IMAGE && !printer.isBusy() && printer.isConnected();
+        finishJob(schedulerFailure(badImage ? BTP_ERR_BAD_IMAGE : BTP_ERR_NOT_CONNECTED,
+                                   printer.getLastError()));
+        return false;
+    }
+    return true;
+}
+
+void KodakPrintScheduler::beginWait(uint8_t errorCode) {
+    // A job can bounce between a ready probe and another transient reply;
+    // that is still one wait
+    if (waitingOn == BTP_ERR_SUCCESS) {
+        waitStartedAt = millis();
+        stats.transient_waits++;
+    }
+    waitingOn = errorCode;
+    state = SCHED_WAITING;
+    nextProbeAt = millis() + probeIntervalMs(errorCode);
+}
+
+void KodakPrintScheduler::endWait() {
+    if (waitingOn == BTP_ERR_SUCCESS) {
+        return;
+    }
+    stats.last_wait_ms = millis() - waitStartedAt;
+    stats.wait_ms_total += stats.last_wait_ms;
+    waitingOn = BTP_ERR_SUCCESS;
+}
+
+void KodakPrintScheduler::finishJob(const KodakRequestResult& result) {
+    endWait();
+    state = SCHED_IDLE;
+    lastResult = result;
+
+    if (result.success) {
+        stats.jobs_printed++;
+    } else {
+        stats.jobs_failed++;
+    }
+
+    if (active.callback != nullptr) {
+        active.callback(result, active.context);
+    }
+}
+
+void KodakPrintScheduler::onPrinted(const KodakRequestResult& result, void* context) {
+    KodakPrintScheduler* scheduler = static_cast<KodakPrintScheduler*>(context);
+
+    if (shouldResend(result, *scheduler->active.source)) {
+        scheduler->beginWait(result.errorCode);
+        return;
+    }
+    scheduler->finishJob(result);
+}
+
+void KodakPrintScheduler::onProbed(const KodakRequestResult& result, void* context) {
+    KodakPrintScheduler* scheduler = static_cast<KodakPrintScheduler*>(context);
+
+    if (result.success) {
+        // Ready: the engine is idle again inside its callback, so send right away
+        scheduler->startPrint();
+        return;
+    }
+
+    switch (KodakStepProtocol::classifyError(result.errorCode)) {
+        case KODAK_ERROR_TRANSIENT:
+            scheduler->beginWait(result.errorCode);
+            break;
+        case KODAK_ERROR_ATTENTION:
+            scheduler->finishJob(result);
+            break;
+        default:
+            // No usable answer (timeout, link drop); the supervisor deals with
+            // the link and the next probe tries again
+            scheduler->state = SCHED_WAITING;
+            scheduler->nextProbeAt = millis() + probeIntervalMs(scheduler->waitingOn);
+            break;
+    }
+}
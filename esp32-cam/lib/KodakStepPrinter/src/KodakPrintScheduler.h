@@ -0,0 +1,117 @@
+#ifndef KODAK_PRINT_SCHEDULER_H
+#define KODAK_PRINT_SCHEDULER_H
+
+#include <Arduino.h>
+#include "KodakStepPrinter.h"
+
+// Scheduler configuration
+#define BTP_SCHED_QUEUE_DEPTH 4
+#define BTP_SCHED_PROBE_BUSY_MS 1000        // Status probe interval while the printer is busy
+#define BTP_SCHED_PROBE_COOLING_MS 5000     // ...while cooling
+#define BTP_SCHED_PROBE_OVERHEAT_MS 15000   // ...while overheating
+#define BTP_SCHED_MAX_WAIT_MS 600000        // Give up on a transient state after this long
+
+// Throughput counters; wait_ms_total against the job count gives the thermal cost per print
+struct KodakSchedulerStats {
+    uint32_t jobs_printed;
+    uint32_t jobs_failed;
+    uint32_t transient_waits;   // Jobs held back by busy/cooling/overheating
+    uint32_t status_probes;     // GET_PAGE_TYPE queries sent while waiting
+    uint32_t wait_ms_total;     // Time jobs spent waiting for the printer to become ready
+    uint32_t last_wait_ms;
+};
+
+/**
+ * Error-aware print scheduling for one printer
+ *
+ * printImage() fails the same way whether the printer is cooling for a
+ * minute or has run out of paper. The scheduler classifies the error code
+ * (KodakStepProtocol::classifyError): a transient state holds the job and
+ * probes the printer with GET_PAGE_TYPE, one 34-byte round trip, at an
+ * interval that suits the state. The job is sent again from the probe that
+ * reports ready, with no fixed retry delay in between. Errors that need the
+ * user, link failures and unknown errors complete the job right away.
+ *
+ * Transient errors usually arrive in the PAGE_TYPE or PRINT_READY reply,
+ * but a printer can also report one mid-transfer, after image bytes were
+ * read. Every resend rewinds the source first; a source that cannot rewind
+ * (a streamed upload) completes with the printer's error instead.
+ *
+ * Usage:
+ *   KodakPrintScheduler scheduler(printer);
+ *   scheduler.submit(source, 1, onDone);
+ *   void loop() { scheduler.poll(); }
+ *
+ *   scheduler.printImage(source);     // Or block until printed or given up
+ */
+class KodakPrintScheduler {
+public:
+    explicit KodakPrintScheduler(KodakStepPrinter& printer);
+
+    KodakPrintScheduler(const KodakPrintScheduler&) = delete;
+    KodakPrintScheduler& operator=(const KodakPrintScheduler&) = delete;
+
+    // Queue a job; the source must stay valid until its callback fires
+    bool submit(KodakImageSource& source, uint8_t numCopies = 1,
+                KodakCompletionCallback callback = nullptr, void* context = nullptr);
+
+    // Blocking: submit and poll until the job completes
+    bool printImage(KodakImageSource& source, uint8_t numCopies = 1);
+
+    bool poll();                // Drive the printer and the schedule; true while work is pending
+    bool isBusy() const;
+    bool isWaiting() const;     // Holding a job for a transient printer state
+    uint8_t getWaitingOn() const;   // BTP_ERR_* being waited out, BTP_ERR_SUCCESS if none
+    size_t getQueuedJobs() const;
+    const KodakRequestResult& getLastResult() const;
+
+    const KodakSchedulerStats& getStats() const;
+    void resetStats();
+    void setMaxWaitMs(uint32_t ms);
+
+    static uint32_t probeIntervalMs(uint8_t errorCode);
+    // True if the failed job is worth waiting out: a transient error and a
+    // source that rewound to its first byte
+    static bool shouldResend(const KodakRequestResult& result, KodakImageSource& source);
+
+private:
+    enum ScheduleState {
+        SCHED_IDLE,
+        SCHED_PRINTING,         // Print request in flight
+        SCHED_WAITING,          // Transient error; next probe at nextProbeAt
+        SCHED_PROBING           // Status probe in flight
+    };
+
+    struct Job {
+        KodakImageSource* source;
+        uint8_t numCopies;
+        KodakCompletionCallback callback;
+        void* context;
+    };
+
+    KodakStepPrinter& printer;
+
+    Job queue[BTP_SCHED_QUEUE_DEPTH];
+    size_t queueHead;
+    size_t queueCount;
+
+    ScheduleState state;
+    Job active;
+    uint8_t waitingOn;
+    uint32_t waitStartedAt;
+    uint32_t nextProbeAt;
+    uint32_t maxWaitMs;
+
+    KodakSchedulerStats stats;
+    KodakRequestResult lastResult;
+
+    bool startPrint();
+    void beginWait(uint8_t errorCode);
+    void endWait();
+    void finishJob(const KodakRequestResult& result);
+
+    static void onPrinted(const KodakRequestResult& result, void* context);
+    static void onProbed(const KodakRequestResult& result, void* context);
+};
+
+#endif // KODAK_PRINT_SCHEDULER_H
@@ -0,0 +1,227 @@
+#include "KodakSessionRecorder.h"
+#include "KodakStepProtocol.h"
+#ifdef ESP_PLATFORM
+#include "esp_heap_caps.h"
+#endif
+
+static_assert(sizeof(KodakSessionRecord) == 16, "KodakSessionRecord is the trace format");
+static_assert(sizeof(KodakSessionHeader) == 16, "KodakSessionHeader is the trace format");
+
+static void* allocateRing(size_t bytes) {
+#ifdef ESP_PLATFORM
+    void* ring = heap_caps_malloc(bytes, MALLOC_CAP_SPIRAM);
+    return (ring != nullptr) ? ring : heap_caps_malloc(bytes, MALLOC_CAP_8BIT);
+#else
+    return malloc(bytes);
+#endif
+}
+
+static void freeRing(void* ring) {
+#ifdef ESP_PLATFORM
+    heap_caps_free(ring);
+#else
+    free(ring);
+#endif
+}
+
+KodakSessionRecorder::KodakSessionRecorder() {
+    ring = nullptr;
+    mask = 0;
+    head = 0;
+    enabled = false;
+}
+
+KodakSessionRecorder::~KodakSessionRecorder() {
+    end();
+}
+
+bool KodakSessionRecorder::begin(size_t capacity) {
+    end();
+
+    // Power of two so the free-running count wraps with a mask
+    size_t slots = 1;
+    while (slots * 2 <= capacity) {
+        slots *= 2;
+    }
+    if (slots < 2) {
+        return false;
+    }
+
+    ring = (KodakSessionRecord*)allocateRing(slots * sizeof(KodakSessionRecord));
+    if (ring == nullptr) {
+        return false;
+    }
+
+    mask = slots - 1;
+    head = 0;
+    enabled = true;
+    return true;
+}
+
+void KodakSessionRecorder::end() {
+    freeRing(ring);
+    ring = nullptr;
+    mask = 0;
+    head = 0;
+    enabled = false;
+}
+
+bool KodakSessionRecorder::isInitialized() const {
+    return ring != nullptr;
+}
+
+void KodakSessionRecorder::setEnabled(bool enable) {
+    enabled = enable && ring != nullptr;
+}
+
+bool KodakSessionRecorder::isEnabled() const {
+    return enabled;
+}
+
+void KodakSessionRecorder::clear() {
+    head = 0;
+}
+
+// =============================================================================
+// Producer
+// =============================================================================
+
+void KodakSessionRecorder::record(KodakSessionEvent event, uint16_t length, uint32_t arg0, uint32_t arg1) {
+    if (!enabled) {
+        return;
+    }
+
+    KodakSessionRecord& slot = ring[head & mask];
+    slot.timestamp_us = micros();
+    slot.event = event;
+    slot.reserved = 0;
+    slot.length = length;
+    slot.args[0] = arg0;
+    slot.args[1] = arg1;
+    head++;
+}
+
+void KodakSessionRecorder::recordFrame(KodakSessionEvent event, const uint8_t* frame) {
+    if (!enabled || frame == nullptr) {
+        return;
+    }
+    // Bytes 0-5 are the header and device flags; 6-13 hold everything a reply reports
+    uint32_t a = ((uint32_t)frame[6] << 24) | ((uint32_t)frame[7] << 16) |
+                 ((uint32_t)frame[8] << 8) | frame[9];
+    uint32_t b = ((uint32_t)frame[10] << 24) | ((uint32_t)frame[11] << 16) |
+                 ((uint32_t)frame[12] << 8) | frame[13];
+    record(event, BTP_PACKET_SIZE, a, b);
+}
+
+// =============================================================================
+// Export
+// =============================================================================
+
+size_t KodakSessionRecorder::getCount() const {
+    if (ring == nullptr) {
+        return 0;
+    }
+    return (head > mask) ? mask + 1 : head;
+}
+
+uint32_t KodakSessionRecorder::getOverwritten() const {
+    return head - getCount();
+}
+
+bool KodakSessionRecorder::getRecord(size_t index, KodakSessionRecord* out) const {
+    if (out == nullptr || index >= getCount()) {
+        return false;
+    }
+    *out = ring[(getOverwritten() + index) & mask];
+    return true;
+}
+
+void KodakSessionRecorder::fillHeader(KodakSessionHeader* header) const {
+    header->magic = BTP_SESSION_MAGIC;
+    header->version = BTP_SESSION_VERSION;
+    header->record_size = sizeof(KodakSessionRecord);
+    header->record_count = getCount();
+    header->overwritten = getOverwritten();
+}
+
+size_t KodakSessionRecorder::exportTo(Print& output) const {
+    KodakSessionHeader header;
+    fillHeader(&header);
+    size_t written = output.write((const uint8_t*)&header, sizeof(header));
+
+    // Oldest first: from the overwrite point to the end of the ring, then the start
+    size_t count = header.record_count;
+    size_t first = header.overwritten & mask;
+    size_t run = (count < mask + 1 - first) ? count : mask + 1 - first;
+    if (run > 0) {
+        written += output.write((const uint8_t*)&ring[first], run * sizeof(KodakSessionRecord));
+    }
+    if (count > run) {
+        written += output.write((const uint8_t*)ring, (count - run) * sizeof(KodakSessionRecord));
+    }
+    return written;
+}
+
+// Buffers hex digits into BTP_SESSION_HEX_LINE-byte lines
+class KodakHexLines {
+public:
+    explicit KodakHexLines(Print& output) : output(output), used(0), written(0) {}
+
+    void write(const uint8_t* data, size_t length) {
+        static const char digits[] = "0123456789abcdef";
+        for (size_t i = 0; i < length; i++) {
+            line[used++] = digits[data[i] >> 4];
+            line[used++] = digits[data[i] & 0x0F];
+            if (used == sizeof(line) - 1) {
+                flush();
+            }
+        }
+    }
+
+    size_t finish() {
+        flush();
+        return written;
+    }
+
+private:
+    Print& output;
+    char line[BTP_SESSION_HEX_LINE * 2 + 1];
+    size_t used;
+    size_t written;
+
+    void flush() {
+        if (used == 0) {
+            return;
+        }
+        line[used++] = '\n';
+        written += output.write((const uint8_t*)line, used);
+        used = 0;
+    }
+};
+
+size_t KodakSessionRecorder::exportHex(Print& output) const {
+    KodakSessionHeader header;
+    fillHeader(&header);
+
+    size_t written = output.print(BTP_SESSION_HEX_BEGIN "\n");
+    KodakHexLines lines(output);
+    lines.write((const uint8_t*)&header, sizeof(header));
+    for (size_t i = 0; i < header.record_count; i++) {
+        lines.write((const uint8_t*)&ring[(header.overwritten + i) & mask], sizeof(KodakSessionRecord));
+    }
+    written += lines.finish();
+    written += output.print(BTP_SESSION_HEX_END "\n");
+    return written;
+}
+
+void KodakSessionRecorder::unpackFrame(const KodakSessionRecord& record, uint8_t* frame) {
+    memset(frame, 0, BTP_PACKET_SIZE);
+    frame[0] = BTP_START_1;
+    frame[1] = BTP_START_2;
+    frame[2] = BTP_IDENT_1;
+    frame[3] = BTP_IDENT_2;
+    for (int i = 0; i < 4; i++) {
+        frame[6 + i] = (uint8_t)(record.args[0] >> (24 - 8 * i));
+        frame[10 + i] = (uint8_t)(record.args[1] >> (24 - 8 * i));
+    }
+}
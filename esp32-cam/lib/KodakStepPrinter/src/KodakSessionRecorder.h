@@ -0,0 +1,111 @@
+#ifndef KODAK_SESSION_RECORDER_H
+#define KODAK_SESSION_RECORDER_H
+
+#include <Arduino.h>
+
+#define BTP_SESSION_RING_SIZE 8192          // Records, 16 bytes each; rounded down to a power of two
+#define BTP_SESSION_MAGIC 0x5254534B        // "KSTR" as stored little-endian
+#define BTP_SESSION_VERSION 1
+#define BTP_SESSION_HEX_LINE 32             // Trace bytes per exportHex() line
+#define BTP_SESSION_HEX_BEGIN "KODAK SESSION BEGIN"
+#define BTP_SESSION_HEX_END "KODAK SESSION END"
+
+enum KodakSessionEvent : uint8_t {
+    KODAK_SESSION_TX,       // Command frame; args: bytes 6-9 and 10-13
+    KODAK_SESSION_RX,       // Frame from the printer, reply or unsolicited; args as TX
+    KODAK_SESSION_ACK,      // Ack to a printer-initiated message; args as TX
+    KODAK_SESSION_CHUNK,    // Image chunk write(): length requested, args: written, time in write() (us)
+    KODAK_SESSION_PRINT,    // PRINT_READY about to go out; args: image size, copies
+    KODAK_SESSION_DONE,     // Print request finished; args: success, BTP_ERR_* code
+    KODAK_SESSION_EVENT_COUNT
+};
+
+// Exported as is, so the layout is the trace format (little-endian)
+struct KodakSessionRecord {
+    uint32_t timestamp_us;  // micros(); for chunks, when write() returned
+    uint8_t event;          // KodakSessionEvent
+    uint8_t reserved;
+    uint16_t length;        // Chunk bytes requested; BTP_PACKET_SIZE for frames
+    uint32_t args[2];
+};
+
+// Leads an exported trace
+struct KodakSessionHeader {
+    uint32_t magic;         // BTP_SESSION_MAGIC
+    uint16_t version;       // BTP_SESSION_VERSION
+    uint16_t record_size;   // sizeof(KodakSessionRecord)
+    uint32_t record_count;
+    uint32_t overwritten;   // Older records the ring no longer held
+};
+
+/**
+ * Session recorder for offline analysis of field traces
+ *
+ * Stores every frame sent and received, every image chunk write and the
+ * start and end of each print. Each entry is a 16-byte binary record with a
+ * microsecond timestamp, kept in a ring in PSRAM. A frame keeps bytes 6-13:
+ * type, sub type, error or status byte and the payload fields the replies
+ * carry. That is enough to answer the same commands the same way. When
+ * the ring is full the oldest records are overwritten, so it always holds
+ * the most recent part of the session.
+ *
+ * exportTo() writes the trace in binary (an SD File). exportHex() writes
+ * the same bytes as hex lines between BTP_SESSION_HEX_BEGIN and
+ * BTP_SESSION_HEX_END, to be cut out of a Serial log. The native test
+ * environment's KodakSessionReplay reads either one and drives the
+ * loopback simulator with the recorded latencies.
+ *
+ * The task that drives the printer records, and the same task exports or
+ * pauses the recorder with setEnabled(false) first. The ring is never
+ * locked.
+ *
+ * Usage:
+ *   KodakSessionRecorder session;
+ *   session.begin();
+ *   printer.setRecorder(&session);
+ *   ...
+ *   File file = SD_MMC.open("/session.ktr", FILE_WRITE);
+ *   session.exportTo(file);
+ */
+class KodakSessionRecorder {
+public:
+    KodakSessionRecorder();
+    ~KodakSessionRecorder();
+
+    KodakSessionRecorder(const KodakSessionRecorder&) = delete;
+    KodakSessionRecorder& operator=(const KodakSessionRecorder&) = delete;
+
+    // Ring lives in PSRAM when available
+    bool begin(size_t capacity = BTP_SESSION_RING_SIZE);
+    void end();
+    bool isInitialized() const;
+
+    void setEnabled(bool enabled);      // On after begin()
+    bool isEnabled() const;
+    void clear();
+
+    // Producer side: the task that drives the printer, never blocks
+    void record(KodakSessionEvent event, uint16_t length, uint32_t arg0 = 0, uint32_t arg1 = 0);
+    void recordFrame(KodakSessionEvent event, const uint8_t* frame);
+
+    size_t getCount() const;            // Records held
+    uint32_t getOverwritten() const;
+    bool getRecord(size_t index, KodakSessionRecord* record) const;    // 0 is the oldest
+
+    // Header, then the records oldest first; returns bytes written
+    size_t exportTo(Print& output) const;
+    size_t exportHex(Print& output) const;
+
+    // Full 34-byte frame from a TX, RX or ACK record; bytes not recorded are zero
+    static void unpackFrame(const KodakSessionRecord& record, uint8_t* frame);
+
+private:
+    KodakSessionRecord* ring;
+    uint32_t mask;
+    uint32_t head;              // Records ever written; the slot is head & mask
+    bool enabled;
+
+    void fillHeader(KodakSessionHeader* header) const;
+};
+
+#endif // KODAK_SESSION_RECORDER_H
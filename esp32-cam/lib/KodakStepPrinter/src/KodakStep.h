@@ -37,6 +37,15 @@
 #define KODAK_STEP_H
 
 #include "KodakStepProtocol.h"
+#include "KodakStepPacing.h"
+#include "KodakStepMetrics.h"
+#include "KodakStepLog.h"
+#include "KodakSessionRecorder.h"
+#include "KodakStepTasks.h"
+#include "KodakImageSource.h"
 #include "KodakStepPrinter.h"
+#include "KodakStepPrinterPool.h"
+#include "KodakPrintScheduler.h"
+#include "KodakJobArena.h"
 
 #endif // KODAK_STEP_H
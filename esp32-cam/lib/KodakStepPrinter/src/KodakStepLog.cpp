@@ -0,0 +1,215 @@
+#include "KodakStepLog.h"
+#include "esp_heap_caps.h"
+#include <stdio.h>
+
+static const char* const BTP_LOG_EVENT_NAMES[KODAK_LOG_EVENT_COUNT] = {
+    "msg", "error", "tx", "rx", "chunk", "short write", "timeout"
+};
+
+KodakStepLog::KodakStepLog() {
+    ring = nullptr;
+    mask = 0;
+    head = 0;
+    tail = 0;
+    dropped = 0;
+    output = nullptr;
+    flushIntervalMs = BTP_LOG_FLUSH_INTERVAL_MS;
+    flushTask = nullptr;
+    flushRunning = false;
+}
+
+KodakStepLog::~KodakStepLog() {
+    end();
+}
+
+bool KodakStepLog::begin(size_t capacity) {
+    end();
+
+    // Power of two so the free-running indices wrap with a mask
+    size_t slots = 1;
+    while (slots * 2 <= capacity) {
+        slots *= 2;
+    }
+    if (slots < 2) {
+        return false;
+    }
+
+    size_t bytes = slots * sizeof(KodakLogRecord);
+    ring = (KodakLogRecord*)heap_caps_malloc(bytes, MALLOC_CAP_SPIRAM);
+    if (ring == nullptr) {
+        ring = (KodakLogRecord*)heap_caps_malloc(bytes, MALLOC_CAP_8BIT);
+    }
+    if (ring == nullptr) {
+        return false;
+    }
+
+    mask = slots - 1;
+    head = 0;
+    tail = 0;
+    dropped = 0;
+    return true;
+}
+
+void KodakStepLog::end() {
+    stopFlushTask();
+    heap_caps_free(ring);
+    ring = nullptr;
+    mask = 0;
+    head = 0;
+    tail = 0;
+}
+
+bool KodakStepLog::isInitialized() const {
+    return ring != nullptr;
+}
+
+// =============================================================================
+// Producer
+// =============================================================================
+
+void KodakStepLog::log(KodakLogEvent event, const char* text, uint32_t arg0, uint32_t arg1) {
+    if (ring == nullptr) {
+        return;
+    }
+
+    // Only this side writes head; acquire pairs with the consumer's release of tail
+    uint32_t h = head;
+    if (h - __atomic_load_n(&tail, __ATOMIC_ACQUIRE) > mask) {
+        dropped++;
+        return;
+    }
+
+    KodakLogRecord& record = ring[h & mask];
+    record.timestamp_us = micros();
+    record.text = text;
+    record.args[0] = arg0;
+    record.args[1] = arg1;
+    record.event = event;
+
+    // Publish the record only once it is fully written
+    __atomic_store_n(&head, h + 1, __ATOMIC_RELEASE);
+}
+
+void KodakStepLog::logPacket(KodakLogEvent event, const uint8_t* packet) {
+    // Bytes 0-3 are the fixed ESC * C A header; keep the part that differs
+    uint32_t a = ((uint32_t)packet[4] << 24) | ((uint32_t)packet[5] << 16) |
+                 ((uint32_t)packet[6] << 8) | packet[7];
+    uint32_t b = ((uint32_t)packet[8] << 24) | ((uint32_t)packet[9] << 16) |
+                 ((uint32_t)packet[10] << 8) | packet[11];
+    log(event, nullptr, a, b);
+}
+
+// =============================================================================
+// Consumer
+// =============================================================================
+
+size_t KodakStepLog::flush(Print& out, size_t maxRecords) {
+    if (ring == nullptr) {
+        return 0;
+    }
+
+    uint32_t t = tail;
+    uint32_t available = __atomic_load_n(&head, __ATOMIC_ACQUIRE) - t;
+    size_t count = 0;
+    char line[BTP_LOG_LINE_SIZE];
+
+    while (available > 0 && count < maxRecords) {
+        size_t len = format(ring[t & mask], line, sizeof(line));
+        // Hand the slot back before the (possibly slow) write
+        __atomic_store_n(&tail, ++t, __ATOMIC_RELEASE);
+        out.write((const uint8_t*)line, len);
+        available--;
+        count++;
+    }
+    return count;
+}
+
+size_t KodakStepLog::getPending() const {
+    return __atomic_load_n(&head, __ATOMIC_ACQUIRE) - __atomic_load_n(&tail, __ATOMIC_ACQUIRE);
+}
+
+uint32_t KodakStepLog::getDropped() const {
+    return dropped;
+}
+
+size_t KodakStepLog::format(const KodakLogRecord& record, char* buffer, size_t size) {
+    if (size == 0) {
+        return 0;
+    }
+
+    const char* name = (record.event < KODAK_LOG_EVENT_COUNT) ? BTP_LOG_EVENT_NAMES[record.event] : "?";
+    unsigned long sec = record.timestamp_us / 1000000;
+    unsigned long usec = record.timestamp_us % 1000000;
+    unsigned long a = record.args[0];
+    unsigned long b = record.args[1];
+    int len;
+
+    switch (record.event) {
+        case KODAK_LOG_MESSAGE:
+        case KODAK_LOG_ERROR:
+            len = snprintf(buffer, size, "[%6lu.%06lu] %s%s\n", sec, usec,
+                           (record.event == KODAK_LOG_ERROR) ? "Error: " : "",
+                           record.text != nullptr ? record.text : "");
+            break;
+        case KODAK_LOG_PACKET_TX:
+        case KODAK_LOG_PACKET_RX:
+            len = snprintf(buffer, size, "[%6lu.%06lu] %s %08lX %08lX\n", sec, usec, name, a, b);
+            break;
+        case KODAK_LOG_CHUNK:
+            len = snprintf(buffer, size, "[%6lu.%06lu] chunk offset=%lu len=%lu\n", sec, usec, a, b);
+            break;
+        case KODAK_LOG_SHORT_WRITE:
+            len = snprintf(buffer, size, "[%6lu.%06lu] short write %lu of %lu\n", sec, usec, a, b);
+            break;
+        default:
+            len = snprintf(buffer, size, "[%6lu.%06lu] %s %lu %lu\n", sec, usec, name, a, b);
+            break;
+    }
+
+    if (len < 0) {
+        return 0;
+    }
+    return ((size_t)len < size) ? (size_t)len : size - 1;
+}
+
+// =============================================================================
+// Flush task
+// =============================================================================
+
+bool KodakStepLog::startFlushTask(Print& out, uint32_t intervalMs) {
+    if (ring == nullptr || flushTask != nullptr) {
+        return false;
+    }
+
+    output = &out;
+    flushIntervalMs = intervalMs > 0 ? intervalMs : 1;
+    flushRunning = true;
+    if (xTaskCreatePinnedToCore(flushTaskEntry, "kodak_log", BTP_LOG_TASK_STACK_SIZE, this,
+                                BTP_LOG_TASK_PRIORITY, &flushTask, BTP_LOG_TASK_CORE) != pdPASS) {
+        flushRunning = false;
+        flushTask = nullptr;
+        return false;
+    }
+    return true;
+}
+
+void KodakStepLog::stopFlushTask() {
+    flushRunning = false;
+
+    // The task drains what is left, clears flushTask and exits
+    while (flushTask != nullptr) {
+        delay(10);
+    }
+}
+
+void KodakStepLog::flushTaskEntry(void* arg) {
+    KodakStepLog* self = static_cast<KodakStepLog*>(arg);
+    while (self->flushRunning) {
+        self->flush(*self->output);
+        vTaskDelay(pdMS_TO_TICKS(self->flushIntervalMs));
+    }
+    self->flush(*self->output);
+
+    self->flushTask = nullptr;
+    vTaskDelete(nullptr);
+}
@@ -0,0 +1,92 @@
+#ifndef KODAK_STEP_LOG_H
+#define KODAK_STEP_LOG_H
+
+#include <Arduino.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#define BTP_LOG_RING_SIZE 256           // Records; rounded down to a power of two
+#define BTP_LOG_FLUSH_INTERVAL_MS 50
+#define BTP_LOG_TASK_STACK_SIZE 3072
+#define BTP_LOG_TASK_PRIORITY 1         // Below loop() and the transfer task
+#define BTP_LOG_TASK_CORE 1             // Away from the Bluedroid stack on core 0
+#define BTP_LOG_LINE_SIZE 96
+
+enum KodakLogEvent : uint8_t {
+    KODAK_LOG_MESSAGE,      // text
+    KODAK_LOG_ERROR,        // text
+    KODAK_LOG_PACKET_TX,    // args: packet bytes 4-7 and 8-11 (command and first payload bytes)
+    KODAK_LOG_PACKET_RX,    // args: as PACKET_TX
+    KODAK_LOG_CHUNK,        // args: offset, length
+    KODAK_LOG_SHORT_WRITE,  // args: written, requested
+    KODAK_LOG_TIMEOUT,      // args: step
+    KODAK_LOG_EVENT_COUNT
+};
+
+struct KodakLogRecord {
+    uint32_t timestamp_us;
+    const char* text;       // String literal or nullptr; never copied
+    uint32_t args[2];
+    uint8_t event;
+};
+
+/**
+ * Deferred trace log
+ *
+ * A lock-free single-producer / single-consumer ring of fixed-size binary
+ * records. The producer (whichever task drives KodakStepPrinter) only
+ * stores a timestamp, an event id, a static string pointer and two
+ * integers; a low-priority task formats them and writes them to any Print
+ * (Serial, an SD File, a UDP adapter). When the ring is full new records
+ * are dropped and counted rather than waiting for the flush.
+ *
+ * Usage:
+ *   KodakStepLog trace;
+ *   trace.begin();
+ *   trace.startFlushTask(Serial);
+ *   printer.setLogger(&trace);
+ */
+class KodakStepLog {
+public:
+    KodakStepLog();
+    ~KodakStepLog();
+
+    KodakStepLog(const KodakStepLog&) = delete;
+    KodakStepLog& operator=(const KodakStepLog&) = delete;
+
+    // Ring lives in PSRAM when available
+    bool begin(size_t capacity = BTP_LOG_RING_SIZE);
+    void end();
+    bool isInitialized() const;
+
+    // Producer side: one task only, never blocks
+    void log(KodakLogEvent event, const char* text, uint32_t arg0 = 0, uint32_t arg1 = 0);
+    void logPacket(KodakLogEvent event, const uint8_t* packet);
+
+    // Consumer side: either the flush task or explicit flush() calls, not both
+    bool startFlushTask(Print& output, uint32_t intervalMs = BTP_LOG_FLUSH_INTERVAL_MS);
+    void stopFlushTask();
+    size_t flush(Print& output, size_t maxRecords = SIZE_MAX);
+
+    size_t getPending() const;
+    uint32_t getDropped() const;
+
+    // "[    12.345678] chunk offset=4096 len=4096"; returns length written
+    static size_t format(const KodakLogRecord& record, char* buffer, size_t size);
+
+private:
+    KodakLogRecord* ring;
+    uint32_t mask;
+    uint32_t head;              // Next slot to write; producer only
+    uint32_t tail;              // Next slot to read; consumer only
+    volatile uint32_t dropped;
+
+    Print* output;
+    uint32_t flushIntervalMs;
+    TaskHandle_t flushTask;
+    volatile bool flushRunning;
+
+    static void flushTaskEntry(void* arg);
+};
+
+#endif // KODAK_STEP_LOG_H
@@ -0,0 +1,34 @@
+#include "KodakStepMetrics.h"
+
+const uint16_t BTP_RTT_BUCKET_LIMITS_MS[BTP_RTT_BUCKET_COUNT - 1] = {
+    10, 20, 50, 100, 200, 500, 1000
+};
+
+void KodakPrinterMetrics::reset() {
+    memset(this, 0, sizeof(*this));
+}
+
+void KodakPrinterMetrics::recordRtt(uint32_t ms) {
+    rtt_histogram[rttBucket(ms)]++;
+}
+
+void KodakPrinterMetrics::recordChunk(size_t requested, size_t written, uint32_t elapsedUs) {
+    chunks_written++;
+    bytes_sent += written;
+    chunk_write_us_total += elapsedUs;
+    if (elapsedUs > chunk_write_us_max) {
+        chunk_write_us_max = elapsedUs;
+    }
+    if (written < requested) {
+        chunk_short_writes++;
+    }
+}
+
+uint8_t KodakPrinterMetrics::rttBucket(uint32_t ms) {
+    for (uint8_t i = 0; i < BTP_RTT_BUCKET_COUNT - 1; i++) {
+        if (ms < BTP_RTT_BUCKET_LIMITS_MS[i]) {
+            return i;
+        }
+    }
+    return BTP_RTT_BUCKET_COUNT - 1;
+}
@@ -0,0 +1,54 @@
+#ifndef KODAK_STEP_METRICS_H
+#define KODAK_STEP_METRICS_H
+
+#include <Arduino.h>
+
+// Command round-trip histogram: bucket i counts RTTs below BTP_RTT_BUCKET_LIMITS_MS[i],
+// the last bucket everything slower
+#define BTP_RTT_BUCKET_COUNT 8
+extern const uint16_t BTP_RTT_BUCKET_LIMITS_MS[BTP_RTT_BUCKET_COUNT - 1];
+
+/**
+ * Transfer instrumentation, updated by KodakStepPrinter as it runs
+ *
+ * Phase timings hold the most recent occurrence; counters accumulate until
+ * reset(). Nothing here is printed, so it is safe to sample from a status
+ * page or telemetry task while printing.
+ */
+struct KodakPrinterMetrics {
+    // Phase timings (ms, last run)
+    uint32_t discovery_ms;
+    uint32_t connect_ms;
+    uint32_t initialize_ms;
+    uint32_t resume_ms;             // resume(): stack restart to printer initialized
+    uint32_t preflight_ms;          // Print start to PRINT_READY (battery + paper checks)
+    uint32_t print_ready_ms;        // PRINT_READY round trip
+    uint32_t transfer_ms;           // First chunk to last chunk queued
+    uint32_t accept_ms;             // Last chunk queued to the printer's END_OF_RECEIVED
+    uint32_t finish_ms;             // Last chunk queued to the print-finished report
+
+    // Image transfer
+    uint32_t bytes_per_sec;         // Throughput of the last transfer
+    uint32_t bytes_sent;
+    uint32_t chunks_written;
+    uint32_t chunk_write_us_total;  // Time spent inside write() for image chunks
+    uint32_t chunk_write_us_max;
+    uint32_t image_crc32;           // CRC-32 of the last image sent (with integrity checks on)
+
+    // Link health
+    uint32_t prints;
+    uint32_t commands_sent;
+    uint32_t command_short_writes;  // sendCommand() wrote less than a full packet
+    uint32_t chunk_short_writes;
+    uint32_t response_timeouts;
+    uint32_t printer_events;        // Printer-initiated messages read and acked
+    uint32_t integrity_failures;    // Jobs stopped by a JPEG marker or checksum check
+    uint32_t rtt_histogram[BTP_RTT_BUCKET_COUNT];
+
+    void reset();
+    void recordRtt(uint32_t ms);
+    void recordChunk(size_t requested, size_t written, uint32_t elapsedUs);
+    static uint8_t rttBucket(uint32_t ms);
+};
+
+#endif // KODAK_STEP_METRICS_H
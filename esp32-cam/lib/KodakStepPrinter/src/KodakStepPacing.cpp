@@ -0,0 +1,79 @@
+#include "KodakStepPacing.h"
+
+KodakStepPacer::KodakStepPacer() {
+    reset(KODAK_PACING_FIXED);
+}
+
+void KodakStepPacer::reset(KodakPacingMode newMode) {
+    mode = newMode;
+    // Adaptive mode starts from the conservative profile and moves from there
+    chunkSize = BTP_CHUNK_SIZE;
+    delayMs = BTP_INTER_CHUNK_DELAY_MS;
+    cleanWrites = 0;
+    shortWrites = 0;
+    stalls = 0;
+}
+
+KodakPacingMode KodakStepPacer::getMode() const {
+    return mode;
+}
+
+size_t KodakStepPacer::getChunkSize() const {
+    return chunkSize;
+}
+
+uint32_t KodakStepPacer::getDelayMs() const {
+    return delayMs;
+}
+
+void KodakStepPacer::onChunkWritten(size_t requested, size_t written, uint32_t elapsedUs) {
+    if (written < requested) {
+        shortWrites++;
+    } else if (elapsedUs > BTP_PACING_STALL_US) {
+        stalls++;
+    }
+
+    if (mode == KODAK_PACING_FIXED) {
+        return;
+    }
+
+    if (written < requested) {
+        // TX queue stayed full for the whole write timeout - back off hard
+        cleanWrites = 0;
+        chunkSize /= 2;
+        if (chunkSize < BTP_PACING_MIN_CHUNK_SIZE) {
+            chunkSize = BTP_PACING_MIN_CHUNK_SIZE;
+        }
+        delayMs = (delayMs == 0) ? BTP_INTER_CHUNK_DELAY_MS : delayMs * 2;
+        if (delayMs > BTP_PACING_MAX_DELAY_MS) {
+            delayMs = BTP_PACING_MAX_DELAY_MS;
+        }
+        return;
+    }
+
+    if (elapsedUs > BTP_PACING_STALL_US) {
+        // write() itself is pacing us at link speed; sleeping on top only adds idle time
+        cleanWrites = 0;
+        delayMs = 0;
+        chunkSize = (chunkSize > BTP_PACING_MIN_CHUNK_SIZE + BTP_PACING_CHUNK_STEP)
+                        ? chunkSize - BTP_PACING_CHUNK_STEP
+                        : BTP_PACING_MIN_CHUNK_SIZE;
+        return;
+    }
+
+    delayMs /= 2;
+    if (++cleanWrites >= BTP_PACING_GROW_AFTER) {
+        cleanWrites = 0;
+        if (chunkSize + BTP_PACING_CHUNK_STEP <= BTP_PACING_MAX_CHUNK_SIZE) {
+            chunkSize += BTP_PACING_CHUNK_STEP;
+        }
+    }
+}
+
+uint32_t KodakStepPacer::getShortWriteCount() const {
+    return shortWrites;
+}
+
+uint32_t KodakStepPacer::getStallCount() const {
+    return stalls;
+}
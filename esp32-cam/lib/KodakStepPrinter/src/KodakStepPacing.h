@@ -0,0 +1,63 @@
+#ifndef KODAK_STEP_PACING_H
+#define KODAK_STEP_PACING_H
+
+#include <Arduino.h>
+#include "KodakStepProtocol.h"
+
+// Adaptive pacing limits
+#define BTP_PACING_MIN_CHUNK_SIZE 1024
+#define BTP_PACING_MAX_CHUNK_SIZE 16384
+#define BTP_PACING_CHUNK_STEP 1024
+#define BTP_PACING_MAX_DELAY_MS 100
+#define BTP_PACING_STALL_US 40000       // write() blocked this long = SPP TX queue full
+#define BTP_PACING_GROW_AFTER 4         // Clean writes needed before growing the chunk
+#define BTP_PACING_MAX_SHORT_WRITES 8   // Consecutive short writes before giving up
+
+// Image transfer pacing profiles
+enum KodakPacingMode {
+    KODAK_PACING_FIXED,     // BTP_CHUNK_SIZE chunks, BTP_INTER_CHUNK_DELAY_MS gap (conservative)
+    KODAK_PACING_ADAPTIVE   // Chunk size and gap follow SPP write backpressure
+};
+
+/**
+ * Chunk size / inter-chunk delay controller for image transfer
+ *
+ * BluetoothSerial::write() queues data for the SPP stack and only blocks when
+ * that TX queue is full, returning a short count if it stays full. The time
+ * spent inside write() and short writes are therefore the backpressure signals:
+ *   - short write:  multiplicative decrease (halve chunk, double delay)
+ *   - stalled write: queue is full and the link is the bottleneck, so drop the
+ *                    sleep and shrink the chunk to keep each call short
+ *   - clean writes:  additive increase of chunk size, halve the delay
+ *
+ * In KODAK_PACING_FIXED mode the controller always returns the protocol
+ * defaults and ignores feedback.
+ */
+class KodakStepPacer {
+public:
+    KodakStepPacer();
+
+    void reset(KodakPacingMode mode);
+    KodakPacingMode getMode() const;
+
+    // Current pacing decisions
+    size_t getChunkSize() const;
+    uint32_t getDelayMs() const;
+
+    // Feedback from one write() call
+    void onChunkWritten(size_t requested, size_t written, uint32_t elapsedUs);
+
+    // Counters since last reset
+    uint32_t getShortWriteCount() const;
+    uint32_t getStallCount() const;
+
+private:
+    KodakPacingMode mode;
+    size_t chunkSize;
+    uint32_t delayMs;
+    uint8_t cleanWrites;
+    uint32_t shortWrites;
+    uint32_t stalls;
+};
+
+#endif // KODAK_STEP_PACING_H
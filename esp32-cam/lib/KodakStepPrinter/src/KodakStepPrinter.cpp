@@ -1,17 +1,67 @@
 #include "KodakStepPrinter.h"
+#include <new>
+#include "esp_heap_caps.h"
+
+// Guards the discovery candidates against the Bluetooth task's scan callback
+static portMUX_TYPE scanLock = portMUX_INITIALIZER_UNLOCKED;
 
 KodakStepPrinter::KodakStepPrinter() {
     btSerial = nullptr;
+    link = nullptr;
     memset(&status, 0, sizeof(status));
     memset(lastError, 0, sizeof(lastError));
-    debugEnabled = true;  // Default to enabled for backward compatibility
+    lastErrorCode = BTP_ERR_SUCCESS;
+    debugEnabled = false;  // Serial output slows transfers; opt in with setDebugOutput()
+    logger = nullptr;
+    recorder = nullptr;
+    pacingMode = KODAK_PACING_ADAPTIVE;
+    integrityCheck = true;
+    metrics.reset();
+    statusCacheTtlMs = 0;
+    addressCacheEnabled = true;
+    scanFilter[0] = '\0';
+    candidateCount = 0;
+    scanDevicesHeard = 0;
+    scanning = false;
+    scanStrongMatch = false;
+    scanStartedAt = 0;
+    scanTimeoutMs = 0;
+    memset(scanCachedAddress, 0, sizeof(scanCachedAddress));
+    scanHaveCached = false;
+    discoveryCallback = nullptr;
+    discoveryContext = nullptr;
+    connectedToCachedAddress = false;
+    localName[0] = '\0';
+    suspended = false;
+    autoReconnect = false;
+    memset(&linkStats, 0, sizeof(linkStats));
+    haveLastAddress = false;
+    reconnectAttempts = 0;
+    reconnectAt = 0;
+    linkDownSince = 0;
+    memset(&request, 0, sizeof(request));
+    request.state = ASYNC_IDLE;
+    memset(&lastResult, 0, sizeof(lastResult));
+    quietUntil = millis();
+    rxStream = nullptr;
+    eventCallback = nullptr;
+    eventContext = nullptr;
+    lastEvent = KODAK_EVENT_NONE;
+    lastTransferEndedAt = 0;
+    pendingAckCount = 0;
+    writerTask = nullptr;
+    writerRunning = false;
+    writerCore = -1;
 }
 
 KodakStepPrinter::~KodakStepPrinter() {
+    stopDiscovery();
     disconnect();
-    if (btSerial != nullptr) {
-        delete btSerial;
-        btSerial = nullptr;
+    stopWriterTask();
+    destroyBluetooth();
+    if (rxStream != nullptr) {
+        vStreamBufferDelete(rxStream);
+        rxStream = nullptr;
     }
 }
 
@@ -23,39 +73,86 @@ bool KodakStepPrinter::getDebugOutput() const {
     return debugEnabled;
 }
 
-void KodakStepPrinter::debugPrint(const char* msg) {
-    if (debugEnabled) {
-        Serial.print(msg);
-    }
+void KodakStepPrinter::setLogger(KodakStepLog* log) {
+    logger = log;
 }
 
-void KodakStepPrinter::debugPrintln(const char* msg) {
-    if (debugEnabled) {
-        Serial.println(msg);
-    }
+KodakStepLog* KodakStepPrinter::getLogger() const {
+    return logger;
+}
+
+void KodakStepPrinter::setRecorder(KodakSessionRecorder* sessionRecorder) {
+    recorder = sessionRecorder;
+}
+
+KodakSessionRecorder* KodakStepPrinter::getRecorder() const {
+    return recorder;
+}
+
+void KodakStepPrinter::setPacingMode(KodakPacingMode mode) {
+    pacingMode = mode;
+}
+
+KodakPacingMode KodakStepPrinter::getPacingMode() const {
+    return pacingMode;
+}
+
+void KodakStepPrinter::setIntegrityCheck(bool enabled) {
+    integrityCheck = enabled;
+}
+
+bool KodakStepPrinter::getIntegrityCheck() const {
+    return integrityCheck;
+}
+
+void KodakStepPrinter::setStatusCacheTtl(uint32_t ttlMs) {
+    statusCacheTtlMs = ttlMs;
+}
+
+uint32_t KodakStepPrinter::getStatusCacheTtl() const {
+    return statusCacheTtlMs;
+}
+
+void KodakStepPrinter::invalidateStatusCache() {
+    status.battery_updated_ms = 0;
+    status.charging_updated_ms = 0;
+    status.paper_updated_ms = 0;
+    status.print_count_updated_ms = 0;
+    status.auto_power_off_updated_ms = 0;
 }
 
 bool KodakStepPrinter::begin(const char* deviceName) {
-    if (btSerial != nullptr) {
-        delete btSerial;
-        btSerial = nullptr;
-    }
+    destroyBluetooth();
 
-    btSerial = new (std::nothrow) BluetoothSerial();
-    if (btSerial == nullptr) {
-        setError("Failed to allocate BluetoothSerial (out of memory)");
-        return false;
-    }
+    // Lives inside the printer object, so begin() never touches the heap for it
+    btSerial = new (btSerialStorage) BluetoothSerial();
+    link = btSerial;
+    strncpy(localName, deviceName, sizeof(localName) - 1);
+    localName[sizeof(localName) - 1] = '\0';
 
     // Initialize in master mode (second param = true) to connect to printer
     if (!btSerial->begin(deviceName, true)) {
         setError("Failed to initialize Bluetooth");
-        delete btSerial;
-        btSerial = nullptr;
+        destroyBluetooth();
         return false;
     }
 
-    if (debugEnabled) {
+    // Route incoming SPP data into a stream buffer so the receiver sleeps until
+    // bytes arrive and reads them in bulk. Without it, fall back to polling.
+    if (rxStream == nullptr) {
+        rxStream = xStreamBufferCreate(BTP_RX_BUFFER_SIZE, 1);
+    }
+    if (rxStream != nullptr) {
+        btSerial->onData([this](const uint8_t* data, size_t length) {
+            onBluetoothData(data, length);
+        });
+    } else {
+        debugPrintln("Warning: no RX stream buffer, using polled receive");
+    }
+
+    suspended = false;
+
+    if (BTP_LOG_ENABLED(BTP_LOG_INFO, debugEnabled)) {
         Serial.print("Bluetooth initialized as: ");
         Serial.println(deviceName);
     }
@@ -68,11 +165,12 @@ bool KodakStepPrinter::connect(const char* printerAddress) {
         return false;
     }
 
-    if (debugEnabled) {
+    if (BTP_LOG_ENABLED(BTP_LOG_INFO, debugEnabled)) {
         Serial.print("Connecting to printer at address: ");
         Serial.println(printerAddress);
     }
 
+    uint32_t connectStart = millis();
     if (!btSerial->connect(printerAddress)) {
         setError("Failed to connect to printer");
         return false;
@@ -80,11 +178,53 @@ bool KodakStepPrinter::connect(const char* printerAddress) {
 
     delay(500);  // Initial connection delay
     yield();
+    metrics.connect_ms = millis() - connectStart;
     status.is_connected = true;
+    connectedToCachedAddress = false;
+    haveLastAddress = false;  // Reconnect through BluetoothSerial's remembered peer
+    invalidateStatusCache();  // May be a different printer than last time
     debugPrintln("Connected to printer");
     return true;
 }
 
+bool KodakStepPrinter::connect(const BTAddress& address) {
+    if (btSerial == nullptr) {
+        setError("Bluetooth not initialized. Call begin() first.");
+        return false;
+    }
+
+    if (BTP_LOG_ENABLED(BTP_LOG_INFO, debugEnabled)) {
+        Serial.print("Connecting to address: ");
+        Serial.println(address.toString().c_str());
+    }
+    return connectToAddress(address);
+}
+
+// Same "aa:bb:cc:dd:ee:ff" form as BTAddress::toString(), without the std::string
+static void formatAddress(const BTAddress& address, char* text, size_t textSize) {
+    const uint8_t* bytes = (const uint8_t*)address.getNative();
+    snprintf(text, textSize, "%02x:%02x:%02x:%02x:%02x:%02x",
+             bytes[0], bytes[1], bytes[2], bytes[3], bytes[4], bytes[5]);
+}
+
+// Case-insensitive substring search without String allocations
+static bool nameContains(const char* name, const char* searchLower) {
+    size_t nameLen = strlen(name);
+    size_t searchLen = strlen(searchLower);
+    for (size_t j = 0; j + searchLen <= nameLen; j++) {
+        bool subMatch = true;
+        for (size_t k = 0; k < searchLen && subMatch; k++) {
+            if (tolower(name[j + k]) != searchLower[k]) {
+                subMatch = false;
+            }
+        }
+        if (subMatch) {
+            return true;
+        }
+    }
+    return false;
+}
+
 bool KodakStepPrinter::connectByName(const char* printerName) {
     if (btSerial == nullptr) {
         setError("Bluetooth not initialized. Call begin() first.");
@@ -96,101 +236,316 @@ bool KodakStepPrinter::connectByName(const char* printerName) {
         return false;
     }
 
+    setScanFilter(printerName);
+
+    // Fast path: reconnect straight to the printer we used last time
+    BTAddress cachedAddress;
+    if (loadCachedAddress(scanFilter, &cachedAddress)) {
+        if (BTP_LOG_ENABLED(BTP_LOG_INFO, debugEnabled)) {
+            Serial.print("Trying cached printer address: ");
+            Serial.println(cachedAddress.toString().c_str());
+        }
+        if (connectToAddress(cachedAddress)) {
+            connectedToCachedAddress = true;
+            return true;
+        }
+        debugPrintln("Cached address failed, falling back to discovery");
+    }
+
+    if (!discoverByName(printerName)) {
+        return false;
+    }
+
+    // Strongest link first; a printer that is heard but will not connect
+    // gives way to the next best
+    KodakDiscoveredPrinter ranked[BTP_SCAN_CONNECT_TRIES];
+    size_t count = getDiscoveredPrinters(ranked, BTP_SCAN_CONNECT_TRIES);
+    for (size_t i = 0; i < count; i++) {
+        if (BTP_LOG_ENABLED(BTP_LOG_INFO, debugEnabled)) {
+            Serial.print("Connecting to address: ");
+            Serial.print(ranked[i].address.toString().c_str());
+            Serial.print(" (");
+            Serial.print(ranked[i].rssi);
+            Serial.println(" dBm)");
+        }
+        if (connectToAddress(ranked[i].address)) {
+            saveCachedAddress(ranked[i].address, ranked[i].name);
+            connectedToCachedAddress = true;
+            return true;
+        }
+    }
+    return false;
+}
+
+void KodakStepPrinter::setScanFilter(const char* printerName) {
+    // Pre-convert search string to lowercase once (avoid repeated allocations)
+    size_t searchLen = strlen(printerName);
+    if (searchLen >= sizeof(scanFilter)) {
+        searchLen = sizeof(scanFilter) - 1;
+    }
+    for (size_t i = 0; i < searchLen; i++) {
+        scanFilter[i] = tolower(printerName[i]);
+    }
+    scanFilter[searchLen] = '\0';
+}
+
+bool KodakStepPrinter::discoverByName(const char* printerName) {
+    if (!discoverAsync(printerName)) {
+        return false;
+    }
+    while (pollDiscovery()) {
+        delay(50);
+    }
+
+    if (candidateCount == 0) {
+        setError("Printer not found in scan");
+        return false;
+    }
+    return true;
+}
+
+// =============================================================================
+// Discovery
+// =============================================================================
+
+bool KodakStepPrinter::discoverAsync(const char* printerName, KodakDiscoveryCallback callback,
+                                     void* context, uint32_t timeoutMs) {
+    if (btSerial == nullptr) {
+        setError("Bluetooth not initialized. Call begin() first.");
+        return false;
+    }
+    if (printerName == nullptr) {
+        setError("Printer name cannot be null");
+        return false;
+    }
+
+    stopDiscovery();
+    setScanFilter(printerName);
+
+    // Read NVS here, not from the scan callback on the Bluetooth task
+    BTAddress cachedAddress;
+    scanHaveCached = loadCachedAddress(scanFilter, &cachedAddress) &&
+                     cachedAddress.getNative() != nullptr;
+    if (scanHaveCached) {
+        memcpy(scanCachedAddress, cachedAddress.getNative(), sizeof(scanCachedAddress));
+    }
+
+    portENTER_CRITICAL(&scanLock);
+    candidateCount = 0;
+    scanDevicesHeard = 0;
+    scanStrongMatch = false;
+    discoveryCallback = callback;
+    discoveryContext = context;
+    portEXIT_CRITICAL(&scanLock);
+
     debugPrintln("\n=== Bluetooth Discovery ===");
-    if (debugEnabled) {
+    if (BTP_LOG_ENABLED(BTP_LOG_INFO, debugEnabled)) {
         Serial.print("Searching for device containing: ");
         Serial.println(printerName);
     }
 
-    // Scan for devices first
-    debugPrintln("Starting Bluetooth scan...");
-    BTScanResults* scanResults = btSerial->discover(10000);  // 10 second scan
-
-    if (scanResults == nullptr) {
-        debugPrintln("ERROR: Scan returned null");
+    scanning = true;
+    scanStartedAt = millis();
+    scanTimeoutMs = timeoutMs;
+    if (!btSerial->discoverAsync([this](BTAdvertisedDevice* device) {
+            onDeviceDiscovered(device);
+        }, timeoutMs)) {
+        scanning = false;
+        debugPrintln("ERROR: Scan failed to start");
         setError("Bluetooth scan failed");
         return false;
     }
+    return true;
+}
 
-    int count = scanResults->getCount();
-    if (debugEnabled) {
-        Serial.print("Found ");
-        Serial.print(count);
-        Serial.println(" Bluetooth devices:");
+bool KodakStepPrinter::pollDiscovery() {
+    if (!scanning) {
+        return false;
+    }
+    logCandidates();
+    if (!scanStrongMatch && millis() - scanStartedAt < scanTimeoutMs) {
+        return true;
     }
+    stopDiscovery();
+    return false;
+}
 
-    BTAddress targetAddress;
-    bool found = false;
+void KodakStepPrinter::stopDiscovery() {
+    if (!scanning) {
+        return;
+    }
+    scanning = false;
+    if (btSerial == nullptr) {
+        return;
+    }
+    btSerial->discoverStop();
+    metrics.discovery_ms = millis() - scanStartedAt;
+    logCandidates();
 
-    // Pre-convert search string to lowercase once (avoid repeated allocations)
-    size_t searchLen = strlen(printerName);
-    char* searchLower = (char*)alloca(searchLen + 1);  // Stack allocation
-    for (size_t i = 0; i <= searchLen; i++) {
-        searchLower[i] = tolower(printerName[i]);
-    }
-
-    for (int i = 0; i < count; i++) {
-        BTAdvertisedDevice* device = scanResults->getDevice(i);
-        if (device) {
-            // Use C strings directly to avoid String heap allocations
-            const char* name = device->getName().c_str();
-            const char* addr = device->getAddress().toString().c_str();
-
-            if (debugEnabled) {
-                Serial.print("  [");
-                Serial.print(i);
-                Serial.print("] ");
-                Serial.print(addr);
-                Serial.print(" - \"");
-                Serial.print(name);
-                Serial.println("\"");
-            }
+    if (BTP_LOG_ENABLED(BTP_LOG_INFO, debugEnabled)) {
+        Serial.print("Scan finished after ");
+        Serial.print(metrics.discovery_ms);
+        Serial.print(" ms, ");
+        Serial.print((unsigned)scanDevicesHeard);
+        Serial.print(" devices, ");
+        Serial.print((unsigned)candidateCount);
+        Serial.println(" matches");
+    }
+    debugPrintln("=== End Discovery ===\n");
+}
 
-            // Case-insensitive substring search without String allocations
-            size_t nameLen = strlen(name);
-            bool match = false;
-            for (size_t j = 0; j + searchLen <= nameLen && !match; j++) {
-                bool subMatch = true;
-                for (size_t k = 0; k < searchLen && subMatch; k++) {
-                    if (tolower(name[j + k]) != searchLower[k]) {
-                        subMatch = false;
-                    }
-                }
-                if (subMatch) {
-                    match = true;
-                }
-            }
+void KodakStepPrinter::logCandidates() {
+    if (!BTP_LOG_ENABLED(BTP_LOG_INFO, debugEnabled || logger != nullptr)) {
+        return;
+    }
 
-            if (match) {
-                debugPrintln("      ^ MATCH FOUND!");
-                targetAddress = device->getAddress();
-                found = true;
-                break;
-            }
+    KodakDiscoveredPrinter fresh[BTP_SCAN_MAX_CANDIDATES];
+    size_t freshCount = 0;
+    portENTER_CRITICAL(&scanLock);
+    for (size_t i = 0; i < candidateCount; i++) {
+        if (candidateUnlogged[i]) {
+            fresh[freshCount++] = candidates[i];
+            candidateUnlogged[i] = false;
         }
-        yield();  // Allow other tasks during scan processing
     }
-    debugPrintln("=== End Discovery ===\n");
+    portEXIT_CRITICAL(&scanLock);
+
+    for (size_t i = 0; i < freshCount; i++) {
+        if (BTP_LOG_ENABLED(BTP_LOG_INFO, debugEnabled)) {
+            char address[18];
+            formatAddress(fresh[i].address, address, sizeof(address));
+            Serial.print("  ");
+            Serial.print(address);
+            Serial.print(" - \"");
+            Serial.print(fresh[i].name);
+            Serial.print("\" ");
+            Serial.print(fresh[i].rssi);
+            Serial.println(" dBm");
+        }
+        debugPrintln(fresh[i].score >= BTP_SCAN_STRONG_SCORE ? "      ^ STRONG MATCH" : "      ^ MATCH");
+    }
+}
 
-    if (!found) {
-        setError("Printer not found in scan");
-        return false;
+bool KodakStepPrinter::isDiscovering() const {
+    return scanning;
+}
+
+size_t KodakStepPrinter::getDiscoveredPrinters(KodakDiscoveredPrinter* printers,
+                                               size_t maxPrinters) const {
+    KodakDiscoveredPrinter snapshot[BTP_SCAN_MAX_CANDIDATES];
+    portENTER_CRITICAL(&scanLock);
+    size_t count = candidateCount;
+    for (size_t i = 0; i < count; i++) {
+        snapshot[i] = candidates[i];
+    }
+    portEXIT_CRITICAL(&scanLock);
+
+    // Insertion sort, best score first; ties keep the order they were heard in
+    for (size_t i = 1; i < count; i++) {
+        KodakDiscoveredPrinter candidate = snapshot[i];
+        size_t j = i;
+        while (j > 0 && snapshot[j - 1].score < candidate.score) {
+            snapshot[j] = snapshot[j - 1];
+            j--;
+        }
+        snapshot[j] = candidate;
     }
 
-    if (debugEnabled) {
-        Serial.print("Connecting to address: ");
-        Serial.println(targetAddress.toString().c_str());
+    if (count > maxPrinters) {
+        count = maxPrinters;
+    }
+    for (size_t i = 0; i < count; i++) {
+        printers[i] = snapshot[i];
     }
+    return count;
+}
+
+int16_t KodakStepPrinter::scoreCandidate(int8_t rssi, bool cached) {
+    // A printer known to work beats a slightly stronger stranger
+    return (int16_t)rssi + (cached ? BTP_SCAN_CACHED_BONUS : 0);
+}
+
+void KodakStepPrinter::onDeviceDiscovered(BTAdvertisedDevice* device) {
+    // Runs on the Bluetooth task: no Serial and no logger here, only the
+    // locked candidate table. Unnamed devices can't match, so skip them
+    // before getName() copies anything.
+    if (device == nullptr || !scanning || !device->haveName()) {
+        return;
+    }
+    scanDevicesHeard++;
+
+    std::string name = device->getName();
+    int8_t rssi = device->haveRSSI() ? device->getRSSI() : BTP_SCAN_UNKNOWN_RSSI;
+
+    if (!nameContains(name.c_str(), scanFilter)) {
+        return;
+    }
+
+    KodakDiscoveredPrinter found;
+    found.address = device->getAddress();
+    strncpy(found.name, name.c_str(), sizeof(found.name) - 1);
+    found.name[sizeof(found.name) - 1] = '\0';
+    found.rssi = rssi;
+    const uint8_t* native = (const uint8_t*)found.address.getNative();
+    found.cached = scanHaveCached && native != nullptr &&
+                   memcmp(native, scanCachedAddress, sizeof(scanCachedAddress)) == 0;
+    found.score = scoreCandidate(rssi, found.cached);
+
+    // Inquiry can report a device more than once; keep one entry per address
+    bool kept = false;
+    portENTER_CRITICAL(&scanLock);
+    size_t slot = candidateCount;
+    for (size_t i = 0; i < candidateCount; i++) {
+        const uint8_t* other = (const uint8_t*)candidates[i].address.getNative();
+        if (native != nullptr && other != nullptr && memcmp(native, other, sizeof(scanCachedAddress)) == 0) {
+            slot = i;
+            break;
+        }
+    }
+    if (slot == candidateCount && candidateCount == BTP_SCAN_MAX_CANDIDATES) {
+        // Table full: replace the weakest, if this one is better
+        slot = 0;
+        for (size_t i = 1; i < candidateCount; i++) {
+            if (candidates[i].score < candidates[slot].score) {
+                slot = i;
+            }
+        }
+        if (candidates[slot].score >= found.score) {
+            slot = BTP_SCAN_MAX_CANDIDATES;
+        }
+    }
+    if (slot < BTP_SCAN_MAX_CANDIDATES) {
+        candidates[slot] = found;
+        candidateUnlogged[slot] = true;
+        if (slot == candidateCount) {
+            candidateCount++;
+        }
+        if (found.score >= BTP_SCAN_STRONG_SCORE) {
+            scanStrongMatch = true;
+        }
+        kept = true;
+    }
+    KodakDiscoveryCallback callback = discoveryCallback;
+    void* context = discoveryContext;
+    portEXIT_CRITICAL(&scanLock);
+
+    if (kept && callback != nullptr) {
+        callback(found, context);
+    }
+}
+
+bool KodakStepPrinter::connectToAddress(const BTAddress& address, uint32_t settleMs) {
+    uint32_t connectStart = millis();
 
     // Connect using the BTAddress directly
-    if (!btSerial->connect(targetAddress)) {
+    if (!btSerial->connect(address)) {
         debugPrintln("connect() returned false");
         setError("Failed to connect to printer");
         return false;
     }
 
     debugPrintln("connect() returned true, waiting...");
-    delay(1000);  // Initial connection delay
+    delay(settleMs);  // Initial connection delay
     yield();
 
     // Verify connection
@@ -200,362 +555,1588 @@ bool KodakStepPrinter::connectByName(const char* printerName) {
         return false;
     }
 
+    metrics.connect_ms = millis() - connectStart;
     status.is_connected = true;
+    connectedToCachedAddress = false;
+    lastAddress = address;
+    haveLastAddress = true;
+    invalidateStatusCache();
     debugPrintln("Connected to printer successfully!");
     return true;
 }
 
-void KodakStepPrinter::disconnect() {
-    if (btSerial != nullptr && status.is_connected) {
-        btSerial->disconnect();
-        status.is_connected = false;
-        debugPrintln("Disconnected from printer");
-    }
+// =============================================================================
+// Printer address cache (NVS)
+// =============================================================================
+
+void KodakStepPrinter::setAddressCacheEnabled(bool enabled) {
+    addressCacheEnabled = enabled;
 }
 
-bool KodakStepPrinter::isConnected() {
-    return status.is_connected && (btSerial != nullptr) && btSerial->connected();
+bool KodakStepPrinter::getAddressCacheEnabled() const {
+    return addressCacheEnabled;
 }
 
-bool KodakStepPrinter::initialize(bool isSlimDevice, uint8_t* rawResponse) {
-    if (!isConnected()) {
-        setError("Not connected to printer");
+bool KodakStepPrinter::getCachedSlimDevice(bool* isSlimDevice) {
+    Preferences prefs;
+    if (!addressCacheEnabled || !prefs.begin(BTP_CACHE_NAMESPACE, true)) {
         return false;
     }
 
-    uint8_t command[BTP_PACKET_SIZE];
-    uint8_t response[BTP_PACKET_SIZE];
-
-    // Send GET_ACCESSORY_INFO
-    protocol.buildGetAccessoryInfoPacket(command, isSlimDevice);
+    char address[18];
+    bool cached = prefs.getString("addr", address, sizeof(address)) > 0;
+    if (cached && isSlimDevice != nullptr) {
+        *isSlimDevice = prefs.getBool("slim", false);
+    }
+    prefs.end();
+    return cached;
+}
 
-    debugPrintln("Sending GET_ACCESSORY_INFO...");
-    if (debugEnabled) {
-        protocol.printPacketHex(command, BTP_PACKET_SIZE, debugEnabled);
+void KodakStepPrinter::clearAddressCache() {
+    Preferences prefs;
+    if (prefs.begin(BTP_CACHE_NAMESPACE, false)) {
+        prefs.clear();
+        prefs.end();
     }
+}
 
-    if (!sendAndReceive(command, response)) {
-        setError("Failed to get accessory info");
+bool KodakStepPrinter::loadCachedAddress(const char* printerName, BTAddress* address) {
+    Preferences prefs;
+    if (!addressCacheEnabled || !prefs.begin(BTP_CACHE_NAMESPACE, true)) {
         return false;
     }
 
-    // Copy raw response if requested
-    if (rawResponse != nullptr) {
-        memcpy(rawResponse, response, BTP_PACKET_SIZE);
-    }
+    char cachedAddress[18];
+    char cachedName[BTP_CACHE_NAME_SIZE];
+    bool found = prefs.getString("addr", cachedAddress, sizeof(cachedAddress)) > 0 &&
+                 prefs.getString("name", cachedName, sizeof(cachedName)) > 0;
+    prefs.end();
 
-    uint8_t errorCode;
-    if (!protocol.parseResponse(response, &errorCode)) {
-        setError(protocol.getErrorString(errorCode));
-        status.error_code = errorCode;
+    // Only reuse the entry if it still answers to the requested name
+    if (!found || !nameContains(cachedName, printerName)) {
         return false;
     }
 
-    status.is_slim_device = isSlimDevice;
-    status.error_code = BTP_ERR_SUCCESS;
-
-    debugPrintln("Printer initialized successfully");
-    delay(500);  // Wait after initialization
-    yield();
+    *address = BTAddress(std::string(cachedAddress));
     return true;
 }
 
-bool KodakStepPrinter::getBatteryLevel(uint8_t* level, uint8_t* rawResponse) {
-    if (level == nullptr) {
-        setError("Output parameter 'level' cannot be null");
-        return false;
+void KodakStepPrinter::saveCachedAddress(const BTAddress& address, const char* deviceName) {
+    Preferences prefs;
+    if (!addressCacheEnabled || !prefs.begin(BTP_CACHE_NAMESPACE, false)) {
+        return;
     }
 
-    if (!isConnected()) {
-        setError("Not connected to printer");
-        return false;
-    }
+    char text[18];
+    formatAddress(address, text, sizeof(text));
 
-    uint8_t command[BTP_PACKET_SIZE];
-    uint8_t response[BTP_PACKET_SIZE];
+    char previous[18];
+    if (prefs.getString("addr", previous, sizeof(previous)) == 0 ||
+        strcmp(previous, text) != 0) {
+        // Different printer - its slim flag is unknown until initialize()
+        prefs.putString("addr", text);
+        prefs.putBool("slim", false);
+    }
+    prefs.putString("name", deviceName);
+    prefs.end();
+}
 
-    // Battery level is in byte 12 of GET_ACCESSORY_INFO response
-    // Note: GET_BATTERY_LEVEL (0x0E) returns charging status, not battery percentage
-    protocol.buildGetAccessoryInfoPacket(command, status.is_slim_device);
+void KodakStepPrinter::saveCachedSlimDevice(bool isSlimDevice) {
+    Preferences prefs;
+    // Only the printer behind the cached address owns the cached flag
+    if (!addressCacheEnabled || !connectedToCachedAddress ||
+        !prefs.begin(BTP_CACHE_NAMESPACE, false)) {
+        return;
+    }
 
-    if (!sendAndReceive(command, response)) {
-        setError("Failed to get battery level");
-        return false;
+    // Skip the flash write when nothing changed
+    if (prefs.getBool("slim", false) != isSlimDevice) {
+        prefs.putBool("slim", isSlimDevice);
     }
+    prefs.end();
+}
 
-    if (rawResponse != nullptr) {
-        memcpy(rawResponse, response, BTP_PACKET_SIZE);
+void KodakStepPrinter::disconnect() {
+    if (isBusy()) {
+        completeRequest(false, "Not connected to printer");
     }
 
-    *level = response[12];
-    status.battery_level = *level;
+    invalidateStatusCache();
 
-    delay(100);
-    yield();
-    return true;
+    if (link != nullptr && status.is_connected) {
+        if (btSerial != nullptr) {
+            btSerial->disconnect();
+        }
+        status.is_connected = false;
+        debugPrintln("Disconnected from printer");
+    }
 }
 
-bool KodakStepPrinter::getChargingStatus(bool* isCharging, uint8_t* rawResponse) {
-    if (isCharging == nullptr) {
-        setError("Output parameter 'isCharging' cannot be null");
-        return false;
-    }
+bool KodakStepPrinter::isConnected() {
+    return status.is_connected && linkConnected();
+}
 
-    if (!isConnected()) {
-        setError("Not connected to printer");
-        return false;
+void KodakStepPrinter::attachLink(Stream& stream) {
+    stopDiscovery();
+    disconnect();
+    stopWriterTask();
+    destroyBluetooth();
+    // An attached link is polled; nothing would feed the SPP stream buffer
+    if (rxStream != nullptr) {
+        vStreamBufferDelete(rxStream);
+        rxStream = nullptr;
     }
 
-    uint8_t command[BTP_PACKET_SIZE];
-    uint8_t response[BTP_PACKET_SIZE];
-
-    // GET_BATTERY_LEVEL (0x0E) returns charging status in byte 8 (1 = charging)
-    protocol.buildGetBatteryLevelPacket(command);
+    link = &stream;
+    rxFrame.reset();
+    status.is_connected = true;
+    invalidateStatusCache();
+}
 
-    if (!sendAndReceive(command, response)) {
-        setError("Failed to get charging status");
-        return false;
+void KodakStepPrinter::detachLink() {
+    if (link == nullptr || btSerial != nullptr) {
+        return;     // Bluetooth, or nothing attached
     }
+    disconnect();
+    link = nullptr;
+}
 
-    if (rawResponse != nullptr) {
-        memcpy(rawResponse, response, BTP_PACKET_SIZE);
-    }
+bool KodakStepPrinter::linkConnected() {
+    // An attached stream has no connection state of its own
+    return link != nullptr && (btSerial == nullptr || btSerial->connected());
+}
 
-    // Byte 8 contains charging status: 1 = charging, 0 = not charging
-    *isCharging = (response[8] == 1);
+// =============================================================================
+// Link supervisor
+// =============================================================================
 
-    delay(100);
-    yield();
-    return true;
+void KodakStepPrinter::setAutoReconnect(bool enabled) {
+    autoReconnect = enabled;
 }
 
-bool KodakStepPrinter::checkPaperStatus() {
-    if (!isConnected()) {
-        setError("Not connected to printer");
-        return false;
-    }
+bool KodakStepPrinter::getAutoReconnect() const {
+    return autoReconnect;
+}
 
-    uint8_t command[BTP_PACKET_SIZE];
-    uint8_t response[BTP_PACKET_SIZE];
+const KodakLinkStats& KodakStepPrinter::getLinkStats() const {
+    return linkStats;
+}
 
-    protocol.buildGetPageTypePacket(command);
+const KodakPrinterMetrics& KodakStepPrinter::getMetrics() const {
+    return metrics;
+}
 
-    debugPrintln("Checking paper status...");
+void KodakStepPrinter::resetMetrics() {
+    metrics.reset();
+}
 
-    if (!sendAndReceive(command, response)) {
-        setError("Failed to check paper status");
-        return false;
-    }
+bool KodakStepPrinter::linkLost() {
+    // status.is_connected is cleared on an explicit disconnect, so only an
+    // unexpected drop gets here
+    return status.is_connected && link != nullptr && !linkConnected();
+}
 
-    uint8_t errorCode;
-    if (!protocol.parseResponse(response, &errorCode)) {
-        setError(protocol.getErrorString(errorCode));
-        status.error_code = errorCode;
-        return false;
+bool KodakStepPrinter::failRequest(const char* error) {
+    if (link != nullptr && !linkConnected()) {
+        return onLinkDropped(error);
     }
-
-    debugPrintln("Paper status OK");
-    delay(100);
-    yield();
-    return true;
+    completeRequest(false, error);
+    return false;
 }
 
-bool KodakStepPrinter::getPrintCount(uint16_t* count) {
-    if (count == nullptr) {
-        setError("Output parameter 'count' cannot be null");
-        return false;
-    }
+bool KodakStepPrinter::onLinkDropped(const char* error) {
+    waitForWriter();    // Before the source rewinds under an unfinished write()
+    status.is_connected = false;
+    invalidateStatusCache();
+    linkStats.drops++;
+    linkDownSince = millis();
+    pendingAckCount = 0;    // Those events belong to the dead connection
+    debugPrintln("Bluetooth link lost");
 
-    if (!isConnected()) {
-        setError("Not connected to printer");
-        return false;
+    bool resumable = autoReconnect && isBusy() && request.type == KODAK_REQUEST_PRINT &&
+                     request.source->rewind();
+    if (isBusy() && !resumable) {
+        completeRequest(false, error);
     }
 
-    uint8_t command[BTP_PACKET_SIZE];
-    uint8_t response[BTP_PACKET_SIZE];
-
-    protocol.buildGetPrintCountPacket(command);
-
-    if (!sendAndReceive(command, response)) {
-        setError("Failed to get print count");
+    if (!autoReconnect) {
         return false;
     }
 
-    *count = protocol.parsePrintCount(response);
+    if (resumable) {
+        debugPrintln("Print job will restart after reconnect");
+    } else {
+        // Nothing to resume, but bring the link back for the next request
+        request.type = KODAK_REQUEST_RECONNECT;
+        request.callback = nullptr;
+        request.source = nullptr;
+    }
 
-    delay(100);
-    yield();
+    reconnectAttempts = 0;
+    reconnectAt = millis();
+    request.state = ASYNC_RECONNECT;
     return true;
 }
 
-bool KodakStepPrinter::getAutoPowerOff(uint8_t* minutes) {
-    if (minutes == nullptr) {
-        setError("Output parameter 'minutes' cannot be null");
+bool KodakStepPrinter::attemptReconnect() {
+    reconnectAttempts++;
+    if (BTP_LOG_ENABLED(BTP_LOG_INFO, debugEnabled)) {
+        Serial.print("Reconnect attempt ");
+        Serial.print(reconnectAttempts);
+        Serial.print(" of ");
+        Serial.println(BTP_RECONNECT_MAX_ATTEMPTS);
+    }
+
+    bool cachedLink = connectedToCachedAddress;
+    bool connected;
+    if (haveLastAddress) {
+        connected = connectToAddress(lastAddress);
+    } else {
+        connected = btSerial->connect() && btSerial->connected();
+        status.is_connected = connected;
+    }
+
+    if (connected) {
+        connectedToCachedAddress = cachedLink;
+        uint32_t downtime = millis() - linkDownSince;
+        linkStats.reconnects++;
+        linkStats.lastDowntimeMs = downtime;
+        linkStats.totalDowntimeMs += downtime;
+        if (BTP_LOG_ENABLED(BTP_LOG_INFO, debugEnabled)) {
+            Serial.print("Reconnected after ");
+            Serial.print(downtime);
+            Serial.println(" ms");
+        }
+
+        if (request.type == KODAK_REQUEST_PRINT) {
+            // Battery and paper may have changed while the link was down
+            linkStats.resumedJobs++;
+            debugPrintln("Restarting interrupted print job");
+            beginStep(nextPreflightStep(STEP_ACCESSORY_INFO));
+            return true;
+        }
+
+        request.state = ASYNC_IDLE;
         return false;
     }
 
-    if (!isConnected()) {
-        setError("Not connected to printer");
+    if (reconnectAttempts >= BTP_RECONNECT_MAX_ATTEMPTS) {
+        linkStats.failedReconnects++;
+        completeRequest(false, "Reconnect to printer failed");
         return false;
     }
 
-    uint8_t command[BTP_PACKET_SIZE];
-    uint8_t response[BTP_PACKET_SIZE];
+    uint32_t backoff = BTP_RECONNECT_BASE_DELAY_MS << (reconnectAttempts - 1);
+    if (backoff > BTP_RECONNECT_MAX_DELAY_MS) {
+        backoff = BTP_RECONNECT_MAX_DELAY_MS;
+    }
+    reconnectAt = millis() + backoff;
+    return true;
+}
 
-    protocol.buildGetAutoPowerOffPacket(command);
+// =============================================================================
+// Power saving
+// =============================================================================
 
-    if (!sendAndReceive(command, response)) {
-        setError("Failed to get auto power off setting");
+bool KodakStepPrinter::suspend() {
+    if (suspended) {
+        return true;
+    }
+    if (isBusy()) {
+        setError("Printer busy", BTP_ERR_BUSY);
         return false;
     }
 
-    *minutes = protocol.parseAutoPowerOff(response);
-
-    delay(100);
-    yield();
+    stopDiscovery();
+    disconnect();
+    // Tearing BluetoothSerial down stops Bluedroid and the controller
+    destroyBluetooth();
+    suspended = true;
+    debugPrintln("Bluetooth suspended");
     return true;
 }
 
-bool KodakStepPrinter::printImage(const uint8_t* jpegData, size_t dataSize, uint8_t numCopies,
-                                   KodakProgressCallback progressCallback) {
-    if (jpegData == nullptr) {
-        setError("Image data cannot be null");
-        return false;
+bool KodakStepPrinter::resume() {
+    if (!suspended) {
+        return isConnected();
     }
 
-    if (dataSize == 0) {
-        setError("Image data size cannot be zero");
+    uint32_t resumeStart = millis();
+    if (!begin(localName)) {
         return false;
     }
 
-    if (dataSize > BTP_MAX_IMAGE_SIZE) {
-        setError("Image data exceeds maximum size (2MB)");
+    if (!haveLastAddress) {
+        setError("No printer to resume; connect first");
         return false;
     }
 
-    if (!isConnected()) {
-        setError("Not connected to printer");
+    bool cachedLink = connectedToCachedAddress;
+    if (!connectToAddress(lastAddress, BTP_RESUME_SETTLE_MS)) {
         return false;
     }
+    connectedToCachedAddress = cachedLink;
+
+    // Model is known from before the suspend; a paper warning leaves the link usable
+    initialize(status.is_slim_device);
+    metrics.resume_ms = millis() - resumeStart;
+    return true;
+}
+
+bool KodakStepPrinter::isSuspended() const {
+    return suspended;
+}
+
+// =============================================================================
+// Blocking operations (thin wrappers over the request engine)
+// =============================================================================
+
+bool KodakStepPrinter::runToCompletion() {
+    // A supervisor-only reconnect left behind by a failed request runs from poll()
+    while (isBusy() && request.type != KODAK_REQUEST_RECONNECT) {
+        // Sleep until the engine can make progress instead of spinning
+        uint32_t waitMs = pollWaitMs();
+        if (waitMs > 0) {
+            delay(waitMs);
+        }
+
+        // While waiting for a response, block on the RX stream until data arrives
+        TickType_t rxWait = 0;
+        if (request.state == ASYNC_RECEIVE && rxStream != nullptr) {
+            int32_t remaining = (int32_t)(request.deadline - millis());
+            rxWait = (remaining > 0) ? pdMS_TO_TICKS(remaining) + 1 : 0;
+        }
+
+        advance(rxWait);
+        yield();  // Allow other tasks
+    }
+    return lastResult.success;
+}
 
-    // Check battery level
-    uint8_t battery;
-    if (!getBatteryLevel(&battery)) {
+bool KodakStepPrinter::initialize(bool isSlimDevice, uint8_t* rawResponse) {
+    if (!initializeAsync(isSlimDevice) || !runToCompletion()) {
         return false;
     }
 
-    if (battery < BTP_MIN_BATTERY_LEVEL) {
-        setError("Battery too low to print");
+    // Copy raw response if requested
+    if (rawResponse != nullptr) {
+        memcpy(rawResponse, request.response, BTP_PACKET_SIZE);
+    }
+
+    // Wait after initialization like the official app
+    runQuietPeriod();
+    return true;
+}
+
+bool KodakStepPrinter::getBatteryLevel(uint8_t* level, uint8_t* rawResponse) {
+    if (level == nullptr) {
+        setError("Output parameter 'level' cannot be null");
         return false;
     }
 
-    // Check paper status
-    if (!checkPaperStatus()) {
+    if (!getBatteryLevelAsync() || !runToCompletion()) {
         return false;
     }
 
-    // Send PRINT_READY command
-    uint8_t command[BTP_PACKET_SIZE];
-    uint8_t response[BTP_PACKET_SIZE];
+    if (rawResponse != nullptr) {
+        memcpy(rawResponse, request.response, BTP_PACKET_SIZE);
+    }
 
-    protocol.buildPrintReadyPacket(command, dataSize, numCopies);
+    *level = (uint8_t)lastResult.value;
+    return true;
+}
 
-    debugPrintln("Sending PRINT_READY...");
-    if (debugEnabled) {
-        Serial.print("Image size: ");
-        Serial.print(dataSize);
-        Serial.print(" bytes, copies: ");
-        Serial.println(numCopies);
+bool KodakStepPrinter::getChargingStatus(bool* isCharging, uint8_t* rawResponse) {
+    if (isCharging == nullptr) {
+        setError("Output parameter 'isCharging' cannot be null");
+        return false;
     }
 
-    if (!sendAndReceive(command, response)) {
-        setError("Failed to send PRINT_READY");
+    if (!getChargingStatusAsync() || !runToCompletion()) {
         return false;
     }
 
-    uint8_t errorCode;
-    if (!protocol.parseResponse(response, &errorCode)) {
-        setError(protocol.getErrorString(errorCode));
-        status.error_code = errorCode;
+    if (rawResponse != nullptr) {
+        memcpy(rawResponse, request.response, BTP_PACKET_SIZE);
+    }
+
+    *isCharging = (lastResult.value != 0);
+    return true;
+}
+
+bool KodakStepPrinter::checkPaperStatus() {
+    return checkPaperStatusAsync() && runToCompletion();
+}
+
+bool KodakStepPrinter::getPrintCount(uint16_t* count) {
+    if (count == nullptr) {
+        setError("Output parameter 'count' cannot be null");
         return false;
     }
 
-    delay(100);
-    yield();
+    if (!getPrintCountAsync() || !runToCompletion()) {
+        return false;
+    }
+
+    *count = (uint16_t)lastResult.value;
+    return true;
+}
+
+bool KodakStepPrinter::getAutoPowerOff(uint8_t* minutes) {
+    if (minutes == nullptr) {
+        setError("Output parameter 'minutes' cannot be null");
+        return false;
+    }
+
+    if (!getAutoPowerOffAsync() || !runToCompletion()) {
+        return false;
+    }
+
+    *minutes = (uint8_t)lastResult.value;
+    return true;
+}
+
+bool KodakStepPrinter::refreshStatus() {
+    return refreshStatusAsync() && runToCompletion();
+}
+
+bool KodakStepPrinter::printImage(const uint8_t* jpegData, size_t dataSize, uint8_t numCopies,
+                                   KodakProgressCallback progressCallback) {
+    if (jpegData == nullptr) {
+        setError("Image data cannot be null", BTP_ERR_BAD_IMAGE);
+        return false;
+    }
+
+    KodakMemorySource source(jpegData, dataSize);
+    return printImage(source, numCopies, progressCallback);
+}
+
+bool KodakStepPrinter::printImage(KodakImageSource& source, uint8_t numCopies,
+                                   KodakProgressCallback progressCallback) {
+    return printImageAsync(source, numCopies, progressCallback) && runToCompletion();
+}
+
+bool KodakStepPrinter::printBatch(KodakBatchItem* items, size_t count,
+                                  KodakBatchItemCallback itemCallback, void* context) {
+    return printBatchAsync(items, count, itemCallback, nullptr, context) && runToCompletion();
+}
+
+// =============================================================================
+// Asynchronous operations
+// =============================================================================
+
+bool KodakStepPrinter::initializeAsync(bool isSlimDevice, KodakCompletionCallback callback,
+                                       void* context) {
+    if (!startRequest(KODAK_REQUEST_INITIALIZE, STEP_ACCESSORY_INFO, callback, context)) {
+        return false;
+    }
+    request.isSlimDevice = isSlimDevice;
+    beginStep(STEP_ACCESSORY_INFO);
+    return true;
+}
+
+bool KodakStepPrinter::getBatteryLevelAsync(KodakCompletionCallback callback, void* context) {
+    if (!startRequest(KODAK_REQUEST_BATTERY_LEVEL, STEP_ACCESSORY_INFO, callback, context)) {
+        return false;
+    }
+    beginStep(STEP_ACCESSORY_INFO);
+    return true;
+}
+
+bool KodakStepPrinter::getChargingStatusAsync(KodakCompletionCallback callback, void* context) {
+    if (!startRequest(KODAK_REQUEST_CHARGING_STATUS, STEP_CHARGING_STATUS, callback, context)) {
+        return false;
+    }
+    beginStep(STEP_CHARGING_STATUS);
+    return true;
+}
+
+bool KodakStepPrinter::checkPaperStatusAsync(KodakCompletionCallback callback, void* context) {
+    if (!startRequest(KODAK_REQUEST_PAPER_STATUS, STEP_PAGE_TYPE, callback, context)) {
+        return false;
+    }
+    beginStep(STEP_PAGE_TYPE);
+    return true;
+}
+
+bool KodakStepPrinter::getPrintCountAsync(KodakCompletionCallback callback, void* context) {
+    if (!startRequest(KODAK_REQUEST_PRINT_COUNT, STEP_PRINT_COUNT, callback, context)) {
+        return false;
+    }
+    beginStep(STEP_PRINT_COUNT);
+    return true;
+}
+
+bool KodakStepPrinter::getAutoPowerOffAsync(KodakCompletionCallback callback, void* context) {
+    if (!startRequest(KODAK_REQUEST_AUTO_POWER_OFF, STEP_AUTO_POWER_OFF, callback, context)) {
+        return false;
+    }
+    beginStep(STEP_AUTO_POWER_OFF);
+    return true;
+}
 
-    // Transfer image data
-    debugPrintln("Transferring image data...");
-    if (!transferImageData(jpegData, dataSize, progressCallback)) {
-        setError("Failed to transfer image data");
+bool KodakStepPrinter::refreshStatusAsync(KodakCompletionCallback callback, void* context) {
+    if (!startRequest(KODAK_REQUEST_REFRESH_STATUS, STEP_STATUS_BATCH, callback, context)) {
+        return false;
+    }
+    beginStep(STEP_STATUS_BATCH);
+    return true;
+}
+
+bool KodakStepPrinter::printImageAsync(KodakImageSource& source, uint8_t numCopies,
+                                        KodakProgressCallback progressCallback,
+                                        KodakCompletionCallback callback, void* context) {
+    size_t dataSize = source.size();
+
+    if (dataSize == 0) {
+        return rejectImage("Image data size cannot be zero");
+    }
+
+    if (dataSize > BTP_MAX_IMAGE_SIZE) {
+        return rejectImage("Image data exceeds BTP_MAX_IMAGE_SIZE");
+    }
+
+    // Whole image in memory: a truncated capture is caught before pre-flight
+    const uint8_t* data = source.contiguous();
+    if (integrityCheck && data != nullptr && !KodakStepProtocol::hasJpegMarkers(data, dataSize)) {
+        metrics.integrity_failures++;
+        return rejectImage("Image is not a complete JPEG");
+    }
+
+    AsyncStep firstStep = nextPreflightStep(STEP_ACCESSORY_INFO);
+    if (!startRequest(KODAK_REQUEST_PRINT, firstStep, callback, context)) {
         return false;
     }
 
-    debugPrintln("Image transfer complete!");
-    debugPrintln("Printer should start printing now...");
+    request.source = &source;
+    request.numCopies = numCopies;
+    request.progressCallback = progressCallback;
 
+    // Pre-flight: battery level (from accessory info), then paper status,
+    // each skipped while its cached reading is still fresh
+    beginStep(firstStep);
     return true;
 }
 
-bool KodakStepPrinter::transferImageData(const uint8_t* data, size_t size,
-                                          KodakProgressCallback progressCallback) {
-    size_t offset = 0;
-    size_t chunkNum = 0;
-    size_t totalChunks = (size + BTP_CHUNK_SIZE - 1) / BTP_CHUNK_SIZE;
+bool KodakStepPrinter::printBatchAsync(KodakBatchItem* items, size_t count,
+                                       KodakBatchItemCallback itemCallback,
+                                       KodakCompletionCallback callback, void* context) {
+    if (items == nullptr || count == 0) {
+        setError("Batch has no items", BTP_ERR_BAD_IMAGE);
+        return false;
+    }
+
+    // Check every item up front so a bad one cannot stop the batch halfway
+    for (size_t i = 0; i < count; i++) {
+        size_t dataSize = (items[i].source != nullptr) ? items[i].source->size() : 0;
+        if (dataSize == 0) {
+            return rejectImage("Batch item has no image data");
+        }
+        if (dataSize > BTP_MAX_IMAGE_SIZE) {
+            return rejectImage("Batch item exceeds BTP_MAX_IMAGE_SIZE");
+        }
+        const uint8_t* data = items[i].source->contiguous();
+        if (integrityCheck && data != nullptr && !KodakStepProtocol::hasJpegMarkers(data, dataSize)) {
+            metrics.integrity_failures++;
+            return rejectImage("Batch item is not a complete JPEG");
+        }
+    }
+
+    AsyncStep firstStep = nextPreflightStep(STEP_ACCESSORY_INFO);
+    if (!startRequest(KODAK_REQUEST_PRINT, firstStep, callback, context)) {
+        return false;
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        items[i].printed = false;
+        items[i].error_code = BTP_ERR_SUCCESS;
+        items[i].error = nullptr;
+        items[i].transfer_ms = 0;
+        items[i].crc32 = 0;
+    }
+
+    request.items = items;
+    request.itemCount = count;
+    request.itemIndex = 0;
+    request.itemsPrinted = 0;
+    request.itemCallback = itemCallback;
+    request.source = items[0].source;
+    request.numCopies = items[0].num_copies;
+    request.readySince = millis();
+
+    // Pre-flight once for the whole batch
+    beginStep(firstStep);
+    return true;
+}
+
+bool KodakStepPrinter::isBusy() const {
+    return request.state != ASYNC_IDLE;
+}
+
+void KodakStepPrinter::cancel() {
+    if (isBusy()) {
+        completeRequest(false, "Request cancelled");
+    }
+}
+
+const KodakRequestResult& KodakStepPrinter::getLastResult() const {
+    return lastResult;
+}
+
+KodakResponseView KodakStepPrinter::getLastResponse() const {
+    return KodakResponseView(request.response);
+}
+
+void KodakStepPrinter::setEventCallback(KodakEventCallback callback, void* context) {
+    eventCallback = callback;
+    eventContext = context;
+}
+
+KodakPrinterEvent KodakStepPrinter::getLastEvent() const {
+    return lastEvent;
+}
+
+// =============================================================================
+// Request engine
+// =============================================================================
+
+// Queries sent back to back by refreshStatus(); replies arrive in this order
+static const uint8_t BTP_BATCH_RESPONSE_TYPES[BTP_BATCH_COMMANDS] = {
+    BTP_RESP_ACCESSORY_INFO,
+    BTP_RESP_CHARGING_STATUS,
+    BTP_RESP_PAGE_TYPE,
+    0x00,                       // Print count reply type is undocumented - not checked
+    BTP_RESP_AUTO_POWER_OFF
+};
+
+bool KodakStepPrinter::startRequest(KodakRequestType type, AsyncStep firstStep,
+                                    KodakCompletionCallback callback, void* context) {
+    if (request.state == ASYNC_RECONNECT) {
+        setError("Reconnecting to printer");
+        return false;
+    }
+
+    if (isBusy()) {
+        setError("Printer busy with another request", BTP_ERR_BUSY);
+        return false;
+    }
 
-    // Check connection once at start, then use skipConnectionCheck for performance
     if (!isConnected()) {
+        setError("Not connected to printer");
         return false;
     }
 
-    while (offset < size) {
-        size_t remaining = size - offset;
-        size_t chunkSize = (remaining < BTP_CHUNK_SIZE) ? remaining : BTP_CHUNK_SIZE;
+    request.type = type;
+    request.step = firstStep;
+    request.isSlimDevice = status.is_slim_device;
+    request.callback = callback;
+    request.context = context;
+    request.source = nullptr;
+    request.numCopies = 1;
+    request.progressCallback = nullptr;
+    request.items = nullptr;
+    request.itemCount = 0;
+    request.itemIndex = 0;
+    request.itemsPrinted = 0;
+    request.itemCallback = nullptr;
+    request.startedAt = millis();
+
+    lastResult.type = type;
+    lastResult.success = false;
+    lastResult.errorCode = BTP_ERR_SUCCESS;
+    lastResult.value = 0;
+    lastResult.error = nullptr;
+    return true;
+}
+
+void KodakStepPrinter::beginStep(AsyncStep step) {
+    request.step = step;
 
-        chunkNum++;
-        if (debugEnabled) {
-            Serial.print("Sending chunk ");
-            Serial.print(chunkNum);
-            Serial.print("/");
-            Serial.print(totalChunks);
-            Serial.print(" (");
+    switch (step) {
+        case STEP_ACCESSORY_INFO:
+            if (request.type == KODAK_REQUEST_INITIALIZE) {
+                debugPrintln("Sending GET_ACCESSORY_INFO...");
+            }
+            break;
+        case STEP_PAGE_TYPE:
+            debugPrintln("Checking paper status...");
+            break;
+        case STEP_PRINT_READY:
+            if (request.itemIndex == 0) {
+                metrics.preflight_ms = millis() - request.startedAt;
+            }
+            debugPrintln("Sending PRINT_READY...");
+            if (recorder != nullptr) {
+                recorder->record(KODAK_SESSION_PRINT, 0, request.source->size(), request.numCopies);
+            }
+            if (BTP_LOG_ENABLED(BTP_LOG_INFO, debugEnabled)) {
+                Serial.print("Image size: ");
+                Serial.print(request.source->size());
+                Serial.print(" bytes, copies: ");
+                Serial.println(request.numCopies);
+            }
+            break;
+        case STEP_STATUS_BATCH:
+            request.batchSent = 0;
+            request.batchReceived = 0;
+            request.state = ASYNC_SEND;
+            return;
+        case STEP_TRANSFER:
+            debugPrintln("Transferring image data...");
+            request.offset = 0;
+            request.pending = nullptr;
+            request.pendingLen = 0;
+            request.chunkNum = 0;
+            request.shortWriteRun = 0;
+            request.writeInFlight = false;
+            request.crc = 0;
+            request.tailLen = 0;
+            request.integrityError = nullptr;
+            request.transferStartedAt = millis();
+            pacer.reset(pacingMode);
+            request.state = ASYNC_TRANSFER;
+            return;
+        default:
+            break;
+    }
+
+    buildStepPacket(step, request.command);
+    if (step == STEP_ACCESSORY_INFO && request.type == KODAK_REQUEST_INITIALIZE) {
+        protocol.printPacketHex(request.command, BTP_PACKET_SIZE, debugEnabled && logger == nullptr);
+    }
+    request.state = ASYNC_SEND;
+}
+
+void KodakStepPrinter::buildStepPacket(AsyncStep step, uint8_t* buffer) const {
+    switch (step) {
+        case STEP_ACCESSORY_INFO:
+            // Battery level is in byte 12 of GET_ACCESSORY_INFO response
+            // Note: GET_BATTERY_LEVEL (0x0E) returns charging status, not battery percentage
+            protocol.buildGetAccessoryInfoPacket(buffer, request.isSlimDevice);
+            break;
+        case STEP_CHARGING_STATUS:
+            // GET_BATTERY_LEVEL (0x0E) returns charging status in byte 8 (1 = charging)
+            protocol.buildGetBatteryLevelPacket(buffer);
+            break;
+        case STEP_PAGE_TYPE:
+            protocol.buildGetPageTypePacket(buffer);
+            break;
+        case STEP_PRINT_COUNT:
+            protocol.buildGetPrintCountPacket(buffer);
+            break;
+        case STEP_AUTO_POWER_OFF:
+            protocol.buildGetAutoPowerOffPacket(buffer);
+            break;
+        case STEP_PRINT_READY:
+            protocol.buildPrintReadyPacket(buffer, request.source->size(), request.numCopies);
+            break;
+        case STEP_TRANSFER:
+        case STEP_STATUS_BATCH:
+            break;
+    }
+}
+
+bool KodakStepPrinter::sendBatchCommand() {
+    static const AsyncStep batchSteps[BTP_BATCH_COMMANDS] = {
+        STEP_ACCESSORY_INFO, STEP_CHARGING_STATUS, STEP_PAGE_TYPE,
+        STEP_PRINT_COUNT, STEP_AUTO_POWER_OFF
+    };
+
+    if (request.batchSent == 0) {
+        flushReceived();
+    }
+
+    buildStepPacket(batchSteps[request.batchSent], request.command);
+    request.sentAt[request.batchSent] = millis();
+    if (recorder != nullptr) {
+        recorder->recordFrame(KODAK_SESSION_TX, request.command);
+    }
+    if (!sendCommand(request.command, BTP_PACKET_SIZE)) {
+        return failRequest(stepFailureMessage());
+    }
+
+    // Replies queue up in the RX buffer while the remaining queries go out
+    if (++request.batchSent < BTP_BATCH_COMMANDS) {
+        setQuietPeriod(BTP_BATCH_SPACING_MS);
+        return true;
+    }
+
+    request.deadline = millis() + BTP_COMMAND_TIMEOUT_MS;
+    request.state = ASYNC_RECEIVE;
+    return true;
+}
+
+bool KodakStepPrinter::poll() {
+    return advance(0);
+}
+
+bool KodakStepPrinter::advance(TickType_t rxWaitTicks) {
+    // Notice a dropped link even while idle, not just on the next failed write
+    if (request.state != ASYNC_RECONNECT && linkLost()) {
+        return onLinkDropped(isBusy() ? stepFailureMessage() : "Not connected to printer");
+    }
+
+    switch (request.state) {
+        case ASYNC_IDLE:
+            // Print-finished and error reports keep coming after the request
+            if (link != nullptr && status.is_connected) {
+                pumpPrinterEvents();
+            }
+            return false;
+
+        case ASYNC_SEND:
+            // Between pipelined status queries the buffer holds their replies
+            if (request.step != STEP_STATUS_BATCH || request.batchSent == 0) {
+                if (!pumpPrinterEvents()) {
+                    return isBusy();
+                }
+            }
+            if (!quietPeriodElapsed()) {
+                return true;
+            }
+            if (request.step == STEP_STATUS_BATCH) {
+                return sendBatchCommand();
+            }
+            // Anything still buffered belongs to an earlier, abandoned exchange
+            flushReceived();
+            request.sentAt[0] = millis();
+            if (recorder != nullptr) {
+                recorder->recordFrame(KODAK_SESSION_TX, request.command);
+            }
+            if (!sendCommand(request.command, BTP_PACKET_SIZE)) {
+                return failRequest(stepFailureMessage());
+            }
+            request.deadline = millis() + BTP_COMMAND_TIMEOUT_MS;
+            request.state = ASYNC_RECEIVE;
+            return true;
+
+        case ASYNC_RECEIVE:
+            if (receiveResponseBytes(rxWaitTicks)) {
+                memcpy(request.response, rxFrame.frame(), BTP_PACKET_SIZE);
+                rxFrame.reset();
+                // The print count reply type is undocumented; while one is
+                // due, every frame is taken as the reply. Any other reply,
+                // batched or not, can be beaten by a printer report.
+                bool unchecked = request.step == STEP_PRINT_COUNT ||
+                    (request.step == STEP_STATUS_BATCH &&
+                     BTP_BATCH_RESPONSE_TYPES[request.batchReceived] == 0x00);
+                if (!unchecked) {
+                    KodakPrinterEvent event = KodakStepProtocol::classifyMessage(request.response);
+                    if (event != KODAK_EVENT_NONE) {
+                        if (!handlePrinterEvent(event, request.response[8])) {
+                            return isBusy();
+                        }
+                        // An upload request answering PRINT_READY is as good as its reply
+                        if (event != KODAK_EVENT_START_OF_SEND || request.step != STEP_PRINT_READY) {
+                            return true;
+                        }
+                    }
+                }
+                metrics.recordRtt(millis() - request.sentAt[(request.step == STEP_STATUS_BATCH)
+                                                            ? request.batchReceived : 0]);
+                handleResponse();
+                return isBusy();
+            }
+            if (!status.is_connected) {
+                return failRequest(stepFailureMessage());
+            }
+            // Signed difference handles millis() overflow correctly
+            if ((int32_t)(millis() - request.deadline) > 0) {
+                if (BTP_LOG_ENABLED(BTP_LOG_INFO, logger != nullptr)) {
+                    logger->log(KODAK_LOG_TIMEOUT, nullptr, request.step);
+                } else {
+                    debugPrintln("Response timeout");
+                }
+                metrics.response_timeouts++;
+                completeRequest(false, stepFailureMessage());
+                return false;
+            }
+            return true;
+
+        case ASYNC_TRANSFER:
+            // Read between chunks only: acks never race the writer task
+            if (!request.writeInFlight && !pumpPrinterEvents()) {
+                return isBusy();
+            }
+            if (!quietPeriodElapsed()) {
+                return true;
+            }
+            if (!transferChunk()) {
+                if (request.integrityError != nullptr) {
+                    failIntegrityCheck(request.integrityError);
+                    return false;
+                }
+                return failRequest(stepFailureMessage());
+            }
+            if (request.offset >= request.source->size()) {
+                // Everything is queued in the SPP stack; the source can free its memory
+                request.source->release();
+                metrics.image_crc32 = request.crc;
+                metrics.transfer_ms = millis() - request.transferStartedAt;
+                metrics.bytes_per_sec = (metrics.transfer_ms > 0)
+                    ? (uint32_t)((uint64_t)request.offset * 1000 / metrics.transfer_ms) : 0;
+                metrics.prints++;
+                lastTransferEndedAt = millis();
+                flushPendingAcks();
+                debugPrintln("Image transfer complete!");
+                debugPrintln("Printer should start printing now...");
+                if (request.items != nullptr && nextPrintItem()) {
+                    return true;
+                }
+                completeRequest(true);
+                return false;
+            }
+            return true;
+
+        case ASYNC_RECONNECT:
+            if ((int32_t)(millis() - reconnectAt) < 0) {
+                return true;
+            }
+            return attemptReconnect();
+    }
+
+    return false;
+}
+
+void KodakStepPrinter::handleResponse() {
+    const uint8_t* response = request.response;
+    KodakResponseView reply(response);
+
+    if (BTP_LOG_ENABLED(BTP_LOG_VERBOSE, logger != nullptr)) {
+        logger->logPacket(KODAK_LOG_PACKET_RX, response);
+    } else if (BTP_LOG_ENABLED(BTP_LOG_VERBOSE, debugEnabled)) {
+        Serial.println("Received response:");
+        protocol.printPacketHex(response, BTP_PACKET_SIZE, true);
+    }
+
+    switch (request.step) {
+        case STEP_ACCESSORY_INFO:
+            if (request.type == KODAK_REQUEST_INITIALIZE) {
+                if (!reply.ok()) {
+                    failWithPrinterError(reply.errorCode());
+                    return;
+                }
+                status.is_slim_device = request.isSlimDevice;
+                status.error_code = BTP_ERR_SUCCESS;
+                saveCachedSlimDevice(request.isSlimDevice);
+                applyStatusResponse(STEP_ACCESSORY_INFO, response);
+                metrics.initialize_ms = millis() - request.startedAt;
+                debugPrintln("Printer initialized successfully");
+                setQuietPeriod(500);  // Wait after initialization
+                completeRequest(true);
+                return;
+            }
+
+            lastResult.value = applyStatusResponse(STEP_ACCESSORY_INFO, response);
+            setQuietPeriod(100);
+
+            if (request.type == KODAK_REQUEST_PRINT) {
+                if (status.battery_level < BTP_MIN_BATTERY_LEVEL) {
+                    completeRequest(false, "Battery too low to print");
+                    return;
+                }
+                beginStep(nextPreflightStep(STEP_PAGE_TYPE));
+                return;
+            }
+            completeRequest(true);
+            return;
+
+        case STEP_PAGE_TYPE:
+            if (!reply.ok()) {
+                failWithPrinterError(reply.errorCode());
+                return;
+            }
+            setPaperStatus(BTP_ERR_SUCCESS);
+            debugPrintln("Paper status OK");
+            setQuietPeriod(100);
+            if (request.type == KODAK_REQUEST_PRINT) {
+                beginStep(STEP_PRINT_READY);
+                return;
+            }
+            completeRequest(true);
+            return;
+
+        case STEP_CHARGING_STATUS:
+        case STEP_PRINT_COUNT:
+        case STEP_AUTO_POWER_OFF:
+            lastResult.value = applyStatusResponse(request.step, response);
+            setQuietPeriod(100);
+            completeRequest(true);
+            return;
+
+        case STEP_PRINT_READY:
+            metrics.print_ready_ms = millis() - request.sentAt[0];
+            if (!reply.ok()) {
+                if (request.items != nullptr &&
+                    KodakStepProtocol::classifyError(reply.errorCode()) == KODAK_ERROR_TRANSIENT &&
+                    millis() - request.readySince < BTP_PRINT_BATCH_READY_TIMEOUT_MS) {
+                    // Most often still printing the previous item; ask again shortly
+                    status.error_code = reply.errorCode();
+                    setQuietPeriod(BTP_PRINT_BATCH_BUSY_RETRY_MS);
+                    beginStep(STEP_PRINT_READY);
+                    return;
+                }
+                failWithPrinterError(reply.errorCode());
+                return;
+            }
+            setQuietPeriod(100);
+            beginStep(STEP_TRANSFER);
+            return;
+
+        case STEP_STATUS_BATCH:
+            handleBatchResponse();
+            return;
+
+        case STEP_TRANSFER:
+            break;
+    }
+}
+
+void KodakStepPrinter::handleBatchResponse() {
+    static const AsyncStep batchSteps[BTP_BATCH_COMMANDS] = {
+        STEP_ACCESSORY_INFO, STEP_CHARGING_STATUS, STEP_PAGE_TYPE,
+        STEP_PRINT_COUNT, STEP_AUTO_POWER_OFF
+    };
+
+    const uint8_t* response = request.response;
+    KodakResponseView reply(response);
+    uint8_t index = request.batchReceived;
+    uint8_t expectedType = BTP_BATCH_RESPONSE_TYPES[index];
+
+    if (!reply.isValid() || (expectedType != 0x00 && reply.type() != expectedType)) {
+        completeRequest(false, "Unexpected status response");
+        return;
+    }
+
+    if (batchSteps[index] == STEP_PAGE_TYPE) {
+        // Paper state is reported, not treated as a failure of the refresh
+        setPaperStatus(reply.errorCode());
+        lastResult.errorCode = reply.errorCode();
+    } else {
+        applyStatusResponse(batchSteps[index], response);
+    }
+
+    if (++request.batchReceived < BTP_BATCH_COMMANDS) {
+        request.deadline = millis() + BTP_COMMAND_TIMEOUT_MS;
+        return;
+    }
+
+    lastResult.value = status.battery_level;
+    setQuietPeriod(100);
+    debugPrintln("Status refreshed");
+    completeRequest(true);
+}
+
+uint32_t KodakStepPrinter::applyStatusResponse(AsyncStep step, const uint8_t* response) {
+    uint32_t now = millis();
+
+    switch (step) {
+        case STEP_ACCESSORY_INFO:
+            status.battery_level = KodakAccessoryInfoView(response).batteryLevel();
+            status.battery_updated_ms = now;
+            return status.battery_level;
+        case STEP_CHARGING_STATUS:
+            status.is_charging = KodakChargingStatusView(response).isCharging();
+            status.charging_updated_ms = now;
+            return status.is_charging ? 1 : 0;
+        case STEP_PRINT_COUNT:
+            status.print_count = KodakPrintCountView(response).printCount();
+            status.print_count_updated_ms = now;
+            return status.print_count;
+        case STEP_AUTO_POWER_OFF:
+            status.auto_power_off_minutes = KodakAutoPowerOffView(response).minutes();
+            status.auto_power_off_updated_ms = now;
+            return status.auto_power_off_minutes;
+        default:
+            return 0;
+    }
+}
+
+void KodakStepPrinter::setPaperStatus(uint8_t errorCode) {
+    status.error_code = errorCode;
+    // Only a clean paper check is worth reusing
+    status.paper_updated_ms = (errorCode == BTP_ERR_SUCCESS) ? millis() : 0;
+}
+
+KodakStepPrinter::AsyncStep KodakStepPrinter::nextPreflightStep(AsyncStep from) {
+    uint32_t now = millis();
+
+    if (from == STEP_ACCESSORY_INFO) {
+        // A cached low reading is re-checked - the printer may have been charged since
+        if (!KodakStepProtocol::isFresh(status.battery_updated_ms, now, statusCacheTtlMs) ||
+            status.battery_level < BTP_MIN_BATTERY_LEVEL) {
+            return STEP_ACCESSORY_INFO;
+        }
+        debugPrintln("Using cached battery level");
+        from = STEP_PAGE_TYPE;
+    }
+
+    if (from == STEP_PAGE_TYPE) {
+        if (!KodakStepProtocol::isFresh(status.paper_updated_ms, now, statusCacheTtlMs) ||
+            status.error_code != BTP_ERR_SUCCESS) {
+            return STEP_PAGE_TYPE;
+        }
+        debugPrintln("Using cached paper status");
+    }
+
+    return STEP_PRINT_READY;
+}
+
+bool KodakStepPrinter::transferChunk() {
+    if (link == nullptr) {
+        return false;
+    }
+
+    if (request.writeInFlight) {
+        WriteResult result;
+        if (!writerResults.pop(&result)) {
+            return true;    // Still inside write() on the writer task
+        }
+        request.writeInFlight = false;
+        return finishChunk(result.written, result.writeUs);
+    }
+
+    if (!nextChunk()) {
+        return false;
+    }
+
+    if (writerTask != nullptr) {
+        // Only one chunk is ever in flight, so the ring cannot be full
+        WriteChunk chunk = {request.pending, request.pendingLen};
+        writerChunks.push(chunk);
+        request.writeInFlight = true;
+        xTaskNotifyGive(writerTask);
+        return true;
+    }
+
+    uint32_t writeStart = micros();
+    size_t written = link->write(request.pending, request.pendingLen);
+    return finishChunk(written, micros() - writeStart);
+}
+
+bool KodakStepPrinter::nextChunk() {
+    KodakImageSource& source = *request.source;
+    size_t size = source.size();
+
+    // Pull the next chunk only once the previous one is fully written
+    if (request.pendingLen == 0) {
+        size_t remaining = size - request.offset;
+        size_t chunkLimit = pacer.getChunkSize();
+        request.pendingLen = source.next(&request.pending,
+                                         (remaining < chunkLimit) ? remaining : chunkLimit);
+        if (request.pendingLen == 0 || request.pending == nullptr) {
+            debugPrintln("Image source ended early");
+            return false;
+        }
+        if (request.pendingLen > remaining) {
+            request.pendingLen = remaining;
+        }
+        // Checked as it is pulled, so a bad final chunk is never written
+        if (integrityCheck && !checkChunk(request.offset, request.pendingLen)) {
+            request.pendingLen = 0;
+            return false;
+        }
+    }
+
+    size_t chunkSize = request.pendingLen;
+
+    request.chunkNum++;
+    if (BTP_LOG_ENABLED(BTP_LOG_VERBOSE, logger != nullptr)) {
+        logger->log(KODAK_LOG_CHUNK, nullptr, request.offset, chunkSize);
+    } else if (BTP_LOG_ENABLED(BTP_LOG_VERBOSE, debugEnabled)) {
+        Serial.print("Sending chunk ");
+        Serial.print(request.chunkNum);
+        Serial.print(" (");
+        Serial.print(chunkSize);
+        Serial.print(" bytes at offset ");
+        Serial.print(request.offset);
+        Serial.println(")");
+    }
+    return true;
+}
+
+bool KodakStepPrinter::finishChunk(size_t written, uint32_t writeUs) {
+    size_t size = request.source->size();
+    size_t chunkSize = request.pendingLen;
+
+    pacer.onChunkWritten(chunkSize, written, writeUs);
+    metrics.recordChunk(chunkSize, written, writeUs);
+    if (recorder != nullptr) {
+        recorder->record(KODAK_SESSION_CHUNK, (uint16_t)chunkSize, written, writeUs);
+    }
+
+    if (written != chunkSize) {
+        if (BTP_LOG_ENABLED(BTP_LOG_VERBOSE, logger != nullptr)) {
+            logger->log(KODAK_LOG_SHORT_WRITE, nullptr, written, chunkSize);
+        } else if (BTP_LOG_ENABLED(BTP_LOG_VERBOSE, debugEnabled)) {
+            Serial.print("Warning: Only wrote ");
+            Serial.print(written);
+            Serial.print(" of ");
             Serial.print(chunkSize);
-            Serial.println(" bytes)");
+            Serial.println(" bytes");
         }
 
-        // Use skipConnectionCheck=true since we checked at start of transfer
-        if (!sendCommand(&data[offset], chunkSize, true)) {
+        // Fixed pacing keeps the original strict behaviour; adaptive pacing
+        // treats a short write as backpressure and resends the remainder
+        if (pacingMode == KODAK_PACING_FIXED ||
+            ++request.shortWriteRun > BTP_PACING_MAX_SHORT_WRITES ||
+            !linkConnected()) {
             debugPrintln("Failed to send chunk");
             return false;
         }
+    } else {
+        request.shortWriteRun = 0;
+    }
+
+    request.pending += written;
+    request.pendingLen -= written;
+    request.offset += written;
+
+    // Call progress callback if provided
+    if (request.progressCallback != nullptr && written > 0) {
+        request.progressCallback(request.offset, size);
+    }
+
+    if (BTP_LOG_ENABLED(BTP_LOG_INFO, debugEnabled) &&
+        pacingMode == KODAK_PACING_ADAPTIVE && request.offset >= size) {
+        Serial.print("Adaptive pacing: final chunk ");
+        Serial.print(pacer.getChunkSize());
+        Serial.print(" bytes, gap ");
+        Serial.print(pacer.getDelayMs());
+        Serial.print(" ms, short writes ");
+        Serial.print(pacer.getShortWriteCount());
+        Serial.print(", stalls ");
+        Serial.println(pacer.getStallCount());
+    }
+
+    // Inter-chunk gap is a quiet period rather than a blocking delay
+    setQuietPeriod(pacer.getDelayMs());
+    return true;
+}
+
+void KodakStepPrinter::failWithPrinterError(uint8_t errorCode) {
+    status.error_code = errorCode;
+    lastResult.errorCode = errorCode;
+    completeRequest(false, protocol.getErrorString(errorCode));
+}
+
+bool KodakStepPrinter::checkChunk(size_t offset, size_t length) {
+    const uint8_t* chunk = request.pending;
+    KodakImageSource& source = *request.source;
+
+    request.crc = KodakStepProtocol::crc32(request.crc, chunk, length);
+
+    if (offset == 0 && (length < 2 || chunk[0] != 0xFF || chunk[1] != 0xD8)) {
+        request.integrityError = "Image does not start with a JPEG SOI marker";
+        return false;
+    }
+
+    // Keep the last BTP_JPEG_EOI_WINDOW bytes, which may span several chunks
+    if (length >= BTP_JPEG_EOI_WINDOW) {
+        memcpy(request.tail, chunk + length - BTP_JPEG_EOI_WINDOW, BTP_JPEG_EOI_WINDOW);
+        request.tailLen = BTP_JPEG_EOI_WINDOW;
+    } else {
+        size_t keep = BTP_JPEG_EOI_WINDOW - length;
+        if (keep > request.tailLen) {
+            keep = request.tailLen;
+        }
+        memmove(request.tail, request.tail + request.tailLen - keep, keep);
+        memcpy(request.tail + keep, chunk, length);
+        request.tailLen = keep + length;
+    }
+
+    if (offset + length < source.size()) {
+        return true;
+    }
+
+    // Final chunk, still unsent: the printer has no complete image to print yet
+    if (!KodakStepProtocol::hasJpegEnd(request.tail, request.tailLen)) {
+        request.integrityError = "Image does not end with a JPEG EOI marker";
+        return false;
+    }
+    uint32_t expected;
+    if (source.getExpectedCrc32(&expected) && expected != request.crc) {
+        request.integrityError = "Image checksum mismatch";
+        return false;
+    }
+    return true;
+}
+
+void KodakStepPrinter::failIntegrityCheck(const char* error) {
+    debugPrintln(error);
+    metrics.integrity_failures++;
+    lastResult.errorCode = BTP_ERR_BAD_IMAGE;
+    completeRequest(false, error);
+}
+
+bool KodakStepPrinter::rejectImage(const char* error) {
+    // Refused before a request starts; the code tells a scheduler not to
+    // retry. A request in flight keeps its own result.
+    if (!isBusy()) {
+        lastResult.type = KODAK_REQUEST_PRINT;
+        lastResult.success = false;
+        lastResult.errorCode = BTP_ERR_BAD_IMAGE;
+        lastResult.value = 0;
+        lastResult.error = error;
+    }
+    setError(error, BTP_ERR_BAD_IMAGE);
+    return false;
+}
+
+bool KodakStepPrinter::nextPrintItem() {
+    KodakBatchItem& item = request.items[request.itemIndex];
+    item.printed = true;
+    item.transfer_ms = metrics.transfer_ms;
+    item.crc32 = request.crc;
+    request.itemsPrinted++;
+    if (request.itemCallback != nullptr) {
+        request.itemCallback(request.itemIndex, item, request.context);
+    }
+
+    if (++request.itemIndex >= request.itemCount) {
+        return false;
+    }
+
+    // Battery and paper were checked for the batch; straight to the next PRINT_READY
+    KodakBatchItem& next = request.items[request.itemIndex];
+    request.source = next.source;
+    request.numCopies = next.num_copies;
+    request.readySince = millis();
+    setQuietPeriod(BTP_PRINT_BATCH_GAP_MS);
+    beginStep(STEP_PRINT_READY);
+    return true;
+}
+
+void KodakStepPrinter::finishPrintItems(const char* error) {
+    for (size_t i = request.itemIndex; i < request.itemCount; i++) {
+        KodakBatchItem& item = request.items[i];
+        if (i == request.itemIndex) {
+            item.error_code = lastResult.errorCode;
+            item.error = (error != nullptr) ? error : "Print failed";
+        } else {
+            item.error = "Not sent: batch stopped at an earlier item";
+        }
+        if (request.itemCallback != nullptr) {
+            request.itemCallback(i, item, request.context);
+        }
+    }
+    request.itemIndex = request.itemCount;
+}
+
+void KodakStepPrinter::completeRequest(bool success, const char* error) {
+    waitForWriter();
+    // No more image bytes follow, so held-back acks can go now
+    flushPendingAcks();
+
+    if (request.type == KODAK_REQUEST_RECONNECT) {
+        // Supervisor-only request: nobody is waiting on a result
+        request.state = ASYNC_IDLE;
+        if (!success && error != nullptr) {
+            setError(error);
+        }
+        return;
+    }
+
+    KodakCompletionCallback callback = request.callback;
+    void* context = request.context;
+
+    if (request.items != nullptr) {
+        if (!success) {
+            finishPrintItems(error);
+        }
+        lastResult.value = request.itemsPrinted;
+        request.items = nullptr;
+    }
 
-        offset += chunkSize;
+    request.state = ASYNC_IDLE;
+    request.callback = nullptr;
 
-        // Call progress callback if provided
-        if (progressCallback != nullptr) {
-            progressCallback(offset, size);
+    lastResult.success = success;
+    lastResult.error = success ? nullptr : error;
+    if (recorder != nullptr && lastResult.type == KODAK_REQUEST_PRINT) {
+        recorder->record(KODAK_SESSION_DONE, 0, success, lastResult.errorCode);
+    }
+    if (!success) {
+        // Whatever went wrong may have changed battery or paper state
+        invalidateStatusCache();
+        if (error != nullptr) {
+            setError(error, lastResult.errorCode);
         }
+    }
 
-        delay(BTP_INTER_CHUNK_DELAY_MS);
-        yield();  // Allow other tasks between chunks
+    // Engine is idle again, so the callback may start the next request
+    if (callback != nullptr) {
+        callback(lastResult, context);
     }
+}
 
+const char* KodakStepPrinter::stepFailureMessage() const {
+    switch (request.step) {
+        case STEP_ACCESSORY_INFO:
+            return (request.type == KODAK_REQUEST_INITIALIZE) ? "Failed to get accessory info"
+                                                              : "Failed to get battery level";
+        case STEP_CHARGING_STATUS: return "Failed to get charging status";
+        case STEP_PAGE_TYPE: return "Failed to check paper status";
+        case STEP_PRINT_COUNT: return "Failed to get print count";
+        case STEP_AUTO_POWER_OFF: return "Failed to get auto power off setting";
+        case STEP_PRINT_READY: return "Failed to send PRINT_READY";
+        case STEP_TRANSFER: return "Failed to transfer image data";
+        case STEP_STATUS_BATCH: return "Failed to refresh status";
+    }
+    return "Request failed";
+}
+
+uint32_t KodakStepPrinter::pollWaitMs() const {
+    if (!quietPeriodElapsed()) {
+        uint32_t remaining = quietUntil - millis();
+        // Between batch items END_OF_RECEIVED can end the gap early
+        if (request.items != nullptr && request.state == ASYNC_SEND && remaining > BTP_EVENT_POLL_MS) {
+            return BTP_EVENT_POLL_MS;
+        }
+        return remaining;
+    }
+    if (request.state == ASYNC_RECEIVE && rxStream == nullptr) {
+        return 1;  // Polled receive fallback
+    }
+    if (request.state == ASYNC_TRANSFER && request.writeInFlight) {
+        return 1;  // Writer task has the chunk; sleep rather than spin on its result
+    }
+    if (request.state == ASYNC_RECONNECT && (int32_t)(reconnectAt - millis()) > 0) {
+        return reconnectAt - millis();
+    }
+    return 0;
+}
+
+bool KodakStepPrinter::quietPeriodElapsed() const {
+    return (int32_t)(millis() - quietUntil) >= 0;
+}
+
+void KodakStepPrinter::setQuietPeriod(uint32_t ms) {
+    quietUntil = millis() + ms;
+}
+
+void KodakStepPrinter::runQuietPeriod() {
+    while (!quietPeriodElapsed()) {
+        delay(pollWaitMs());
+        yield();
+    }
+}
+
+// =============================================================================
+// Printer-initiated messages
+// =============================================================================
+
+bool KodakStepPrinter::pumpPrinterEvents() {
+    // Borrows the reply assembler, which only ASYNC_RECEIVE otherwise reads
+    while (receiveResponseBytes(0)) {
+        uint8_t frame[BTP_PACKET_SIZE];
+        memcpy(frame, rxFrame.frame(), BTP_PACKET_SIZE);
+        rxFrame.reset();
+
+        KodakPrinterEvent event = KodakStepProtocol::classifyMessage(frame);
+        if (event == KODAK_EVENT_NONE) {
+            // Late reply to an abandoned exchange
+            if (BTP_LOG_ENABLED(BTP_LOG_VERBOSE, logger != nullptr)) {
+                logger->logPacket(KODAK_LOG_PACKET_RX, frame);
+            }
+            continue;
+        }
+        if (!handlePrinterEvent(event, frame[8])) {
+            return false;
+        }
+    }
     return true;
 }
 
+// false if the message ended the request
+bool KodakStepPrinter::handlePrinterEvent(KodakPrinterEvent event, uint8_t errorCode) {
+    metrics.printer_events++;
+    lastEvent = event;
+    debugPrintln(KodakStepProtocol::getEventName(event));
+
+    bool midImage = request.state == ASYNC_TRANSFER &&
+                    (request.offset > 0 || request.pendingLen > 0 || request.writeInFlight);
+    if (!midImage) {
+        sendEventAck(event, errorCode);
+    } else if (pendingAckCount < BTP_EVENT_ACK_QUEUE) {
+        pendingAcks[pendingAckCount].event = event;
+        pendingAcks[pendingAckCount].errorCode = errorCode;
+        pendingAckCount++;
+    }
+
+    switch (event) {
+        case KODAK_EVENT_DATA_ACCEPTED:
+            metrics.accept_ms = millis() - lastTransferEndedAt;
+            // The printer has the previous batch item; no need to wait out the gap
+            if (request.items != nullptr && request.state == ASYNC_SEND &&
+                request.step == STEP_PRINT_READY) {
+                quietUntil = millis();
+            }
+            break;
+        case KODAK_EVENT_PRINT_FINISHED:
+            metrics.finish_ms = millis() - lastTransferEndedAt;
+            break;
+        case KODAK_EVENT_ERROR:
+            status.error_code = errorCode;
+            invalidateStatusCache();
+            break;
+        default:
+            break;
+    }
+
+    if (eventCallback != nullptr) {
+        eventCallback(event, errorCode, eventContext);
+    }
+
+    if (event == KODAK_EVENT_ERROR && request.state == ASYNC_TRANSFER) {
+        failWithPrinterError(errorCode);
+        return false;
+    }
+    return true;
+}
+
+void KodakStepPrinter::sendEventAck(KodakPrinterEvent event, uint8_t errorCode) {
+    uint8_t ack[BTP_PACKET_SIZE];
+    if (protocol.buildEventAck(ack, event, errorCode)) {
+        if (recorder != nullptr) {
+            recorder->recordFrame(KODAK_SESSION_ACK, ack);
+        }
+        sendCommand(ack, BTP_PACKET_SIZE);
+    }
+}
+
+void KodakStepPrinter::flushPendingAcks() {
+    for (uint8_t i = 0; i < pendingAckCount; i++) {
+        sendEventAck(pendingAcks[i].event, pendingAcks[i].errorCode);
+    }
+    pendingAckCount = 0;
+}
+
+// =============================================================================
+// Communication helpers
+// =============================================================================
+
 bool KodakStepPrinter::sendCommand(const uint8_t* command, size_t length, bool skipConnectionCheck) {
-    if (btSerial == nullptr) {
+    if (link == nullptr) {
         return false;
     }
 
     // Only check connection if not skipped (for performance in hot path)
-    if (!skipConnectionCheck && !btSerial->connected()) {
+    if (!skipConnectionCheck && !linkConnected()) {
         status.is_connected = false;
         return false;
     }
 
-    size_t written = btSerial->write(command, length);
+    size_t written = link->write(command, length);
+    metrics.commands_sent++;
+    if (BTP_LOG_ENABLED(BTP_LOG_VERBOSE, logger != nullptr) && length == BTP_PACKET_SIZE) {
+        logger->logPacket(KODAK_LOG_PACKET_TX, command);
+    }
     if (written != length) {
-        if (debugEnabled) {
+        metrics.command_short_writes++;
+        if (BTP_LOG_ENABLED(BTP_LOG_INFO, logger != nullptr)) {
+            logger->log(KODAK_LOG_SHORT_WRITE, nullptr, written, length);
+        } else if (BTP_LOG_ENABLED(BTP_LOG_INFO, debugEnabled)) {
             Serial.print("Warning: Only wrote ");
             Serial.print(written);
             Serial.print(" of ");
@@ -568,58 +2149,175 @@ bool KodakStepPrinter::sendCommand(const uint8_t* command, size_t length, bool s
     return true;
 }
 
-bool KodakStepPrinter::receiveResponse(uint8_t* response, uint32_t timeoutMs) {
-    if (btSerial == nullptr || !btSerial->connected()) {
+bool KodakStepPrinter::receiveResponseBytes(TickType_t waitTicks) {
+    if (!linkConnected()) {
         status.is_connected = false;
         return false;
     }
 
-    uint32_t startTime = millis();
-    size_t bytesRead = 0;
+    uint8_t buffer[BTP_PACKET_SIZE];
+    bool hadFrame = rxFrame.hasFrame();
 
-    while (bytesRead < BTP_PACKET_SIZE) {
-        // Unsigned subtraction handles millis() overflow correctly
-        if (millis() - startTime > timeoutMs) {
-            debugPrintln("Response timeout");
-            return false;
+    if (rxStream == nullptr) {
+        // Polled fallback: take whatever the link has queued
+        while (!rxFrame.hasFrame() && link->available()) {
+            buffer[0] = link->read();
+            rxFrame.feed(buffer, 1);
         }
-
-        if (btSerial->available()) {
-            response[bytesRead++] = btSerial->read();
-        } else {
-            delay(10);  // Small delay to avoid busy waiting
-            yield();    // Allow other tasks
+    } else {
+        // Read only what the frame still needs so the next frame stays in the buffer.
+        // The first read may block until the SPP callback delivers data.
+        while (!rxFrame.hasFrame()) {
+            size_t got = xStreamBufferReceive(rxStream, buffer, rxFrame.bytesNeeded(), waitTicks);
+            if (got == 0) {
+                break;
+            }
+            rxFrame.feed(buffer, got);
+            waitTicks = 0;
         }
     }
 
-    if (debugEnabled) {
-        Serial.println("Received response:");
-        protocol.printPacketHex(response, BTP_PACKET_SIZE, debugEnabled);
+    // Stamped as the frame completes, not when the engine gets round to it
+    if (recorder != nullptr && !hadFrame && rxFrame.hasFrame()) {
+        recorder->recordFrame(KODAK_SESSION_RX, rxFrame.frame());
     }
-
-    return true;
+    return rxFrame.hasFrame();
 }
 
-bool KodakStepPrinter::sendAndReceive(const uint8_t* command, uint8_t* response) {
-    if (!sendCommand(command, BTP_PACKET_SIZE)) {
-        return false;
+void KodakStepPrinter::onBluetoothData(const uint8_t* data, size_t length) {
+    // Runs in the Bluetooth stack task; never block it
+    if (rxStream != nullptr) {
+        xStreamBufferSend(rxStream, data, length, 0);
     }
+}
 
-    return receiveResponse(response);
+void KodakStepPrinter::flushReceived() {
+    rxFrame.reset();
+    if (rxStream != nullptr) {
+        xStreamBufferReset(rxStream);
+    } else if (link != nullptr) {
+        while (link->available()) {
+            link->read();
+        }
+    }
 }
 
 KodakStepProtocol::PrinterStatus KodakStepPrinter::getStatus() const {
     return status;
 }
 
+size_t KodakStepPrinter::getTargetImageSize() const {
+    return KodakStepProtocol::targetImageSize(status.is_slim_device,
+                                              heap_caps_get_largest_free_block(MALLOC_CAP_SPIRAM));
+}
+
 const char* KodakStepPrinter::getLastError() const {
     return lastError;
 }
 
-void KodakStepPrinter::setError(const char* error) {
+uint8_t KodakStepPrinter::getLastErrorCode() const {
+    return lastErrorCode;
+}
+
+// =============================================================================
+// Writer task
+// =============================================================================
+
+bool KodakStepPrinter::startWriterTask(int8_t core, UBaseType_t priority) {
+    if (writerTask != nullptr) {
+        return true;
+    }
+
+    writerChunks.reset();
+    writerResults.reset();
+    writerCore = core;
+    writerRunning = true;
+    if (xTaskCreatePinnedToCore(writerTaskEntry, "kodak_bt_tx", BTP_WRITER_STACK_SIZE, this,
+                                priority, &writerTask,
+                                (core < 0) ? tskNO_AFFINITY : core) != pdPASS) {
+        writerRunning = false;
+        writerTask = nullptr;
+        setError("Failed to create Bluetooth writer task");
+        return false;
+    }
+    return true;
+}
+
+void KodakStepPrinter::stopWriterTask() {
+    if (writerTask == nullptr) {
+        return;
+    }
+
+    waitForWriter();
+    writerRunning = false;
+    xTaskNotifyGive(writerTask);
+    while (writerTask != nullptr) {
+        delay(1);
+    }
+}
+
+bool KodakStepPrinter::hasWriterTask() const {
+    return writerTask != nullptr;
+}
+
+KodakTaskLoad KodakStepPrinter::getWriterLoad() {
+    return writerMeter.sample();
+}
+
+void KodakStepPrinter::waitForWriter() {
+    // The source keeps its chunk in place only until the write has returned
+    while (request.writeInFlight) {
+        WriteResult result;
+        if (writerResults.pop(&result)) {
+            request.writeInFlight = false;
+        } else {
+            delay(1);
+        }
+    }
+}
+
+void KodakStepPrinter::writerTaskEntry(void* arg) {
+    static_cast<KodakStepPrinter*>(arg)->writerLoop();
+}
+
+void KodakStepPrinter::writerLoop() {
+    writerMeter.attach("kodak_bt_tx", writerCore);
+
+    while (writerRunning) {
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(100));
+
+        WriteChunk chunk;
+        while (writerChunks.pop(&chunk)) {
+            WriteResult result;
+            writerMeter.beginWork();
+            uint32_t writeStart = micros();
+            result.written = link->write(chunk.data, chunk.len);
+            result.writeUs = micros() - writeStart;
+            writerMeter.endWork();
+            writerResults.push(result);
+        }
+    }
+
+    writerMeter.detach();
+    writerTask = nullptr;
+    vTaskDelete(nullptr);
+}
+
+void KodakStepPrinter::destroyBluetooth() {
+    if (btSerial != nullptr) {
+        btSerial->~BluetoothSerial();
+        btSerial = nullptr;
+        link = nullptr;
+    }
+}
+
+void KodakStepPrinter::setError(const char* error, uint8_t errorCode) {
     strncpy(lastError, error, sizeof(lastError) - 1);
     lastError[sizeof(lastError) - 1] = '\0';
-    if (debugEnabled) {
+    lastErrorCode = errorCode;
+    if (BTP_LOG_ENABLED(BTP_LOG_INFO, logger != nullptr)) {
+        logger->log(KODAK_LOG_ERROR, error);  // Error strings are all literals
+    } else if (BTP_LOG_ENABLED(BTP_LOG_INFO, debugEnabled)) {
         Serial.print("Error: ");
         Serial.println(error);
     }
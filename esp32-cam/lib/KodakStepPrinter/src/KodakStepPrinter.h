@@ -3,11 +3,111 @@
 
 #include <Arduino.h>
 #include "BluetoothSerial.h"
+#include <Preferences.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/stream_buffer.h"
 #include "KodakStepProtocol.h"
+#include "KodakStepPacing.h"
+#include "KodakImageSource.h"
+#include "KodakStepMetrics.h"
+#include "KodakStepLog.h"
+#include "KodakSessionRecorder.h"
+#include "KodakStepTasks.h"
+
+#define BTP_RX_BUFFER_SIZE 512  // Stream buffer between the SPP data callback and the receiver
+#define BTP_BATCH_SPACING_MS 10 // Gap between pipelined status queries
+#define BTP_BATCH_COMMANDS 5    // Queries pipelined by refreshStatus()
+#define BTP_SCAN_TIMEOUT_MS 10000   // Upper bound for connectByName() discovery
+#define BTP_SCAN_MAX_CANDIDATES 8   // Matching printers kept per scan; the weakest is dropped
+#define BTP_SCAN_STRONG_SCORE -60   // A match scoring this (dBm plus bonus) ends the scan early
+#define BTP_SCAN_CACHED_BONUS 10    // dB credited to the printer that connected last time
+#define BTP_SCAN_UNKNOWN_RSSI -90   // Assumed for devices reported without an RSSI
+#define BTP_SCAN_CONNECT_TRIES 2    // Ranked matches connectByName() tries before giving up
+#define BTP_CACHE_NAMESPACE "kodakstep" // NVS namespace for the last connected printer
+#define BTP_CACHE_NAME_SIZE 32
+#define BTP_RECONNECT_MAX_ATTEMPTS 5
+#define BTP_RECONNECT_BASE_DELAY_MS 500   // Doubles after every failed attempt
+#define BTP_RECONNECT_MAX_DELAY_MS 8000
+#define BTP_CONNECT_SETTLE_MS 1000      // SPP open to the first command
+#define BTP_RESUME_SETTLE_MS 250        // ...on resume(), to a printer that was just talking to us
+#define BTP_PRINT_BATCH_GAP_MS 500              // Last chunk of one batch item to the next PRINT_READY
+#define BTP_PRINT_BATCH_BUSY_RETRY_MS 1000      // PRINT_READY answered busy or cooling: ask again after this
+#define BTP_PRINT_BATCH_READY_TIMEOUT_MS 60000  // ...for up to this long per item
+#define BTP_EVENT_ACK_QUEUE 4       // Acks held back until the last image byte is out
+#define BTP_EVENT_POLL_MS 10        // Receive check interval while waiting out the batch gap
 
 // Progress callback for image transfer: (bytesSent, totalBytes)
 typedef void (*KodakProgressCallback)(size_t bytesSent, size_t totalBytes);
 
+// Asynchronous request types
+enum KodakRequestType {
+    KODAK_REQUEST_NONE,
+    KODAK_REQUEST_INITIALIZE,
+    KODAK_REQUEST_BATTERY_LEVEL,
+    KODAK_REQUEST_CHARGING_STATUS,
+    KODAK_REQUEST_PAPER_STATUS,
+    KODAK_REQUEST_PRINT_COUNT,
+    KODAK_REQUEST_AUTO_POWER_OFF,
+    KODAK_REQUEST_REFRESH_STATUS,
+    KODAK_REQUEST_PRINT,
+    KODAK_REQUEST_RECONNECT     // Internal: link supervisor with no job attached
+};
+
+// Outcome of an asynchronous request
+struct KodakRequestResult {
+    KodakRequestType type;
+    bool success;
+    uint8_t errorCode;    // Printer error code (BTP_ERR_*)
+    uint32_t value;       // Battery %, charging (0/1), print count or power-off minutes
+    const char* error;    // Error message when !success
+};
+
+// Link supervisor counters
+struct KodakLinkStats {
+    uint32_t drops;             // SPP link losses detected
+    uint32_t reconnects;        // Successful automatic reconnects
+    uint32_t failedReconnects;  // Gave up after BTP_RECONNECT_MAX_ATTEMPTS
+    uint32_t resumedJobs;       // Print jobs restarted after a reconnect
+    uint32_t lastDowntimeMs;
+    uint32_t totalDowntimeMs;
+};
+
+// Completion callback for asynchronous requests
+typedef void (*KodakCompletionCallback)(const KodakRequestResult& result, void* context);
+
+// One image of a printBatch() job. The caller fills in source and
+// num_copies; the rest is the item's result, written as the batch runs.
+struct KodakBatchItem {
+    KodakImageSource* source;
+    uint8_t num_copies;
+    bool printed;               // Last byte handed to the printer
+    uint8_t error_code;         // BTP_ERR_* when the printer turned the item away
+    const char* error;          // Why the item failed or was not sent; nullptr when printed
+    uint32_t transfer_ms;
+    uint32_t crc32;             // CRC-32 of the bytes sent, once printed
+};
+
+// Called from poll() as each batch item finishes, printed or not; must not start a request
+typedef void (*KodakBatchItemCallback)(size_t index, const KodakBatchItem& item, void* context);
+
+// Called from poll() for each message the printer sends on its own, once it
+// is acked; errorCode is byte 8 (BTP_ERR_SUCCESS unless KODAK_EVENT_ERROR).
+// Must not start a request.
+typedef void (*KodakEventCallback)(KodakPrinterEvent event, uint8_t errorCode, void* context);
+
+// Printer found by discoverAsync()
+struct KodakDiscoveredPrinter {
+    BTAddress address;
+    char name[BTP_CACHE_NAME_SIZE];
+    int8_t rssi;                // dBm; BTP_SCAN_UNKNOWN_RSSI if the stack gave none
+    bool cached;                // The printer in the NVS address cache
+    int16_t score;              // See scoreCandidate(); higher is better
+};
+
+// Called from the Bluetooth task for each matching device, and again when its RSSI changes.
+// Keep it short and don't log from it; pollDiscovery() logs matches on the calling task.
+typedef void (*KodakDiscoveryCallback)(const KodakDiscoveredPrinter& printer, void* context);
+
 /**
  * High-level interface for Kodak Step Printer
  * Manages Bluetooth connection, protocol flow, and image transfer
@@ -24,6 +124,14 @@ typedef void (*KodakProgressCallback)(size_t bytesSent, size_t totalBytes);
  *   printer.connectByName("Step");
  *   printer.initialize();
  *   printer.printImage(jpegData, jpegSize);
+ *
+ * Non-blocking usage:
+ *   printer.printImageAsync(source, 1, nullptr, onDone);
+ *   void loop() { printer.poll(); ... }
+ *
+ * Every operation runs on one request state machine driven by poll(). The
+ * blocking methods start a request and poll it to completion. Only one
+ * request can be in flight at a time.
  */
 class KodakStepPrinter {
 public:
@@ -37,9 +145,68 @@ public:
     // Connection management
     bool begin(const char* deviceName = "ESP32-Kodak");
     bool connect(const char* printerAddress);
+    bool connect(const BTAddress& address);
     bool connectByName(const char* printerName);
     void disconnect();
     bool isConnected();
+    // Run the engine over any Stream instead of Bluetooth: a wired adapter,
+    // or a scripted printer in the tests and benchmarks. Stops Bluetooth;
+    // the link counts as connected until detachLink(), and replies are
+    // polled. begin() switches back to Bluetooth.
+    void attachLink(Stream& stream);
+    void detachLink();
+
+    // Last connected printer, kept in NVS so connectByName() can reconnect
+    // without a Bluetooth scan. Enabled by default.
+    void setAddressCacheEnabled(bool enabled);
+    bool getAddressCacheEnabled() const;
+    bool getCachedSlimDevice(bool* isSlimDevice);   // false if nothing is cached
+    void clearAddressCache();
+
+    // Background discovery of printers whose name contains printerName.
+    // Matches are ranked by RSSI, with BTP_SCAN_CACHED_BONUS for the cached
+    // printer, and the scan ends early once one scores BTP_SCAN_STRONG_SCORE.
+    // connectByName() runs this when the cached address does not answer and
+    // connects to the best match instead of the first one heard.
+    bool discoverAsync(const char* printerName, KodakDiscoveryCallback callback = nullptr,
+                       void* context = nullptr, uint32_t timeoutMs = BTP_SCAN_TIMEOUT_MS);
+    bool pollDiscovery();       // true while the scan runs; stops it on a strong match or the timeout
+    void stopDiscovery();
+    bool isDiscovering() const;
+    // Copies up to maxPrinters matches, best first; safe while the scan runs
+    size_t getDiscoveredPrinters(KodakDiscoveredPrinter* printers, size_t maxPrinters) const;
+    static int16_t scoreCandidate(int8_t rssi, bool cached);
+
+    // Link supervision: poll() notices a dropped SPP link, reconnects to the
+    // last address with backoff and restarts an interrupted print from its
+    // source (which must support rewind()). Off by default. Each reconnect
+    // attempt blocks poll() for the duration of the Bluetooth connect.
+    void setAutoReconnect(bool enabled);
+    bool getAutoReconnect() const;
+    const KodakLinkStats& getLinkStats() const;
+
+    // Power saving: suspend() drops the link and shuts the Bluetooth stack
+    // down so the radio is off, as light sleep needs. resume() brings the
+    // stack back and reconnects straight to the last printer, with no scan
+    // or cache lookup and a BTP_RESUME_SETTLE_MS settle, then runs
+    // initialize() for the model already known. True once the link is up;
+    // getMetrics().resume_ms is how long it took. Not while busy.
+    bool suspend();
+    bool resume();
+    bool isSuspended() const;
+
+    // Instrumentation (no Serial output; sample at any time)
+    const KodakPrinterMetrics& getMetrics() const;
+    void resetMetrics();
+
+    // Bluetooth writer task: image chunks are written by a task pinned next
+    // to the Bluedroid stack, so the task driving poll() gets its core back
+    // while write() waits on the SPP queue. Start and stop from the task that
+    // drives poll(); a chunk in flight is finished first.
+    bool startWriterTask(int8_t core = BTP_WRITER_CORE, UBaseType_t priority = BTP_WRITER_PRIORITY);
+    void stopWriterTask();
+    bool hasWriterTask() const;
+    KodakTaskLoad getWriterLoad();      // Window since the previous call
 
     // Printer operations
     bool initialize(bool isSlimDevice = false, uint8_t* rawResponse = nullptr);
@@ -48,38 +215,319 @@ public:
     bool checkPaperStatus();
     bool getPrintCount(uint16_t* count);
     bool getAutoPowerOff(uint8_t* minutes);
+    bool refreshStatus();   // Battery, charging, paper, print count and power-off in one pass
 
     // Printing
     bool printImage(const uint8_t* jpegData, size_t dataSize, uint8_t numCopies = 1,
                     KodakProgressCallback progressCallback = nullptr);
+    bool printImage(KodakImageSource& source, uint8_t numCopies = 1,
+                    KodakProgressCallback progressCallback = nullptr);
+    // Several images on one request: the pre-flight checks run once, then each
+    // item's PRINT_READY follows the previous item's last chunk. A busy or
+    // cooling reply to PRINT_READY is retried for BTP_PRINT_BATCH_READY_TIMEOUT_MS;
+    // any other failure stops the batch, and the items not sent are marked so.
+    // True only if every item printed; getLastResult().value is the count printed.
+    bool printBatch(KodakBatchItem* items, size_t count,
+                    KodakBatchItemCallback itemCallback = nullptr, void* context = nullptr);
+
+    // Asynchronous operations - start a request and return immediately.
+    // Call poll() until it returns false; the callback fires on completion.
+    // A print source must stay valid until the request completes.
+    bool initializeAsync(bool isSlimDevice = false, KodakCompletionCallback callback = nullptr,
+                         void* context = nullptr);
+    bool getBatteryLevelAsync(KodakCompletionCallback callback = nullptr, void* context = nullptr);
+    bool getChargingStatusAsync(KodakCompletionCallback callback = nullptr, void* context = nullptr);
+    bool checkPaperStatusAsync(KodakCompletionCallback callback = nullptr, void* context = nullptr);
+    bool getPrintCountAsync(KodakCompletionCallback callback = nullptr, void* context = nullptr);
+    bool getAutoPowerOffAsync(KodakCompletionCallback callback = nullptr, void* context = nullptr);
+    bool refreshStatusAsync(KodakCompletionCallback callback = nullptr, void* context = nullptr);
+    bool printImageAsync(KodakImageSource& source, uint8_t numCopies = 1,
+                         KodakProgressCallback progressCallback = nullptr,
+                         KodakCompletionCallback callback = nullptr, void* context = nullptr);
+    // The items and their sources must stay valid until the request completes
+    bool printBatchAsync(KodakBatchItem* items, size_t count,
+                         KodakBatchItemCallback itemCallback = nullptr,
+                         KodakCompletionCallback callback = nullptr, void* context = nullptr);
+
+    bool poll();                // Advance the current request; true while one is in progress
+    bool isBusy() const;
+    void cancel();
+    const KodakRequestResult& getLastResult() const;
+    // Last frame received, read in place; valid until the next request starts
+    KodakResponseView getLastResponse() const;
+
+    // Messages the printer sends on its own (upload request, END_OF_RECEIVED,
+    // error and print-finished reports) are read and acked by poll() during
+    // a transfer and between requests alike; keep calling poll() after a
+    // print to hear that it finished. An error report during a transfer
+    // fails the job, and in a batch END_OF_RECEIVED sends the next item's
+    // PRINT_READY without waiting out BTP_PRINT_BATCH_GAP_MS.
+    void setEventCallback(KodakEventCallback callback, void* context = nullptr);
+    KodakPrinterEvent getLastEvent() const;
 
     // Status
     KodakStepProtocol::PrinterStatus getStatus() const;
     const char* getLastError() const;
+    // BTP_ERR_* code behind getLastError(): the failed request's code, or for
+    // a refused call BTP_ERR_BAD_IMAGE (the image), BTP_ERR_BUSY (engine busy)
+    // and BTP_ERR_NOT_CONNECTED for everything else
+    uint8_t getLastErrorCode() const;
+    // JPEG size to re-encode to for this printer (see targetImageSize()),
+    // from the model found by initialize() and the PSRAM free right now.
+    // Safe to call from any task.
+    size_t getTargetImageSize() const;
+
+    // Status cache: while a successful battery/paper reading is younger than the
+    // TTL, printImage() skips that pre-flight query. 0 (default) disables it.
+    // Any failed request or disconnect invalidates the cache.
+    void setStatusCacheTtl(uint32_t ttlMs);
+    uint32_t getStatusCacheTtl() const;
+    void invalidateStatusCache();
 
     // Configuration
-    void setDebugOutput(bool enabled);
+    void setDebugOutput(bool enabled);      // Off by default; see BTP_LOG_LEVEL
     bool getDebugOutput() const;
+    // Record debug output in a deferred trace log instead of writing it to
+    // Serial in line. Call from the task that drives the printer.
+    void setLogger(KodakStepLog* log);
+    KodakStepLog* getLogger() const;
+    // Record frames, chunk writes and print boundaries for replay on the
+    // host; nullptr (default) stops. Same task rule as setLogger().
+    void setRecorder(KodakSessionRecorder* sessionRecorder);
+    KodakSessionRecorder* getRecorder() const;
+    void setPacingMode(KodakPacingMode mode);
+    KodakPacingMode getPacingMode() const;
+    // On by default: JPEG markers are checked before PRINT_READY (sources with
+    // contiguous()) or as the first and last chunks go out (streams), and a
+    // CRC-32 of the bytes sent is kept and, if the source has one, compared
+    // before the last chunk. A job that fails never prints; it ends with
+    // BTP_ERR_BAD_IMAGE.
+    void setIntegrityCheck(bool enabled);
+    bool getIntegrityCheck() const;
 
 private:
-    BluetoothSerial* btSerial;
+    BluetoothSerial* btSerial;          // Constructed in btSerialStorage by begin(), nullptr before
+    alignas(BluetoothSerial) uint8_t btSerialStorage[sizeof(BluetoothSerial)];
+    Stream* link;                       // Commands, chunks and polled replies: btSerial or attachLink()
     KodakStepProtocol protocol;
     KodakStepProtocol::PrinterStatus status;
     char lastError[128];
+    uint8_t lastErrorCode;
     bool debugEnabled;
+    KodakStepLog* logger;
+    KodakSessionRecorder* recorder;
+    KodakPacingMode pacingMode;
+    bool integrityCheck;
+    uint32_t statusCacheTtlMs;
+    bool addressCacheEnabled;
+    bool connectedToCachedAddress;  // Current link is the printer stored in NVS
+    char localName[BTP_CACHE_NAME_SIZE];    // begin() device name, for resume()
+    bool suspended;
+
+    // Discovery; candidates are written from the Bluetooth task's scan callback,
+    // which must not log. pollDiscovery() reports the entries it marked unlogged.
+    char scanFilter[BTP_CACHE_NAME_SIZE];
+    KodakDiscoveredPrinter candidates[BTP_SCAN_MAX_CANDIDATES];
+    bool candidateUnlogged[BTP_SCAN_MAX_CANDIDATES];
+    size_t candidateCount;
+    volatile uint32_t scanDevicesHeard;     // Named devices, matching or not
+    volatile bool scanning;
+    volatile bool scanStrongMatch;
+    uint32_t scanStartedAt;
+    uint32_t scanTimeoutMs;
+    uint8_t scanCachedAddress[6];
+    bool scanHaveCached;
+    KodakDiscoveryCallback discoveryCallback;
+    void* discoveryContext;
+
+    // Link supervisor
+    bool autoReconnect;
+    KodakLinkStats linkStats;
+    BTAddress lastAddress;
+    bool haveLastAddress;
+    uint8_t reconnectAttempts;
+    uint32_t reconnectAt;
+    uint32_t linkDownSince;
+    KodakStepPacer pacer;
+    KodakPrinterMetrics metrics;
+
+    // Request engine
+    enum AsyncState {
+        ASYNC_IDLE,
+        ASYNC_SEND,         // Waiting for the quiet period, then send command
+        ASYNC_RECEIVE,      // Collecting the 34-byte response
+        ASYNC_TRANSFER,     // Sending image chunks
+        ASYNC_RECONNECT     // Link lost; waiting for the next reconnect attempt
+    };
+
+    enum AsyncStep {
+        STEP_ACCESSORY_INFO,
+        STEP_CHARGING_STATUS,
+        STEP_PAGE_TYPE,
+        STEP_PRINT_COUNT,
+        STEP_AUTO_POWER_OFF,
+        STEP_PRINT_READY,
+        STEP_TRANSFER,
+        STEP_STATUS_BATCH       // All status queries pipelined, replies in order
+    };
+
+    struct AsyncRequest {
+        KodakRequestType type;
+        AsyncState state;
+        AsyncStep step;
+        uint32_t deadline;              // Response timeout (millis)
+        uint8_t command[BTP_PACKET_SIZE];
+        uint8_t response[BTP_PACKET_SIZE];
+        bool isSlimDevice;
+        uint8_t batchSent;
+        uint8_t batchReceived;
+        uint32_t startedAt;             // millis() when the request was accepted
+        uint32_t sentAt[BTP_BATCH_COMMANDS];    // Send time per pipelined command, for RTT
+        uint32_t transferStartedAt;
+        KodakCompletionCallback callback;
+        void* context;
+
+        // Print job
+        KodakImageSource* source;
+        uint8_t numCopies;
+        KodakProgressCallback progressCallback;
+        size_t offset;
+        const uint8_t* pending;
+        size_t pendingLen;
+        size_t chunkNum;
+        uint8_t shortWriteRun;
+        bool writeInFlight;             // pending is with the writer task
+        uint32_t crc;                   // CRC-32 of the chunks pulled so far
+        uint8_t tail[BTP_JPEG_EOI_WINDOW];  // Last bytes pulled, for the EOI check
+        size_t tailLen;
+        const char* integrityError;     // Set by nextChunk() when the image fails a check
+
+        // Batch job: items[itemIndex] is the one in source and numCopies
+        KodakBatchItem* items;
+        size_t itemCount;
+        size_t itemIndex;
+        size_t itemsPrinted;
+        uint32_t readySince;            // First PRINT_READY for the current item
+        KodakBatchItemCallback itemCallback;
+    };
+
+    AsyncRequest request;
+    KodakRequestResult lastResult;
+    uint32_t quietUntil;                // No command before this time (printer settle delays)
+
+    // Receive path: SPP data callback -> stream buffer -> frame assembler
+    StreamBufferHandle_t rxStream;
+    KodakFrameAssembler rxFrame;
+
+    // Printer-initiated messages. Image bytes are counted, not framed, so an
+    // ack written between two chunks would land inside the JPEG; once the
+    // first chunk is out, acks wait here until the last one is.
+    struct PendingAck {
+        KodakPrinterEvent event;
+        uint8_t errorCode;
+    };
+    KodakEventCallback eventCallback;
+    void* eventContext;
+    KodakPrinterEvent lastEvent;
+    uint32_t lastTransferEndedAt;       // millis() the last image byte was queued
+    PendingAck pendingAcks[BTP_EVENT_ACK_QUEUE];
+    uint8_t pendingAckCount;
+
+    // Transmit path with a writer task: one image chunk handed over and its
+    // write() result handed back, each through a lock-free ring
+    struct WriteChunk {
+        const uint8_t* data;
+        size_t len;
+    };
+    struct WriteResult {
+        size_t written;
+        uint32_t writeUs;
+    };
+    TaskHandle_t writerTask;
+    volatile bool writerRunning;
+    int8_t writerCore;
+    KodakSpscQueue<WriteChunk, 2> writerChunks;
+    KodakSpscQueue<WriteResult, 2> writerResults;
+    KodakTaskMeter writerMeter;
+
+    bool advance(TickType_t rxWaitTicks);
+    bool startRequest(KodakRequestType type, AsyncStep firstStep,
+                      KodakCompletionCallback callback, void* context);
+    void beginStep(AsyncStep step);
+    void buildStepPacket(AsyncStep step, uint8_t* buffer) const;
+    bool sendBatchCommand();
+    void handleResponse();
+    void handleBatchResponse();
+    uint32_t applyStatusResponse(AsyncStep step, const uint8_t* response);
+    void setPaperStatus(uint8_t errorCode);
+    AsyncStep nextPreflightStep(AsyncStep from);
+    bool transferChunk();
+    bool nextChunk();
+    bool finishChunk(size_t written, uint32_t writeUs);
+    void waitForWriter();
+    static void writerTaskEntry(void* arg);
+    void writerLoop();
+    void completeRequest(bool success, const char* error = nullptr);
+    void failWithPrinterError(uint8_t errorCode);
+    bool checkChunk(size_t offset, size_t length);
+    void failIntegrityCheck(const char* error);
+    bool rejectImage(const char* error);
+    bool nextPrintItem();
+    void finishPrintItems(const char* error);
+    bool pumpPrinterEvents();
+    bool handlePrinterEvent(KodakPrinterEvent event, uint8_t errorCode);
+    void sendEventAck(KodakPrinterEvent event, uint8_t errorCode);
+    void flushPendingAcks();
+    const char* stepFailureMessage() const;
+    uint32_t pollWaitMs() const;
+    bool runToCompletion();
+    bool quietPeriodElapsed() const;
+    void setQuietPeriod(uint32_t ms);
+    void runQuietPeriod();
 
     // Communication helpers (skipConnectionCheck for internal use after already checking)
     bool sendCommand(const uint8_t* command, size_t length, bool skipConnectionCheck = false);
-    bool receiveResponse(uint8_t* response, uint32_t timeoutMs = BTP_COMMAND_TIMEOUT_MS);
-    bool sendAndReceive(const uint8_t* command, uint8_t* response);
+    bool receiveResponseBytes(TickType_t waitTicks);
+    void onBluetoothData(const uint8_t* data, size_t length);
+    void flushReceived();
 
-    // Image transfer
-    bool transferImageData(const uint8_t* data, size_t size, KodakProgressCallback progressCallback);
+    // Connection helpers
+    void logCandidates();
+    bool connectToAddress(const BTAddress& address, uint32_t settleMs = BTP_CONNECT_SETTLE_MS);
+    bool discoverByName(const char* printerName);
+    void setScanFilter(const char* printerName);
+    void onDeviceDiscovered(BTAdvertisedDevice* device);
+    bool loadCachedAddress(const char* printerName, BTAddress* address);
+    void saveCachedAddress(const BTAddress& address, const char* deviceName);
+    void saveCachedSlimDevice(bool isSlimDevice);
+    bool linkLost();
+    bool linkConnected();
+    bool failRequest(const char* error);
+    bool onLinkDropped(const char* error);
+    bool attemptReconnect();
 
     // Utility
-    void setError(const char* error);
+    void setError(const char* error, uint8_t errorCode = BTP_ERR_NOT_CONNECTED);
+    void destroyBluetooth();
     void debugPrint(const char* msg);
     void debugPrintln(const char* msg);
 };
 
+// Inline so the message strings drop out of the image when BTP_LOG_LEVEL is BTP_LOG_NONE
+inline void KodakStepPrinter::debugPrint(const char* msg) {
+    if (BTP_LOG_ENABLED(BTP_LOG_INFO, logger != nullptr)) {
+        logger->log(KODAK_LOG_MESSAGE, msg);
+    } else if (BTP_LOG_ENABLED(BTP_LOG_INFO, debugEnabled)) {
+        Serial.print(msg);
+    }
+}
+
+inline void KodakStepPrinter::debugPrintln(const char* msg) {
+    if (BTP_LOG_ENABLED(BTP_LOG_INFO, logger != nullptr)) {
+        logger->log(KODAK_LOG_MESSAGE, msg);
+    } else if (BTP_LOG_ENABLED(BTP_LOG_INFO, debugEnabled)) {
+        Serial.println(msg);
+    }
+}
+
 #endif // KODAK_STEP_PRINTER_H
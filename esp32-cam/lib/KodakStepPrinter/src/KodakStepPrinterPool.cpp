@@ -0,0 +1,260 @@
+#include "KodakStepPrinterPool.h"
+
+// Result for a job that failed before the printer engine could report one
+static KodakRequestResult poolFailure(uint8_t errorCode, const char* error) {
+    KodakRequestResult result;
+    result.type = KODAK_REQUEST_PRINT;
+    result.success = false;
+    result.errorCode = errorCode;
+    result.value = 0;
+    result.error = error;
+    return result;
+}
+
+static const char* poolStateName(KodakPoolPrinterState state) {
+    switch (state) {
+        case KODAK_POOL_IDLE: return "idle";
+        case KODAK_POOL_SENDING: return "sending";
+        case KODAK_POOL_PRINTING: return "printing";
+        case KODAK_POOL_ERROR: return "error";
+    }
+    return "?";
+}
+
+KodakStepPrinterPool::KodakStepPrinterPool(KodakStepPrinter& link) : link(link) {
+    memset(printers, 0, sizeof(printers));
+    printerCount = 0;
+    memset(queue, 0, sizeof(queue));
+    queueHead = 0;
+    queueCount = 0;
+    state = DISPATCH_IDLE;
+    memset(&active, 0, sizeof(active));
+    activePrinter = -1;
+    connectedPrinter = -1;
+    printCycleMs = BTP_POOL_PRINT_CYCLE_MS;
+}
+
+int KodakStepPrinterPool::addPrinter(const char* name, const char* address, bool isSlimDevice) {
+    if (printerCount >= BTP_POOL_MAX_PRINTERS || name == nullptr || address == nullptr) {
+        return -1;
+    }
+
+    KodakPoolPrinterStatus& printer = printers[printerCount];
+    memset(&printer, 0, sizeof(printer));
+    strncpy(printer.name, name, sizeof(printer.name) - 1);
+    printer.state = KODAK_POOL_IDLE;
+    printer.is_slim_device = isSlimDevice;
+    addresses[printerCount] = BTAddress(std::string(address));
+    return (int)printerCount++;
+}
+
+bool KodakStepPrinterPool::submit(KodakImageSource& source, uint8_t numCopies,
+                                  KodakPoolJobCallback callback, void* context) {
+    if (queueCount >= BTP_POOL_QUEUE_DEPTH || printerCount == 0) {
+        return false;
+    }
+
+    Job& job = queue[(queueHead + queueCount) % BTP_POOL_QUEUE_DEPTH];
+    job.source = &source;
+    job.numCopies = numCopies;
+    job.attempts = 0;
+    job.callback = callback;
+    job.context = context;
+    queueCount++;
+    return true;
+}
+
+bool KodakStepPrinterPool::poll() {
+    refreshStates();
+
+    if (state != DISPATCH_IDLE) {
+        link.poll();
+        return true;
+    }
+
+    // Supervise the link between jobs; a reconnect in progress holds dispatch
+    if (link.poll()) {
+        return true;
+    }
+
+    if (queueCount == 0) {
+        return false;
+    }
+
+    int index = selectPrinter();
+    if (index < 0) {
+        return true;  // Every printer is printing or sitting out an error
+    }
+
+    active = queue[queueHead];
+    queueHead = (queueHead + 1) % BTP_POOL_QUEUE_DEPTH;
+    queueCount--;
+    activePrinter = index;
+    startJob(index);
+    return true;
+}
+
+bool KodakStepPrinterPool::isBusy() const {
+    return state != DISPATCH_IDLE || queueCount > 0;
+}
+
+size_t KodakStepPrinterPool::getQueuedJobs() const {
+    return queueCount;
+}
+
+size_t KodakStepPrinterPool::getPrinterCount() const {
+    return printerCount;
+}
+
+const KodakPoolPrinterStatus& KodakStepPrinterPool::getPrinterStatus(size_t index) const {
+    return printers[(index < printerCount) ? index : 0];
+}
+
+void KodakStepPrinterPool::printStatusTable() const {
+    Serial.println("#  Name                State     Batt  Sent  Failed  Error");
+    for (size_t i = 0; i < printerCount; i++) {
+        const KodakPoolPrinterStatus& printer = printers[i];
+        Serial.printf("%-2u %-19s %-9s %3u%%  %4lu  %6lu  %s\n",
+                      (unsigned)i, printer.name, poolStateName(printer.state),
+                      printer.battery_level, (unsigned long)printer.jobs_sent,
+                      (unsigned long)printer.jobs_failed,
+                      (printer.state != KODAK_POOL_ERROR) ? "-"
+                      : (printer.error_code != BTP_ERR_SUCCESS)
+                          ? KodakStepProtocol::getErrorString(printer.error_code)
+                          : "Request failed");
+    }
+}
+
+void KodakStepPrinterPool::setPrintCycleMs(uint32_t ms) {
+    printCycleMs = ms;
+}
+
+// =============================================================================
+// Dispatch
+// =============================================================================
+
+void KodakStepPrinterPool::refreshStates() {
+    uint32_t now = millis();
+    for (size_t i = 0; i < printerCount; i++) {
+        KodakPoolPrinterStatus& printer = printers[i];
+        if ((printer.state == KODAK_POOL_PRINTING || printer.state == KODAK_POOL_ERROR) &&
+            (int32_t)(now - printer.available_at_ms) >= 0) {
+            printer.state = KODAK_POOL_IDLE;
+        }
+    }
+}
+
+int KodakStepPrinterPool::selectPrinter() {
+    // Least busy: fewest jobs sent, ties go to the printer already on the link
+    int best = -1;
+    for (size_t i = 0; i < printerCount; i++) {
+        if (printers[i].state != KODAK_POOL_IDLE) {
+            continue;
+        }
+        if (best < 0 || printers[i].jobs_sent < printers[best].jobs_sent ||
+            (printers[i].jobs_sent == printers[best].jobs_sent && (int)i == connectedPrinter)) {
+            best = (int)i;
+        }
+    }
+    return best;
+}
+
+bool KodakStepPrinterPool::startJob(int index) {
+    KodakPoolPrinterStatus& printer = printers[index];
+    printer.state = KODAK_POOL_SENDING;
+    active.attempts++;
+
+    if (connectedPrinter == index && link.isConnected()) {
+        state = DISPATCH_PRINTING;
+        if (!link.printImageAsync(*active.source, active.numCopies, nullptr, onPrinted, this)) {
+            finishJob(poolFailure(link.getLastErrorCode(), link.getLastError()));
+            return false;
+        }
+        return true;
+    }
+
+    // Hand the single SPP link over to this printer
+    connectedPrinter = -1;
+    if (link.isConnected()) {
+        link.disconnect();
+    }
+    if (!link.connect(addresses[index])) {
+        finishJob(poolFailure(BTP_ERR_NOT_CONNECTED, "Failed to connect to printer"));
+        return false;
+    }
+
+    state = DISPATCH_INITIALIZING;
+    if (!link.initializeAsync(printer.is_slim_device, onInitialized, this)) {
+        finishJob(poolFailure(link.getLastErrorCode(), link.getLastError()));
+        return false;
+    }
+    return true;
+}
+
+void KodakStepPrinterPool::finishJob(const KodakRequestResult& result) {
+    KodakPoolPrinterStatus& printer = printers[activePrinter];
+    uint32_t now = millis();
+
+    state = DISPATCH_IDLE;
+    if (link.isConnected()) {
+        printer.battery_level = link.getStatus().battery_level;
+    } else {
+        connectedPrinter = -1;
+    }
+
+    if (result.success) {
+        printer.jobs_sent++;
+        printer.error_code = BTP_ERR_SUCCESS;
+        printer.state = KODAK_POOL_PRINTING;
+        printer.available_at_ms = now + printCycleMs * (active.numCopies > 0 ? active.numCopies : 1);
+    } else if (KodakStepProtocol::classifyError(result.errorCode) == KODAK_ERROR_DATA) {
+        // The image is at fault, not the printer: resending the same bytes
+        // elsewhere cannot succeed, and this printer stays usable
+        printer.jobs_failed++;
+        printer.error_code = result.errorCode;
+        printer.state = KODAK_POOL_IDLE;
+    } else {
+        printer.jobs_failed++;
+        printer.error_code = result.errorCode;
+        printer.state = KODAK_POOL_ERROR;
+        printer.available_at_ms = now + BTP_POOL_ERROR_RETRY_MS;
+
+        // Give another printer a go before reporting the failure
+        if (active.attempts < BTP_POOL_MAX_ATTEMPTS && active.source->rewind() &&
+            queueCount < BTP_POOL_QUEUE_DEPTH) {
+            requeueFront(active);
+            return;
+        }
+    }
+
+    if (active.callback != nullptr) {
+        active.callback(activePrinter, result, active.context);
+    }
+}
+
+void KodakStepPrinterPool::requeueFront(const Job& job) {
+    queueHead = (queueHead + BTP_POOL_QUEUE_DEPTH - 1) % BTP_POOL_QUEUE_DEPTH;
+    queue[queueHead] = job;
+    queueCount++;
+}
+
+void KodakStepPrinterPool::onInitialized(const KodakRequestResult& result, void* context) {
+    KodakStepPrinterPool* pool = static_cast<KodakStepPrinterPool*>(context);
+
+    if (!result.success) {
+        pool->finishJob(result);
+        return;
+    }
+
+    // The engine is idle again inside its callback, so the print can start here
+    pool->connectedPrinter = pool->activePrinter;
+    pool->state = DISPATCH_PRINTING;
+    if (!pool->link.printImageAsync(*pool->active.source, pool->active.numCopies, nullptr,
+                                    onPrinted, pool)) {
+        pool->finishJob(poolFailure(pool->link.getLastErrorCode(), pool->link.getLastError()));
+    }
+}
+
+void KodakStepPrinterPool::onPrinted(const KodakRequestResult& result, void* context) {
+    static_cast<KodakStepPrinterPool*>(context)->finishJob(result);
+}
@@ -0,0 +1,124 @@
+#ifndef KODAK_STEP_PRINTER_POOL_H
+#define KODAK_STEP_PRINTER_POOL_H
+
+#include <Arduino.h>
+#include "KodakStepPrinter.h"
+
+// Pool configuration
+#define BTP_POOL_MAX_PRINTERS 4
+#define BTP_POOL_QUEUE_DEPTH 8
+#define BTP_POOL_PRINT_CYCLE_MS 60000   // Time a printer needs per copy once the data is in
+#define BTP_POOL_ERROR_RETRY_MS 30000   // How long a failed printer sits out
+#define BTP_POOL_MAX_ATTEMPTS 2         // Tries per job across the pool
+
+// Per-printer state as seen by the pool
+enum KodakPoolPrinterState {
+    KODAK_POOL_IDLE,        // Ready for a job
+    KODAK_POOL_SENDING,     // Holds the Bluetooth link, transferring a job
+    KODAK_POOL_PRINTING,    // Data delivered, printer busy on its own
+    KODAK_POOL_ERROR        // Last job failed; skipped until the retry time
+};
+
+// One row of the pool's status table
+struct KodakPoolPrinterStatus {
+    char name[BTP_CACHE_NAME_SIZE];
+    KodakPoolPrinterState state;
+    bool is_slim_device;
+    uint8_t battery_level;
+    uint8_t error_code;         // BTP_ERR_* from the last failure
+    uint32_t jobs_sent;
+    uint32_t jobs_failed;
+    uint32_t available_at_ms;   // millis() when PRINTING or ERROR ends
+};
+
+// Called when a pool job finishes; printerIndex is -1 if no printer took it
+typedef void (*KodakPoolJobCallback)(int printerIndex, const KodakRequestResult& result,
+                                     void* context);
+
+/**
+ * Fan print jobs out over several Kodak Step printers
+ *
+ * Arduino's BluetoothSerial drives a single SPP connection, so the pool
+ * time-multiplexes one KodakStepPrinter link: a printer only needs the link
+ * while the JPEG is transferred and then spends about a minute printing on
+ * its own. The pool sends the next queued job to another printer meanwhile,
+ * so N printers give close to N times the throughput.
+ *
+ * Jobs go to the least-busy printer: an idle one that is not in an error
+ * state and has sent the fewest jobs, preferring the one already connected.
+ * A failed job is retried once on another printer if its source can rewind;
+ * one that failed on its image data (KODAK_ERROR_DATA) is reported at once.
+ *
+ * Usage:
+ *   KodakStepPrinterPool pool(printer);
+ *   pool.addPrinter("Booth A", "aa:bb:cc:dd:ee:01");
+ *   pool.addPrinter("Booth B", "aa:bb:cc:dd:ee:02");
+ *   pool.submit(source, 1, onDone);
+ *   void loop() { pool.poll(); }
+ */
+class KodakStepPrinterPool {
+public:
+    explicit KodakStepPrinterPool(KodakStepPrinter& link);
+
+    KodakStepPrinterPool(const KodakStepPrinterPool&) = delete;
+    KodakStepPrinterPool& operator=(const KodakStepPrinterPool&) = delete;
+
+    // Register a printer; returns its index or -1 if the pool is full
+    int addPrinter(const char* name, const char* address, bool isSlimDevice = false);
+
+    // Queue a job; the source must stay valid until its callback fires
+    bool submit(KodakImageSource& source, uint8_t numCopies = 1,
+                KodakPoolJobCallback callback = nullptr, void* context = nullptr);
+
+    bool poll();                // Drive dispatch and the link; true while work is pending
+    bool isBusy() const;
+    size_t getQueuedJobs() const;
+
+    // Status table
+    size_t getPrinterCount() const;
+    const KodakPoolPrinterStatus& getPrinterStatus(size_t index) const;
+    void printStatusTable() const;
+
+    void setPrintCycleMs(uint32_t ms);
+
+private:
+    enum DispatchState {
+        DISPATCH_IDLE,
+        DISPATCH_INITIALIZING,
+        DISPATCH_PRINTING
+    };
+
+    struct Job {
+        KodakImageSource* source;
+        uint8_t numCopies;
+        uint8_t attempts;
+        KodakPoolJobCallback callback;
+        void* context;
+    };
+
+    KodakStepPrinter& link;
+    KodakPoolPrinterStatus printers[BTP_POOL_MAX_PRINTERS];
+    BTAddress addresses[BTP_POOL_MAX_PRINTERS];
+    size_t printerCount;
+
+    Job queue[BTP_POOL_QUEUE_DEPTH];
+    size_t queueHead;
+    size_t queueCount;
+
+    DispatchState state;
+    Job active;
+    int activePrinter;
+    int connectedPrinter;       // Printer the link is initialized against, -1 if none
+    uint32_t printCycleMs;
+
+    int selectPrinter();
+    void refreshStates();
+    bool startJob(int index);
+    void finishJob(const KodakRequestResult& result);
+    void requeueFront(const Job& job);
+
+    static void onInitialized(const KodakRequestResult& result, void* context);
+    static void onPrinted(const KodakRequestResult& result, void* context);
+};
+
+#endif // KODAK_STEP_PRINTER_POOL_H
@@ -1,58 +1,59 @@
 #include "KodakStepProtocol.h"
+#ifdef ESP_PLATFORM
+#include "esp_rom_crc.h"
+#endif
 
 KodakStepProtocol::KodakStepProtocol() {
 }
 
-void KodakStepProtocol::initPacketHeader(uint8_t* buffer, uint8_t flags1, uint8_t flags2) const {
-    memset(buffer, 0, BTP_PACKET_SIZE);
-    buffer[0] = BTP_START_1;  // 0x1B (ESC)
-    buffer[1] = BTP_START_2;  // 0x2A (*)
-    buffer[2] = BTP_IDENT_1;  // 0x43 (C)
-    buffer[3] = BTP_IDENT_2;  // 0x41 (A)
-    buffer[4] = flags1;
-    buffer[5] = flags2;
+// Packet templates, expanded from BTP_PACKET_TABLE at compile time. Only
+// bytes 4-8 vary, so the remaining 25 bytes are spelled out once here.
+#define BTP_PACKET_BYTES(name, f1, f2, cmd, sub, b8)                              \
+    {BTP_START_1, BTP_START_2, BTP_IDENT_1, BTP_IDENT_2, f1, f2, cmd, sub, b8, \
+     0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
+
+static constexpr uint8_t BTP_PACKET_TEMPLATES[KODAK_PACKET_COUNT][BTP_PACKET_SIZE] = {
+    BTP_PACKET_TABLE(BTP_PACKET_BYTES)
+};
+
+#undef BTP_PACKET_BYTES
+
+static inline void copyTemplate(uint8_t* buffer, KodakPacketId id) {
+    memcpy(buffer, BTP_PACKET_TEMPLATES[id], BTP_PACKET_SIZE);
+}
+
+const uint8_t* KodakStepProtocol::packetTemplate(KodakPacketId id) {
+    return (id < KODAK_PACKET_COUNT) ? BTP_PACKET_TEMPLATES[id] : nullptr;
 }
 
 void KodakStepProtocol::buildGetAccessoryInfoPacket(uint8_t* buffer, bool isSlim) const {
     // 1B 2A 43 41 00 [00|02] 01 00 00 00 00 00... (rest zeros)
-    initPacketHeader(buffer, 0x00, isSlim ? BTP_FLAG_SLIM_DEVICE : BTP_FLAG_STANDARD_DEVICE);
-    buffer[6] = BTP_CMD_GET_ACCESSORY_INFO;
-    buffer[7] = 0x00;
+    copyTemplate(buffer, isSlim ? KODAK_PACKET_ACCESSORY_INFO_SLIM : KODAK_PACKET_ACCESSORY_INFO);
 }
 
 void KodakStepProtocol::buildGetBatteryLevelPacket(uint8_t* buffer) const {
     // 1B 2A 43 41 00 00 0E 00 00 00 00 00... (rest zeros)
-    initPacketHeader(buffer);
-    buffer[6] = BTP_CMD_GET_BATTERY_LEVEL;
-    buffer[7] = 0x00;
+    copyTemplate(buffer, KODAK_PACKET_BATTERY_LEVEL);
 }
 
 void KodakStepProtocol::buildGetPageTypePacket(uint8_t* buffer) const {
     // 1B 2A 43 41 00 00 0D 00 00 00 00 00... (rest zeros)
-    initPacketHeader(buffer);
-    buffer[6] = BTP_CMD_GET_PAGE_TYPE;
-    buffer[7] = 0x00;
+    copyTemplate(buffer, KODAK_PACKET_PAGE_TYPE);
 }
 
 void KodakStepProtocol::buildGetPrintCountPacket(uint8_t* buffer) const {
     // 1B 2A 43 41 00 00 00 01 00 00 00 00... (rest zeros)
-    initPacketHeader(buffer);
-    buffer[6] = BTP_CMD_PRINT_READY;  // 0x00
-    buffer[7] = 0x01;  // Flag distinguishes from PRINT_READY
+    copyTemplate(buffer, KODAK_PACKET_PRINT_COUNT);
 }
 
 void KodakStepProtocol::buildGetAutoPowerOffPacket(uint8_t* buffer) const {
     // 1B 2A 43 41 00 00 10 00 00 00 00 00... (rest zeros)
-    initPacketHeader(buffer);
-    buffer[6] = BTP_CMD_GET_AUTO_POWER_OFF;
-    buffer[7] = 0x00;
+    copyTemplate(buffer, KODAK_PACKET_AUTO_POWER_OFF);
 }
 
 void KodakStepProtocol::buildPrintReadyPacket(uint8_t* buffer, uint32_t imageSize, uint8_t numCopies) const {
     // 1B 2A 43 41 00 00 00 00 [SZ] [SZ] [SZ] [CP] 00 00 00 00... (rest zeros)
-    initPacketHeader(buffer);
-    buffer[6] = BTP_CMD_PRINT_READY;  // 0x00
-    buffer[7] = 0x00;
+    copyTemplate(buffer, KODAK_PACKET_PRINT_READY);
 
     // Image size - 3 bytes, big-endian
     buffer[8] = (imageSize >> 16) & 0xFF;  // MSB
@@ -61,67 +62,71 @@ void KodakStepProtocol::buildPrintReadyPacket(uint8_t* buffer, uint32_t imageSiz
 
     // Number of copies
     buffer[11] = numCopies;
-
-    // Bytes 12-15 are zeros (already set by initPacketHeader)
 }
 
 void KodakStepProtocol::buildStartOfSendAck(uint8_t* buffer) const {
     // 1B 2A 43 41 00 00 01 00 02 00 00 00... (rest zeros)
-    initPacketHeader(buffer);
-    buffer[6] = 0x01;
-    buffer[7] = 0x00;
-    buffer[8] = 0x02;
+    copyTemplate(buffer, KODAK_PACKET_START_OF_SEND_ACK);
 }
 
 void KodakStepProtocol::buildEndOfReceivedAck(uint8_t* buffer) const {
     // 1B 2A 43 41 00 00 01 01 02 00 00 00... (rest zeros)
-    initPacketHeader(buffer);
-    buffer[6] = 0x01;
-    buffer[7] = 0x01;
-    buffer[8] = 0x02;
+    copyTemplate(buffer, KODAK_PACKET_END_OF_RECEIVED_ACK);
 }
 
 void KodakStepProtocol::buildErrorMessageAck(uint8_t* buffer, uint8_t errorCode) const {
     // 1B 2A 43 41 00 00 01 00 [EC] 00 00 00... (rest zeros)
-    initPacketHeader(buffer);
-    buffer[6] = 0x01;
-    buffer[7] = 0x00;
+    copyTemplate(buffer, KODAK_PACKET_ERROR_MESSAGE_ACK);
     buffer[8] = errorCode;
 }
 
+bool KodakStepProtocol::buildEventAck(uint8_t* buffer, KodakPrinterEvent event, uint8_t errorCode) const {
+    switch (event) {
+        case KODAK_EVENT_START_OF_SEND:
+            buildStartOfSendAck(buffer);
+            return true;
+        case KODAK_EVENT_DATA_ACCEPTED:
+            buildEndOfReceivedAck(buffer);
+            return true;
+        case KODAK_EVENT_PRINT_FINISHED:
+        case KODAK_EVENT_ERROR:
+            // Echoes the reported code, BTP_ERR_SUCCESS for print finished
+            buildErrorMessageAck(buffer, errorCode);
+            return true;
+        case KODAK_EVENT_NONE:
+            break;
+    }
+    return false;
+}
+
+// The parse* helpers predate the response views and are kept for existing
+// callers; new code should construct a view over the frame instead.
+
 bool KodakStepProtocol::parseResponse(const uint8_t* response, uint8_t* errorCode, uint8_t* dataOut) const {
     if (errorCode == nullptr) {
         return false;
     }
 
-    // Verify header
-    if (response[0] != BTP_START_1 ||
-        response[1] != BTP_START_2 ||
-        response[2] != BTP_IDENT_1 ||
-        response[3] != BTP_IDENT_2) {
-        *errorCode = BTP_ERR_NOT_CONNECTED;
+    KodakResponseView view(response);
+    *errorCode = view.errorCode();
+    if (!view.isValid()) {
         return false;
     }
 
-    // Extract error code from byte 8
-    *errorCode = response[8];
-
     // Copy payload if requested (bytes 9-33)
     if (dataOut != nullptr) {
-        memcpy(dataOut, &response[9], 25);
+        memcpy(dataOut, view.payload(), BTP_PAYLOAD_SIZE);
     }
 
-    return (*errorCode == BTP_ERR_SUCCESS);
+    return view.ok();
 }
 
 uint16_t KodakStepProtocol::parsePrintCount(const uint8_t* response) const {
-    // Print count is a 16-bit value in bytes 8-9 (big-endian)
-    return (response[8] << 8) | response[9];
+    return KodakPrintCountView(response).printCount();
 }
 
 uint8_t KodakStepProtocol::parseAutoPowerOff(const uint8_t* response) const {
-    // Auto power off timeout in minutes is in byte 8
-    return response[8];
+    return KodakAutoPowerOffView(response).minutes();
 }
 
 uint8_t KodakStepProtocol::parseErrorCode(const uint8_t* response) const {
@@ -129,6 +134,71 @@ uint8_t KodakStepProtocol::parseErrorCode(const uint8_t* response) const {
     return response[8];
 }
 
+bool KodakStepProtocol::isFresh(uint32_t updatedMs, uint32_t nowMs, uint32_t ttlMs) {
+    // Unsigned subtraction keeps working across the 49-day millis() wrap
+    return ttlMs > 0 && updatedMs != 0 && (nowMs - updatedMs) < ttlMs;
+}
+
+size_t KodakStepProtocol::targetImageSize(bool isSlimDevice, size_t largestFreePsram) {
+    size_t target = isSlimDevice ? BTP_TARGET_IMAGE_SIZE_SLIM : BTP_TARGET_IMAGE_SIZE;
+
+    // The encoded image and whatever it is re-encoded from must both fit
+    size_t headroom = largestFreePsram / 2;
+    if (largestFreePsram != 0 && headroom < target) {
+        target = headroom;
+    }
+    if (target < BTP_MIN_TARGET_IMAGE_SIZE) {
+        target = BTP_MIN_TARGET_IMAGE_SIZE;
+    }
+    return (target < BTP_MAX_IMAGE_SIZE) ? target : BTP_MAX_IMAGE_SIZE;
+}
+
+#ifndef ESP_PLATFORM
+// Reflected polynomial 0xEDB88320, four bits at a time: 64 bytes of table
+static const uint32_t BTP_CRC32_NIBBLES[16] = {
+    0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC, 0x76DC4190, 0x6B6B51F4, 0x4DB26158, 0x5005713C,
+    0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C, 0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C
+};
+#endif
+
+uint32_t KodakStepProtocol::crc32(uint32_t crc, const uint8_t* data, size_t length) {
+    if (data == nullptr || length == 0) {
+        return crc;
+    }
+#ifdef ESP_PLATFORM
+    // Table-driven routine in mask ROM: no flash cache misses, no table in DRAM
+    return esp_rom_crc32_le(crc, data, length);
+#else
+    crc = ~crc;
+    for (size_t i = 0; i < length; i++) {
+        crc = BTP_CRC32_NIBBLES[(crc ^ data[i]) & 0x0F] ^ (crc >> 4);
+        crc = BTP_CRC32_NIBBLES[(crc ^ (data[i] >> 4)) & 0x0F] ^ (crc >> 4);
+    }
+    return ~crc;
+#endif
+}
+
+bool KodakStepProtocol::hasJpegMarkers(const uint8_t* data, size_t length) {
+    if (data == nullptr || length < 4 || data[0] != 0xFF || data[1] != 0xD8) {
+        return false;
+    }
+    size_t window = (length - 2 < BTP_JPEG_EOI_WINDOW) ? length - 2 : BTP_JPEG_EOI_WINDOW;
+    return hasJpegEnd(data + length - window, window);
+}
+
+bool KodakStepProtocol::hasJpegEnd(const uint8_t* tail, size_t length) {
+    if (tail == nullptr) {
+        return false;
+    }
+    // Search backwards: EOI is normally the last two bytes
+    for (size_t i = length; i >= 2; i--) {
+        if (tail[i - 2] == 0xFF && tail[i - 1] == 0xD9) {
+            return true;
+        }
+    }
+    return false;
+}
+
 const char* KodakStepProtocol::getErrorString(uint8_t errorCode) {
     switch (errorCode) {
         case BTP_ERR_SUCCESS: return "Success";
@@ -141,13 +211,70 @@ const char* KodakStepProtocol::getErrorString(uint8_t errorCode) {
         case BTP_ERR_COOLING: return "Printer cooling";
         case BTP_ERR_MISFEED: return "Paper misfeed";
         case BTP_ERR_BUSY: return "Printer busy";
+        case BTP_ERR_BAD_IMAGE: return "Image failed integrity check";
         case BTP_ERR_NOT_CONNECTED: return "Not connected";
         default: return "Unknown error";
     }
 }
 
+KodakErrorClass KodakStepProtocol::classifyError(uint8_t errorCode) {
+    switch (errorCode) {
+        case BTP_ERR_SUCCESS:
+            return KODAK_ERROR_NONE;
+        case BTP_ERR_BUSY:
+        case BTP_ERR_COOLING:
+        case BTP_ERR_OVERHEATING:
+            return KODAK_ERROR_TRANSIENT;
+        case BTP_ERR_PAPER_JAM:
+        case BTP_ERR_NO_PAPER:
+        case BTP_ERR_COVER_OPEN:
+        case BTP_ERR_PAPER_MISMATCH:
+        case BTP_ERR_LOW_BATTERY:
+        case BTP_ERR_MISFEED:
+            return KODAK_ERROR_ATTENTION;
+        case BTP_ERR_NOT_CONNECTED:
+            return KODAK_ERROR_LINK;
+        case BTP_ERR_BAD_IMAGE:
+            return KODAK_ERROR_DATA;
+        default:
+            return KODAK_ERROR_UNKNOWN;
+    }
+}
+
+KodakPrinterEvent KodakStepProtocol::classifyMessage(const uint8_t* frame) {
+    KodakResponseView message(frame);
+    if (!message.isValid()) {
+        return KODAK_EVENT_NONE;
+    }
+
+    if (message.type() == BTP_MSG_UPLOAD_REQUEST && message.subType() == BTP_MSG_SUB_UPLOAD_REQUEST) {
+        return KODAK_EVENT_START_OF_SEND;
+    }
+    if (message.type() == BTP_MSG_NOTIFY) {
+        if (message.subType() == BTP_MSG_SUB_END_OF_RECEIVED) {
+            return KODAK_EVENT_DATA_ACCEPTED;
+        }
+        if (message.subType() == BTP_MSG_SUB_ERROR) {
+            return message.ok() ? KODAK_EVENT_PRINT_FINISHED : KODAK_EVENT_ERROR;
+        }
+    }
+    // Accessory info replies also use byte 6 = 0x01, with sub type 0x02
+    return KODAK_EVENT_NONE;
+}
+
+const char* KodakStepProtocol::getEventName(KodakPrinterEvent event) {
+    switch (event) {
+        case KODAK_EVENT_NONE: return "None";
+        case KODAK_EVENT_START_OF_SEND: return "Start of send";
+        case KODAK_EVENT_DATA_ACCEPTED: return "Data accepted";
+        case KODAK_EVENT_PRINT_FINISHED: return "Print finished";
+        case KODAK_EVENT_ERROR: return "Printer error";
+    }
+    return "Unknown";
+}
+
 void KodakStepProtocol::printPacketHex(const uint8_t* packet, size_t length, bool enabled) {
-    if (!enabled) return;
+    if (!BTP_LOG_ENABLED(BTP_LOG_VERBOSE, enabled)) return;
 
     Serial.print("Packet [");
     Serial.print(length);
@@ -163,3 +290,59 @@ void KodakStepProtocol::printPacketHex(const uint8_t* packet, size_t length, boo
     }
     Serial.println();
 }
+
+// =============================================================================
+// KodakFrameAssembler
+// =============================================================================
+
+static const uint8_t BTP_HEADER[4] = {BTP_START_1, BTP_START_2, BTP_IDENT_1, BTP_IDENT_2};
+
+KodakFrameAssembler::KodakFrameAssembler() {
+    length = 0;
+    discarded = 0;
+}
+
+void KodakFrameAssembler::reset() {
+    length = 0;
+}
+
+size_t KodakFrameAssembler::feed(const uint8_t* data, size_t count) {
+    size_t consumed = 0;
+
+    while (consumed < count && length < BTP_PACKET_SIZE) {
+        uint8_t b = data[consumed++];
+
+        if (length < sizeof(BTP_HEADER) && b != BTP_HEADER[length]) {
+            // Header bytes are all distinct, so the only possible restart is this byte
+            discarded += length;
+            if (b == BTP_HEADER[0]) {
+                buffer[0] = b;
+                length = 1;
+            } else {
+                discarded++;
+                length = 0;
+            }
+            continue;
+        }
+
+        buffer[length++] = b;
+    }
+
+    return consumed;
+}
+
+bool KodakFrameAssembler::hasFrame() const {
+    return length >= BTP_PACKET_SIZE;
+}
+
+const uint8_t* KodakFrameAssembler::frame() const {
+    return buffer;
+}
+
+size_t KodakFrameAssembler::bytesNeeded() const {
+    return BTP_PACKET_SIZE - length;
+}
+
+uint32_t KodakFrameAssembler::getDiscardedBytes() const {
+    return discarded;
+}
@@ -9,7 +9,32 @@
 #define BTP_INTER_CHUNK_DELAY_MS 20
 #define BTP_COMMAND_TIMEOUT_MS 5000
 #define BTP_MIN_BATTERY_LEVEL 30
-#define BTP_MAX_IMAGE_SIZE (2 * 1024 * 1024)  // 2MB max (practical limit for ESP32 with PSRAM)
+#define BTP_SIZE_FIELD_MAX 0xFFFFFF           // PRINT_READY carries the image size in 3 bytes
+#define BTP_MAX_IMAGE_SIZE (2 * 1024 * 1024)  // Hard ceiling for any transfer; aim for the target below
+#define BTP_PAYLOAD_OFFSET 9
+#define BTP_PAYLOAD_SIZE (BTP_PACKET_SIZE - BTP_PAYLOAD_OFFSET)  // Response bytes 9-33
+#define BTP_JPEG_EOI_WINDOW 32                // Trailing bytes searched for EOI; some encoders pad after it
+
+// Per-model JPEG size targets. The firmware limits are not published; these
+// are conservative defaults that print at full raster quality. Override with
+// -DBTP_TARGET_IMAGE_SIZE=<bytes> and friends.
+#ifndef BTP_TARGET_IMAGE_SIZE
+#define BTP_TARGET_IMAGE_SIZE (512 * 1024)        // Step, Step Touch, Touch Snap 2
+#endif
+#ifndef BTP_TARGET_IMAGE_SIZE_SLIM
+#define BTP_TARGET_IMAGE_SIZE_SLIM (256 * 1024)   // Step Slim
+#endif
+#define BTP_MIN_TARGET_IMAGE_SIZE (64 * 1024)     // Floor when PSRAM is short
+
+// Debug log levels. Messages above BTP_LOG_LEVEL are compiled out of the image;
+// setDebugOutput() gates the rest at run time. Set with -DBTP_LOG_LEVEL=<n>.
+#define BTP_LOG_NONE 0
+#define BTP_LOG_INFO 1      // Connection, handshake and print lifecycle
+#define BTP_LOG_VERBOSE 2   // Packet hex dumps and per-chunk transfer progress
+#ifndef BTP_LOG_LEVEL
+#define BTP_LOG_LEVEL BTP_LOG_INFO
+#endif
+#define BTP_LOG_ENABLED(level, runtime) (BTP_LOG_LEVEL >= (level) && (runtime))
 
 // Packet Header Bytes
 #define BTP_START_1 0x1B  // ESC
@@ -25,6 +50,20 @@
 #define BTP_CMD_GET_AUTO_POWER_OFF 0x10
 #define BTP_CMD_PRINT_READY 0x00
 
+// Response Types (Response Byte 6)
+#define BTP_RESP_ACCESSORY_INFO 0x01
+#define BTP_RESP_CHARGING_STATUS 0x04  // Reply to GET_BATTERY_LEVEL
+#define BTP_RESP_PAGE_TYPE 0x0D
+#define BTP_RESP_AUTO_POWER_OFF 0x10
+
+// Printer-initiated messages (bytes 6-7). The upload request is in the
+// response table; the other two are inferred from the acks that answer them.
+#define BTP_MSG_UPLOAD_REQUEST 0x00         // Byte 7 BTP_MSG_SUB_UPLOAD_REQUEST
+#define BTP_MSG_SUB_UPLOAD_REQUEST 0x02
+#define BTP_MSG_NOTIFY 0x01                 // Error report or END_OF_RECEIVED, by byte 7
+#define BTP_MSG_SUB_ERROR 0x00              // Byte 8 is the error code; 0 once the print is out
+#define BTP_MSG_SUB_END_OF_RECEIVED 0x01
+
 // Error Codes (Response Byte 8)
 #define BTP_ERR_SUCCESS 0x00
 #define BTP_ERR_PAPER_JAM 0x01
@@ -36,12 +75,56 @@
 #define BTP_ERR_COOLING 0x07
 #define BTP_ERR_MISFEED 0x08
 #define BTP_ERR_BUSY 0x09
+#define BTP_ERR_BAD_IMAGE 0xFD       // Host-side: the image failed an integrity check and was not printed
 #define BTP_ERR_NOT_CONNECTED 0xFE
 
+// What an error code asks of the caller (see KodakStepProtocol::classifyError)
+enum KodakErrorClass : uint8_t {
+    KODAK_ERROR_NONE,
+    KODAK_ERROR_TRANSIENT,      // Busy, cooling, overheating: clears on its own
+    KODAK_ERROR_ATTENTION,      // Jam, paper, cover, misfeed, battery: needs the user
+    KODAK_ERROR_LINK,           // Not connected
+    KODAK_ERROR_DATA,           // Bad image: resending the same bytes cannot help
+    KODAK_ERROR_UNKNOWN
+};
+
+// Printer-initiated message (see KodakStepProtocol::classifyMessage)
+enum KodakPrinterEvent : uint8_t {
+    KODAK_EVENT_NONE,               // A reply to a command
+    KODAK_EVENT_START_OF_SEND,      // Printer asks for the image data
+    KODAK_EVENT_DATA_ACCEPTED,      // END_OF_RECEIVED: the whole image has arrived
+    KODAK_EVENT_PRINT_FINISHED,     // Error report with BTP_ERR_SUCCESS: the sheet is out
+    KODAK_EVENT_ERROR               // Error report with a BTP_ERR_* code
+};
+
 // Device Type Flags (Byte 5)
 #define BTP_FLAG_STANDARD_DEVICE 0x00
 #define BTP_FLAG_SLIM_DEVICE 0x02
 
+// Command descriptor table: one entry per outgoing packet, expanded at compile
+// time into 34-byte templates in flash. Columns are packet bytes 4-8
+// (flags1, flags2, command, sub type, byte 8); everything after is zero unless
+// the builder patches it. Add new commands here.
+//   X(name,                flags1, flags2,                   command,                    sub,  byte8)
+#define BTP_PACKET_TABLE(X) \
+    X(ACCESSORY_INFO,       0x00, BTP_FLAG_STANDARD_DEVICE, BTP_CMD_GET_ACCESSORY_INFO, 0x00, 0x00) \
+    X(ACCESSORY_INFO_SLIM,  0x00, BTP_FLAG_SLIM_DEVICE,     BTP_CMD_GET_ACCESSORY_INFO, 0x00, 0x00) \
+    X(BATTERY_LEVEL,        0x00, 0x00,                     BTP_CMD_GET_BATTERY_LEVEL,  0x00, 0x00) \
+    X(PAGE_TYPE,            0x00, 0x00,                     BTP_CMD_GET_PAGE_TYPE,      0x00, 0x00) \
+    X(PRINT_COUNT,          0x00, 0x00,                     BTP_CMD_PRINT_READY,        0x01, 0x00) \
+    X(AUTO_POWER_OFF,       0x00, 0x00,                     BTP_CMD_GET_AUTO_POWER_OFF, 0x00, 0x00) \
+    X(PRINT_READY,          0x00, 0x00,                     BTP_CMD_PRINT_READY,        0x00, 0x00) \
+    X(START_OF_SEND_ACK,    0x00, 0x00,                     0x01,                       0x00, 0x02) \
+    X(END_OF_RECEIVED_ACK,  0x00, 0x00,                     0x01,                       0x01, 0x02) \
+    X(ERROR_MESSAGE_ACK,    0x00, 0x00,                     0x01,                       0x00, 0x00)
+
+enum KodakPacketId : uint8_t {
+#define BTP_PACKET_ID(name, f1, f2, cmd, sub, b8) KODAK_PACKET_##name,
+    BTP_PACKET_TABLE(BTP_PACKET_ID)
+#undef BTP_PACKET_ID
+    KODAK_PACKET_COUNT
+};
+
 /**
  * Kodak Step Printer Protocol Implementation
  * Based on reverse-engineered specification from Kodak Step Touch APK
@@ -54,6 +137,16 @@ public:
         uint8_t error_code;
         bool is_slim_device;
         bool is_connected;
+        bool is_charging;
+        uint16_t print_count;
+        uint8_t auto_power_off_minutes;
+
+        // millis() of the last successful read of each field (0 = not cached)
+        uint32_t battery_updated_ms;
+        uint32_t charging_updated_ms;
+        uint32_t paper_updated_ms;
+        uint32_t print_count_updated_ms;
+        uint32_t auto_power_off_updated_ms;
     };
 
     KodakStepProtocol();
@@ -68,6 +161,8 @@ public:
     void buildStartOfSendAck(uint8_t* buffer) const;
     void buildEndOfReceivedAck(uint8_t* buffer) const;
     void buildErrorMessageAck(uint8_t* buffer, uint8_t errorCode) const;
+    // The ack that answers a printer-initiated message; false for KODAK_EVENT_NONE
+    bool buildEventAck(uint8_t* buffer, KodakPrinterEvent event, uint8_t errorCode) const;
 
     // Response parsing methods (all const)
     bool parseResponse(const uint8_t* response, uint8_t* errorCode, uint8_t* dataOut = nullptr) const;
@@ -77,10 +172,111 @@ public:
 
     // Utility methods
     static const char* getErrorString(uint8_t errorCode);
-    static void printPacketHex(const uint8_t* packet, size_t length, bool enabled = true);
+    static KodakErrorClass classifyError(uint8_t errorCode);
+    // Tells a message the printer sent on its own from a reply to a command
+    static KodakPrinterEvent classifyMessage(const uint8_t* frame);
+    static const char* getEventName(KodakPrinterEvent event);
+    static bool isFresh(uint32_t updatedMs, uint32_t nowMs, uint32_t ttlMs);
+    // JPEG size to aim for: the model's target, lowered to half the largest
+    // free PSRAM block (0 = no PSRAM figure) but never below BTP_MIN_TARGET_IMAGE_SIZE
+    static size_t targetImageSize(bool isSlimDevice, size_t largestFreePsram);
+    // Standard CRC-32 (IEEE 802.3, as zlib); chain calls by passing the previous result, start at 0
+    static uint32_t crc32(uint32_t crc, const uint8_t* data, size_t length);
+    // SOI at the start and EOI within the last BTP_JPEG_EOI_WINDOW bytes
+    static bool hasJpegMarkers(const uint8_t* data, size_t length);
+    static bool hasJpegEnd(const uint8_t* tail, size_t length);
+    static void printPacketHex(const uint8_t* packet, size_t length, bool enabled = true);  // BTP_LOG_VERBOSE
+
+    // Precomputed packet in flash; fixed packets can be sent from here without a copy
+    static const uint8_t* packetTemplate(KodakPacketId id);
+};
+
+// =============================================================================
+// Response views
+// =============================================================================
+
+/**
+ * Read-only view over a received 34-byte frame
+ *
+ * Borrows the buffer (no copy) and checks the header once on construction;
+ * accessors read fields in place. The buffer must outlive the view. Check
+ * isValid() or ok() before trusting a field: only errorCode() and payload()
+ * account for a bad header (BTP_ERR_NOT_CONNECTED and nullptr).
+ */
+class KodakResponseView {
+public:
+    explicit KodakResponseView(const uint8_t* frame)
+        : frame(frame),
+          valid(frame != nullptr && frame[0] == BTP_START_1 && frame[1] == BTP_START_2 &&
+                frame[2] == BTP_IDENT_1 && frame[3] == BTP_IDENT_2) {}
+
+    bool isValid() const { return valid; }
+    bool ok() const { return valid && frame[8] == BTP_ERR_SUCCESS; }
+
+    uint8_t type() const { return frame[6]; }       // Response type
+    uint8_t subType() const { return frame[7]; }
+    uint8_t errorCode() const { return valid ? frame[8] : BTP_ERR_NOT_CONNECTED; }
+
+    // Bytes 9-33 (BTP_PAYLOAD_SIZE), or nullptr for an invalid frame
+    const uint8_t* payload() const { return valid ? frame + BTP_PAYLOAD_OFFSET : nullptr; }
+    const uint8_t* data() const { return frame; }
+
+protected:
+    const uint8_t* frame;
+    bool valid;
+};
+
+// Reply to GET_ACCESSORY_INFO
+class KodakAccessoryInfoView : public KodakResponseView {
+public:
+    explicit KodakAccessoryInfoView(const uint8_t* frame) : KodakResponseView(frame) {}
+    uint8_t batteryLevel() const { return frame[12]; }
+};
+
+// Reply to GET_BATTERY_LEVEL (type BTP_RESP_CHARGING_STATUS)
+class KodakChargingStatusView : public KodakResponseView {
+public:
+    explicit KodakChargingStatusView(const uint8_t* frame) : KodakResponseView(frame) {}
+    bool isCharging() const { return frame[8] == 1; }   // Status sits in the error code byte
+};
+
+// Reply to GET_PRINT_COUNT
+class KodakPrintCountView : public KodakResponseView {
+public:
+    explicit KodakPrintCountView(const uint8_t* frame) : KodakResponseView(frame) {}
+    uint16_t printCount() const { return (frame[8] << 8) | frame[9]; }  // Big-endian
+};
+
+// Reply to GET_AUTO_POWER_OFF
+class KodakAutoPowerOffView : public KodakResponseView {
+public:
+    explicit KodakAutoPowerOffView(const uint8_t* frame) : KodakResponseView(frame) {}
+    uint8_t minutes() const { return frame[8]; }
+};
+
+/**
+ * Reassembles 34-byte frames from an arbitrary byte stream
+ *
+ * Bytes are dropped until the 1B 2A 43 41 header has been seen, so a lost or
+ * stray byte costs one frame instead of desynchronising every later response.
+ * feed() stops right after a frame completes; call reset() before the next one.
+ */
+class KodakFrameAssembler {
+public:
+    KodakFrameAssembler();
+
+    void reset();
+    size_t feed(const uint8_t* data, size_t length);  // Returns bytes consumed
+
+    bool hasFrame() const;
+    const uint8_t* frame() const;
+    size_t bytesNeeded() const;         // Bytes still missing from the current frame
+    uint32_t getDiscardedBytes() const; // Bytes dropped while resynchronising
 
 private:
-    void initPacketHeader(uint8_t* buffer, uint8_t flags1 = 0x00, uint8_t flags2 = 0x00) const;
+    uint8_t buffer[BTP_PACKET_SIZE];
+    size_t length;
+    uint32_t discarded;
 };
 
 #endif // KODAK_STEP_PROTOCOL_H
@@ -0,0 +1,68 @@
+#include "KodakStepTasks.h"
+
+KodakTaskMeter::KodakTaskMeter() {
+    name = "";
+    core = -1;
+    task = nullptr;
+    busyUs = 0;
+    workStartedUs = 0;
+    lastBusyUs = 0;
+    lastSampleUs = 0;
+}
+
+void KodakTaskMeter::attach(const char* taskName, int8_t taskCore) {
+    name = taskName;
+    core = taskCore;
+    busyUs = 0;
+    lastSampleUs = micros();
+    task = xTaskGetCurrentTaskHandle();
+    lastBusyUs = readBusyUs();
+}
+
+void KodakTaskMeter::detach() {
+    task = nullptr;
+}
+
+bool KodakTaskMeter::isAttached() const {
+    return task != nullptr;
+}
+
+void KodakTaskMeter::beginWork() {
+    workStartedUs = micros();
+}
+
+void KodakTaskMeter::endWork() {
+    // Only the measured task writes busyUs, so no read-modify-write race
+    busyUs = busyUs + (uint32_t)(micros() - workStartedUs);
+}
+
+uint32_t KodakTaskMeter::readBusyUs() const {
+#if configGENERATE_RUN_TIME_STATS && configUSE_TRACE_FACILITY
+    if (task != nullptr) {
+        TaskStatus_t info;
+        vTaskGetInfo(task, &info, pdFALSE, eRunning);
+        return info.ulRunTimeCounter;   // esp_timer microseconds on ESP-IDF
+    }
+#endif
+    return busyUs;
+}
+
+KodakTaskLoad KodakTaskMeter::sample() {
+    KodakTaskLoad load;
+    load.name = name;
+    load.core = core;
+
+    uint32_t now = micros();
+    uint32_t busy = readBusyUs();
+    load.window_us = now - lastSampleUs;
+    load.busy_us = busy - lastBusyUs;
+    if (load.busy_us > load.window_us) {
+        load.busy_us = load.window_us;  // Work that began in the previous window
+    }
+    load.load_percent = (load.window_us > 0)
+        ? (uint8_t)((uint64_t)load.busy_us * 100 / load.window_us) : 0;
+
+    lastSampleUs = now;
+    lastBusyUs = busy;
+    return load;
+}
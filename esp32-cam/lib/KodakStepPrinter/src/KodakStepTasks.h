@@ -0,0 +1,126 @@
+#ifndef KODAK_STEP_TASKS_H
+#define KODAK_STEP_TASKS_H
+
+#include <Arduino.h>
+#include <atomic>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+// Bluetooth writer task: same core as the Bluedroid stack, above the app tasks
+#define BTP_WRITER_CORE 0
+#define BTP_WRITER_PRIORITY 5
+#define BTP_WRITER_STACK_SIZE 4096
+
+/**
+ * Lock-free single-producer/single-consumer ring
+ *
+ * One task calls push(), one other task calls pop(); neither ever blocks or
+ * takes a lock, so the queue can sit between tasks on different cores
+ * without either one waiting on the other's scheduler. Pair it with a task
+ * notification when the consumer should sleep until something arrives.
+ *
+ * Capacity is fixed at compile time and must be a power of two, so the
+ * free-running indexes stay valid across their wrap. reset() can lower the
+ * usable depth, but only while neither task is using the queue.
+ */
+template <typename T, size_t N>
+class KodakSpscQueue {
+    static_assert(N > 0 && (N & (N - 1)) == 0, "KodakSpscQueue capacity must be a power of two");
+
+public:
+    KodakSpscQueue() : head(0), tail(0), limit(N) {}
+
+    KodakSpscQueue(const KodakSpscQueue&) = delete;
+    KodakSpscQueue& operator=(const KodakSpscQueue&) = delete;
+
+    void reset(size_t depth = N) {
+        head.store(0, std::memory_order_relaxed);
+        tail.store(0, std::memory_order_relaxed);
+        limit = (depth == 0 || depth > N) ? N : depth;
+    }
+
+    // Producer side
+    bool push(const T& item) {
+        size_t t = tail.load(std::memory_order_relaxed);
+        if (t - head.load(std::memory_order_acquire) >= limit) {
+            return false;
+        }
+        slots[t % N] = item;
+        tail.store(t + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer side
+    bool pop(T* item) {
+        size_t h = head.load(std::memory_order_relaxed);
+        if (h == tail.load(std::memory_order_acquire)) {
+            return false;
+        }
+        *item = slots[h % N];
+        head.store(h + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Either side; a snapshot that may already be stale
+    size_t size() const {
+        return tail.load(std::memory_order_acquire) - head.load(std::memory_order_acquire);
+    }
+    bool isEmpty() const { return size() == 0; }
+    size_t capacity() const { return limit; }
+
+private:
+    // Free-running counters; the slot is counter % N
+    std::atomic<size_t> head;
+    std::atomic<size_t> tail;
+    size_t limit;
+    T slots[N];
+};
+
+// One task's share of its core, for a status page
+struct KodakTaskLoad {
+    const char* name;
+    int8_t core;                // -1 if not pinned
+    uint8_t load_percent;       // Busy time over the window since the previous sample
+    uint32_t busy_us;           // ...of window_us
+    uint32_t window_us;
+};
+
+/**
+ * Per-task CPU accounting
+ *
+ * With FreeRTOS run-time stats compiled in (configGENERATE_RUN_TIME_STATS)
+ * the load comes from the scheduler's own run-time counter for the task.
+ * The stock Arduino-ESP32 build leaves that off, so otherwise the task
+ * brackets each unit of work with beginWork()/endWork() and the load is
+ * the time spent inside them: an upper bound that also counts waits inside
+ * the work, such as a write() blocked on a full SPP queue.
+ *
+ * The task calls attach() and the work brackets; one other task calls
+ * sample() to read the load and start the next window.
+ */
+class KodakTaskMeter {
+public:
+    KodakTaskMeter();
+
+    void attach(const char* name, int8_t core);     // From the task being measured
+    void detach();
+    bool isAttached() const;
+
+    void beginWork();
+    void endWork();
+
+    KodakTaskLoad sample();
+
+private:
+    const char* name;
+    int8_t core;
+    TaskHandle_t task;
+    volatile uint32_t busyUs;       // Accumulated; differences survive the wrap
+    uint32_t workStartedUs;
+    uint32_t lastBusyUs;
+    uint32_t lastSampleUs;
+
+    uint32_t readBusyUs() const;
+};
+
+#endif // KODAK_STEP_TASKS_H
@@ -2,6 +2,7 @@
 
 ESP32CameraHelper::ESP32CameraHelper() {
     initialized = false;
+    sleeping = false;
 }
 
 void ESP32CameraHelper::initConfig() {
@@ -33,7 +34,7 @@ void ESP32CameraHelper::initConfig() {
     config.grab_mode = CAMERA_GRAB_LATEST;
 }
 
-bool ESP32CameraHelper::begin(framesize_t frameSize, int jpegQuality) {
+bool ESP32CameraHelper::begin(framesize_t frameSize, int jpegQuality, size_t fbCount) {
     if (initialized) {
         Serial.println("Camera already initialized");
         return true;
@@ -47,6 +48,9 @@ bool ESP32CameraHelper::begin(framesize_t frameSize, int jpegQuality) {
     initConfig();
     config.frame_size = frameSize;
     config.jpeg_quality = jpegQuality;
+    // More than one buffer lets a new frame be captured while an earlier one
+    // is still being sent to the printer
+    config.fb_count = (fbCount > 0) ? fbCount : 1;
 
     // Initialize camera
     esp_err_t err = esp_camera_init(&config);
@@ -85,6 +89,47 @@ void ESP32CameraHelper::end() {
     }
 }
 
+bool ESP32CameraHelper::sleep() {
+    if (sleeping) {
+        return true;
+    }
+    if (!initialized) {
+        return false;
+    }
+
+    // Also stops XCLK, so GPIO0 is a plain input again
+    esp_camera_deinit();
+    initialized = false;
+
+    pinMode(PWDN_GPIO_NUM, OUTPUT);
+    digitalWrite(PWDN_GPIO_NUM, HIGH);     // OV2640 power-down
+    digitalWrite(FLASH_GPIO_NUM, LOW);
+    sleeping = true;
+    return true;
+}
+
+bool ESP32CameraHelper::wake() {
+    if (!sleeping) {
+        return initialized;
+    }
+
+    // esp_camera_init() takes PWDN low again before probing the sensor
+    esp_err_t err = esp_camera_init(&config);
+    if (err != ESP_OK) {
+        Serial.print("Camera wake failed with error 0x");
+        Serial.println(err, HEX);
+        return false;
+    }
+
+    initialized = true;
+    sleeping = false;
+    return true;
+}
+
+bool ESP32CameraHelper::isSleeping() const {
+    return sleeping;
+}
+
 camera_fb_t* ESP32CameraHelper::captureImage() {
     if (!initialized) {
         Serial.println("Camera not initialized");
@@ -190,6 +235,10 @@ bool ESP32CameraHelper::isInitialized() {
     return initialized;
 }
 
+size_t ESP32CameraHelper::getFrameBufferCount() const {
+    return config.fb_count;
+}
+
 void ESP32CameraHelper::printCameraInfo() {
     if (!initialized) {
         Serial.println("Camera not initialized");
@@ -237,3 +286,23 @@ void ESP32CameraHelper::printCameraInfo() {
 
     Serial.println("===================\n");
 }
+
+ESP32CameraFrameSource::ESP32CameraFrameSource(camera_fb_t* fb)
+    : KodakMemorySource(fb ? fb->buf : nullptr, fb ? fb->len : 0), fb(fb) {
+}
+
+ESP32CameraFrameSource::~ESP32CameraFrameSource() {
+    release();
+}
+
+bool ESP32CameraFrameSource::rewind() {
+    return fb != nullptr && KodakMemorySource::rewind();
+}
+
+void ESP32CameraFrameSource::release() {
+    if (fb != nullptr) {
+        esp_camera_fb_return(fb);
+        fb = nullptr;
+        forget();   // fb->buf belongs to the driver again
+    }
+}
@@ -0,0 +1,328 @@
+#include "ImagePrep.h"
+#include "esp_heap_caps.h"
+#include "esp_jpg_decode.h"
+
+// Encoder qualities tried in order until the output fits the byte budget
+static const uint8_t PREP_QUALITIES[] = {JPEGE_Q_HIGH, JPEGE_Q_MED, JPEGE_Q_LOW};
+
+ImagePrep::ImagePrep() {
+    initialized = false;
+    arena = nullptr;
+    outWidth = 0;
+    outHeight = 0;
+    budget = 0;
+    sizeLimit = 0;
+    passBudget = 0;
+    memset(&encodeState, 0, sizeof(encodeState));
+    srcStrip = nullptr;
+    srcStripWidth = 0;
+    outStrip = nullptr;
+    columnMap = nullptr;
+    input = nullptr;
+    inputLen = 0;
+    srcWidth = 0;
+    srcHeight = 0;
+    cropX = 0;
+    cropY = 0;
+    cropWidth = 0;
+    cropHeight = 0;
+    nextOutRow = 0;
+    passFailed = false;
+    overBudget = false;
+    lastDurationMs = 0;
+    lastPasses = 0;
+    lastError = nullptr;
+}
+
+ImagePrep::~ImagePrep() {
+    end();
+}
+
+bool ImagePrep::begin(uint16_t outputWidth, uint16_t outputHeight, size_t byteBudget) {
+    end();
+
+    // The encoder works in whole 16x16 MCUs
+    outWidth = outputWidth - (outputWidth % PREP_MCU_SIZE);
+    outHeight = outputHeight - (outputHeight % PREP_MCU_SIZE);
+    budget = byteBudget;
+    if (outWidth == 0 || outHeight == 0 || budget == 0) {
+        lastError = "Invalid output size";
+        return false;
+    }
+
+    outStrip = (uint16_t*)allocate(outWidth * PREP_MCU_SIZE * sizeof(uint16_t));
+    columnMap = (uint16_t*)allocate(outWidth * sizeof(uint16_t));
+    if (outStrip == nullptr || columnMap == nullptr) {
+        lastError = "Out of PSRAM for strip buffers";
+        end();
+        return false;
+    }
+
+    initialized = true;
+    return true;
+}
+
+void ImagePrep::end() {
+    KodakJobArena::releaseAny(srcStrip);
+    KodakJobArena::releaseAny(outStrip);
+    KodakJobArena::releaseAny(columnMap);
+    srcStrip = nullptr;
+    srcStripWidth = 0;
+    outStrip = nullptr;
+    columnMap = nullptr;
+    initialized = false;
+}
+
+uint8_t* ImagePrep::prepare(const uint8_t* jpeg, size_t len, size_t* outLen) {
+    lastError = nullptr;
+    lastPasses = 0;
+
+    if (!initialized) {
+        lastError = "Image prep not initialized";
+        return nullptr;
+    }
+    if (jpeg == nullptr || len == 0 || outLen == nullptr) {
+        lastError = "No input image";
+        return nullptr;
+    }
+
+    uint32_t start = millis();
+    passBudget = getByteBudget();
+    if (arena != nullptr) {
+        size_t room = arena->getStats(KODAK_ARENA_PSRAM).largest_free;
+        if (room < passBudget) {
+            passBudget = room;
+        }
+    }
+    uint8_t* output = (passBudget > 0) ? (uint8_t*)allocate(passBudget) : nullptr;
+    if (output == nullptr) {
+        lastError = "Out of PSRAM for output image";
+        return nullptr;
+    }
+
+    input = jpeg;
+    inputLen = len;
+
+    size_t size = 0;
+    for (size_t i = 0; i < sizeof(PREP_QUALITIES) && size == 0; i++) {
+        lastPasses++;
+        size = encodePass(output, PREP_QUALITIES[i]);
+        if (size == 0 && !overBudget) {
+            break;  // Decode or encoder error; a lower quality will not help
+        }
+    }
+
+    lastDurationMs = millis() - start;
+
+    if (size == 0) {
+        if (lastError == nullptr) {
+            lastError = "Image does not fit byte budget";
+        }
+        freeImage(output);
+        return nullptr;
+    }
+
+    if (arena != nullptr) {
+        arena->shrink(output, size);    // The rest of the budget goes back for the next job
+    }
+    *outLen = size;
+    return output;
+}
+
+void ImagePrep::setArena(KodakJobArena* jobArena) {
+    arena = jobArena;
+}
+
+void ImagePrep::setSizeLimit(size_t limit) {
+    sizeLimit = limit;
+}
+
+size_t ImagePrep::getByteBudget() const {
+    size_t limit = sizeLimit;
+    return (limit != 0 && limit < budget) ? limit : budget;
+}
+
+void ImagePrep::freeImage(uint8_t* image) {
+    // Arena or heap, whichever it came from
+    KodakJobArena::releaseAny(image);
+}
+
+void* ImagePrep::allocate(size_t bytes) {
+    if (arena != nullptr) {
+        return arena->allocate(bytes, KODAK_ARENA_PSRAM);
+    }
+    return heap_caps_malloc(bytes, MALLOC_CAP_SPIRAM);
+}
+
+uint32_t ImagePrep::getLastDurationMs() const {
+    return lastDurationMs;
+}
+
+uint8_t ImagePrep::getLastPasses() const {
+    return lastPasses;
+}
+
+const char* ImagePrep::getLastError() const {
+    return lastError;
+}
+
+// =============================================================================
+// Strip pipeline
+// =============================================================================
+
+size_t ImagePrep::encodePass(uint8_t* output, uint8_t quality) {
+    srcWidth = 0;
+    srcHeight = 0;
+    nextOutRow = 0;
+    passFailed = false;
+    overBudget = false;
+
+    if (encoder.open(output, (int)passBudget) != JPEGE_SUCCESS ||
+        encoder.encodeBegin(&encodeState, outWidth, outHeight, JPEGE_PIXEL_RGB565,
+                            JPEGE_SUBSAMPLE_420, quality) != JPEGE_SUCCESS) {
+        lastError = "JPEG encoder setup failed";
+        return 0;
+    }
+
+    // Decoder hands over one MCU block at a time, a full MCU row before the next
+    esp_err_t err = esp_jpg_decode(inputLen, JPG_SCALE_NONE, readInput, writeBlock, this);
+    if (err != ESP_OK || passFailed || srcWidth == 0) {
+        encoder.close();
+        if (lastError == nullptr && !overBudget) {
+            lastError = "JPEG decode failed";
+        }
+        return 0;
+    }
+
+    // Rounding can leave the last output rows unfilled; repeat the final one
+    while (nextOutRow < outHeight && !passFailed) {
+        uint16_t* prev = outStrip + ((nextOutRow + PREP_MCU_SIZE - 1) % PREP_MCU_SIZE) * outWidth;
+        memcpy(outStrip + (nextOutRow % PREP_MCU_SIZE) * outWidth, prev, outWidth * sizeof(uint16_t));
+        if (++nextOutRow % PREP_MCU_SIZE == 0) {
+            flushBand();
+        }
+    }
+
+    int size = encoder.close();
+    if (passFailed || size <= 0) {
+        return 0;
+    }
+    return (size_t)size;
+}
+
+bool ImagePrep::beginSource(uint16_t width, uint16_t height) {
+    if (width == 0 || height == 0) {
+        return false;
+    }
+
+    if (width > srcStripWidth) {
+        KodakJobArena::releaseAny(srcStrip);
+        srcStrip = (uint8_t*)allocate((size_t)width * PREP_MAX_STRIP_ROWS * 3);
+        srcStripWidth = (srcStrip != nullptr) ? width : 0;
+        if (srcStrip == nullptr) {
+            lastError = "Out of PSRAM for decode strip";
+            passFailed = true;
+            return false;
+        }
+    }
+
+    srcWidth = width;
+    srcHeight = height;
+
+    // Center crop to 2:3 portrait, as the host-side prep does with auto_crop
+    if ((uint32_t)width * PREP_ASPECT_HEIGHT > (uint32_t)height * PREP_ASPECT_WIDTH) {
+        cropHeight = height;
+        cropWidth = (uint32_t)height * PREP_ASPECT_WIDTH / PREP_ASPECT_HEIGHT;
+    } else {
+        cropWidth = width;
+        cropHeight = (uint32_t)width * PREP_ASPECT_HEIGHT / PREP_ASPECT_WIDTH;
+    }
+    cropX = (width - cropWidth) / 2;
+    cropY = (height - cropHeight) / 2;
+
+    for (uint16_t ox = 0; ox < outWidth; ox++) {
+        columnMap[ox] = cropX + (uint32_t)ox * cropWidth / outWidth;
+    }
+    return true;
+}
+
+bool ImagePrep::consumeBlock(uint16_t x, uint16_t y, uint16_t w, uint16_t h, const uint8_t* data) {
+    if (h > PREP_MAX_STRIP_ROWS || x + w > srcWidth) {
+        lastError = "Unexpected decoder block size";
+        passFailed = true;
+        return false;
+    }
+
+    for (uint16_t row = 0; row < h; row++) {
+        memcpy(srcStrip + ((size_t)row * srcWidth + x) * 3, data + (size_t)row * w * 3, (size_t)w * 3);
+    }
+
+    if (x + w < srcWidth) {
+        return true;  // Rest of this MCU row still to come
+    }
+
+    // Strip complete: emit every output row that samples from it
+    while (nextOutRow < outHeight) {
+        uint32_t sy = cropY + (uint32_t)nextOutRow * cropHeight / outHeight;
+        if (sy >= (uint32_t)y + h) {
+            break;
+        }
+        emitRow(srcStrip + (size_t)(sy - y) * srcWidth * 3);
+        if (passFailed) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void ImagePrep::emitRow(const uint8_t* srcRow) {
+    uint16_t* dst = outStrip + (nextOutRow % PREP_MCU_SIZE) * outWidth;
+    for (uint16_t ox = 0; ox < outWidth; ox++) {
+        const uint8_t* p = srcRow + columnMap[ox] * 3;
+        dst[ox] = ((p[0] & 0xF8) << 8) | ((p[1] & 0xFC) << 3) | (p[2] >> 3);
+    }
+
+    if (++nextOutRow % PREP_MCU_SIZE == 0) {
+        flushBand();
+    }
+}
+
+bool ImagePrep::flushBand() {
+    for (uint16_t x = 0; x < outWidth; x += PREP_MCU_SIZE) {
+        int rc = encoder.addMCU(&encodeState, (uint8_t*)(outStrip + x), outWidth * sizeof(uint16_t));
+        if (rc != JPEGE_SUCCESS) {
+            // The encoder writes straight into the budget-sized buffer
+            overBudget = (rc == JPEGE_NO_BUFFER || rc == JPEGE_MEM_ERROR);
+            if (!overBudget) {
+                lastError = "JPEG encode failed";
+            }
+            passFailed = true;
+            return false;
+        }
+    }
+    return true;
+}
+
+size_t ImagePrep::readInput(void* arg, size_t index, uint8_t* buf, size_t len) {
+    ImagePrep* prep = static_cast<ImagePrep*>(arg);
+    if (index >= prep->inputLen) {
+        return 0;
+    }
+    size_t remaining = prep->inputLen - index;
+    if (len > remaining) {
+        len = remaining;
+    }
+    if (buf != nullptr) {
+        memcpy(buf, prep->input + index, len);
+    }
+    return len;
+}
+
+bool ImagePrep::writeBlock(void* arg, uint16_t x, uint16_t y, uint16_t w, uint16_t h, uint8_t* data) {
+    ImagePrep* prep = static_cast<ImagePrep*>(arg);
+    if (data == nullptr) {
+        // Start (x = y = 0, w x h = image size) and end markers
+        return (x == 0 && y == 0) ? prep->beginSource(w, h) : true;
+    }
+    return prep->consumeBlock(x, y, w, h, data);
+}
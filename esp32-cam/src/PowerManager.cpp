@@ -0,0 +1,196 @@
+#include "PowerManager.h"
+#include "esp_sleep.h"
+
+PowerManager::PowerManager(KodakStepPrinter& printer, ESP32CameraHelper& camera)
+    : printer(printer), camera(camera) {
+    pipeline = nullptr;
+    spooler = nullptr;
+    server = nullptr;
+    printerName = nullptr;
+    wakePin = POWER_WAKE_GPIO;
+    idleMs = POWER_IDLE_MS;
+    sleepMs = POWER_SLEEP_MS;
+    lastActivity = 0;
+    state = POWER_ACTIVE;
+    running = false;
+    memset(&stats, 0, sizeof(stats));
+}
+
+bool PowerManager::begin(gpio_num_t buttonPin) {
+    wakePin = buttonPin;
+    lastActivity = millis();
+    state = POWER_ACTIVE;
+    running = true;
+    return true;
+}
+
+void PowerManager::setPipeline(PrintPipeline* printPipeline) {
+    pipeline = printPipeline;
+}
+
+void PowerManager::setSpooler(PrintSpooler* jobSpooler) {
+    spooler = jobSpooler;
+}
+
+void PowerManager::setPrintServer(PrintServer* printServer) {
+    server = printServer;
+}
+
+void PowerManager::setPrinterName(const char* name) {
+    printerName = name;
+}
+
+void PowerManager::setTimeouts(uint32_t idleAfterMs, uint32_t sleepAfterMs) {
+    idleMs = idleAfterMs;
+    sleepMs = (sleepAfterMs > idleAfterMs) ? sleepAfterMs : idleAfterMs;
+}
+
+void PowerManager::noteActivity() {
+    lastActivity = millis();
+    if (state != POWER_ACTIVE) {
+        setClock(POWER_ACTIVE);
+    }
+}
+
+// =============================================================================
+// Idle tracking
+// =============================================================================
+
+bool PowerManager::poll() {
+    if (!running) {
+        return false;
+    }
+
+    if (isBusy()) {
+        noteActivity();
+        return false;
+    }
+
+    uint32_t idle = millis() - lastActivity;
+    if (idle >= sleepMs && canSleep()) {
+        lightSleep();
+        return true;
+    }
+    if (idle >= idleMs && state == POWER_ACTIVE) {
+        setClock(POWER_IDLE);
+    }
+    return false;
+}
+
+bool PowerManager::isBusy() const {
+    if (printer.isBusy()) {
+        return true;
+    }
+    if (pipeline != nullptr && pipeline->isBusy()) {
+        return true;
+    }
+    if (spooler != nullptr && spooler->getPendingJobs() > 0) {
+        return true;
+    }
+    return server != nullptr && server->isReceiving();
+}
+
+bool PowerManager::canSleep() const {
+    // Light sleep drops the Wi-Fi association along with Bluetooth
+    return server == nullptr || !server->isRunning();
+}
+
+void PowerManager::setClock(PowerState newState) {
+    setCpuFrequencyMhz(newState == POWER_IDLE ? POWER_IDLE_CPU_MHZ : POWER_ACTIVE_CPU_MHZ);
+    state = newState;
+}
+
+// =============================================================================
+// Light sleep
+// =============================================================================
+
+void PowerManager::lightSleep() {
+    // The transfer task owns the printer while the pipeline runs
+    bool restartPipeline = pipeline != nullptr && pipeline->isRunning();
+    size_t queueDepth = restartPipeline ? pipeline->getQueueDepth() : 0;
+    if (restartPipeline) {
+        pipeline->end();
+    }
+    camera.sleep();
+    printer.suspend();
+
+    Serial.println("Power: light sleep until the button is pressed");
+    Serial.flush();
+
+    // GPIO0 stops being XCLK once the camera is asleep
+    pinMode(wakePin, INPUT_PULLUP);
+    gpio_wakeup_enable(wakePin, GPIO_INTR_LOW_LEVEL);
+    esp_sleep_enable_gpio_wakeup();
+
+    state = POWER_SLEEPING;
+    uint32_t sleepStart = millis();
+    esp_light_sleep_start();
+    uint32_t wokeAt = millis();     // esp_timer keeps counting through light sleep
+
+    gpio_wakeup_disable(wakePin);
+    esp_sleep_disable_wakeup_source(ESP_SLEEP_WAKEUP_GPIO);
+    stats.sleeps++;
+    stats.last_sleep_ms = wokeAt - sleepStart;
+    stats.total_sleep_ms += stats.last_sleep_ms;
+
+    setClock(POWER_ACTIVE);
+    bool ready = wakeUp();
+    if (restartPipeline && camera.isInitialized()) {
+        pipeline->begin(queueDepth);
+    }
+
+    stats.last_wake_to_ready_ms = millis() - wokeAt;
+    if (stats.last_wake_to_ready_ms > stats.max_wake_to_ready_ms) {
+        stats.max_wake_to_ready_ms = stats.last_wake_to_ready_ms;
+    }
+    lastActivity = millis();
+
+    Serial.print("Power: awake after ");
+    Serial.print(stats.last_sleep_ms / 1000);
+    Serial.print(" s, ready in ");
+    Serial.print(stats.last_wake_to_ready_ms);
+    Serial.println(ready ? " ms" : " ms without the printer");
+}
+
+bool PowerManager::wakeUp() {
+    uint32_t start = millis();
+    if (!camera.wake()) {
+        Serial.println("Power: camera did not wake");
+    }
+    stats.last_camera_wake_ms = millis() - start;
+
+    start = millis();
+    bool linked = printer.resume();
+    if (!linked && printerName != nullptr) {
+        // Switched off or out of range meanwhile; a scan finds it if it moved
+        Serial.print("Power: resume failed (");
+        Serial.print(printer.getLastError());
+        Serial.println("), searching for the printer");
+        linked = printer.connectByName(printerName);
+        if (linked) {
+            printer.initialize(printer.getStatus().is_slim_device);
+        }
+    }
+    stats.last_printer_resume_ms = millis() - start;
+
+    if (!linked) {
+        stats.failed_resumes++;
+    }
+    return linked;
+}
+
+// =============================================================================
+// Status
+// =============================================================================
+
+PowerState PowerManager::getState() const {
+    return state;
+}
+
+uint32_t PowerManager::getIdleMs() const {
+    return millis() - lastActivity;
+}
+
+const PowerStats& PowerManager::getStats() const {
+    return stats;
+}
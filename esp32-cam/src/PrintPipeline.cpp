@@ -0,0 +1,499 @@
+#include "PrintPipeline.h"
+
+// How often idle tasks wake up to check for end()
+#define PIPELINE_POLL_TICKS pdMS_TO_TICKS(100)
+
+PrintPipeline::PrintPipeline(ESP32CameraHelper& camera, KodakStepPrinter& printer)
+    : camera(camera), printer(printer) {
+    topology = defaultTopology();
+    captureTask = nullptr;
+    processTask = nullptr;
+    transferTask = nullptr;
+    startedWriter = false;
+    sourceJobActive = false;
+    statusRequested = false;
+    jobCallback = nullptr;
+    imagePrep = nullptr;
+    spooler = nullptr;
+    running = false;
+    transferActive = false;
+    nextJobId = 1;
+    completedJobs = 0;
+    failedJobs = 0;
+}
+
+PrintPipeline::~PrintPipeline() {
+    end();
+}
+
+bool PrintPipeline::begin(size_t queueDepth) {
+    if (running) {
+        return true;
+    }
+
+    if (!camera.isInitialized()) {
+        Serial.println("Pipeline: camera not initialized");
+        return false;
+    }
+
+    if (camera.getFrameBufferCount() < 2) {
+        Serial.println("Pipeline: warning - single frame buffer, capture will wait for each transfer");
+    }
+
+    captureRequests.reset();
+    frameQueue.reset();
+    jobQueue.reset(queueDepth > 0 ? queueDepth : 1);
+    sourceJobs.reset();
+
+    if (topology.bt_writer && !printer.hasWriterTask()) {
+        startedWriter = printer.startWriterTask(topology.writer_core, topology.writer_priority);
+        if (!startedWriter) {
+            Serial.println("Pipeline: warning - no Bluetooth writer task, transfer task writes");
+        }
+    }
+
+    running = true;
+
+    // Consumers first, so every push has a task to notify
+    if (!startTask(transferTaskEntry, "kodak_tx", this, topology.transfer_priority,
+                   topology.transfer_core, &transferTask) ||
+        !startTask(processTaskEntry, "kodak_prep", this, topology.process_priority,
+                   topology.process_core, &processTask) ||
+        !startTask(captureTaskEntry, "kodak_cap", this, topology.capture_priority,
+                   topology.capture_core, &captureTask)) {
+        Serial.println("Pipeline: failed to create tasks");
+        end();
+        return false;
+    }
+
+    Serial.println("Pipeline started");
+    return true;
+}
+
+void PrintPipeline::end() {
+    running = false;
+
+    // Tasks notice running == false once woken, or within one poll interval
+    notify(captureTask);
+    notify(processTask);
+    notify(transferTask);
+    while (captureTask != nullptr || processTask != nullptr || transferTask != nullptr) {
+        delay(10);
+    }
+
+    // Every task is gone, so this side may drain the rings
+    Job job;
+    while (frameQueue.pop(&job) || jobQueue.pop(&job)) {
+        releaseJob(job);
+        failedJobs++;
+    }
+    uint8_t numCopies;
+    while (captureRequests.pop(&numCopies)) {
+    }
+    SourceJob sourceJob;
+    while (sourceJobs.pop(&sourceJob)) {
+        KodakRequestResult result = {KODAK_REQUEST_PRINT, false, BTP_ERR_NOT_CONNECTED, 0,
+                                     "Pipeline stopped"};
+        sourceJob.callback(result, sourceJob.context);
+    }
+    sourceJobActive = false;
+    statusRequested = false;
+
+    if (startedWriter) {
+        printer.stopWriterTask();
+        startedWriter = false;
+    }
+}
+
+bool PrintPipeline::requestCapture(uint8_t numCopies) {
+    if (!running) {
+        return false;
+    }
+    if (!captureRequests.push(numCopies)) {
+        return false;
+    }
+    notify(captureTask);
+    return true;
+}
+
+bool PrintPipeline::submitSource(KodakImageSource& source, uint8_t numCopies,
+                                 KodakCompletionCallback callback, void* context) {
+    if (!running || callback == nullptr || sourceJobActive) {
+        return false;
+    }
+
+    SourceJob job = {&source, numCopies, callback, context};
+    sourceJobActive = true;     // Cleared by the transfer task once the callback has run
+    if (!sourceJobs.push(job)) {
+        sourceJobActive = false;
+        return false;
+    }
+    notify(transferTask);
+    return true;
+}
+
+bool PrintPipeline::requestStatusRefresh() {
+    if (!running) {
+        return false;
+    }
+    statusRequested = true;
+    notify(transferTask);
+    return true;
+}
+
+bool PrintPipeline::isStatusRefreshPending() const {
+    return statusRequested;
+}
+
+void PrintPipeline::setJobCallback(PipelineJobCallback callback) {
+    jobCallback = callback;
+}
+
+void PrintPipeline::setTopology(const PipelineTopology& taskTopology) {
+    topology = taskTopology;
+}
+
+const PipelineTopology& PrintPipeline::getTopology() const {
+    return topology;
+}
+
+PipelineTopology PrintPipeline::defaultTopology() {
+    PipelineTopology defaults;
+    defaults.capture_core = PIPELINE_CAPTURE_CORE;
+    defaults.capture_priority = PIPELINE_CAPTURE_PRIORITY;
+    defaults.process_core = PIPELINE_PROCESS_CORE;
+    defaults.process_priority = PIPELINE_PROCESS_PRIORITY;
+    defaults.transfer_core = PIPELINE_TRANSFER_CORE;
+    defaults.transfer_priority = PIPELINE_TRANSFER_PRIORITY;
+    defaults.bt_writer = true;
+    defaults.writer_core = BTP_WRITER_CORE;
+    defaults.writer_priority = BTP_WRITER_PRIORITY;
+    return defaults;
+}
+
+void PrintPipeline::setImagePrep(ImagePrep* prep) {
+    imagePrep = prep;
+}
+
+void PrintPipeline::setSpooler(PrintSpooler* jobSpooler) {
+    spooler = jobSpooler;
+}
+
+bool PrintPipeline::isRunning() const {
+    return running;
+}
+
+bool PrintPipeline::isBusy() const {
+    return transferActive || sourceJobActive || getQueuedJobs() > 0;
+}
+
+size_t PrintPipeline::getQueuedJobs() const {
+    if (spooler != nullptr) {
+        return spooler->getPendingJobs();
+    }
+    return frameQueue.size() + jobQueue.size();
+}
+
+size_t PrintPipeline::getQueueDepth() const {
+    return jobQueue.capacity();
+}
+
+uint32_t PrintPipeline::getCompletedJobs() const {
+    return completedJobs + ((spooler != nullptr) ? spooler->getCompletedJobs() : 0);
+}
+
+uint32_t PrintPipeline::getFailedJobs() const {
+    return failedJobs + ((spooler != nullptr) ? spooler->getFailedJobs() : 0);
+}
+
+size_t PrintPipeline::getTaskLoads(KodakTaskLoad* loads, size_t maxLoads) {
+    KodakTaskMeter* meters[] = {&captureMeter, &processMeter, &transferMeter};
+    size_t count = 0;
+
+    for (size_t i = 0; i < sizeof(meters) / sizeof(meters[0]) && count < maxLoads; i++) {
+        if (meters[i]->isAttached()) {
+            loads[count++] = meters[i]->sample();
+        }
+    }
+    if (printer.hasWriterTask() && count < maxLoads) {
+        loads[count++] = printer.getWriterLoad();
+    }
+    return count;
+}
+
+bool PrintPipeline::startTask(TaskFunction_t entry, const char* name, PrintPipeline* pipeline,
+                              UBaseType_t priority, int8_t core, TaskHandle_t* handle) {
+    return xTaskCreatePinnedToCore(entry, name, PIPELINE_TASK_STACK_SIZE, pipeline, priority,
+                                   handle, (core < 0) ? tskNO_AFFINITY : core) == pdPASS;
+}
+
+void PrintPipeline::notify(TaskHandle_t task) {
+    // A wake-up that arrives too early only costs a poll interval
+    if (task != nullptr) {
+        xTaskNotifyGive(task);
+    }
+}
+
+void PrintPipeline::captureTaskEntry(void* arg) {
+    static_cast<PrintPipeline*>(arg)->captureLoop();
+}
+
+void PrintPipeline::processTaskEntry(void* arg) {
+    static_cast<PrintPipeline*>(arg)->processLoop();
+}
+
+void PrintPipeline::transferTaskEntry(void* arg) {
+    static_cast<PrintPipeline*>(arg)->transferLoop();
+}
+
+void PrintPipeline::captureLoop() {
+    captureMeter.attach("kodak_cap", topology.capture_core);
+    uint8_t numCopies;
+
+    while (running) {
+        if (!captureRequests.pop(&numCopies)) {
+            ulTaskNotifyTake(pdTRUE, PIPELINE_POLL_TICKS);
+            continue;
+        }
+
+        // Blocks only if every frame buffer is still queued or being sent
+        captureMeter.beginWork();
+        camera_fb_t* fb = camera.captureImage();
+        captureMeter.endWork();
+        if (fb == nullptr) {
+            failedJobs++;
+            if (jobCallback != nullptr) {
+                jobCallback(0, false, "Failed to capture image");
+            }
+            continue;
+        }
+
+        Job job;
+        job.id = nextJobId++;
+        job.fb = fb;
+        job.prepared = nullptr;
+        job.preparedLen = 0;
+        job.numCopies = numCopies;
+
+        // The ring holds one slot per frame buffer, so this rarely waits
+        bool queued = false;
+        while (running && !(queued = frameQueue.push(job))) {
+            ulTaskNotifyTake(pdTRUE, PIPELINE_POLL_TICKS);
+        }
+        if (queued) {
+            notify(processTask);
+        } else {
+            releaseJob(job);
+        }
+    }
+
+    captureMeter.detach();
+    captureTask = nullptr;
+    vTaskDelete(nullptr);
+}
+
+void PrintPipeline::processLoop() {
+    processMeter.attach("kodak_prep", topology.process_core);
+    Job job;
+
+    while (running) {
+        if (!frameQueue.pop(&job)) {
+            ulTaskNotifyTake(pdTRUE, PIPELINE_POLL_TICKS);
+            continue;
+        }
+        notify(captureTask);    // Room for the next frame
+
+        processMeter.beginWork();
+        if (imagePrep != nullptr) {
+            // Model and free PSRAM can both change between frames
+            imagePrep->setSizeLimit(printer.getTargetImageSize());
+            job.prepared = imagePrep->prepare(job.fb->buf, job.fb->len, &job.preparedLen);
+            if (job.prepared != nullptr) {
+                // The smaller copy is all the printer needs; free the frame buffer now
+                camera.releaseImage(job.fb);
+                job.fb = nullptr;
+            } else {
+                Serial.print("Pipeline: image prep failed, sending raw frame: ");
+                Serial.println(imagePrep->getLastError());
+            }
+        }
+        processMeter.endWork();
+
+        handOff(job);
+    }
+
+    processMeter.detach();
+    processTask = nullptr;
+    vTaskDelete(nullptr);
+}
+
+void PrintPipeline::handOff(Job& job) {
+    if (spooler != nullptr) {
+        processMeter.beginWork();
+        bool spooled = spoolJob(job);
+        processMeter.endWork();
+        if (!spooled) {
+            failedJobs++;
+            if (jobCallback != nullptr) {
+                jobCallback(0, false, spooler->getLastError());
+            }
+        }
+        return;
+    }
+
+    // Wait for room in the job queue rather than dropping the shot
+    bool queued = false;
+    while (running && !(queued = jobQueue.push(job))) {
+        ulTaskNotifyTake(pdTRUE, PIPELINE_POLL_TICKS);
+    }
+    if (queued) {
+        notify(transferTask);
+    } else {
+        releaseJob(job);
+    }
+}
+
+void PrintPipeline::transferLoop() {
+    transferMeter.attach("kodak_tx", topology.transfer_core);
+
+    if (spooler != nullptr) {
+        drainSpooler();
+        return;
+    }
+
+    Job job;
+
+    while (running) {
+        if (runSourceJob()) {
+            continue;
+        }
+        runStatusRefresh();
+        if (!jobQueue.pop(&job)) {
+            printer.poll();     // Reads and acks the printer's print-finished and error reports
+            ulTaskNotifyTake(pdTRUE, PIPELINE_POLL_TICKS);
+            continue;
+        }
+        notify(processTask);    // Room for the next job
+
+        transferActive = true;
+        transferMeter.beginWork();
+        waitForPrinter();
+
+        bool success = false;
+        if (printer.isConnected()) {
+            if (job.prepared != nullptr) {
+                KodakMemorySource source(job.prepared, job.preparedLen);
+                success = printer.printImage(source, job.numCopies);
+            } else {
+                // Frame buffer goes back to the camera as soon as the last chunk is queued
+                ESP32CameraFrameSource source(job.fb);
+                success = printer.printImage(source, job.numCopies);
+                job.fb = nullptr;
+            }
+        }
+        releaseJob(job);
+        transferMeter.endWork();
+
+        if (success) {
+            completedJobs++;
+        } else {
+            failedJobs++;
+        }
+
+        if (jobCallback != nullptr) {
+            jobCallback(job.id, success,
+                        success ? nullptr : (printer.isConnected() ? printer.getLastError()
+                                                                   : "Printer not connected"));
+        }
+
+        transferActive = false;
+    }
+
+    transferMeter.detach();
+    transferTask = nullptr;
+    vTaskDelete(nullptr);
+}
+
+bool PrintPipeline::spoolJob(Job& job) {
+    uint32_t spoolId;
+    if (job.prepared != nullptr) {
+        spoolId = spooler->enqueueOwned(job.prepared, job.preparedLen, job.numCopies);
+        job.prepared = nullptr;
+    } else {
+        // The spooler keeps its own copy, so the frame buffer goes straight back
+        spoolId = spooler->enqueue(job.fb->buf, job.fb->len, job.numCopies);
+    }
+    releaseJob(job);
+    return spoolId != 0;
+}
+
+void PrintPipeline::drainSpooler() {
+    while (running) {
+        if (runSourceJob()) {
+            continue;
+        }
+        runStatusRefresh();
+        // poll() returns as soon as the head job is waiting out a retry delay
+        transferMeter.beginWork();
+        bool pending = spooler->poll();
+        if (!pending) {
+            printer.poll();     // As above: the spooler only polls the printer for a due job
+        }
+        transferMeter.endWork();
+        vTaskDelay(pending ? pdMS_TO_TICKS(10) : PIPELINE_POLL_TICKS);
+    }
+
+    transferMeter.detach();
+    transferTask = nullptr;
+    vTaskDelete(nullptr);
+}
+
+bool PrintPipeline::runSourceJob() {
+    SourceJob job;
+    if (!sourceJobs.pop(&job)) {
+        return false;
+    }
+
+    transferActive = true;
+    transferMeter.beginWork();
+    waitForPrinter();
+
+    KodakRequestResult result;
+    if (printer.isConnected()) {
+        printer.printImage(*job.source, job.numCopies);
+        result = printer.getLastResult();
+    } else {
+        result = {KODAK_REQUEST_PRINT, false, BTP_ERR_NOT_CONNECTED, 0, "Printer not connected"};
+    }
+    transferMeter.endWork();
+
+    job.callback(result, job.context);
+    sourceJobActive = false;
+    transferActive = false;
+    return true;
+}
+
+void PrintPipeline::runStatusRefresh() {
+    // A spooled job's scheduler may hold an async request; leave it for the next pass
+    if (!statusRequested || printer.isBusy()) {
+        return;
+    }
+    if (printer.isConnected()) {
+        printer.refreshStatus();
+    }
+    statusRequested = false;
+}
+
+void PrintPipeline::waitForPrinter() {
+    // Give the printer's link supervisor a chance to bring a dropped link back
+    while (running && printer.poll()) {
+        delay(10);
+    }
+}
+
+void PrintPipeline::releaseJob(Job& job) {
+    camera.releaseImage(job.fb);
+    job.fb = nullptr;
+    ImagePrep::freeImage(job.prepared);
+    job.prepared = nullptr;
+}
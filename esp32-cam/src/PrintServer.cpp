@@ -0,0 +1,550 @@
+#include "PrintServer.h"
+
+// How often blocked waits wake up to check for end() or an aborted upload
+#define SERVER_POLL_TICKS pdMS_TO_TICKS(100)
+#define SERVER_PUMP_SIZE 1024       // Socket read size, on the server task's stack
+#define SERVER_JSON_SIZE 768
+
+PrintServer::PrintServer(PrintPipeline& pipeline, KodakStepPrinter& printer)
+    : pipeline(pipeline), printer(printer), server(SERVER_PORT) {
+    spooler = nullptr;
+    imagePrep = nullptr;
+    serverTask = nullptr;
+    running = false;
+    receiving = false;
+    streamStorage = nullptr;
+    memset(&streamState, 0, sizeof(streamState));
+    stream = nullptr;
+    scratch = nullptr;
+    uploadUnread = 0;
+    uploadAborted = false;
+    printDone = false;
+    memset(&printResult, 0, sizeof(printResult));
+    memset(&stats, 0, sizeof(stats));
+}
+
+PrintServer::~PrintServer() {
+    end();
+}
+
+bool PrintServer::begin(uint16_t port) {
+    if (running) {
+        return true;
+    }
+
+    // Allocated once; uploads of any size reuse the same two buffers
+    streamStorage = (uint8_t*)heap_caps_malloc(SERVER_STREAM_SIZE + 1, MALLOC_CAP_SPIRAM);
+    scratch = (uint8_t*)heap_caps_malloc(SERVER_SCRATCH_SIZE, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    if (streamStorage != nullptr) {
+        stream = xStreamBufferCreateStatic(SERVER_STREAM_SIZE, 1, streamStorage, &streamState);
+    }
+    if (stream == nullptr || scratch == nullptr) {
+        Serial.println("Print server: out of memory for upload buffers");
+        end();
+        return false;
+    }
+
+    server.begin(port);
+    server.setNoDelay(true);
+    running = true;
+
+    if (xTaskCreatePinnedToCore(taskEntry, "kodak_http", SERVER_TASK_STACK_SIZE, this,
+                                SERVER_TASK_PRIORITY, &serverTask, SERVER_TASK_CORE) != pdPASS) {
+        Serial.println("Print server: failed to create task");
+        end();
+        return false;
+    }
+
+    Serial.print("Print server listening on port ");
+    Serial.println(port);
+    return true;
+}
+
+void PrintServer::end() {
+    running = false;
+    uploadAborted = true;
+
+    // The task finishes the request in hand; an upload stops within one poll interval
+    while (serverTask != nullptr) {
+        delay(10);
+    }
+    server.end();
+
+    if (stream != nullptr) {
+        vStreamBufferDelete(stream);
+        stream = nullptr;
+    }
+    heap_caps_free(streamStorage);
+    streamStorage = nullptr;
+    heap_caps_free(scratch);
+    scratch = nullptr;
+}
+
+void PrintServer::setSpooler(PrintSpooler* jobSpooler) {
+    spooler = jobSpooler;
+}
+
+void PrintServer::setImagePrep(ImagePrep* prep) {
+    imagePrep = prep;
+}
+
+bool PrintServer::isRunning() const {
+    return running;
+}
+
+bool PrintServer::isReceiving() const {
+    return receiving;
+}
+
+const PrintServerStats& PrintServer::getStats() const {
+    return stats;
+}
+
+KodakTaskLoad PrintServer::getTaskLoad() {
+    return meter.sample();
+}
+
+// =============================================================================
+// Connections
+// =============================================================================
+
+void PrintServer::taskEntry(void* arg) {
+    static_cast<PrintServer*>(arg)->serverLoop();
+}
+
+void PrintServer::serverLoop() {
+    meter.attach("kodak_http", SERVER_TASK_CORE);
+
+    while (running) {
+        WiFiClient client = server.available();
+        if (!client) {
+            vTaskDelay(SERVER_POLL_TICKS);
+            continue;
+        }
+
+        meter.beginWork();
+        client.setTimeout(SERVER_IO_TIMEOUT_MS / 1000);
+        handleClient(client);
+        client.stop();
+        meter.endWork();
+    }
+
+    meter.detach();
+    serverTask = nullptr;
+    vTaskDelete(nullptr);
+}
+
+void PrintServer::handleClient(WiFiClient& client) {
+    Request request;
+    if (!readRequest(client, request)) {
+        stats.requests_rejected++;
+        sendError(client, 400, "Malformed request");
+        return;
+    }
+
+    if (strcmp(request.method, "OPTIONS") == 0) {
+        // CORS preflight from a browser app: image/jpeg bodies are not a "simple" request
+        client.print("HTTP/1.1 204 No Content\r\n"
+                     "Access-Control-Allow-Origin: *\r\n"
+                     "Access-Control-Allow-Methods: GET, POST, OPTIONS\r\n"
+                     "Access-Control-Allow-Headers: Content-Type\r\n"
+                     "Connection: close\r\n\r\n");
+    } else if (strcmp(request.path, "/print") == 0 && strcmp(request.method, "POST") == 0) {
+        handlePrint(client, request);
+    } else if (strcmp(request.path, "/status") == 0 && strcmp(request.method, "GET") == 0) {
+        sendStatus(client);
+    } else {
+        stats.requests_rejected++;
+        sendError(client, 404, "Not found");
+    }
+}
+
+bool PrintServer::readRequest(WiFiClient& client, Request& request) {
+    memset(&request, 0, sizeof(request));
+    request.copies = 1;
+
+    // Request line: METHOD /path?query HTTP/1.1
+    char line[SERVER_LINE_SIZE];
+    if (!readLine(client, line, sizeof(line))) {
+        return false;
+    }
+    char* target = strchr(line, ' ');
+    if (target == nullptr) {
+        return false;
+    }
+    *target++ = '\0';
+    char* version = strchr(target, ' ');
+    if (version != nullptr) {
+        *version = '\0';
+    }
+    char* query = strchr(target, '?');
+    if (query != nullptr) {
+        *query++ = '\0';
+        parseQuery(query, request);
+    }
+    strncpy(request.method, line, sizeof(request.method) - 1);
+    strncpy(request.path, target, sizeof(request.path) - 1);
+
+    // Headers, up to the blank line; only the framing ones matter here
+    while (readLine(client, line, sizeof(line))) {
+        if (line[0] == '\0') {
+            return true;
+        }
+        for (char* c = line; *c != '\0' && *c != ':'; c++) {
+            *c = tolower(*c);
+        }
+        if (strncmp(line, "content-length:", 15) == 0) {
+            request.contentLength = strtoul(line + 15, nullptr, 10);
+            request.haveLength = true;
+        } else if (strncmp(line, "transfer-encoding:", 18) == 0) {
+            request.chunked = strstr(line + 18, "chunked") != nullptr;
+        } else if (strncmp(line, "expect:", 7) == 0) {
+            request.expectContinue = strstr(line + 7, "100-continue") != nullptr;
+        }
+    }
+    return false;
+}
+
+bool PrintServer::readLine(WiFiClient& client, char* line, size_t size) {
+    size_t len = 0;
+    uint32_t lastByteAt = millis();
+
+    while (client.connected() || client.available() > 0) {
+        int c = client.read();
+        if (c < 0) {
+            if (millis() - lastByteAt >= SERVER_IO_TIMEOUT_MS) {
+                return false;
+            }
+            delay(1);
+            continue;
+        }
+        lastByteAt = millis();
+        if (c == '\n') {
+            line[len] = '\0';
+            return true;
+        }
+        if (c != '\r' && len < size - 1) {
+            line[len++] = (char)c;
+        }
+    }
+    return false;
+}
+
+void PrintServer::parseQuery(const char* query, Request& request) {
+    const char* copies = strstr(query, "copies=");
+    if (copies != nullptr && (copies == query || copies[-1] == '&')) {
+        long value = strtol(copies + 7, nullptr, 10);
+        request.copies = (value < 1) ? 1 : (value > SERVER_MAX_COPIES) ? SERVER_MAX_COPIES
+                                                                       : (uint8_t)value;
+    }
+}
+
+// =============================================================================
+// Uploads
+// =============================================================================
+
+void PrintServer::handlePrint(WiFiClient& client, const Request& request) {
+    if (request.chunked || !request.haveLength) {
+        stats.requests_rejected++;
+        sendError(client, 411, "Content-Length required: the printer needs the size up front");
+        return;
+    }
+    if (request.contentLength < 2) {
+        stats.requests_rejected++;
+        sendError(client, 400, "Empty upload");
+        return;
+    }
+    bool resize = imagePrep != nullptr && request.contentLength > printer.getTargetImageSize();
+    if (request.contentLength > (resize ? SERVER_MAX_RESIZE_SIZE : SERVER_MAX_UPLOAD_SIZE)) {
+        stats.requests_rejected++;
+        sendError(client, 413, resize ? "Image larger than SERVER_MAX_RESIZE_SIZE"
+                                      : "Image larger than BTP_MAX_IMAGE_SIZE");
+        return;
+    }
+    if (!pipeline.isRunning()) {
+        stats.requests_rejected++;
+        sendError(client, 503, "Print pipeline not running");
+        return;
+    }
+
+    if (request.expectContinue) {
+        client.print("HTTP/1.1 100 Continue\r\n\r\n");
+    }
+
+    // Check the JPEG SOI before anything reaches the printer
+    uint8_t soi[2];
+    if (client.readBytes(soi, sizeof(soi)) != sizeof(soi)) {
+        stats.requests_rejected++;
+        return;
+    }
+    if (soi[0] != 0xFF || soi[1] != 0xD8) {
+        stats.requests_rejected++;
+        sendError(client, 415, "Body is not a JPEG");
+        return;
+    }
+
+    uint32_t startedAt = millis();
+    stats.bytes_received += sizeof(soi);
+    if (resize) {
+        handleResize(client, request, startedAt);
+        return;
+    }
+
+    xStreamBufferReset(stream);
+    xStreamBufferSend(stream, soi, sizeof(soi), 0);
+    uploadUnread = request.contentLength;
+    uploadAborted = false;
+    printDone = false;
+
+    // Lives on this task's stack; the transfer task is done with it once printDone is set
+    KodakCallbackSource source(request.contentLength, readUpload, this, scratch,
+                               SERVER_SCRATCH_SIZE);
+    if (!pipeline.submitSource(source, request.copies, onPrinted, this)) {
+        stats.requests_rejected++;
+        sendError(client, 503, "Printer busy with another upload");
+        return;
+    }
+
+    receiving = true;
+    bool complete = pumpUpload(client, request.contentLength - sizeof(soi));
+    if (!complete) {
+        uploadAborted = true;   // The transfer task gives up on the missing bytes
+    }
+    while (!printDone) {
+        vTaskDelay(pdMS_TO_TICKS(10));
+    }
+    receiving = false;
+
+    sendPrintResult(client, request, request.contentLength, false, complete, startedAt);
+}
+
+void PrintServer::handleResize(WiFiClient& client, const Request& request, uint32_t startedAt) {
+    uint8_t* upload = (uint8_t*)heap_caps_malloc(request.contentLength, MALLOC_CAP_SPIRAM);
+    if (upload == nullptr) {
+        stats.requests_rejected++;
+        sendError(client, 413, "Not enough PSRAM to resize this image");
+        return;
+    }
+    upload[0] = 0xFF;   // SOI, already read and checked
+    upload[1] = 0xD8;
+
+    receiving = true;
+    bool complete = readBody(client, upload + 2, request.contentLength - 2);
+    receiving = false;
+    if (!complete) {
+        heap_caps_free(upload);
+        stats.uploads_failed++;
+        sendError(client, 408, "Upload stalled or disconnected");
+        return;
+    }
+
+    size_t preparedLen = 0;
+    imagePrep->setSizeLimit(printer.getTargetImageSize());
+    uint8_t* prepared = imagePrep->prepare(upload, request.contentLength, &preparedLen);
+    heap_caps_free(upload);
+    if (prepared == nullptr) {
+        stats.uploads_failed++;
+        sendError(client, 422, imagePrep->getLastError());
+        return;
+    }
+
+    printDone = false;
+    KodakMemorySource source(prepared, preparedLen);
+    if (!pipeline.submitSource(source, request.copies, onPrinted, this)) {
+        ImagePrep::freeImage(prepared);
+        stats.requests_rejected++;
+        sendError(client, 503, "Printer busy with another upload");
+        return;
+    }
+    while (!printDone) {
+        vTaskDelay(pdMS_TO_TICKS(10));
+    }
+    ImagePrep::freeImage(prepared);
+
+    stats.uploads_resized++;
+    sendPrintResult(client, request, preparedLen, true, true, startedAt);
+}
+
+void PrintServer::sendPrintResult(WiFiClient& client, const Request& request, size_t bytes,
+                                  bool resized, bool complete, uint32_t startedAt) {
+    stats.last_upload_ms = millis() - startedAt;
+    if (printResult.success) {
+        stats.uploads_printed++;
+        char body[128];
+        snprintf(body, sizeof(body),
+                 "{\"printed\":true,\"bytes\":%u,\"resized\":%s,\"copies\":%u,\"ms\":%lu}",
+                 (unsigned)bytes, resized ? "true" : "false",
+                 request.copies, (unsigned long)stats.last_upload_ms);
+        sendJson(client, 200, body);
+    } else {
+        stats.uploads_failed++;
+        sendError(client, complete ? 503 : 408,
+                  complete ? (printResult.error != nullptr ? printResult.error : "Print failed")
+                           : "Upload stalled or disconnected");
+    }
+}
+
+bool PrintServer::pumpUpload(WiFiClient& client, size_t length) {
+    uint8_t buffer[SERVER_PUMP_SIZE];
+    uint32_t lastDataAt = millis();
+
+    while (length > 0 && !printDone && running) {
+        int got = client.read(buffer, (length < sizeof(buffer)) ? length : sizeof(buffer));
+        if (got <= 0) {
+            if (!client.connected() || millis() - lastDataAt >= SERVER_IO_TIMEOUT_MS) {
+                return false;
+            }
+            vTaskDelay(1);
+            continue;
+        }
+        lastDataAt = millis();
+        length -= got;
+        stats.bytes_received += got;
+
+        // Blocks while the printer is slower than Wi-Fi, which is the normal case;
+        // TCP flow control then holds the sender back
+        size_t sent = 0;
+        while (sent < (size_t)got && !printDone) {
+            sent += xStreamBufferSend(stream, buffer + sent, got - sent, SERVER_POLL_TICKS);
+        }
+    }
+    return length == 0 || printDone;
+}
+
+bool PrintServer::readBody(WiFiClient& client, uint8_t* dest, size_t length) {
+    uint32_t lastDataAt = millis();
+
+    while (length > 0 && running) {
+        int got = client.read(dest, length);
+        if (got <= 0) {
+            if (!client.connected() || millis() - lastDataAt >= SERVER_IO_TIMEOUT_MS) {
+                return false;
+            }
+            vTaskDelay(1);
+            continue;
+        }
+        lastDataAt = millis();
+        dest += got;
+        length -= got;
+        stats.bytes_received += got;
+    }
+    return length == 0;
+}
+
+size_t PrintServer::readUpload(uint8_t* dest, size_t maxLen, void* context) {
+    // Runs on the pipeline's transfer task
+    PrintServer* server = static_cast<PrintServer*>(context);
+    size_t want = (maxLen < server->uploadUnread) ? maxLen : server->uploadUnread;
+    size_t got = 0;
+    uint32_t lastDataAt = millis();
+
+    // Fill the whole chunk so the printer does not get a write() per TCP segment
+    while (got < want) {
+        size_t n = xStreamBufferReceive(server->stream, dest + got, want - got, SERVER_POLL_TICKS);
+        if (n > 0) {
+            got += n;
+            lastDataAt = millis();
+        } else if (server->uploadAborted || millis() - lastDataAt >= SERVER_IO_TIMEOUT_MS) {
+            return 0;
+        }
+    }
+    server->uploadUnread -= got;
+    return got;
+}
+
+void PrintServer::onPrinted(const KodakRequestResult& result, void* context) {
+    PrintServer* server = static_cast<PrintServer*>(context);
+    server->printResult = result;
+    server->printDone = true;
+}
+
+// =============================================================================
+// Responses
+// =============================================================================
+
+void PrintServer::sendStatus(WiFiClient& client) {
+    KodakStepProtocol::PrinterStatus status = printer.getStatus();
+    char error[80];
+    jsonEscape(KodakStepProtocol::getErrorString(status.error_code), error, sizeof(error));
+
+    char body[SERVER_JSON_SIZE];
+    int len = snprintf(body, sizeof(body),
+        "{\"printer\":{\"connected\":%s,\"battery\":%u,\"charging\":%s,\"print_count\":%u,"
+        "\"error_code\":%u,\"error\":\"%s\"},"
+        "\"queue\":{\"busy\":%s,\"queued\":%u,\"completed\":%lu,\"failed\":%lu,\"receiving\":%s}",
+        status.is_connected ? "true" : "false", status.battery_level,
+        status.is_charging ? "true" : "false", status.print_count, status.error_code, error,
+        pipeline.isBusy() ? "true" : "false", (unsigned)pipeline.getQueuedJobs(),
+        (unsigned long)pipeline.getCompletedJobs(), (unsigned long)pipeline.getFailedJobs(),
+        receiving ? "true" : "false");
+
+    if (spooler != nullptr && spooler->isRunning() && len > 0 && (size_t)len < sizeof(body)) {
+        jsonEscape(spooler->getLastError() != nullptr ? spooler->getLastError() : "", error,
+                   sizeof(error));
+        len += snprintf(body + len, sizeof(body) - len,
+            ",\"spool\":{\"pending\":%u,\"retry_in_ms\":%lu,\"on_card\":%s,\"last_error\":\"%s\"}",
+            (unsigned)spooler->getPendingJobs(), (unsigned long)spooler->getNextAttemptInMs(),
+            spooler->isUsingSdCard() ? "true" : "false", error);
+    }
+
+    if (len > 0 && (size_t)len < sizeof(body)) {
+        snprintf(body + len, sizeof(body) - len,
+            ",\"server\":{\"printed\":%lu,\"failed\":%lu,\"rejected\":%lu,\"resized\":%lu,"
+            "\"bytes\":%lu,\"last_upload_ms\":%lu,\"target_size\":%u}}",
+            (unsigned long)stats.uploads_printed, (unsigned long)stats.uploads_failed,
+            (unsigned long)stats.requests_rejected, (unsigned long)stats.uploads_resized,
+            (unsigned long)stats.bytes_received, (unsigned long)stats.last_upload_ms,
+            (unsigned)printer.getTargetImageSize());
+    }
+    sendJson(client, 200, body);
+}
+
+void PrintServer::sendError(WiFiClient& client, int code, const char* error) {
+    char escaped[128];
+    jsonEscape(error, escaped, sizeof(escaped));
+    char body[160];
+    snprintf(body, sizeof(body), "{\"printed\":false,\"error\":\"%s\"}", escaped);
+    sendJson(client, code, body);
+}
+
+void PrintServer::sendJson(WiFiClient& client, int code, const char* body) {
+    char header[160];
+    snprintf(header, sizeof(header),
+             "HTTP/1.1 %d %s\r\n"
+             "Content-Type: application/json\r\n"
+             "Content-Length: %u\r\n"
+             "Access-Control-Allow-Origin: *\r\n"
+             "Connection: close\r\n\r\n",
+             code, reasonPhrase(code), (unsigned)strlen(body));
+    client.print(header);
+    client.print(body);
+}
+
+const char* PrintServer::reasonPhrase(int code) {
+    switch (code) {
+        case 200: return "OK";
+        case 400: return "Bad Request";
+        case 404: return "Not Found";
+        case 408: return "Request Timeout";
+        case 411: return "Length Required";
+        case 413: return "Payload Too Large";
+        case 415: return "Unsupported Media Type";
+        case 422: return "Unprocessable Entity";
+        case 503: return "Service Unavailable";
+        default: return "Error";
+    }
+}
+
+void PrintServer::jsonEscape(const char* text, char* out, size_t size) {
+    size_t len = 0;
+    for (; *text != '\0' && len < size - 2; text++) {
+        char c = *text;
+        if (c == '"' || c == '\\') {
+            out[len++] = '\\';
+            out[len++] = c;
+        } else if ((uint8_t)c >= 0x20) {
+            out[len++] = c;
+        }
+    }
+    out[len] = '\0';
+}
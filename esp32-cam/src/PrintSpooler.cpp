@@ -0,0 +1,472 @@
+#include "PrintSpooler.h"
+#include <SD_MMC.h>
+
+// Written here first and renamed into place, so a reset mid-write never
+// leaves a truncated job behind
+#define SPOOL_INCOMING_PATH SPOOL_DIR "/incoming.tmp"
+
+PrintSpooler::PrintSpooler(KodakStepPrinter& printer) : printer(printer), scheduler(printer) {
+    arena = nullptr;
+    jobQueue = nullptr;
+    memset(&jobQueueState, 0, sizeof(jobQueueState));
+    jobQueueStorage = nullptr;
+    jobCallback = nullptr;
+    scratch = nullptr;
+    running = false;
+    printing = false;
+    sdCard = false;
+    lastError = nullptr;
+    memset(&current, 0, sizeof(current));
+    hasCurrent = false;
+    retry = 0;
+    attempts = 0;
+    nextAttemptMs = 0;
+    nextJobId = 1;
+    completedJobs = 0;
+    failedJobs = 0;
+    retries = 0;
+}
+
+PrintSpooler::~PrintSpooler() {
+    end();
+}
+
+bool PrintSpooler::begin(bool useSdCard, size_t queueDepth) {
+    if (running) {
+        return true;
+    }
+
+    if (queueDepth == 0) {
+        queueDepth = 1;
+    }
+    if (arena != nullptr) {
+        jobQueueStorage = (uint8_t*)arena->allocate(queueDepth * sizeof(Job), KODAK_ARENA_INTERNAL);
+        if (jobQueueStorage != nullptr) {
+            jobQueue = xQueueCreateStatic(queueDepth, sizeof(Job), jobQueueStorage, &jobQueueState);
+        }
+    } else {
+        jobQueue = xQueueCreate(queueDepth, sizeof(Job));
+    }
+    if (jobQueue == nullptr) {
+        KodakJobArena::releaseAny(jobQueueStorage);
+        jobQueueStorage = nullptr;
+        Serial.println("Spooler: failed to create queue");
+        return false;
+    }
+
+    if (useSdCard) {
+        // 1-bit mode leaves GPIO4 (flash LED) and GPIO12/13 alone
+        scratch = (uint8_t*)allocate(BTP_CHUNK_SIZE, KODAK_ARENA_INTERNAL);
+        if (scratch != nullptr && SD_MMC.begin("/sdcard", true) && SD_MMC.cardType() != CARD_NONE) {
+            sdCard = true;
+            recoverFromCard();
+        } else {
+            Serial.println("Spooler: no SD card, spooling to PSRAM only");
+            KodakJobArena::releaseAny(scratch);
+            scratch = nullptr;
+        }
+    }
+
+    running = true;
+
+    Serial.print("Spooler started (");
+    Serial.print(sdCard ? "PSRAM + SD" : "PSRAM");
+    if (uxQueueMessagesWaiting(jobQueue) > 0) {
+        Serial.print(", ");
+        Serial.print((unsigned)uxQueueMessagesWaiting(jobQueue));
+        Serial.print(" jobs recovered");
+    }
+    Serial.println(")");
+    return true;
+}
+
+void PrintSpooler::end() {
+    running = false;
+
+    if (hasCurrent) {
+        releaseJob(current, false);
+        hasCurrent = false;
+    }
+
+    if (jobQueue != nullptr) {
+        Job job;
+        while (xQueueReceive(jobQueue, &job, 0) == pdTRUE) {
+            releaseJob(job, false);
+        }
+        vQueueDelete(jobQueue);
+        jobQueue = nullptr;
+    }
+    KodakJobArena::releaseAny(jobQueueStorage);
+    jobQueueStorage = nullptr;
+
+    KodakJobArena::releaseAny(scratch);
+    scratch = nullptr;
+
+    if (sdCard) {
+        SD_MMC.end();
+        sdCard = false;
+    }
+}
+
+void PrintSpooler::setArena(KodakJobArena* jobArena) {
+    arena = jobArena;
+}
+
+uint32_t PrintSpooler::enqueue(const uint8_t* jpeg, size_t len, uint8_t numCopies) {
+    return addJob(nullptr, len, numCopies, jpeg);
+}
+
+uint32_t PrintSpooler::enqueueOwned(uint8_t* jpeg, size_t len, uint8_t numCopies) {
+    return addJob(jpeg, len, numCopies, jpeg);
+}
+
+void PrintSpooler::setJobCallback(SpoolJobCallback callback) {
+    jobCallback = callback;
+}
+
+bool PrintSpooler::isRunning() const {
+    return running;
+}
+
+bool PrintSpooler::isPrinting() const {
+    return printing;
+}
+
+bool PrintSpooler::isUsingSdCard() const {
+    return sdCard;
+}
+
+size_t PrintSpooler::getPendingJobs() const {
+    size_t queued = (jobQueue != nullptr) ? uxQueueMessagesWaiting(jobQueue) : 0;
+    return queued + (hasCurrent ? 1 : 0);
+}
+
+uint32_t PrintSpooler::getCompletedJobs() const {
+    return completedJobs;
+}
+
+uint32_t PrintSpooler::getFailedJobs() const {
+    return failedJobs;
+}
+
+uint32_t PrintSpooler::getRetries() const {
+    return retries;
+}
+
+uint32_t PrintSpooler::getNextAttemptInMs() const {
+    if (!hasCurrent) {
+        return 0;
+    }
+    int32_t remaining = (int32_t)(nextAttemptMs - millis());
+    return (remaining > 0) ? (uint32_t)remaining : 0;
+}
+
+const KodakSchedulerStats& PrintSpooler::getSchedulerStats() const {
+    return scheduler.getStats();
+}
+
+const char* PrintSpooler::getLastError() const {
+    return lastError;
+}
+
+// =============================================================================
+// Retry policy
+// =============================================================================
+
+uint32_t PrintSpooler::retryDelayMs(uint8_t errorCode, uint8_t retry) {
+    uint32_t delayMs;
+
+    switch (KodakStepProtocol::classifyError(errorCode)) {
+        case KODAK_ERROR_TRANSIENT:
+            // The scheduler already waited BTP_SCHED_MAX_WAIT_MS (something is off),
+            // or could not rewind an SD stream the printer stopped mid-transfer
+            delayMs = (errorCode == BTP_ERR_BUSY)
+                ? (uint32_t)SPOOL_BUSY_BACKOFF_MS << ((retry < 6) ? retry : 6)
+                : (uint32_t)SPOOL_COOLING_BACKOFF_MS << ((retry < 3) ? retry : 3);
+            break;
+
+        case KODAK_ERROR_ATTENTION:
+            // Nothing changes until someone touches the printer; no point backing off further
+            delayMs = SPOOL_ATTENTION_RETRY_MS;
+            break;
+
+        case KODAK_ERROR_LINK:
+            delayMs = SPOOL_LINK_RETRY_MS;
+            break;
+
+        default:
+            delayMs = (uint32_t)SPOOL_BUSY_BACKOFF_MS << ((retry < 6) ? retry : 6);
+            break;
+    }
+
+    return (delayMs < SPOOL_MAX_BACKOFF_MS) ? delayMs : SPOOL_MAX_BACKOFF_MS;
+}
+
+bool PrintSpooler::countsAsAttempt(uint8_t errorCode) {
+    // Timeout or transfer error with no reason from the printer
+    KodakErrorClass errorClass = KodakStepProtocol::classifyError(errorCode);
+    return errorClass == KODAK_ERROR_NONE || errorClass == KODAK_ERROR_UNKNOWN;
+}
+
+// =============================================================================
+// Draining
+// =============================================================================
+
+bool PrintSpooler::poll() {
+    if (!running) {
+        return false;
+    }
+
+    if (!hasCurrent) {
+        if (xQueueReceive(jobQueue, &current, 0) != pdTRUE) {
+            return false;
+        }
+        retry = 0;
+        attempts = 0;
+        nextAttemptMs = millis();
+        hasCurrent = true;
+    }
+
+    if ((int32_t)(millis() - nextAttemptMs) < 0) {
+        return true;
+    }
+
+    // Let the link supervisor finish a reconnect before judging the printer
+    if (printer.poll()) {
+        return true;
+    }
+    if (!printer.isConnected()) {
+        lastError = "Printer not connected";
+        scheduleRetry(BTP_ERR_NOT_CONNECTED);
+        return true;
+    }
+
+    printing = true;
+    bool success = printJob(current);
+    printing = false;
+
+    if (success) {
+        finishJob(true, nullptr);
+    } else if (hasCurrent) {
+        const KodakRequestResult& result = scheduler.getLastResult();
+        uint8_t errorCode = printer.isConnected() ? result.errorCode : BTP_ERR_NOT_CONNECTED;
+        lastError = (result.error != nullptr) ? result.error : printer.getLastError();
+        if (KodakStepProtocol::classifyError(errorCode) == KODAK_ERROR_DATA) {
+            // Damaged or not a JPEG: the same bytes would fail the same way
+            finishJob(false, lastError);
+        } else if (countsAsAttempt(errorCode) && ++attempts >= SPOOL_MAX_ATTEMPTS) {
+            finishJob(false, lastError);
+        } else {
+            scheduleRetry(errorCode);
+        }
+    }
+
+    return getPendingJobs() > 0;
+}
+
+bool PrintSpooler::printJob(const Job& job) {
+    if (job.data != nullptr) {
+        KodakMemorySource source(job.data, job.len);
+        if (job.haveCrc) {
+            source.setExpectedCrc32(job.crc32);
+        }
+        return scheduler.printImage(source, job.numCopies);
+    }
+
+    char path[SPOOL_PATH_SIZE];
+    jobPath(job, path);
+    File file = SD_MMC.open(path, FILE_READ);
+    if (!file || file.size() != job.len) {
+        file.close();
+        finishJob(false, "Spooled image missing from SD card");
+        return false;
+    }
+
+    KodakStreamSource source(file, job.len, scratch, BTP_CHUNK_SIZE);
+    if (job.haveCrc) {
+        source.setExpectedCrc32(job.crc32);
+    }
+    bool success = scheduler.printImage(source, job.numCopies);
+    file.close();
+    return success;
+}
+
+void PrintSpooler::finishJob(bool success, const char* error) {
+    uint32_t id = current.id;
+    releaseJob(current, true);
+    hasCurrent = false;
+
+    if (success) {
+        completedJobs++;
+    } else {
+        failedJobs++;
+        lastError = error;
+    }
+
+    if (jobCallback != nullptr) {
+        jobCallback(id, success, error);
+    }
+}
+
+void PrintSpooler::scheduleRetry(uint8_t errorCode) {
+    uint32_t delayMs = retryDelayMs(errorCode, retry);
+    if (retry < 0xFF) {
+        retry++;
+    }
+    retries++;
+    nextAttemptMs = millis() + delayMs;
+
+    Serial.print("Spooler: job ");
+    Serial.print(current.id);
+    Serial.print(" waiting ");
+    Serial.print(delayMs / 1000);
+    Serial.print(" s (");
+    Serial.print(KodakStepProtocol::getErrorString(errorCode));
+    Serial.println(")");
+}
+
+// =============================================================================
+// Job storage
+// =============================================================================
+
+uint32_t PrintSpooler::addJob(uint8_t* data, size_t len, uint8_t numCopies, const uint8_t* source) {
+    Job job;
+    job.id = nextJobId;
+    job.data = data;
+    job.len = len;
+    job.numCopies = numCopies;
+    job.onCard = false;
+    job.haveCrc = false;
+    job.crc32 = 0;
+
+    if (!running || source == nullptr || len == 0 || len > BTP_MAX_IMAGE_SIZE) {
+        lastError = running ? "Invalid image" : "Spooler not running";
+        releaseJob(job, false);
+        return 0;
+    }
+    if (uxQueueSpacesAvailable(jobQueue) == 0) {
+        lastError = "Spool full";
+        releaseJob(job, false);
+        return 0;
+    }
+
+    job.crc32 = KodakStepProtocol::crc32(0, source, len);
+    job.haveCrc = true;
+
+    // With a card to fall back on, leave PSRAM for the camera and image prep.
+    // The arena is sized for jobs up front, so there it only runs low when full.
+    bool psramLow = (arena != nullptr)
+        ? arena->getStats(KODAK_ARENA_PSRAM).largest_free < len
+        : heap_caps_get_free_size(MALLOC_CAP_SPIRAM) < len + SPOOL_PSRAM_RESERVE;
+
+    if (job.data == nullptr && !(sdCard && psramLow)) {
+        job.data = (uint8_t*)allocate(len, KODAK_ARENA_PSRAM);
+        if (job.data != nullptr) {
+            memcpy(job.data, source, len);
+        }
+    }
+
+    if (sdCard) {
+        job.onCard = writeToCard(job, source);
+        if (job.onCard && psramLow) {
+            // Safe on the card; print from there and give the PSRAM back
+            KodakJobArena::releaseAny(job.data);
+            job.data = nullptr;
+        }
+    }
+
+    if (job.data == nullptr && !job.onCard) {
+        lastError = "No room to spool image";
+        return 0;
+    }
+
+    if (xQueueSend(jobQueue, &job, 0) != pdTRUE) {
+        lastError = "Spool full";
+        releaseJob(job, true);
+        return 0;
+    }
+
+    nextJobId++;
+    return job.id;
+}
+
+bool PrintSpooler::writeToCard(const Job& job, const uint8_t* data) {
+    File file = SD_MMC.open(SPOOL_INCOMING_PATH, FILE_WRITE);
+    if (!file) {
+        return false;
+    }
+    size_t written = file.write(data, job.len);
+    file.close();
+
+    char path[SPOOL_PATH_SIZE];
+    jobPath(job, path);
+    if (written != job.len || !SD_MMC.rename(SPOOL_INCOMING_PATH, path)) {
+        SD_MMC.remove(SPOOL_INCOMING_PATH);
+        return false;
+    }
+    return true;
+}
+
+void PrintSpooler::recoverFromCard() {
+    File dir = SD_MMC.open(SPOOL_DIR);
+    if (!dir || !dir.isDirectory()) {
+        SD_MMC.mkdir(SPOOL_DIR);
+        return;
+    }
+
+    // FAT returns entries in creation order, which is job order
+    File file = dir.openNextFile();
+    while (file) {
+        unsigned long id;
+        unsigned copies;
+        Job job;
+        bool queued = true;
+
+        if (sscanf(file.name(), "%lu-%u.jpg", &id, &copies) == 2 && id > 0 && copies > 0 &&
+            file.size() > 0) {
+            job.id = id;
+            job.data = nullptr;
+            job.len = file.size();
+            job.numCopies = copies;
+            job.onCard = true;
+            job.haveCrc = false;
+            job.crc32 = 0;
+            queued = (xQueueSend(jobQueue, &job, 0) == pdTRUE);
+            if (queued && id >= nextJobId) {
+                nextJobId = id + 1;
+            }
+        }
+
+        file.close();
+        if (!queued) {
+            break;  // The rest stay on the card for the next boot
+        }
+        file = dir.openNextFile();
+    }
+    dir.close();
+}
+
+void* PrintSpooler::allocate(size_t bytes, KodakArenaRegion region) {
+    if (arena != nullptr) {
+        return arena->allocate(bytes, region);
+    }
+    return heap_caps_malloc(bytes, (region == KODAK_ARENA_PSRAM) ? MALLOC_CAP_SPIRAM
+                                                                 : MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+}
+
+void PrintSpooler::releaseJob(Job& job, bool removeFromCard) {
+    KodakJobArena::releaseAny(job.data);
+    job.data = nullptr;
+
+    if (removeFromCard && job.onCard && sdCard) {
+        char path[SPOOL_PATH_SIZE];
+        jobPath(job, path);
+        SD_MMC.remove(path);
+    }
+    job.onCard = false;
+}
+
+void PrintSpooler::jobPath(const Job& job, char* path) {
+    snprintf(path, SPOOL_PATH_SIZE, SPOOL_DIR "/%08lu-%u.jpg", (unsigned long)job.id,
+             (unsigned)job.numCopies);
+}
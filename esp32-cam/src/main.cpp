@@ -6,13 +6,94 @@
 #include <Arduino.h>
 #include <KodakStep.h>
 #include "ESP32CameraHelper.h"
+#include "PrintPipeline.h"
+#include "ImagePrep.h"
+#include "PrintSpooler.h"
+#include "PrintServer.h"
+#include "PowerManager.h"
 
 // Configuration
 const char* PRINTER_SEARCH_NAME = "Step";  // Printer name to search for
 const uint8_t NUM_COPIES = 1;
+const bool PIPELINED_PRINTING = true;      // Capture the next shot while the last one transfers
+const bool PREPARE_IMAGES = true;          // Re-encode to the printer's 2:3 raster before sending
+const bool USE_SPOOLER = true;             // Keep jobs the printer turns away and retry them
+const bool SPOOL_TO_SD = false;            // Also persist spooled jobs to the SD card
+const bool USE_PRINT_SERVER = true;        // Accept JPEG uploads over HTTP (needs the pipeline)
+const bool USE_POWER_MANAGER = true;       // Clock down when idle; light sleep only without the server
+const bool RECORD_SESSION = false;         // Trace printer traffic for 'r'; 128 KB of PSRAM
+const char* WIFI_SSID = "";                // Network to join; empty starts an access point
+const char* WIFI_PASSWORD = "";
+const char* WIFI_AP_NAME = "ESP32-Printer";
+const char* WIFI_AP_PASSWORD = "kodakstep";    // At least 8 characters for WPA2
+const uint32_t WIFI_CONNECT_TIMEOUT_MS = 15000;
+const uint32_t STATUS_REFRESH_WAIT_MS = 2000;  // 's' mid-print shows the cached status after this
 
 KodakStepPrinter printer;
 ESP32CameraHelper camera;
+PrintPipeline pipeline(camera, printer);
+ImagePrep imagePrep;
+ImagePrep uploadPrep;       // Not reentrant; this one runs on the print server's task
+PrintSpooler spooler(printer);
+KodakJobArena jobArena;
+PrintServer printServer(pipeline, printer);
+PowerManager power(printer, camera);
+KodakSessionRecorder session;
+
+bool startWiFi() {
+    // Bluetooth stays up alongside; the coexistence scheduler needs Wi-Fi modem
+    // sleep, so leave WiFi.setSleep() at its default
+    if (WIFI_SSID[0] != '\0') {
+        Serial.print("Joining Wi-Fi ");
+        Serial.println(WIFI_SSID);
+        WiFi.mode(WIFI_STA);
+        WiFi.begin(WIFI_SSID, WIFI_PASSWORD);
+        uint32_t start = millis();
+        while (WiFi.status() != WL_CONNECTED && millis() - start < WIFI_CONNECT_TIMEOUT_MS) {
+            delay(250);
+        }
+        if (WiFi.status() == WL_CONNECTED) {
+            Serial.print("Upload to http://");
+            Serial.print(WiFi.localIP().toString());
+            Serial.println("/print");
+            return true;
+        }
+        Serial.println("Wi-Fi join timed out, starting access point");
+        WiFi.disconnect(true);
+    }
+
+    WiFi.mode(WIFI_AP);
+    if (!WiFi.softAP(WIFI_AP_NAME, WIFI_AP_PASSWORD)) {
+        return false;
+    }
+    Serial.print("Access point ");
+    Serial.print(WIFI_AP_NAME);
+    Serial.print(", upload to http://");
+    Serial.print(WiFi.softAPIP().toString());
+    Serial.println("/print");
+    return true;
+}
+
+void onPipelineJob(uint32_t jobId, bool success, const char* error) {
+    Serial.print("Job ");
+    Serial.print(jobId);
+    if (success) {
+        Serial.println(": print job sent successfully!");
+    } else {
+        Serial.print(": print failed - ");
+        Serial.println(error);
+    }
+}
+
+void onPrinterEvent(KodakPrinterEvent event, uint8_t errorCode, void* context) {
+    Serial.print("Printer: ");
+    Serial.print(KodakStepProtocol::getEventName(event));
+    if (event == KODAK_EVENT_ERROR) {
+        Serial.print(" - ");
+        Serial.print(KodakStepProtocol::getErrorString(errorCode));
+    }
+    Serial.println();
+}
 
 void printStatus() {
     KodakStepProtocol::PrinterStatus status = printer.getStatus();
@@ -22,14 +103,137 @@ void printStatus() {
     Serial.print("Battery:     ");
     Serial.print(status.battery_level);
     Serial.println("%");
+    Serial.print("Charging:    ");
+    Serial.println(status.is_charging ? "YES" : "NO");
+    Serial.print("Print Count: ");
+    Serial.println(status.print_count);
+    Serial.print("Auto Off:    ");
+    Serial.print(status.auto_power_off_minutes);
+    Serial.println(" min");
     Serial.print("Slim Device: ");
     Serial.println(status.is_slim_device ? "YES" : "NO");
+    Serial.print("Target Size: ");
+    Serial.print((unsigned)(printer.getTargetImageSize() / 1024));
+    Serial.println(" KB");
     Serial.print("Error Code:  ");
     Serial.println(status.error_code);
     if (status.error_code != BTP_ERR_SUCCESS) {
         Serial.print("Error:       ");
         Serial.println(KodakStepProtocol::getErrorString(status.error_code));
     }
+    const KodakLinkStats& link = printer.getLinkStats();
+    if (link.drops > 0) {
+        Serial.print("Link Drops:  ");
+        Serial.print(link.drops);
+        Serial.print(" (reconnected ");
+        Serial.print(link.reconnects);
+        Serial.print(", jobs resumed ");
+        Serial.print(link.resumedJobs);
+        Serial.print(", down ");
+        Serial.print(link.totalDowntimeMs);
+        Serial.println(" ms)");
+    }
+    if (spooler.isRunning() && spooler.getPendingJobs() > 0) {
+        Serial.print("Spooled:     ");
+        Serial.print((unsigned)spooler.getPendingJobs());
+        Serial.print(" jobs");
+        uint32_t waitMs = spooler.getNextAttemptInMs();
+        if (waitMs > 0) {
+            Serial.print(", retry in ");
+            Serial.print(waitMs / 1000);
+            Serial.print(" s (");
+            Serial.print(spooler.getLastError());
+            Serial.print(")");
+        }
+        Serial.println();
+    }
+    if (spooler.isRunning() && spooler.getSchedulerStats().transient_waits > 0) {
+        const KodakSchedulerStats& sched = spooler.getSchedulerStats();
+        Serial.print("Ready Waits: ");
+        Serial.print(sched.transient_waits);
+        Serial.print(" (");
+        Serial.print(sched.wait_ms_total / 1000);
+        Serial.print(" s total, ");
+        Serial.print(sched.status_probes);
+        Serial.println(" probes)");
+    }
+    if (pipeline.isRunning()) {
+        KodakTaskLoad loads[PIPELINE_TASK_COUNT];
+        size_t count = pipeline.getTaskLoads(loads, PIPELINE_TASK_COUNT);
+        Serial.print("Task Load:  ");
+        for (size_t i = 0; i < count; i++) {
+            Serial.print(" ");
+            Serial.print(loads[i].name);
+            Serial.print(" ");
+            Serial.print(loads[i].load_percent);
+            Serial.print("% (core ");
+            Serial.print(loads[i].core);
+            Serial.print(")");
+        }
+        Serial.println();
+    }
+    if (printServer.isRunning()) {
+        const PrintServerStats& uploads = printServer.getStats();
+        Serial.print("Uploads:     ");
+        Serial.print(uploads.uploads_printed);
+        Serial.print(" printed, ");
+        Serial.print(uploads.uploads_failed);
+        Serial.print(" failed, ");
+        Serial.print(uploads.requests_rejected);
+        Serial.print(" rejected");
+        if (uploads.uploads_resized > 0) {
+            Serial.print(", ");
+            Serial.print(uploads.uploads_resized);
+            Serial.print(" resized");
+        }
+        if (uploads.uploads_printed + uploads.uploads_failed > 0) {
+            Serial.print(" (last ");
+            Serial.print(uploads.last_upload_ms);
+            Serial.print(" ms)");
+        }
+        Serial.println();
+    }
+    if (jobArena.isReady()) {
+        jobArena.printStats(Serial);
+    }
+    if (USE_POWER_MANAGER) {
+        const PowerStats& powerStats = power.getStats();
+        Serial.print("Power:       ");
+        Serial.print(power.getState() == POWER_ACTIVE ? "active" : "idle");
+        Serial.print(", ");
+        Serial.print(powerStats.sleeps);
+        Serial.print(" sleeps");
+        if (powerStats.sleeps > 0) {
+            Serial.print(", wake to ready ");
+            Serial.print(powerStats.last_wake_to_ready_ms);
+            Serial.print(" ms (printer ");
+            Serial.print(powerStats.last_printer_resume_ms);
+            Serial.print(" ms)");
+        }
+        Serial.println();
+    }
+    const KodakPrinterMetrics& metrics = printer.getMetrics();
+    if (metrics.prints > 0) {
+        Serial.print("Last Send:   ");
+        Serial.print(metrics.transfer_ms);
+        Serial.print(" ms, ");
+        Serial.print(metrics.bytes_per_sec / 1024);
+        Serial.print(" KB/s, ");
+        Serial.print(metrics.chunk_short_writes);
+        Serial.println(" short writes");
+        Serial.print("Last CRC:    0x");
+        Serial.print(metrics.image_crc32, HEX);
+        Serial.print(", ");
+        Serial.print(metrics.integrity_failures);
+        Serial.println(" jobs failed integrity checks");
+    }
+    if (metrics.printer_events > 0) {
+        Serial.print("Accepted:    ");
+        Serial.print(metrics.accept_ms);
+        Serial.print(" ms after last chunk, finished after ");
+        Serial.print(metrics.finish_ms);
+        Serial.println(" ms");
+    }
     Serial.println("======================\n");
 }
 
@@ -43,14 +247,27 @@ void setup() {
 
     // Initialize camera
     Serial.println("Initializing camera...");
-    if (!camera.begin(FRAMESIZE_VGA, 10)) {
+    if (!camera.begin(FRAMESIZE_VGA, 10, PIPELINED_PRINTING ? PIPELINE_FRAME_BUFFERS : 1)) {
         Serial.println("FATAL: Camera initialization failed");
         return;
     }
     Serial.println("Camera initialized");
 
+    // Reserve job memory once, after the camera has its frame buffers
+    if (!jobArena.begin()) {
+        Serial.println("WARNING: Job arena unavailable, image buffers come from the heap");
+    }
+
     // Initialize Bluetooth
     Serial.println("Initializing Bluetooth...");
+    printer.setDebugOutput(true);  // Whatever BTP_LOG_LEVEL left compiled in
+    if (RECORD_SESSION) {
+        if (session.begin()) {
+            printer.setRecorder(&session);
+        } else {
+            Serial.println("WARNING: Session recorder unavailable");
+        }
+    }
     if (!printer.begin("ESP32-Kodak")) {
         Serial.println("FATAL: Bluetooth initialization failed");
         return;
@@ -61,6 +278,8 @@ void setup() {
     Serial.print(PRINTER_SEARCH_NAME);
     Serial.println("'...");
 
+    printer.setAutoReconnect(true);
+    printer.setEventCallback(onPrinterEvent);
     if (!printer.connectByName(PRINTER_SEARCH_NAME)) {
         Serial.println("ERROR: Failed to connect to printer");
         Serial.print("Error: ");
@@ -68,9 +287,11 @@ void setup() {
         return;
     }
 
-    // Initialize printer protocol
+    // Initialize printer protocol (slim flag remembered from the last session)
     Serial.println("Initializing printer...");
-    if (!printer.initialize(false)) {
+    bool isSlim = false;
+    printer.getCachedSlimDevice(&isSlim);
+    if (!printer.initialize(isSlim)) {
         Serial.println("WARNING: Printer initialization returned error");
         Serial.print("Error: ");
         Serial.println(printer.getLastError());
@@ -78,23 +299,141 @@ void setup() {
     }
 
     // Query and display status
-    uint8_t battery = 0;
-    if (printer.getBatteryLevel(&battery)) {
-        Serial.print("Battery level: ");
-        Serial.print(battery);
-        Serial.println("%");
+    if (!printer.refreshStatus()) {
+        Serial.print("Status refresh failed: ");
+        Serial.println(printer.getLastError());
     }
 
     printStatus();
 
+    if (jobArena.isReady()) {
+        imagePrep.setArena(&jobArena);
+        spooler.setArena(&jobArena);
+    }
+
+    bool prepReady = PREPARE_IMAGES && imagePrep.begin();
+    if (PREPARE_IMAGES && !prepReady) {
+        Serial.print("WARNING: Image prep unavailable, sending raw frames: ");
+        Serial.println(imagePrep.getLastError());
+    }
+
+    if (USE_SPOOLER) {
+        if (spooler.begin(SPOOL_TO_SD)) {
+            spooler.setJobCallback(onPipelineJob);
+        } else {
+            Serial.println("WARNING: Spooler failed to start, failed prints are dropped");
+        }
+    }
+
+    if (PIPELINED_PRINTING) {
+        pipeline.setJobCallback(onPipelineJob);
+        if (prepReady) {
+            pipeline.setImagePrep(&imagePrep);
+        }
+        if (spooler.isRunning()) {
+            pipeline.setSpooler(&spooler);
+        }
+        if (!pipeline.begin()) {
+            Serial.println("WARNING: Pipeline failed to start, printing sequentially");
+        }
+    }
+
+    if (USE_PRINT_SERVER && pipeline.isRunning()) {
+        if (startWiFi()) {
+            if (spooler.isRunning()) {
+                printServer.setSpooler(&spooler);
+            }
+            if (jobArena.isReady()) {
+                uploadPrep.setArena(&jobArena);
+            }
+            if (prepReady && uploadPrep.begin()) {
+                printServer.setImagePrep(&uploadPrep);   // Re-encode uploads over the target size
+            }
+            printServer.begin();
+        } else {
+            Serial.println("WARNING: Wi-Fi unavailable, HTTP uploads disabled");
+        }
+    }
+
+    if (USE_POWER_MANAGER) {
+        power.setPrinterName(PRINTER_SEARCH_NAME);
+        if (pipeline.isRunning()) {
+            power.setPipeline(&pipeline);
+        }
+        if (spooler.isRunning()) {
+            power.setSpooler(&spooler);
+        }
+        if (printServer.isRunning()) {
+            power.setPrintServer(&printServer);
+        }
+        power.begin();
+    }
+
     Serial.println("\n=== Ready ===");
     Serial.println("Press the boot button or send 'p' via Serial to capture and print");
     Serial.println("Send 's' to check printer status");
+    if (session.isInitialized()) {
+        Serial.println("Send 'r' to dump the Bluetooth session trace");
+    }
+}
+
+void spoolCapture() {
+    camera_fb_t* fb = camera.captureImage();
+    if (fb == nullptr) {
+        Serial.println("ERROR: Failed to capture image");
+        return;
+    }
+
+    size_t preparedLen = 0;
+    imagePrep.setSizeLimit(printer.getTargetImageSize());
+    uint8_t* prepared = PREPARE_IMAGES ? imagePrep.prepare(fb->buf, fb->len, &preparedLen) : nullptr;
+    uint32_t jobId;
+    if (prepared != nullptr) {
+        camera.releaseImage(fb);
+        jobId = spooler.enqueueOwned(prepared, preparedLen, NUM_COPIES);
+    } else {
+        jobId = spooler.enqueue(fb->buf, fb->len, NUM_COPIES);
+        camera.releaseImage(fb);
+    }
+
+    if (jobId != 0) {
+        Serial.print("Job ");
+        Serial.print(jobId);
+        Serial.print(" spooled (");
+        Serial.print((unsigned)spooler.getPendingJobs());
+        Serial.println(" waiting for printer)");
+    } else {
+        Serial.print("ERROR: ");
+        Serial.println(spooler.getLastError());
+    }
 }
 
 void captureAndPrint() {
     Serial.println("\n=== Capture and Print ===");
 
+    // The transfer task owns the printer and waits out reconnects itself
+    if (pipeline.isRunning()) {
+        if (pipeline.requestCapture(NUM_COPIES)) {
+            Serial.print("Capture queued (");
+            Serial.print(pipeline.getQueuedJobs());
+            Serial.println(" waiting for printer)");
+        } else {
+            Serial.println("ERROR: Capture queue full");
+        }
+        return;
+    }
+
+    // Spool the shot and let loop() print it; the spooler waits out reconnects and printer errors
+    if (spooler.isRunning()) {
+        spoolCapture();
+        return;
+    }
+
+    // Let the link supervisor finish any reconnect in progress
+    while (printer.poll()) {
+        delay(10);
+    }
+
     // Check connection
     if (!printer.isConnected()) {
         Serial.println("ERROR: Printer not connected");
@@ -113,12 +452,30 @@ void captureAndPrint() {
     Serial.print(fb->len);
     Serial.println(" bytes");
 
-    // Print the image
-    Serial.println("Sending to printer...");
-    bool success = printer.printImage(fb->buf, fb->len, NUM_COPIES);
+    // Resize to the printer raster if possible; otherwise print straight from
+    // the frame buffer, which goes back to the camera once the last chunk is queued
+    size_t preparedLen = 0;
+    imagePrep.setSizeLimit(printer.getTargetImageSize());
+    uint8_t* prepared = PREPARE_IMAGES ? imagePrep.prepare(fb->buf, fb->len, &preparedLen) : nullptr;
+    bool success;
+    if (prepared != nullptr) {
+        camera.releaseImage(fb);
+        Serial.print("Prepared ");
+        Serial.print(preparedLen);
+        Serial.print(" bytes in ");
+        Serial.print(imagePrep.getLastDurationMs());
+        Serial.println(" ms");
 
-    // Release the frame buffer
-    camera.releaseImage(fb);
+        Serial.println("Sending to printer...");
+        KodakMemorySource source(prepared, preparedLen);
+        success = printer.printImage(source, NUM_COPIES);
+        ImagePrep::freeImage(prepared);
+    } else {
+        Serial.println("Sending to printer...");
+        ESP32CameraFrameSource source(fb);
+        success = printer.printImage(source, NUM_COPIES);
+        source.release();
+    }
 
     if (success) {
         Serial.println("Print job sent successfully!");
@@ -132,25 +489,56 @@ void captureAndPrint() {
 }
 
 void loop() {
+    static bool lastButtonState = HIGH;
+
+    // Link supervision; in pipelined mode the transfer task does this
+    if (!pipeline.isRunning()) {
+        printer.poll();
+        spooler.poll();
+    }
+
+    // Only the boot button wakes the unit, and that press asks for a print
+    if (USE_POWER_MANAGER && power.poll()) {
+        lastButtonState = LOW;
+        captureAndPrint();
+    }
+
     // Check for serial input
     if (Serial.available()) {
+        power.noteActivity();
         char c = Serial.read();
         if (c == 'p' || c == 'P') {
             captureAndPrint();
         } else if (c == 's' || c == 'S') {
-            // Refresh status
-            uint8_t battery = 0;
-            printer.getBatteryLevel(&battery);
+            // Refresh status; while the pipeline runs, its transfer task owns the link
+            if (pipeline.isRunning()) {
+                pipeline.requestStatusRefresh();
+                uint32_t start = millis();
+                while (pipeline.isStatusRefreshPending() && millis() - start < STATUS_REFRESH_WAIT_MS) {
+                    delay(10);
+                }
+            } else {
+                printer.refreshStatus();
+            }
             printStatus();
+        } else if ((c == 'r' || c == 'R') && session.isInitialized()) {
+            // Paused while it drains; not mid-print, when the transfer task is recording
+            if (pipeline.isBusy()) {
+                Serial.println("Printing, try again when it is done");
+            } else {
+                session.setEnabled(false);
+                session.exportHex(Serial);
+                session.setEnabled(true);
+            }
         }
     }
 
     // Check boot button (GPIO0 on ESP32-CAM)
-    static bool lastButtonState = HIGH;
     bool buttonState = digitalRead(0);
     if (lastButtonState == HIGH && buttonState == LOW) {
         delay(50);  // Debounce
         if (digitalRead(0) == LOW) {
+            power.noteActivity();
             captureAndPrint();
         }
     }
@@ -0,0 +1,451 @@
+/**
+ * Micro-benchmarks for KodakStepProtocol and the transfer path
+ *
+ * Run with: pio test -e esp32cam-bench
+ *
+ * Each benchmark reports the best CPU cycle count over BENCH_ITERATIONS runs
+ * (esp_cpu_get_ccount, 240 MHz) and fails when it exceeds its budget, so a
+ * slowdown shows up as a red test run instead of a slower fleet. Budgets are
+ * loose upper bounds; override any of them with -D in platformio.ini once a
+ * baseline has been recorded for the board.
+ */
+
+#include <Arduino.h>
+#include <unity.h>
+#include <KodakStep.h>
+#include "esp_cpu.h"
+#include "esp_heap_caps.h"
+
+#ifndef BENCH_ITERATIONS
+#define BENCH_ITERATIONS 200
+#endif
+
+// Cycle budgets per call
+#ifndef BENCH_BUDGET_BUILD_CYCLES
+#define BENCH_BUDGET_BUILD_CYCLES 2000
+#endif
+#ifndef BENCH_BUDGET_PARSE_CYCLES
+#define BENCH_BUDGET_PARSE_CYCLES 1000
+#endif
+#ifndef BENCH_BUDGET_HEX_DUMP_CYCLES
+#define BENCH_BUDGET_HEX_DUMP_CYCLES 4000000    // Dominated by the UART at 115200 baud
+#endif
+
+// Cycle budget per image byte for the engine transfer (poll(): source, integrity
+// checks, CRC, pacer, metrics, writer task handoff or sink copy)
+#ifndef BENCH_BUDGET_TRANSFER_CYCLES_PER_BYTE
+#define BENCH_BUDGET_TRANSFER_CYCLES_PER_BYTE 60
+#endif
+// ...of which the CRC-32 alone, over PSRAM
+#ifndef BENCH_BUDGET_CRC_CYCLES_PER_BYTE
+#define BENCH_BUDGET_CRC_CYCLES_PER_BYTE 20
+#endif
+
+#define BENCH_SINK_QUEUE_SIZE BTP_PACING_MAX_CHUNK_SIZE  // Bytes the fake SPP queue accepts per write()
+#define BENCH_TRANSFER_MAX_SIZE BTP_MAX_IMAGE_SIZE
+
+KodakStepProtocol protocol;
+uint8_t packet[BTP_PACKET_SIZE];
+uint8_t* image = nullptr;
+
+void setUp(void) {
+    memset(packet, 0, sizeof(packet));
+}
+
+void tearDown(void) {
+}
+
+// =============================================================================
+// Harness
+// =============================================================================
+
+// Best of BENCH_ITERATIONS; the minimum filters out interrupts and cache misses
+#define BENCH_MIN_CYCLES(result, statement)                 \
+    do {                                                    \
+        uint32_t best = UINT32_MAX;                         \
+        for (int i = 0; i < BENCH_ITERATIONS; i++) {        \
+            uint32_t start = esp_cpu_get_ccount();          \
+            statement;                                      \
+            uint32_t cycles = esp_cpu_get_ccount() - start; \
+            if (cycles < best) {                            \
+                best = cycles;                              \
+            }                                               \
+        }                                                   \
+        result = best;                                      \
+    } while (0)
+
+static void report(const char* name, uint32_t cycles, uint32_t budget) {
+    char line[96];
+    snprintf(line, sizeof(line), "BENCH %-28s %8lu cycles (budget %lu)",
+             name, (unsigned long)cycles, (unsigned long)budget);
+    TEST_MESSAGE(line);
+    TEST_ASSERT_LESS_OR_EQUAL_UINT32_MESSAGE(budget, cycles, name);
+}
+
+#define BENCH_BUILD(name, statement)                        \
+    do {                                                    \
+        uint32_t cycles;                                    \
+        BENCH_MIN_CYCLES(cycles, statement);                \
+        report(name, cycles, BENCH_BUDGET_BUILD_CYCLES);    \
+    } while (0)
+
+// =============================================================================
+// Packet Builders
+// =============================================================================
+
+void bench_buildGetAccessoryInfoPacket(void) {
+    BENCH_BUILD("buildGetAccessoryInfoPacket", protocol.buildGetAccessoryInfoPacket(packet, false));
+}
+
+void bench_buildGetAccessoryInfoPacket_slim(void) {
+    BENCH_BUILD("buildGetAccessoryInfo (slim)", protocol.buildGetAccessoryInfoPacket(packet, true));
+}
+
+void bench_buildGetBatteryLevelPacket(void) {
+    BENCH_BUILD("buildGetBatteryLevelPacket", protocol.buildGetBatteryLevelPacket(packet));
+}
+
+void bench_buildGetPageTypePacket(void) {
+    BENCH_BUILD("buildGetPageTypePacket", protocol.buildGetPageTypePacket(packet));
+}
+
+void bench_buildGetPrintCountPacket(void) {
+    BENCH_BUILD("buildGetPrintCountPacket", protocol.buildGetPrintCountPacket(packet));
+}
+
+void bench_buildGetAutoPowerOffPacket(void) {
+    BENCH_BUILD("buildGetAutoPowerOffPacket", protocol.buildGetAutoPowerOffPacket(packet));
+}
+
+void bench_buildPrintReadyPacket(void) {
+    BENCH_BUILD("buildPrintReadyPacket", protocol.buildPrintReadyPacket(packet, 180000, 2));
+}
+
+void bench_buildStartOfSendAck(void) {
+    BENCH_BUILD("buildStartOfSendAck", protocol.buildStartOfSendAck(packet));
+}
+
+void bench_buildEndOfReceivedAck(void) {
+    BENCH_BUILD("buildEndOfReceivedAck", protocol.buildEndOfReceivedAck(packet));
+}
+
+void bench_buildErrorMessageAck(void) {
+    BENCH_BUILD("buildErrorMessageAck", protocol.buildErrorMessageAck(packet, BTP_ERR_NO_PAPER));
+}
+
+// =============================================================================
+// Response Parsing
+// =============================================================================
+
+void bench_parseResponse(void) {
+    protocol.buildGetBatteryLevelPacket(packet);
+    packet[8] = BTP_ERR_SUCCESS;
+    packet[12] = 85;
+    uint8_t errorCode;
+    uint8_t data[25];
+    volatile bool ok = false;
+
+    uint32_t cycles;
+    BENCH_MIN_CYCLES(cycles, ok = protocol.parseResponse(packet, &errorCode, data));
+    TEST_ASSERT_TRUE(ok);
+    report("parseResponse", cycles, BENCH_BUDGET_PARSE_CYCLES);
+}
+
+void bench_parsePrintCount(void) {
+    protocol.buildGetPrintCountPacket(packet);
+    volatile uint16_t count;
+
+    uint32_t cycles;
+    BENCH_MIN_CYCLES(cycles, count = protocol.parsePrintCount(packet));
+    (void)count;
+    report("parsePrintCount", cycles, BENCH_BUDGET_PARSE_CYCLES);
+}
+
+void bench_parseAutoPowerOff(void) {
+    protocol.buildGetAutoPowerOffPacket(packet);
+    volatile uint8_t minutes;
+
+    uint32_t cycles;
+    BENCH_MIN_CYCLES(cycles, minutes = protocol.parseAutoPowerOff(packet));
+    (void)minutes;
+    report("parseAutoPowerOff", cycles, BENCH_BUDGET_PARSE_CYCLES);
+}
+
+void bench_frameAssembler_feed(void) {
+    protocol.buildGetBatteryLevelPacket(packet);
+    KodakFrameAssembler assembler;
+
+    uint32_t cycles;
+    BENCH_MIN_CYCLES(cycles, assembler.reset(); assembler.feed(packet, BTP_PACKET_SIZE));
+    TEST_ASSERT_TRUE(assembler.hasFrame());
+    report("KodakFrameAssembler::feed", cycles, BENCH_BUDGET_PARSE_CYCLES);
+}
+
+void bench_printPacketHex(void) {
+    protocol.buildPrintReadyPacket(packet, 180000, 1);
+    Serial.flush();
+
+    // Fewer rounds: each one pushes ~110 characters through the UART
+    uint32_t best = UINT32_MAX;
+    for (int i = 0; i < 8; i++) {
+        uint32_t start = esp_cpu_get_ccount();
+        KodakStepProtocol::printPacketHex(packet, BTP_PACKET_SIZE, true);
+        uint32_t cycles = esp_cpu_get_ccount() - start;
+        Serial.flush();
+        if (cycles < best) {
+            best = cycles;
+        }
+    }
+    report("printPacketHex", best, BENCH_BUDGET_HEX_DUMP_CYCLES);
+}
+
+// =============================================================================
+// Engine Transfer
+// =============================================================================
+
+/**
+ * Stand-in for the printer at the far end of BluetoothSerial: answers the
+ * pre-flight queries and PRINT_READY, then takes the image into an
+ * SPP-sized queue. Like the real stack when its queue fills, it can accept
+ * only part of every eighth write so the pacer's backpressure path runs too.
+ */
+class FakeSppSink : public Stream {
+public:
+    uint8_t queue[BENCH_SINK_QUEUE_SIZE];
+    size_t total;
+    uint32_t writes;
+    bool shortWrites;
+
+    FakeSppSink() : total(0), writes(0), shortWrites(true), imageLeft(0),
+                    frameLen(0), rxLen(0), rxPos(0) {}
+
+    void reset(bool withShortWrites) {
+        total = 0;
+        writes = 0;
+        shortWrites = withShortWrites;
+        imageLeft = 0;
+        frameLen = 0;
+        rxLen = 0;
+        rxPos = 0;
+    }
+
+    int available() override { return (int)(rxLen - rxPos); }
+    int read() override { return rxPos < rxLen ? rx[rxPos++] : -1; }
+    int peek() override { return rxPos < rxLen ? rx[rxPos] : -1; }
+
+    size_t write(uint8_t c) override { return write(&c, 1); }
+    size_t write(const uint8_t* data, size_t size) override {
+        if (imageLeft == 0) {
+            receiveCommand(data, size);
+            return size;
+        }
+
+        size_t accepted = min(min(size, imageLeft), (size_t)BENCH_SINK_QUEUE_SIZE);
+        if (++writes % 8 == 0 && shortWrites) {
+            accepted /= 2;
+        }
+        memcpy(queue, data, accepted);
+        total += accepted;
+        imageLeft -= accepted;
+        return accepted;
+    }
+
+private:
+    size_t imageLeft;               // Image bytes still due after PRINT_READY
+    uint8_t frame[BTP_PACKET_SIZE];
+    size_t frameLen;
+    uint8_t rx[BTP_PACKET_SIZE];    // One reply is outstanding at a time
+    size_t rxLen;
+    size_t rxPos;
+
+    void receiveCommand(const uint8_t* data, size_t size) {
+        for (size_t i = 0; i < size; i++) {
+            frame[frameLen++] = data[i];
+            if (frameLen == BTP_PACKET_SIZE) {
+                frameLen = 0;
+                reply();
+            }
+        }
+    }
+
+    void reply() {
+        memset(rx, 0, sizeof(rx));
+        rx[0] = BTP_START_1;
+        rx[1] = BTP_START_2;
+        rx[2] = BTP_IDENT_1;
+        rx[3] = BTP_IDENT_2;
+        rx[6] = frame[6];
+        rx[8] = BTP_ERR_SUCCESS;
+        rxLen = BTP_PACKET_SIZE;
+        rxPos = 0;
+
+        if (frame[6] == BTP_CMD_GET_ACCESSORY_INFO) {
+            rx[6] = BTP_RESP_ACCESSORY_INFO;
+            rx[7] = 0x02;
+            rx[12] = 100;   // Battery level
+        } else if (frame[6] == BTP_CMD_PRINT_READY && frame[7] == 0x00) {
+            imageLeft = ((uint32_t)frame[8] << 16) | ((uint32_t)frame[9] << 8) | frame[10];
+        }
+    }
+};
+
+// Counts the chunks the engine pulls, so the poll() that hands one to the
+// writer task is measured as well as the one that collects its result
+class CountingSource : public KodakMemorySource {
+public:
+    uint32_t pulls;
+
+    CountingSource(const uint8_t* data, size_t size) : KodakMemorySource(data, size), pulls(0) {}
+
+    size_t next(const uint8_t** chunk, size_t maxLen) override {
+        pulls++;
+        return KodakMemorySource::next(chunk, maxLen);
+    }
+};
+
+// Globals: the 16 KB queue would not fit on the loop task stack
+FakeSppSink sink;
+KodakStepPrinter printer;
+
+// printImageAsync() through the real engine, with the fake printer on the
+// link. Only the poll() calls that pull or write a chunk are counted; the
+// pre-flight and the pacer's quiet periods are idle time, not transfer cost.
+static uint32_t engineTransfer(size_t size, bool writerTask) {
+    CountingSource source(image, size);
+    // Every chunk pulled once: a short write's remainder is resent by a
+    // poll() that pulls nothing, so the writer task run takes whole writes
+    sink.reset(!writerTask);
+    printer.attachLink(sink);
+    printer.setPacingMode(KODAK_PACING_ADAPTIVE);
+    if (writerTask) {
+        TEST_ASSERT_TRUE(printer.startWriterTask());
+    }
+    printer.resetMetrics();
+    TEST_ASSERT_TRUE_MESSAGE(printer.printImageAsync(source), printer.getLastError());
+
+    const KodakPrinterMetrics& metrics = printer.getMetrics();
+    uint32_t cycles = 0;
+    bool busy = true;
+    while (busy) {
+        uint32_t chunks = metrics.chunks_written;
+        uint32_t pulls = source.pulls;
+        uint32_t start = esp_cpu_get_ccount();
+        busy = printer.poll();
+        uint32_t elapsed = esp_cpu_get_ccount() - start;
+        if (metrics.chunks_written != chunks || source.pulls != pulls) {
+            cycles += elapsed;
+        } else if (busy) {
+            delay(1);
+        }
+    }
+
+    TEST_ASSERT_TRUE_MESSAGE(printer.getLastResult().success, printer.getLastError());
+    TEST_ASSERT_EQUAL_UINT32(size, sink.total);
+    TEST_ASSERT_EQUAL_UINT32(size, metrics.bytes_sent);
+    TEST_ASSERT_EQUAL_HEX32(KodakStepProtocol::crc32(0, image, size), metrics.image_crc32);
+    printer.stopWriterTask();
+    printer.detachLink();
+    return cycles;
+}
+
+static void benchTransfer(const char* name, size_t size, bool writerTask) {
+    TEST_ASSERT_NOT_NULL_MESSAGE(image, "Benchmark image buffer not allocated");
+
+    // Best of three; a 2 MB run takes long enough that interrupts are background noise
+    uint32_t best = UINT32_MAX;
+    for (int i = 0; i < 3; i++) {
+        uint32_t cycles = engineTransfer(size, writerTask);
+        if (cycles < best) {
+            best = cycles;
+        }
+    }
+    report(name, best / size, BENCH_BUDGET_TRANSFER_CYCLES_PER_BYTE);
+}
+
+void bench_engineTransfer_1mb(void) {
+    benchTransfer("engine transfer 1 MB (cyc/B)", 1024 * 1024, false);
+}
+
+void bench_engineTransfer_2mb(void) {
+    benchTransfer("engine transfer 2 MB (cyc/B)", BENCH_TRANSFER_MAX_SIZE, false);
+}
+
+void bench_engineTransfer_writer_1mb(void) {
+    benchTransfer("writer task 1 MB (cyc/B)", 1024 * 1024, true);
+}
+
+void bench_crc32_1mb(void) {
+    TEST_ASSERT_NOT_NULL_MESSAGE(image, "Benchmark image buffer not allocated");
+
+    uint32_t best = UINT32_MAX;
+    uint32_t crc = 0;
+    for (int i = 0; i < 3; i++) {
+        uint32_t start = esp_cpu_get_ccount();
+        crc = KodakStepProtocol::crc32(0, image, 1024 * 1024);
+        uint32_t cycles = esp_cpu_get_ccount() - start;
+        if (cycles < best) {
+            best = cycles;
+        }
+    }
+    TEST_ASSERT_NOT_EQUAL(0, crc);
+    report("crc32 1 MB (cyc/B)", best / (1024 * 1024), BENCH_BUDGET_CRC_CYCLES_PER_BYTE);
+}
+
+// =============================================================================
+// Test Runner
+// =============================================================================
+
+void setup() {
+    delay(2000);  // Wait for Serial monitor to connect
+
+    // Image lives in PSRAM like a camera frame buffer
+    image = (uint8_t*)heap_caps_malloc(BENCH_TRANSFER_MAX_SIZE, MALLOC_CAP_SPIRAM);
+    if (image != nullptr) {
+        for (size_t i = 0; i < BENCH_TRANSFER_MAX_SIZE; i++) {
+            image[i] = (uint8_t)(i * 31);
+        }
+        // SOI, and an EOI ending each transfer size, to pass the integrity checks
+        image[0] = 0xFF;
+        image[1] = 0xD8;
+        image[1024 * 1024 - 2] = 0xFF;
+        image[1024 * 1024 - 1] = 0xD9;
+        image[BENCH_TRANSFER_MAX_SIZE - 2] = 0xFF;
+        image[BENCH_TRANSFER_MAX_SIZE - 1] = 0xD9;
+    }
+
+    UNITY_BEGIN();
+
+    // Packet builders
+    RUN_TEST(bench_buildGetAccessoryInfoPacket);
+    RUN_TEST(bench_buildGetAccessoryInfoPacket_slim);
+    RUN_TEST(bench_buildGetBatteryLevelPacket);
+    RUN_TEST(bench_buildGetPageTypePacket);
+    RUN_TEST(bench_buildGetPrintCountPacket);
+    RUN_TEST(bench_buildGetAutoPowerOffPacket);
+    RUN_TEST(bench_buildPrintReadyPacket);
+    RUN_TEST(bench_buildStartOfSendAck);
+    RUN_TEST(bench_buildEndOfReceivedAck);
+    RUN_TEST(bench_buildErrorMessageAck);
+
+    // Response parsing
+    RUN_TEST(bench_parseResponse);
+    RUN_TEST(bench_parsePrintCount);
+    RUN_TEST(bench_parseAutoPowerOff);
+    RUN_TEST(bench_frameAssembler_feed);
+    RUN_TEST(bench_printPacketHex);
+
+    // Engine transfer
+    RUN_TEST(bench_engineTransfer_1mb);
+    RUN_TEST(bench_engineTransfer_2mb);
+    RUN_TEST(bench_engineTransfer_writer_1mb);
+    RUN_TEST(bench_crc32_1mb);
+
+    UNITY_END();
+
+    heap_caps_free(image);
+    image = nullptr;
+}
+
+void loop() {
+    // Nothing to do
+}
@@ -155,6 +155,27 @@ void test_buildErrorMessageAck(void) {
     TEST_ASSERT_EQUAL_HEX8(BTP_ERR_NO_PAPER, buffer[8]);
 }
 
+void test_packetTemplates_have_header_and_zero_tail(void) {
+    for (uint8_t id = 0; id < KODAK_PACKET_COUNT; id++) {
+        const uint8_t* packet = KodakStepProtocol::packetTemplate((KodakPacketId)id);
+        TEST_ASSERT_NOT_NULL(packet);
+        TEST_ASSERT_EQUAL_HEX8(BTP_START_1, packet[0]);
+        TEST_ASSERT_EQUAL_HEX8(BTP_IDENT_2, packet[3]);
+        for (size_t i = 9; i < BTP_PACKET_SIZE; i++) {
+            TEST_ASSERT_EQUAL_HEX8(0x00, packet[i]);
+        }
+    }
+    TEST_ASSERT_NULL(KodakStepProtocol::packetTemplate(KODAK_PACKET_COUNT));
+}
+
+void test_packetTemplate_matches_builder(void) {
+    uint8_t buffer[BTP_PACKET_SIZE];
+
+    protocol.buildGetPrintCountPacket(buffer);
+    TEST_ASSERT_EQUAL_MEMORY(KodakStepProtocol::packetTemplate(KODAK_PACKET_PRINT_COUNT),
+                             buffer, BTP_PACKET_SIZE);
+}
+
 // =============================================================================
 // Response Parsing Tests
 // =============================================================================
@@ -222,6 +243,105 @@ void test_parseAutoPowerOff(void) {
     TEST_ASSERT_EQUAL_UINT8(15, minutes);
 }
 
+void test_responseView_reads_in_place(void) {
+    uint8_t response[BTP_PACKET_SIZE] = {0};
+    response[0] = 0x1B;
+    response[1] = 0x2A;
+    response[2] = 0x43;
+    response[3] = 0x41;
+    response[6] = BTP_RESP_ACCESSORY_INFO;
+    response[8] = BTP_ERR_SUCCESS;
+    response[12] = 72;
+
+    KodakAccessoryInfoView view(response);
+
+    TEST_ASSERT_TRUE(view.isValid());
+    TEST_ASSERT_TRUE(view.ok());
+    TEST_ASSERT_EQUAL_HEX8(BTP_RESP_ACCESSORY_INFO, view.type());
+    TEST_ASSERT_EQUAL_UINT8(72, view.batteryLevel());
+    TEST_ASSERT_EQUAL_PTR(response + BTP_PAYLOAD_OFFSET, view.payload());
+    TEST_ASSERT_EQUAL_PTR(response, view.data());
+}
+
+void test_responseView_invalid_header(void) {
+    uint8_t response[BTP_PACKET_SIZE] = {0};
+    response[8] = BTP_ERR_SUCCESS;
+
+    KodakResponseView view(response);
+
+    TEST_ASSERT_FALSE(view.isValid());
+    TEST_ASSERT_FALSE(view.ok());
+    TEST_ASSERT_EQUAL_HEX8(BTP_ERR_NOT_CONNECTED, view.errorCode());
+    TEST_ASSERT_NULL(view.payload());
+}
+
+void test_responseView_status_fields(void) {
+    uint8_t response[BTP_PACKET_SIZE] = {0};
+    response[8] = 0x01;
+    response[9] = 0x2C;
+
+    TEST_ASSERT_TRUE(KodakChargingStatusView(response).isCharging());
+    TEST_ASSERT_EQUAL_UINT16(300, KodakPrintCountView(response).printCount());
+    TEST_ASSERT_EQUAL_UINT8(1, KodakAutoPowerOffView(response).minutes());
+}
+
+// =============================================================================
+// Frame Assembler Tests
+// =============================================================================
+
+static void fillResponse(uint8_t* frame, uint8_t marker) {
+    memset(frame, 0, BTP_PACKET_SIZE);
+    frame[0] = 0x1B;
+    frame[1] = 0x2A;
+    frame[2] = 0x43;
+    frame[3] = 0x41;
+    frame[8] = marker;
+}
+
+void test_frameAssembler_whole_frame(void) {
+    KodakFrameAssembler assembler;
+    uint8_t frame[BTP_PACKET_SIZE];
+    fillResponse(frame, 0x42);
+
+    TEST_ASSERT_EQUAL(BTP_PACKET_SIZE, assembler.feed(frame, BTP_PACKET_SIZE));
+    TEST_ASSERT_TRUE(assembler.hasFrame());
+    TEST_ASSERT_EQUAL_HEX8(0x42, assembler.frame()[8]);
+    TEST_ASSERT_EQUAL(0, assembler.getDiscardedBytes());
+}
+
+void test_frameAssembler_split_and_stops_at_frame_end(void) {
+    KodakFrameAssembler assembler;
+    uint8_t stream[BTP_PACKET_SIZE * 2];
+    fillResponse(stream, 0x01);
+    fillResponse(stream + BTP_PACKET_SIZE, 0x02);
+
+    TEST_ASSERT_EQUAL(10, assembler.feed(stream, 10));
+    TEST_ASSERT_FALSE(assembler.hasFrame());
+    TEST_ASSERT_EQUAL(BTP_PACKET_SIZE - 10, assembler.bytesNeeded());
+
+    // Only the rest of the first frame is consumed
+    TEST_ASSERT_EQUAL(BTP_PACKET_SIZE - 10, assembler.feed(stream + 10, sizeof(stream) - 10));
+    TEST_ASSERT_TRUE(assembler.hasFrame());
+    TEST_ASSERT_EQUAL_HEX8(0x01, assembler.frame()[8]);
+
+    assembler.reset();
+    assembler.feed(stream + BTP_PACKET_SIZE, BTP_PACKET_SIZE);
+    TEST_ASSERT_EQUAL_HEX8(0x02, assembler.frame()[8]);
+}
+
+void test_frameAssembler_resyncs_on_header(void) {
+    KodakFrameAssembler assembler;
+    uint8_t stream[5 + BTP_PACKET_SIZE] = {0x00, 0x1B, 0x2A, 0x1B, 0x99};
+    fillResponse(stream + 5, 0x07);
+
+    assembler.feed(stream, sizeof(stream));
+
+    TEST_ASSERT_TRUE(assembler.hasFrame());
+    TEST_ASSERT_EQUAL_HEX8(0x1B, assembler.frame()[0]);
+    TEST_ASSERT_EQUAL_HEX8(0x07, assembler.frame()[8]);
+    TEST_ASSERT_EQUAL(5, assembler.getDiscardedBytes());
+}
+
 // =============================================================================
 // Error String Tests
 // =============================================================================
@@ -236,11 +356,196 @@ void test_getErrorString_no_paper(void) {
     TEST_ASSERT_EQUAL_STRING("Out of paper", str);
 }
 
+void test_classifyError(void) {
+    TEST_ASSERT_EQUAL(KODAK_ERROR_NONE, KodakStepProtocol::classifyError(BTP_ERR_SUCCESS));
+    TEST_ASSERT_EQUAL(KODAK_ERROR_TRANSIENT, KodakStepProtocol::classifyError(BTP_ERR_BUSY));
+    TEST_ASSERT_EQUAL(KODAK_ERROR_TRANSIENT, KodakStepProtocol::classifyError(BTP_ERR_COOLING));
+    TEST_ASSERT_EQUAL(KODAK_ERROR_TRANSIENT, KodakStepProtocol::classifyError(BTP_ERR_OVERHEATING));
+    TEST_ASSERT_EQUAL(KODAK_ERROR_ATTENTION, KodakStepProtocol::classifyError(BTP_ERR_NO_PAPER));
+    TEST_ASSERT_EQUAL(KODAK_ERROR_ATTENTION, KodakStepProtocol::classifyError(BTP_ERR_COVER_OPEN));
+    TEST_ASSERT_EQUAL(KODAK_ERROR_LINK, KodakStepProtocol::classifyError(BTP_ERR_NOT_CONNECTED));
+    TEST_ASSERT_EQUAL(KODAK_ERROR_DATA, KodakStepProtocol::classifyError(BTP_ERR_BAD_IMAGE));
+    TEST_ASSERT_EQUAL(KODAK_ERROR_UNKNOWN, KodakStepProtocol::classifyError(0x42));
+}
+
 void test_getErrorString_unknown(void) {
     const char* str = KodakStepProtocol::getErrorString(0xFF);
     TEST_ASSERT_EQUAL_STRING("Unknown error", str);
 }
 
+// =============================================================================
+// Printer Message Tests
+// =============================================================================
+
+static void makeMessage(uint8_t* frame, uint8_t type, uint8_t subType, uint8_t code) {
+    uint8_t header[] = {BTP_START_1, BTP_START_2, BTP_IDENT_1, BTP_IDENT_2};
+    memset(frame, 0, BTP_PACKET_SIZE);
+    memcpy(frame, header, sizeof(header));
+    frame[6] = type;
+    frame[7] = subType;
+    frame[8] = code;
+}
+
+void test_classifyMessage_printer_events(void) {
+    uint8_t frame[BTP_PACKET_SIZE];
+
+    makeMessage(frame, 0x00, 0x02, 0x00);
+    TEST_ASSERT_EQUAL(KODAK_EVENT_START_OF_SEND, KodakStepProtocol::classifyMessage(frame));
+    makeMessage(frame, 0x01, 0x01, 0x00);
+    TEST_ASSERT_EQUAL(KODAK_EVENT_DATA_ACCEPTED, KodakStepProtocol::classifyMessage(frame));
+    makeMessage(frame, 0x01, 0x00, BTP_ERR_SUCCESS);
+    TEST_ASSERT_EQUAL(KODAK_EVENT_PRINT_FINISHED, KodakStepProtocol::classifyMessage(frame));
+    makeMessage(frame, 0x01, 0x00, BTP_ERR_PAPER_JAM);
+    TEST_ASSERT_EQUAL(KODAK_EVENT_ERROR, KodakStepProtocol::classifyMessage(frame));
+}
+
+void test_classifyMessage_ignores_replies(void) {
+    uint8_t frame[BTP_PACKET_SIZE];
+
+    makeMessage(frame, BTP_RESP_ACCESSORY_INFO, 0x02, 0x00);
+    TEST_ASSERT_EQUAL(KODAK_EVENT_NONE, KodakStepProtocol::classifyMessage(frame));
+    makeMessage(frame, 0x00, 0x00, 0x00);   // PRINT_READY reply
+    TEST_ASSERT_EQUAL(KODAK_EVENT_NONE, KodakStepProtocol::classifyMessage(frame));
+    makeMessage(frame, 0x01, 0x01, 0x00);
+    frame[0] = 0x00;                        // Bad header
+    TEST_ASSERT_EQUAL(KODAK_EVENT_NONE, KodakStepProtocol::classifyMessage(frame));
+}
+
+void test_buildEventAck_matches_message(void) {
+    uint8_t buffer[BTP_PACKET_SIZE];
+
+    TEST_ASSERT_TRUE(protocol.buildEventAck(buffer, KODAK_EVENT_START_OF_SEND, 0));
+    TEST_ASSERT_EQUAL_HEX8(0x00, buffer[7]);
+    TEST_ASSERT_EQUAL_HEX8(0x02, buffer[8]);
+
+    TEST_ASSERT_TRUE(protocol.buildEventAck(buffer, KODAK_EVENT_DATA_ACCEPTED, 0));
+    TEST_ASSERT_EQUAL_HEX8(0x01, buffer[7]);
+    TEST_ASSERT_EQUAL_HEX8(0x02, buffer[8]);
+
+    TEST_ASSERT_TRUE(protocol.buildEventAck(buffer, KODAK_EVENT_ERROR, BTP_ERR_NO_PAPER));
+    TEST_ASSERT_EQUAL_HEX8(0x00, buffer[7]);
+    TEST_ASSERT_EQUAL_HEX8(BTP_ERR_NO_PAPER, buffer[8]);
+
+    TEST_ASSERT_FALSE(protocol.buildEventAck(buffer, KODAK_EVENT_NONE, 0));
+}
+
+// =============================================================================
+// Status Cache Tests
+// =============================================================================
+
+void test_isFresh_within_ttl(void) {
+    TEST_ASSERT_TRUE(KodakStepProtocol::isFresh(1000, 1500, 1000));
+    TEST_ASSERT_FALSE(KodakStepProtocol::isFresh(1000, 2000, 1000));
+}
+
+void test_isFresh_disabled_or_uncached(void) {
+    TEST_ASSERT_FALSE(KodakStepProtocol::isFresh(1000, 1500, 0));
+    TEST_ASSERT_FALSE(KodakStepProtocol::isFresh(0, 500, 1000));
+}
+
+void test_isFresh_across_millis_wrap(void) {
+    TEST_ASSERT_TRUE(KodakStepProtocol::isFresh(0xFFFFFF00, 0x00000010, 1000));
+}
+
+// =============================================================================
+// Metrics Tests
+// =============================================================================
+
+void test_rttBucket_boundaries(void) {
+    TEST_ASSERT_EQUAL(0, KodakPrinterMetrics::rttBucket(0));
+    TEST_ASSERT_EQUAL(0, KodakPrinterMetrics::rttBucket(9));
+    TEST_ASSERT_EQUAL(1, KodakPrinterMetrics::rttBucket(10));
+    TEST_ASSERT_EQUAL(6, KodakPrinterMetrics::rttBucket(999));
+    TEST_ASSERT_EQUAL(BTP_RTT_BUCKET_COUNT - 1, KodakPrinterMetrics::rttBucket(1000));
+    TEST_ASSERT_EQUAL(BTP_RTT_BUCKET_COUNT - 1, KodakPrinterMetrics::rttBucket(60000));
+}
+
+void test_metrics_recordChunk_counts_short_writes(void) {
+    KodakPrinterMetrics metrics;
+    metrics.reset();
+
+    metrics.recordChunk(4096, 4096, 300);
+    metrics.recordChunk(4096, 1024, 900);
+
+    TEST_ASSERT_EQUAL(2, metrics.chunks_written);
+    TEST_ASSERT_EQUAL(5120, metrics.bytes_sent);
+    TEST_ASSERT_EQUAL(1, metrics.chunk_short_writes);
+    TEST_ASSERT_EQUAL(1200, metrics.chunk_write_us_total);
+    TEST_ASSERT_EQUAL(900, metrics.chunk_write_us_max);
+}
+
+// =============================================================================
+// Trace Log Tests
+// =============================================================================
+
+// Collects flushed log lines
+class CaptureSink : public Print {
+public:
+    char text[512];
+    size_t length;
+
+    CaptureSink() : length(0) { text[0] = '\0'; }
+
+    size_t write(uint8_t c) override { return write(&c, 1); }
+    size_t write(const uint8_t* data, size_t size) override {
+        size_t n = min(size, sizeof(text) - 1 - length);
+        memcpy(text + length, data, n);
+        length += n;
+        text[length] = '\0';
+        return n;
+    }
+};
+
+void test_log_flushes_in_order(void) {
+    KodakStepLog log;
+    TEST_ASSERT_TRUE(log.begin(8));
+
+    log.log(KODAK_LOG_MESSAGE, "first");
+    log.log(KODAK_LOG_CHUNK, nullptr, 4096, 2048);
+    TEST_ASSERT_EQUAL(2, log.getPending());
+
+    CaptureSink sink;
+    TEST_ASSERT_EQUAL(2, log.flush(sink));
+    TEST_ASSERT_EQUAL(0, log.getPending());
+
+    const char* first = strstr(sink.text, "first");
+    const char* chunk = strstr(sink.text, "chunk offset=4096 len=2048");
+    TEST_ASSERT_NOT_NULL(first);
+    TEST_ASSERT_NOT_NULL(chunk);
+    TEST_ASSERT_TRUE(first < chunk);
+}
+
+void test_log_drops_when_full(void) {
+    KodakStepLog log;
+    TEST_ASSERT_TRUE(log.begin(6));  // Rounded down to 4 slots
+
+    for (uint32_t i = 0; i < 6; i++) {
+        log.log(KODAK_LOG_CHUNK, nullptr, i, 0);
+    }
+    TEST_ASSERT_EQUAL(4, log.getPending());
+    TEST_ASSERT_EQUAL(2, log.getDropped());
+
+    CaptureSink sink;
+    log.flush(sink, 1);
+    log.log(KODAK_LOG_CHUNK, nullptr, 6, 0);
+    TEST_ASSERT_EQUAL(4, log.getPending());
+    TEST_ASSERT_EQUAL(2, log.getDropped());
+}
+
+void test_log_format_packet(void) {
+    KodakLogRecord record;
+    record.timestamp_us = 12345678;
+    record.text = nullptr;
+    record.args[0] = 0x0001000E;
+    record.args[1] = 0x00000000;
+    record.event = KODAK_LOG_PACKET_RX;
+
+    char line[BTP_LOG_LINE_SIZE];
+    size_t len = KodakStepLog::format(record, line, sizeof(line));
+    TEST_ASSERT_EQUAL(strlen(line), len);
+    TEST_ASSERT_EQUAL_STRING("[    12.345678] rx 0001000E 00000000\n", line);
+}
+
 // =============================================================================
 // Constants Tests
 // =============================================================================
@@ -257,6 +562,467 @@ void test_min_battery_constant(void) {
     TEST_ASSERT_EQUAL(30, BTP_MIN_BATTERY_LEVEL);
 }
 
+void test_max_image_size_fits_size_field(void) {
+    TEST_ASSERT_TRUE(BTP_MAX_IMAGE_SIZE <= BTP_SIZE_FIELD_MAX);
+}
+
+// =============================================================================
+// Payload Sizing Tests
+// =============================================================================
+
+void test_targetImageSize_per_model(void) {
+    TEST_ASSERT_EQUAL(BTP_TARGET_IMAGE_SIZE, KodakStepProtocol::targetImageSize(false, 4 * 1024 * 1024));
+    TEST_ASSERT_EQUAL(BTP_TARGET_IMAGE_SIZE_SLIM, KodakStepProtocol::targetImageSize(true, 4 * 1024 * 1024));
+    TEST_ASSERT_EQUAL(BTP_TARGET_IMAGE_SIZE, KodakStepProtocol::targetImageSize(false, 0));
+}
+
+void test_targetImageSize_follows_free_psram(void) {
+    // Half the largest block, floored
+    TEST_ASSERT_EQUAL(200 * 1024, KodakStepProtocol::targetImageSize(false, 400 * 1024));
+    TEST_ASSERT_EQUAL(BTP_MIN_TARGET_IMAGE_SIZE, KodakStepProtocol::targetImageSize(false, 32 * 1024));
+}
+
+// =============================================================================
+// Integrity Tests
+// =============================================================================
+
+void test_crc32_check_value(void) {
+    static const uint8_t digits[9] = {'1', '2', '3', '4', '5', '6', '7', '8', '9'};
+    TEST_ASSERT_EQUAL_HEX32(0xCBF43926, KodakStepProtocol::crc32(0, digits, sizeof(digits)));
+    TEST_ASSERT_EQUAL_HEX32(0, KodakStepProtocol::crc32(0, digits, 0));
+}
+
+void test_crc32_chains_across_chunks(void) {
+    static const uint8_t digits[9] = {'1', '2', '3', '4', '5', '6', '7', '8', '9'};
+    uint32_t crc = KodakStepProtocol::crc32(0, digits, 4);
+    crc = KodakStepProtocol::crc32(crc, &digits[4], 5);
+    TEST_ASSERT_EQUAL_HEX32(0xCBF43926, crc);
+}
+
+void test_hasJpegMarkers(void) {
+    static const uint8_t whole[8] = {0xFF, 0xD8, 1, 2, 3, 4, 0xFF, 0xD9};
+    static const uint8_t padded[8] = {0xFF, 0xD8, 1, 2, 0xFF, 0xD9, 0, 0};
+    static const uint8_t truncated[8] = {0xFF, 0xD8, 1, 2, 3, 4, 5, 6};
+    static const uint8_t noStart[8] = {0x00, 0xD8, 1, 2, 3, 4, 0xFF, 0xD9};
+
+    TEST_ASSERT_TRUE(KodakStepProtocol::hasJpegMarkers(whole, sizeof(whole)));
+    TEST_ASSERT_TRUE(KodakStepProtocol::hasJpegMarkers(padded, sizeof(padded)));
+    TEST_ASSERT_FALSE(KodakStepProtocol::hasJpegMarkers(truncated, sizeof(truncated)));
+    TEST_ASSERT_FALSE(KodakStepProtocol::hasJpegMarkers(noStart, sizeof(noStart)));
+    // SOI alone is not also an EOI
+    TEST_ASSERT_FALSE(KodakStepProtocol::hasJpegMarkers(whole, 2));
+}
+
+void test_hasJpegEnd_within_window(void) {
+    uint8_t tail[BTP_JPEG_EOI_WINDOW] = {0};
+    TEST_ASSERT_FALSE(KodakStepProtocol::hasJpegEnd(tail, sizeof(tail)));
+    tail[0] = 0xFF;
+    tail[1] = 0xD9;
+    TEST_ASSERT_TRUE(KodakStepProtocol::hasJpegEnd(tail, sizeof(tail)));
+}
+
+// =============================================================================
+// Discovery Tests
+// =============================================================================
+
+void test_scoreCandidate_ranks_by_rssi(void) {
+    TEST_ASSERT_TRUE(KodakStepPrinter::scoreCandidate(-55, false) >
+                     KodakStepPrinter::scoreCandidate(-80, false));
+    TEST_ASSERT_TRUE(KodakStepPrinter::scoreCandidate(-55, false) >= BTP_SCAN_STRONG_SCORE);
+    TEST_ASSERT_TRUE(KodakStepPrinter::scoreCandidate(BTP_SCAN_UNKNOWN_RSSI, false) < BTP_SCAN_STRONG_SCORE);
+}
+
+void test_scoreCandidate_prefers_cached_printer(void) {
+    // The known printer wins a near tie, not a clearly stronger link
+    TEST_ASSERT_TRUE(KodakStepPrinter::scoreCandidate(-70, true) >
+                     KodakStepPrinter::scoreCandidate(-65, false));
+    TEST_ASSERT_TRUE(KodakStepPrinter::scoreCandidate(-85, true) <
+                     KodakStepPrinter::scoreCandidate(-60, false));
+}
+
+// =============================================================================
+// Pacing Tests
+// =============================================================================
+
+void test_pacer_fixed_ignores_feedback(void) {
+    KodakStepPacer pacer;
+    pacer.reset(KODAK_PACING_FIXED);
+
+    pacer.onChunkWritten(BTP_CHUNK_SIZE, 100, 1000);
+    pacer.onChunkWritten(BTP_CHUNK_SIZE, BTP_CHUNK_SIZE, 100);
+
+    TEST_ASSERT_EQUAL(BTP_CHUNK_SIZE, pacer.getChunkSize());
+    TEST_ASSERT_EQUAL(BTP_INTER_CHUNK_DELAY_MS, pacer.getDelayMs());
+    TEST_ASSERT_EQUAL(1, pacer.getShortWriteCount());
+}
+
+void test_pacer_adaptive_grows_on_clean_writes(void) {
+    KodakStepPacer pacer;
+    pacer.reset(KODAK_PACING_ADAPTIVE);
+
+    for (int i = 0; i < BTP_PACING_GROW_AFTER; i++) {
+        pacer.onChunkWritten(pacer.getChunkSize(), pacer.getChunkSize(), 500);
+    }
+
+    TEST_ASSERT_EQUAL(BTP_CHUNK_SIZE + BTP_PACING_CHUNK_STEP, pacer.getChunkSize());
+    TEST_ASSERT_TRUE(pacer.getDelayMs() < BTP_INTER_CHUNK_DELAY_MS);
+}
+
+void test_pacer_adaptive_backs_off_on_short_write(void) {
+    KodakStepPacer pacer;
+    pacer.reset(KODAK_PACING_ADAPTIVE);
+
+    pacer.onChunkWritten(BTP_CHUNK_SIZE, 512, 1000);
+
+    TEST_ASSERT_EQUAL(BTP_CHUNK_SIZE / 2, pacer.getChunkSize());
+    TEST_ASSERT_EQUAL(BTP_INTER_CHUNK_DELAY_MS * 2, pacer.getDelayMs());
+    TEST_ASSERT_EQUAL(1, pacer.getShortWriteCount());
+}
+
+void test_pacer_adaptive_drops_delay_when_stalled(void) {
+    KodakStepPacer pacer;
+    pacer.reset(KODAK_PACING_ADAPTIVE);
+
+    pacer.onChunkWritten(BTP_CHUNK_SIZE, BTP_CHUNK_SIZE, BTP_PACING_STALL_US + 1);
+
+    TEST_ASSERT_EQUAL(0, pacer.getDelayMs());
+    TEST_ASSERT_EQUAL(BTP_CHUNK_SIZE - BTP_PACING_CHUNK_STEP, pacer.getChunkSize());
+    TEST_ASSERT_EQUAL(1, pacer.getStallCount());
+}
+
+void test_pacer_adaptive_respects_limits(void) {
+    KodakStepPacer pacer;
+    pacer.reset(KODAK_PACING_ADAPTIVE);
+
+    for (int i = 0; i < 10; i++) {
+        pacer.onChunkWritten(pacer.getChunkSize(), 0, 1000);
+    }
+    TEST_ASSERT_EQUAL(BTP_PACING_MIN_CHUNK_SIZE, pacer.getChunkSize());
+    TEST_ASSERT_EQUAL(BTP_PACING_MAX_DELAY_MS, pacer.getDelayMs());
+
+    for (int i = 0; i < 1000; i++) {
+        pacer.onChunkWritten(pacer.getChunkSize(), pacer.getChunkSize(), 100);
+    }
+    TEST_ASSERT_EQUAL(BTP_PACING_MAX_CHUNK_SIZE, pacer.getChunkSize());
+    TEST_ASSERT_EQUAL(0, pacer.getDelayMs());
+
+    // Halving leaves odd multiples of the step; stalls must still stop at the minimum
+    pacer.reset(KODAK_PACING_ADAPTIVE);
+    pacer.onChunkWritten(pacer.getChunkSize(), pacer.getChunkSize(), BTP_PACING_STALL_US + 1);
+    pacer.onChunkWritten(pacer.getChunkSize(), 0, 1000);
+    for (int i = 0; i < BTP_PACING_GROW_AFTER; i++) {
+        pacer.onChunkWritten(pacer.getChunkSize(), pacer.getChunkSize(), 100);
+    }
+    TEST_ASSERT_EQUAL((BTP_CHUNK_SIZE - BTP_PACING_CHUNK_STEP) / 2 + BTP_PACING_CHUNK_STEP,
+                      pacer.getChunkSize());
+    for (int i = 0; i < 3; i++) {
+        pacer.onChunkWritten(pacer.getChunkSize(), pacer.getChunkSize(), BTP_PACING_STALL_US + 1);
+    }
+    TEST_ASSERT_EQUAL(BTP_PACING_MIN_CHUNK_SIZE, pacer.getChunkSize());
+}
+
+// =============================================================================
+// Image Source Tests
+// =============================================================================
+
+void test_memorySource_is_zero_copy(void) {
+    static const uint8_t image[10] = {0xFF, 0xD8, 2, 3, 4, 5, 6, 7, 0xFF, 0xD9};
+    KodakMemorySource source(image, sizeof(image));
+    const uint8_t* chunk = nullptr;
+
+    TEST_ASSERT_EQUAL(10, source.size());
+    TEST_ASSERT_EQUAL(4, source.next(&chunk, 4));
+    TEST_ASSERT_EQUAL_PTR(&image[0], chunk);
+    TEST_ASSERT_EQUAL(4, source.next(&chunk, 4));
+    TEST_ASSERT_EQUAL_PTR(&image[4], chunk);
+    TEST_ASSERT_EQUAL(2, source.next(&chunk, 4));
+    TEST_ASSERT_EQUAL(0, source.next(&chunk, 4));
+
+    TEST_ASSERT_TRUE(source.rewind());
+    TEST_ASSERT_EQUAL(4, source.next(&chunk, 4));
+    TEST_ASSERT_EQUAL_PTR(&image[0], chunk);
+}
+
+void test_imageSource_expected_crc(void) {
+    static const uint8_t image[4] = {0xFF, 0xD8, 0xFF, 0xD9};
+    KodakMemorySource source(image, sizeof(image));
+    uint32_t crc = 0;
+
+    TEST_ASSERT_EQUAL_PTR(image, source.contiguous());
+    TEST_ASSERT_FALSE(source.getExpectedCrc32(&crc));
+    source.setExpectedCrc32(0x12345678);
+    TEST_ASSERT_TRUE(source.getExpectedCrc32(&crc));
+    TEST_ASSERT_EQUAL_HEX32(0x12345678, crc);
+}
+
+static size_t countingReader(uint8_t* dest, size_t maxLen, void* context) {
+    uint8_t* counter = (uint8_t*)context;
+    for (size_t i = 0; i < maxLen; i++) {
+        dest[i] = (*counter)++;
+    }
+    return maxLen;
+}
+
+void test_callbackSource_limits_to_scratch(void) {
+    uint8_t scratch[8];
+    uint8_t counter = 0;
+    KodakCallbackSource source(100, countingReader, &counter, scratch, sizeof(scratch));
+    const uint8_t* chunk = nullptr;
+
+    TEST_ASSERT_EQUAL(100, source.size());
+    TEST_ASSERT_EQUAL(8, source.next(&chunk, BTP_CHUNK_SIZE));
+    TEST_ASSERT_EQUAL_PTR(scratch, chunk);
+    TEST_ASSERT_EQUAL_HEX8(7, chunk[7]);
+    TEST_ASSERT_FALSE(source.rewind());
+}
+
+void test_scheduler_resend_rewinds_source(void) {
+    static const uint8_t image[10] = {0xFF, 0xD8, 2, 3, 4, 5, 6, 7, 0xFF, 0xD9};
+    KodakMemorySource source(image, sizeof(image));
+    const uint8_t* chunk = nullptr;
+    KodakRequestResult cooling = {KODAK_REQUEST_PRINT, false, BTP_ERR_COOLING, 0, "Cooling"};
+    KodakRequestResult noPaper = {KODAK_REQUEST_PRINT, false, BTP_ERR_NO_PAPER, 0, "No paper"};
+
+    // Cooling reported mid-transfer: the resend starts again at SOI
+    TEST_ASSERT_EQUAL(4, source.next(&chunk, 4));
+    TEST_ASSERT_TRUE(KodakPrintScheduler::shouldResend(cooling, source));
+    TEST_ASSERT_EQUAL(4, source.next(&chunk, 4));
+    TEST_ASSERT_EQUAL_PTR(&image[0], chunk);
+    TEST_ASSERT_FALSE(KodakPrintScheduler::shouldResend(noPaper, source));
+
+    // A stream cannot go back, so the job ends with the printer's error
+    uint8_t scratch[8];
+    uint8_t counter = 0;
+    KodakCallbackSource stream(100, countingReader, &counter, scratch, sizeof(scratch));
+    TEST_ASSERT_EQUAL(8, stream.next(&chunk, BTP_CHUNK_SIZE));
+    TEST_ASSERT_FALSE(KodakPrintScheduler::shouldResend(cooling, stream));
+}
+
+// =============================================================================
+// Task Queue Tests
+// =============================================================================
+
+void test_spscQueue_fifo_and_full(void) {
+    KodakSpscQueue<uint8_t, 4> queue;
+    uint8_t value = 0;
+
+    TEST_ASSERT_FALSE(queue.pop(&value));
+    for (uint8_t i = 1; i <= 4; i++) {
+        TEST_ASSERT_TRUE(queue.push(i));
+    }
+    TEST_ASSERT_FALSE(queue.push(5));
+    TEST_ASSERT_EQUAL(4, queue.size());
+
+    TEST_ASSERT_TRUE(queue.pop(&value));
+    TEST_ASSERT_EQUAL(1, value);
+    TEST_ASSERT_TRUE(queue.push(5));
+    for (uint8_t i = 2; i <= 5; i++) {
+        TEST_ASSERT_TRUE(queue.pop(&value));
+        TEST_ASSERT_EQUAL(i, value);
+    }
+    TEST_ASSERT_TRUE(queue.isEmpty());
+}
+
+void test_spscQueue_reset_limits_depth(void) {
+    KodakSpscQueue<uint16_t, 8> queue;
+    uint16_t value = 0;
+
+    queue.reset(2);
+    TEST_ASSERT_EQUAL(2, queue.capacity());
+    TEST_ASSERT_TRUE(queue.push(10));
+    TEST_ASSERT_TRUE(queue.push(11));
+    TEST_ASSERT_FALSE(queue.push(12));
+
+    // Many laps around the ring keep the order
+    for (uint16_t i = 0; i < 100; i++) {
+        TEST_ASSERT_TRUE(queue.pop(&value));
+        TEST_ASSERT_EQUAL(10 + i, value);
+        TEST_ASSERT_TRUE(queue.push(12 + i));
+    }
+
+    queue.reset(0);
+    TEST_ASSERT_EQUAL(8, queue.capacity());
+    TEST_ASSERT_TRUE(queue.isEmpty());
+}
+
+// =============================================================================
+// Job Arena Tests
+// =============================================================================
+
+// Small regions so the tests can fill them: 4 PSRAM blocks, 4 internal blocks
+static const size_t TEST_ARENA_PSRAM = 4 * BTP_ARENA_PSRAM_BLOCK;
+static const size_t TEST_ARENA_INTERNAL = 4 * BTP_ARENA_INTERNAL_BLOCK;
+
+void test_arena_allocate_tracks_high_water(void) {
+    KodakJobArena arena;
+    TEST_ASSERT_TRUE(arena.begin(TEST_ARENA_PSRAM, TEST_ARENA_INTERNAL));
+
+    void* a = arena.allocate(BTP_ARENA_PSRAM_BLOCK + 1);
+    void* b = arena.allocate(1);
+    TEST_ASSERT_NOT_NULL(a);
+    TEST_ASSERT_NOT_NULL(b);
+    TEST_ASSERT_TRUE(arena.owns(a));
+
+    KodakArenaStats stats = arena.getStats(KODAK_ARENA_PSRAM);
+    TEST_ASSERT_EQUAL(3 * BTP_ARENA_PSRAM_BLOCK, stats.in_use);
+    TEST_ASSERT_EQUAL(BTP_ARENA_PSRAM_BLOCK, stats.largest_free);
+
+    arena.release(a);
+    arena.release(b);
+    stats = arena.getStats(KODAK_ARENA_PSRAM);
+    TEST_ASSERT_EQUAL(0, stats.in_use);
+    TEST_ASSERT_EQUAL(3 * BTP_ARENA_PSRAM_BLOCK, stats.high_water);
+    TEST_ASSERT_EQUAL(TEST_ARENA_PSRAM, stats.largest_free);
+}
+
+void test_arena_first_fit_reuses_freed_run(void) {
+    KodakJobArena arena;
+    TEST_ASSERT_TRUE(arena.begin(TEST_ARENA_PSRAM, TEST_ARENA_INTERNAL));
+
+    uint8_t* a = (uint8_t*)arena.allocate(BTP_ARENA_PSRAM_BLOCK);
+    uint8_t* b = (uint8_t*)arena.allocate(BTP_ARENA_PSRAM_BLOCK);
+    TEST_ASSERT_EQUAL_PTR(a + BTP_ARENA_PSRAM_BLOCK, b);
+
+    arena.release(a);
+    TEST_ASSERT_EQUAL_PTR(a, arena.allocate(10));
+    // Too long for the hole at the front; goes after b
+    TEST_ASSERT_EQUAL_PTR(b + BTP_ARENA_PSRAM_BLOCK, arena.allocate(2 * BTP_ARENA_PSRAM_BLOCK));
+}
+
+void test_arena_shrink_returns_tail(void) {
+    KodakJobArena arena;
+    TEST_ASSERT_TRUE(arena.begin(TEST_ARENA_PSRAM, TEST_ARENA_INTERNAL));
+
+    uint8_t* a = (uint8_t*)arena.allocate(TEST_ARENA_PSRAM);
+    TEST_ASSERT_NOT_NULL(a);
+    TEST_ASSERT_TRUE(arena.shrink(a, 100));
+    TEST_ASSERT_FALSE(arena.shrink(a, 100));
+    TEST_ASSERT_EQUAL(BTP_ARENA_PSRAM_BLOCK, arena.getStats(KODAK_ARENA_PSRAM).in_use);
+    TEST_ASSERT_EQUAL_PTR(a + BTP_ARENA_PSRAM_BLOCK, arena.allocate(3 * BTP_ARENA_PSRAM_BLOCK));
+}
+
+void test_arena_full_fails_without_heap_fallback(void) {
+    KodakJobArena arena;
+    TEST_ASSERT_TRUE(arena.begin(TEST_ARENA_PSRAM, TEST_ARENA_INTERNAL));
+
+    void* internal = arena.allocate(TEST_ARENA_INTERNAL, KODAK_ARENA_INTERNAL);
+    TEST_ASSERT_NOT_NULL(internal);
+    TEST_ASSERT_NULL(arena.allocate(1, KODAK_ARENA_INTERNAL));
+    TEST_ASSERT_NULL(arena.allocate(TEST_ARENA_PSRAM + 1));
+    TEST_ASSERT_EQUAL(1, arena.getStats(KODAK_ARENA_INTERNAL).failures);
+
+    // releaseAny() sorts arena pointers from heap ones
+    void* heap = heap_caps_malloc(16, MALLOC_CAP_8BIT);
+    TEST_ASSERT_FALSE(arena.owns(heap));
+    KodakJobArena::releaseAny(heap);
+    KodakJobArena::releaseAny(internal);
+    TEST_ASSERT_EQUAL(0, arena.getStats(KODAK_ARENA_INTERNAL).in_use);
+}
+
+// =============================================================================
+// Engine Tests
+// =============================================================================
+
+// Answers each status query the way a STEP printer does, and can slip a
+// print-finished report in ahead of the accessory info reply
+class FakePrinterLink : public Stream {
+public:
+    bool reportFirst = false;
+    int acks = 0;
+
+    int available() override { return (int)(rxLen - rxPos); }
+    int read() override { return rxPos < rxLen ? rx[rxPos++] : -1; }
+    int peek() override { return rxPos < rxLen ? rx[rxPos] : -1; }
+    size_t write(uint8_t byte) override { return write(&byte, 1); }
+
+    size_t write(const uint8_t* data, size_t length) override {
+        for (size_t i = 0; i < length; i++) {
+            frame[frameLen++] = data[i];
+            if (frameLen == BTP_PACKET_SIZE) {
+                frameLen = 0;
+                handleCommand();
+            }
+        }
+        return length;
+    }
+
+private:
+    uint8_t rx[BTP_PACKET_SIZE * 8];
+    size_t rxLen = 0;
+    size_t rxPos = 0;
+    uint8_t frame[BTP_PACKET_SIZE];
+    size_t frameLen = 0;
+    bool ackDue = false;
+
+    uint8_t* reply(uint8_t type, uint8_t subType, uint8_t errorCode) {
+        uint8_t* out = &rx[rxLen];
+        memset(out, 0, BTP_PACKET_SIZE);
+        out[0] = BTP_START_1;
+        out[1] = BTP_START_2;
+        out[2] = BTP_IDENT_1;
+        out[3] = BTP_IDENT_2;
+        out[6] = type;
+        out[7] = subType;
+        out[8] = errorCode;
+        rxLen += BTP_PACKET_SIZE;
+        return out;
+    }
+
+    void handleCommand() {
+        switch (frame[6]) {
+            case BTP_CMD_GET_ACCESSORY_INFO:
+                // The report's ack carries the same command bytes
+                if (ackDue) {
+                    ackDue = false;
+                    acks++;
+                    return;
+                }
+                if (reportFirst) {
+                    reportFirst = false;
+                    ackDue = true;
+                    reply(0x01, 0x00, BTP_ERR_SUCCESS);
+                }
+                reply(BTP_RESP_ACCESSORY_INFO, 0x02, BTP_ERR_SUCCESS)[12] = 73;
+                break;
+            case BTP_CMD_GET_BATTERY_LEVEL:
+                reply(BTP_RESP_CHARGING_STATUS, 0x00, 1);
+                break;
+            case BTP_CMD_GET_PAGE_TYPE:
+                reply(BTP_RESP_PAGE_TYPE, 0x00, BTP_ERR_SUCCESS);
+                break;
+            case BTP_CMD_PRINT_READY: {
+                uint8_t* count = reply(BTP_CMD_PRINT_READY, 0x01, 0x00);
+                count[8] = 0x01;
+                count[9] = 0x41;
+                break;
+            }
+            case BTP_CMD_GET_AUTO_POWER_OFF:
+                reply(BTP_RESP_AUTO_POWER_OFF, 0x00, 10);
+                break;
+        }
+    }
+};
+
+void test_refreshStatus_acks_print_finished_report(void) {
+    static KodakStepPrinter printer;
+    FakePrinterLink link;
+    link.reportFirst = true;
+
+    printer.attachLink(link);
+    TEST_ASSERT_TRUE(printer.refreshStatus());
+
+    // The report is acked and every slot still gets its own reply
+    KodakStepProtocol::PrinterStatus status = printer.getStatus();
+    TEST_ASSERT_EQUAL(1, link.acks);
+    TEST_ASSERT_EQUAL(KODAK_EVENT_PRINT_FINISHED, printer.getLastEvent());
+    TEST_ASSERT_EQUAL(73, status.battery_level);
+    TEST_ASSERT_TRUE(status.is_charging);
+    TEST_ASSERT_EQUAL(321, status.print_count);
+    TEST_ASSERT_EQUAL(10, status.auto_power_off_minutes);
+    TEST_ASSERT_EQUAL(BTP_ERR_SUCCESS, status.error_code);
+    printer.detachLink();
+}
+
 // =============================================================================
 // Main
 // =============================================================================
@@ -278,6 +1044,8 @@ void setup() {
     RUN_TEST(test_buildStartOfSendAck);
     RUN_TEST(test_buildEndOfReceivedAck);
     RUN_TEST(test_buildErrorMessageAck);
+    RUN_TEST(test_packetTemplates_have_header_and_zero_tail);
+    RUN_TEST(test_packetTemplate_matches_builder);
 
     // Response parsing tests
     RUN_TEST(test_parseResponse_success);
@@ -285,16 +1053,85 @@ void setup() {
     RUN_TEST(test_parseResponse_invalid_header);
     RUN_TEST(test_parsePrintCount);
     RUN_TEST(test_parseAutoPowerOff);
+    RUN_TEST(test_responseView_reads_in_place);
+    RUN_TEST(test_responseView_invalid_header);
+    RUN_TEST(test_responseView_status_fields);
+
+    // Frame assembler tests
+    RUN_TEST(test_frameAssembler_whole_frame);
+    RUN_TEST(test_frameAssembler_split_and_stops_at_frame_end);
+    RUN_TEST(test_frameAssembler_resyncs_on_header);
 
     // Error string tests
     RUN_TEST(test_getErrorString_success);
     RUN_TEST(test_getErrorString_no_paper);
     RUN_TEST(test_getErrorString_unknown);
+    RUN_TEST(test_classifyError);
+
+    // Printer message tests
+    RUN_TEST(test_classifyMessage_printer_events);
+    RUN_TEST(test_classifyMessage_ignores_replies);
+    RUN_TEST(test_buildEventAck_matches_message);
+
+    // Status cache tests
+    RUN_TEST(test_isFresh_within_ttl);
+    RUN_TEST(test_isFresh_disabled_or_uncached);
+    RUN_TEST(test_isFresh_across_millis_wrap);
+
+    // Metrics tests
+    RUN_TEST(test_rttBucket_boundaries);
+    RUN_TEST(test_metrics_recordChunk_counts_short_writes);
+
+    // Trace log tests
+    RUN_TEST(test_log_flushes_in_order);
+    RUN_TEST(test_log_drops_when_full);
+    RUN_TEST(test_log_format_packet);
 
     // Constants tests
     RUN_TEST(test_packet_size_constant);
     RUN_TEST(test_chunk_size_constant);
     RUN_TEST(test_min_battery_constant);
+    RUN_TEST(test_max_image_size_fits_size_field);
+
+    // Payload sizing tests
+    RUN_TEST(test_targetImageSize_per_model);
+    RUN_TEST(test_targetImageSize_follows_free_psram);
+
+    // Integrity tests
+    RUN_TEST(test_crc32_check_value);
+    RUN_TEST(test_crc32_chains_across_chunks);
+    RUN_TEST(test_hasJpegMarkers);
+    RUN_TEST(test_hasJpegEnd_within_window);
+
+    // Discovery tests
+    RUN_TEST(test_scoreCandidate_ranks_by_rssi);
+    RUN_TEST(test_scoreCandidate_prefers_cached_printer);
+
+    // Pacing tests
+    RUN_TEST(test_pacer_fixed_ignores_feedback);
+    RUN_TEST(test_pacer_adaptive_grows_on_clean_writes);
+    RUN_TEST(test_pacer_adaptive_backs_off_on_short_write);
+    RUN_TEST(test_pacer_adaptive_drops_delay_when_stalled);
+    RUN_TEST(test_pacer_adaptive_respects_limits);
+
+    // Image source tests
+    RUN_TEST(test_memorySource_is_zero_copy);
+    RUN_TEST(test_imageSource_expected_crc);
+    RUN_TEST(test_callbackSource_limits_to_scratch);
+    RUN_TEST(test_scheduler_resend_rewinds_source);
+
+    // Task queue tests
+    RUN_TEST(test_spscQueue_fifo_and_full);
+    RUN_TEST(test_spscQueue_reset_limits_depth);
+
+    // Job arena tests
+    RUN_TEST(test_arena_allocate_tracks_high_water);
+    RUN_TEST(test_arena_first_fit_reuses_freed_run);
+    RUN_TEST(test_arena_shrink_returns_tail);
+    RUN_TEST(test_arena_full_fails_without_heap_fallback);
+
+    // Engine tests
+    RUN_TEST(test_refreshStatus_acks_print_finished_report);
 
     UNITY_END();
 }
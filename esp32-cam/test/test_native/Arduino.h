@@ -0,0 +1,90 @@
+/**
+ * Minimal Arduino shim for the native test environment
+ *
+ * Just enough of the core for the hardware-independent parts of the library
+ * (protocol, frame assembler, pacing, image sources, metrics) to build on
+ * the host: integer types, Print/Stream, Serial on stdout and a monotonic
+ * millis()/micros(). Nothing Bluetooth or FreeRTOS related lives here.
+ */
+
+#ifndef NATIVE_ARDUINO_SHIM_H
+#define NATIVE_ARDUINO_SHIM_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define HEX 16
+#define DEC 10
+
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+void yield();
+
+// Functions rather than the core's macros so <chrono> and friends still compile
+template <typename T>
+T min(T a, T b) { return (a < b) ? a : b; }
+template <typename T>
+T max(T a, T b) { return (a > b) ? a : b; }
+
+class Print {
+public:
+    virtual ~Print() {}
+
+    virtual size_t write(uint8_t c) = 0;
+    virtual size_t write(const uint8_t* buffer, size_t size) {
+        size_t n = 0;
+        while (size-- > 0 && write(*buffer++) == 1) {
+            n++;
+        }
+        return n;
+    }
+
+    size_t print(const char* str) { return write((const uint8_t*)str, strlen(str)); }
+    size_t print(char c) { return write((uint8_t)c); }
+    size_t print(unsigned long value, int base = DEC);
+    size_t print(long value, int base = DEC);
+    size_t print(unsigned int value, int base = DEC) { return print((unsigned long)value, base); }
+    size_t print(int value, int base = DEC) { return print((long)value, base); }
+    size_t print(unsigned char value, int base = DEC) { return print((unsigned long)value, base); }
+
+    size_t println() { return print("\n"); }
+    template <typename T>
+    size_t println(T value) { return print(value) + println(); }
+    template <typename T>
+    size_t println(T value, int base) { return print(value, base) + println(); }
+};
+
+class Stream : public Print {
+public:
+    Stream() : timeoutMs(1000) {}
+
+    virtual int available() = 0;
+    virtual int read() = 0;
+
+    void setTimeout(unsigned long ms) { timeoutMs = ms; }
+
+    // Like the Arduino core: waits up to the timeout for each byte
+    size_t readBytes(uint8_t* buffer, size_t length);
+
+protected:
+    unsigned long timeoutMs;
+};
+
+class NativeSerial : public Stream {
+public:
+    void begin(unsigned long) {}
+    void flush() { fflush(stdout); }
+
+    size_t write(uint8_t c) override { return fputc(c, stdout) == EOF ? 0 : 1; }
+    size_t write(const uint8_t* buffer, size_t size) override { return fwrite(buffer, 1, size, stdout); }
+    int available() override { return 0; }
+    int read() override { return -1; }
+};
+
+extern NativeSerial Serial;
+
+#endif // NATIVE_ARDUINO_SHIM_H
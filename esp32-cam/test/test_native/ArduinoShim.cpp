@@ -0,0 +1,54 @@
+#include <Arduino.h>
+#include <chrono>
+#include <thread>
+
+NativeSerial Serial;
+
+static const std::chrono::steady_clock::time_point bootTime = std::chrono::steady_clock::now();
+
+unsigned long micros() {
+    return (unsigned long)std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - bootTime).count();
+}
+
+unsigned long millis() {
+    return micros() / 1000;
+}
+
+void delay(unsigned long ms) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+}
+
+void yield() {
+    std::this_thread::yield();
+}
+
+size_t Print::print(unsigned long value, int base) {
+    char buffer[24];
+    snprintf(buffer, sizeof(buffer), (base == HEX) ? "%lX" : "%lu", value);
+    return print(buffer);
+}
+
+size_t Print::print(long value, int base) {
+    if (base == HEX) {
+        return print((unsigned long)value, base);
+    }
+    char buffer[24];
+    snprintf(buffer, sizeof(buffer), "%ld", value);
+    return print(buffer);
+}
+
+size_t Stream::readBytes(uint8_t* buffer, size_t length) {
+    size_t count = 0;
+    unsigned long start = millis();
+    while (count < length && millis() - start < timeoutMs) {
+        int c = read();
+        if (c < 0) {
+            yield();
+            continue;
+        }
+        buffer[count++] = (uint8_t)c;
+        start = millis();
+    }
+    return count;
+}
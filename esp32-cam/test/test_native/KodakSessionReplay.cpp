@@ -0,0 +1,246 @@
+#include "KodakSessionReplay.h"
+
+KodakSessionReplay::KodakSessionReplay() {
+    overwritten = 0;
+}
+
+void KodakSessionReplay::clear() {
+    records.clear();
+    exchanges.clear();
+    prints.clear();
+    overwritten = 0;
+}
+
+bool KodakSessionReplay::load(const uint8_t* data, size_t length) {
+    clear();
+
+    KodakSessionHeader header;
+    if (data == nullptr || length < sizeof(header)) {
+        return false;
+    }
+    memcpy(&header, data, sizeof(header));
+    if (header.magic != BTP_SESSION_MAGIC || header.version != BTP_SESSION_VERSION ||
+        header.record_size != sizeof(KodakSessionRecord) ||
+        length < sizeof(header) + (size_t)header.record_count * sizeof(KodakSessionRecord)) {
+        return false;
+    }
+
+    records.resize(header.record_count);
+    if (header.record_count > 0) {
+        memcpy(&records[0], data + sizeof(header), header.record_count * sizeof(KodakSessionRecord));
+    }
+    overwritten = header.overwritten;
+    buildScript();
+    return true;
+}
+
+bool KodakSessionReplay::loadFile(const char* path) {
+    clear();
+
+    FILE* file = fopen(path, "rb");
+    if (file == nullptr) {
+        return false;
+    }
+    std::vector<uint8_t> contents;
+    uint8_t buffer[4096];
+    size_t got;
+    while ((got = fread(buffer, 1, sizeof(buffer), file)) > 0) {
+        contents.insert(contents.end(), buffer, buffer + got);
+    }
+    fclose(file);
+
+    if (contents.size() >= sizeof(KodakSessionHeader)) {
+        uint32_t magic;
+        memcpy(&magic, &contents[0], sizeof(magic));
+        if (magic == BTP_SESSION_MAGIC) {
+            return load(&contents[0], contents.size());
+        }
+    }
+
+    // Otherwise a Serial capture with an exportHex() block somewhere in it
+    contents.push_back('\0');
+    std::vector<uint8_t> bytes;
+    if (!decodeHex((const char*)&contents[0], &bytes) || bytes.empty()) {
+        return false;
+    }
+    return load(&bytes[0], bytes.size());
+}
+
+bool KodakSessionReplay::decodeHex(const char* text, std::vector<uint8_t>* bytes) {
+    const char* begin = strstr(text, BTP_SESSION_HEX_BEGIN);
+    if (begin == nullptr) {
+        return false;
+    }
+    const char* end = strstr(begin, BTP_SESSION_HEX_END);
+    if (end == nullptr) {
+        return false;   // Cut off before the end of the block
+    }
+
+    bytes->clear();
+    int high = -1;
+    for (const char* p = begin + strlen(BTP_SESSION_HEX_BEGIN); p < end; p++) {
+        int digit;
+        if (*p >= '0' && *p <= '9') {
+            digit = *p - '0';
+        } else if (*p >= 'a' && *p <= 'f') {
+            digit = *p - 'a' + 10;
+        } else if (*p >= 'A' && *p <= 'F') {
+            digit = *p - 'A' + 10;
+        } else {
+            continue;   // Line breaks, carriage returns from the monitor
+        }
+        if (high < 0) {
+            high = digit;
+        } else {
+            bytes->push_back((uint8_t)((high << 4) | digit));
+            high = -1;
+        }
+    }
+    return high < 0;
+}
+
+// =============================================================================
+// Script
+// =============================================================================
+
+void KodakSessionReplay::buildScript() {
+    std::vector<size_t> waiting;        // Exchanges sent and not answered yet, oldest first
+    uint32_t transferStartedAt = 0;
+    uint32_t lastChunkAt = 0;
+    bool haveChunk = false;
+
+    for (size_t i = 0; i < records.size(); i++) {
+        const KodakSessionRecord& record = records[i];
+
+        // The engine gives up on a reply after BTP_COMMAND_TIMEOUT_MS
+        while (!waiting.empty() &&
+               record.timestamp_us - exchanges[waiting.front()].latency_us >
+                   (uint32_t)BTP_COMMAND_TIMEOUT_MS * 1000) {
+            exchanges[waiting.front()].latency_us = 0;
+            waiting.erase(waiting.begin());
+        }
+
+        switch (record.event) {
+            case KODAK_SESSION_TX: {
+                KodakReplayExchange exchange;
+                KodakSessionRecorder::unpackFrame(record, exchange.command);
+                memset(exchange.reply, 0, sizeof(exchange.reply));
+                exchange.has_reply = false;
+                exchange.latency_us = record.timestamp_us;  // Send time until the reply arrives
+                exchanges.push_back(exchange);
+                waiting.push_back(exchanges.size() - 1);
+                break;
+            }
+
+            case KODAK_SESSION_RX: {
+                uint8_t frame[BTP_PACKET_SIZE];
+                KodakSessionRecorder::unpackFrame(record, frame);
+                KodakPrinterEvent event = KodakStepProtocol::classifyMessage(frame);
+
+                // A START_OF_SEND while PRINT_READY is outstanding answers it
+                bool isReply = event == KODAK_EVENT_NONE;
+                if (event == KODAK_EVENT_START_OF_SEND && !waiting.empty()) {
+                    const uint8_t* command = exchanges[waiting.front()].command;
+                    isReply = command[6] == BTP_CMD_PRINT_READY && command[7] == 0x00;
+                }
+
+                if (isReply && !waiting.empty()) {
+                    KodakReplayExchange& exchange = exchanges[waiting.front()];
+                    memcpy(exchange.reply, frame, BTP_PACKET_SIZE);
+                    exchange.has_reply = true;
+                    exchange.latency_us = record.timestamp_us - exchange.latency_us;
+                    waiting.erase(waiting.begin());
+                } else if (event == KODAK_EVENT_DATA_ACCEPTED && haveChunk && !prints.empty() &&
+                           prints.back().accept_us == 0) {
+                    prints.back().accept_us = record.timestamp_us - lastChunkAt;
+                }
+                break;
+            }
+
+            case KODAK_SESSION_PRINT: {
+                KodakReplayPrint print;
+                memset(&print, 0, sizeof(print));
+                print.image_size = record.args[0];
+                print.copies = (uint8_t)record.args[1];
+                prints.push_back(print);
+                haveChunk = false;
+                break;
+            }
+
+            case KODAK_SESSION_CHUNK: {
+                if (prints.empty()) {
+                    break;
+                }
+                KodakReplayPrint& print = prints.back();
+                if (!haveChunk) {
+                    transferStartedAt = record.timestamp_us - record.args[1];
+                    haveChunk = true;
+                }
+                print.chunks++;
+                print.bytes_sent += record.args[0];
+                if (record.args[0] < record.length) {
+                    print.short_writes++;
+                }
+                lastChunkAt = record.timestamp_us;
+                print.transfer_us = lastChunkAt - transferStartedAt;
+                print.bytes_per_sec = (print.transfer_us > 0)
+                    ? (uint32_t)((uint64_t)print.bytes_sent * 1000000 / print.transfer_us) : 0;
+                break;
+            }
+
+            case KODAK_SESSION_DONE:
+                if (!prints.empty()) {
+                    prints.back().success = record.args[0] != 0;
+                    prints.back().error_code = (uint8_t)record.args[1];
+                }
+                break;
+
+            default:
+                break;  // Acks: the printer does not answer them
+        }
+    }
+
+    // Still waiting when the trace ends: no reply was recorded
+    for (size_t i = 0; i < waiting.size(); i++) {
+        exchanges[waiting[i]].latency_us = 0;
+    }
+}
+
+// =============================================================================
+// Accessors
+// =============================================================================
+
+size_t KodakSessionReplay::getRecordCount() const {
+    return records.size();
+}
+
+uint32_t KodakSessionReplay::getOverwritten() const {
+    return overwritten;
+}
+
+const KodakSessionRecord& KodakSessionReplay::getRecord(size_t index) const {
+    return records[index];
+}
+
+size_t KodakSessionReplay::getExchangeCount() const {
+    return exchanges.size();
+}
+
+const KodakReplayExchange& KodakSessionReplay::getExchange(size_t index) const {
+    return exchanges[index];
+}
+
+size_t KodakSessionReplay::getPrintCount() const {
+    return prints.size();
+}
+
+const KodakReplayPrint& KodakSessionReplay::getPrint(size_t index) const {
+    return prints[index];
+}
+
+uint32_t KodakSessionReplay::getDurationUs() const {
+    if (records.empty()) {
+        return 0;
+    }
+    return records.back().timestamp_us - records.front().timestamp_us;
+}
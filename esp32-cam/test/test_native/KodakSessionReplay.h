@@ -0,0 +1,80 @@
+#ifndef KODAK_SESSION_REPLAY_H
+#define KODAK_SESSION_REPLAY_H
+
+#include <Arduino.h>
+#include <KodakStepProtocol.h>
+#include <KodakSessionRecorder.h>
+#include <vector>
+
+// One command from the trace and what the printer did about it
+struct KodakReplayExchange {
+    uint8_t command[BTP_PACKET_SIZE];   // Bytes 6-13 as sent, header restored
+    uint8_t reply[BTP_PACKET_SIZE];
+    bool has_reply;                     // False: the printer never answered
+    uint32_t latency_us;                // Command sent to reply complete
+};
+
+// One image transfer from the trace
+struct KodakReplayPrint {
+    uint32_t image_size;
+    uint8_t copies;
+    uint32_t bytes_sent;
+    uint32_t chunks;
+    uint32_t short_writes;
+    uint32_t transfer_us;               // First chunk write() entered to last returned
+    uint32_t bytes_per_sec;             // Sustained by the link; a lower bound on its capacity
+    uint32_t accept_us;                 // Last chunk to END_OF_RECEIVED; 0 if none was recorded
+    bool success;
+    uint8_t error_code;
+};
+
+/**
+ * Reads a KodakSessionRecorder trace and turns it into a script for the
+ * simulator
+ *
+ * Commands are paired with replies in the order they went out, as the
+ * printer answers them: a pipelined status batch sends three and gets three
+ * back. Printer-initiated messages (KodakStepProtocol::classifyMessage())
+ * and the acks to them are not exchanges. END_OF_RECEIVED sets accept_us
+ * on the transfer before it.
+ *
+ * KodakStepSimulator::setReplay() answers each command with the recorded
+ * reply after the recorded latency. It drains each image at the rate the
+ * field session achieved, so a slow session can be run again against other
+ * pacing or scheduling code.
+ */
+class KodakSessionReplay {
+public:
+    KodakSessionReplay();
+
+    // Binary trace (exportTo())
+    bool load(const uint8_t* data, size_t length);
+    // Binary trace, or a Serial log with an exportHex() block in it
+    bool loadFile(const char* path);
+    void clear();
+
+    size_t getRecordCount() const;
+    uint32_t getOverwritten() const;
+    const KodakSessionRecord& getRecord(size_t index) const;
+
+    size_t getExchangeCount() const;
+    const KodakReplayExchange& getExchange(size_t index) const;
+    size_t getPrintCount() const;
+    const KodakReplayPrint& getPrint(size_t index) const;
+
+    // Trace start to its last record
+    uint32_t getDurationUs() const;
+
+    // Hex lines between BTP_SESSION_HEX_BEGIN and BTP_SESSION_HEX_END, back to bytes
+    static bool decodeHex(const char* text, std::vector<uint8_t>* bytes);
+
+private:
+    std::vector<KodakSessionRecord> records;
+    std::vector<KodakReplayExchange> exchanges;
+    std::vector<KodakReplayPrint> prints;
+    uint32_t overwritten;
+
+    void buildScript();
+};
+
+#endif // KODAK_SESSION_REPLAY_H
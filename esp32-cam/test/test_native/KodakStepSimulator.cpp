@@ -0,0 +1,385 @@
+#include "KodakStepSimulator.h"
+#include "KodakSessionReplay.h"
+#include <chrono>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#define SIM_POLL_INTERVAL_MS 20
+#define SIM_READ_SIZE 4096
+
+KodakSimConfig::KodakSimConfig() {
+    latency_ms = 0;
+    bandwidth_bytes_per_sec = 0;
+    battery_level = 80;
+    is_charging = false;
+    print_count = 0;
+    auto_power_off_minutes = 5;
+    paper_error = BTP_ERR_SUCCESS;
+    drop_reply_percent = 0;
+    corrupt_reply_percent = 0;
+    seed = 1;
+}
+
+KodakStepSimulator::KodakStepSimulator() {
+    fds[0] = -1;
+    fds[1] = -1;
+    running = false;
+    rngState = 1;
+    replay = nullptr;
+    replayExchange = 0;
+    replayPrint = 0;
+    commands = 0;
+    repliesDropped = 0;
+    repliesCorrupted = 0;
+    imageBytes = 0;
+    prints = 0;
+    imageCrc = 0;
+    replayed = 0;
+}
+
+KodakStepSimulator::~KodakStepSimulator() {
+    stop();
+}
+
+bool KodakStepSimulator::start(const KodakSimConfig& simConfig) {
+    stop();
+
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) != 0) {
+        return false;
+    }
+
+    int bufferSize = SIM_SOCKET_BUFFER_SIZE;
+    for (int i = 0; i < 2; i++) {
+        setsockopt(fds[i], SOL_SOCKET, SO_SNDBUF, &bufferSize, sizeof(bufferSize));
+        setsockopt(fds[i], SOL_SOCKET, SO_RCVBUF, &bufferSize, sizeof(bufferSize));
+    }
+    // Host writes never block, so a full link surfaces as a short write
+    fcntl(fds[0], F_SETFL, fcntl(fds[0], F_GETFL) | O_NONBLOCK);
+
+    config = simConfig;
+    rngState = config.seed != 0 ? config.seed : 1;
+    commands = 0;
+    repliesDropped = 0;
+    repliesCorrupted = 0;
+    imageBytes = 0;
+    prints = 0;
+    imageCrc = 0;
+    replayed = 0;
+    replayExchange = 0;
+    replayPrint = 0;
+
+    running = true;
+    thread = std::thread(&KodakStepSimulator::run, this);
+    return true;
+}
+
+void KodakStepSimulator::stop() {
+    running = false;
+    if (thread.joinable()) {
+        thread.join();
+    }
+    for (int i = 0; i < 2; i++) {
+        if (fds[i] >= 0) {
+            close(fds[i]);
+            fds[i] = -1;
+        }
+    }
+}
+
+void KodakStepSimulator::setReplay(const KodakSessionReplay* sessionReplay) {
+    replay = sessionReplay;
+}
+
+int KodakStepSimulator::hostFd() const {
+    return fds[0];
+}
+
+KodakSimStats KodakStepSimulator::getStats() const {
+    KodakSimStats stats;
+    stats.commands = commands;
+    stats.replies_dropped = repliesDropped;
+    stats.replies_corrupted = repliesCorrupted;
+    stats.image_bytes = imageBytes;
+    stats.prints = prints;
+    stats.image_crc32 = imageCrc;
+    stats.replayed = replayed;
+    return stats;
+}
+
+bool KodakStepSimulator::waitForPrint(uint32_t count, uint32_t timeoutMs) {
+    unsigned long start = millis();
+    while (prints < count) {
+        if (millis() - start >= timeoutMs) {
+            return false;
+        }
+        delay(1);
+    }
+    return true;
+}
+
+// =============================================================================
+// Printer thread
+// =============================================================================
+
+void KodakStepSimulator::run() {
+    KodakFrameAssembler assembler;
+    uint8_t buffer[SIM_READ_SIZE];
+
+    while (running) {
+        struct pollfd pfd = {fds[1], POLLIN, 0};
+        if (poll(&pfd, 1, SIM_POLL_INTERVAL_MS) <= 0) {
+            continue;
+        }
+
+        ssize_t len = recv(fds[1], buffer, sizeof(buffer), 0);
+        if (len <= 0) {
+            break;  // Host closed its end
+        }
+
+        size_t offset = 0;
+        while (offset < (size_t)len && running) {
+            offset += assembler.feed(buffer + offset, len - offset);
+            if (!assembler.hasFrame()) {
+                continue;
+            }
+
+            uint32_t imageSize = handleCommand(assembler.frame());
+            assembler.reset();
+            if (imageSize > 0) {
+                // Anything after PRINT_READY in this read is already image data
+                receiveImage(imageSize, buffer + offset, len - offset);
+                offset = len;
+            }
+        }
+    }
+}
+
+uint32_t KodakStepSimulator::handleCommand(const uint8_t* command) {
+    uint8_t reply[BTP_PACKET_SIZE];
+    commands++;
+
+    uint32_t imageSize = 0;
+    if (replayCommand(command, &imageSize)) {
+        return imageSize;
+    }
+
+    switch (command[6]) {
+        case BTP_CMD_GET_ACCESSORY_INFO:
+            initReply(reply, BTP_RESP_ACCESSORY_INFO, 0x02, BTP_ERR_SUCCESS);
+            reply[12] = config.battery_level;
+            break;
+
+        case BTP_CMD_GET_BATTERY_LEVEL:
+            initReply(reply, BTP_RESP_CHARGING_STATUS, 0x00, config.is_charging ? 1 : 0);
+            break;
+
+        case BTP_CMD_GET_PAGE_TYPE:
+            initReply(reply, BTP_RESP_PAGE_TYPE, 0x00, config.paper_error);
+            break;
+
+        case BTP_CMD_GET_AUTO_POWER_OFF:
+            initReply(reply, BTP_RESP_AUTO_POWER_OFF, 0x00, config.auto_power_off_minutes);
+            break;
+
+        case BTP_CMD_PRINT_READY:
+            if (command[7] == 0x01) {
+                // GET_PRINT_COUNT shares the command byte; count is big-endian in bytes 8-9
+                initReply(reply, BTP_CMD_PRINT_READY, 0x01, 0x00);
+                reply[8] = config.print_count >> 8;
+                reply[9] = config.print_count & 0xFF;
+                break;
+            }
+            {
+                uint8_t error = config.paper_error;
+                if (error == BTP_ERR_SUCCESS && config.battery_level < BTP_MIN_BATTERY_LEVEL) {
+                    error = BTP_ERR_LOW_BATTERY;
+                }
+                initReply(reply, BTP_CMD_PRINT_READY, 0x00, error);
+                sendReply(reply);
+                uint32_t size = ((uint32_t)command[8] << 16) | ((uint32_t)command[9] << 8) | command[10];
+                return (error == BTP_ERR_SUCCESS) ? size : 0;
+            }
+
+        default:
+            initReply(reply, command[6], command[7], BTP_ERR_BUSY);
+            break;
+    }
+
+    sendReply(reply);
+    return 0;
+}
+
+bool KodakStepSimulator::replayCommand(const uint8_t* command, uint32_t* imageSize) {
+    if (replay == nullptr) {
+        return false;
+    }
+
+    // Next recorded exchange for this command; exchanges in between are skipped
+    for (size_t i = replayExchange; i < replay->getExchangeCount(); i++) {
+        const KodakReplayExchange& exchange = replay->getExchange(i);
+        if (exchange.command[6] != command[6] || exchange.command[7] != command[7]) {
+            continue;
+        }
+        replayExchange = i + 1;
+        replayed++;
+
+        if (!exchange.has_reply) {
+            repliesDropped++;
+            return true;
+        }
+        sendAfter(exchange.reply, exchange.latency_us);
+
+        bool printReady = command[6] == BTP_CMD_PRINT_READY && command[7] == 0x00;
+        if (printReady && exchange.reply[8] == BTP_ERR_SUCCESS) {
+            // The size comes from the host; the trace only says the printer took it
+            *imageSize = ((uint32_t)command[8] << 16) | ((uint32_t)command[9] << 8) | command[10];
+        }
+        return true;
+    }
+    return false;
+}
+
+void KodakStepSimulator::receiveImage(uint32_t size, const uint8_t* early, size_t earlyLen) {
+    // Image bytes from the same read as PRINT_READY count like the rest
+    uint32_t received = (earlyLen < size) ? earlyLen : size;
+    uint32_t crc = KodakStepProtocol::crc32(0, early, received);
+    imageBytes += received;
+
+    const KodakReplayPrint* recorded = nullptr;
+    uint32_t bandwidth = config.bandwidth_bytes_per_sec;
+    if (replay != nullptr && replayPrint < replay->getPrintCount()) {
+        recorded = &replay->getPrint(replayPrint++);
+        bandwidth = recorded->bytes_per_sec;
+    }
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    uint8_t buffer[SIM_READ_SIZE];
+
+    while (received < size && running) {
+        size_t want = size - received;
+        if (want > sizeof(buffer)) {
+            want = sizeof(buffer);
+        }
+
+        // Drain no faster than the configured or recorded link rate
+        if (bandwidth > 0) {
+            uint64_t elapsedUs = std::chrono::duration_cast<std::chrono::microseconds>(
+                std::chrono::steady_clock::now() - start).count();
+            uint64_t allowed = elapsedUs * bandwidth / 1000000;
+            if (allowed <= received) {
+                delay(1);
+                continue;
+            }
+            if (want > allowed - received) {
+                want = allowed - received;
+            }
+        }
+
+        struct pollfd pfd = {fds[1], POLLIN, 0};
+        if (poll(&pfd, 1, SIM_POLL_INTERVAL_MS) <= 0) {
+            continue;
+        }
+        ssize_t len = recv(fds[1], buffer, want, 0);
+        if (len <= 0) {
+            return;
+        }
+        crc = KodakStepProtocol::crc32(crc, buffer, len);
+        received += len;
+        imageBytes += len;
+    }
+
+    if (received == size) {
+        imageCrc = crc;
+        config.print_count++;
+        prints++;
+        if (recorded != nullptr && recorded->accept_us > 0) {
+            uint8_t accepted[BTP_PACKET_SIZE];
+            initReply(accepted, BTP_MSG_NOTIFY, BTP_MSG_SUB_END_OF_RECEIVED, BTP_ERR_SUCCESS);
+            sendAfter(accepted, recorded->accept_us);
+        }
+    }
+}
+
+void KodakStepSimulator::initReply(uint8_t* reply, uint8_t type, uint8_t subType, uint8_t errorCode) const {
+    memset(reply, 0, BTP_PACKET_SIZE);
+    reply[0] = BTP_START_1;
+    reply[1] = BTP_START_2;
+    reply[2] = BTP_IDENT_1;
+    reply[3] = BTP_IDENT_2;
+    reply[6] = type;
+    reply[7] = subType;
+    reply[8] = errorCode;
+}
+
+void KodakStepSimulator::sendReply(uint8_t* reply) {
+    if (config.latency_ms > 0) {
+        delay(config.latency_ms);
+    }
+
+    if (chance(config.drop_reply_percent)) {
+        repliesDropped++;
+        return;
+    }
+    if (chance(config.corrupt_reply_percent)) {
+        // A bad header byte makes the host's frame assembler resync past this reply
+        reply[1] ^= 0xFF;
+        repliesCorrupted++;
+    }
+
+    send(fds[1], reply, BTP_PACKET_SIZE, MSG_NOSIGNAL);
+}
+
+void KodakStepSimulator::sendAfter(const uint8_t* frame, uint32_t delayUs) {
+    // Replayed frames are sent as recorded: no extra latency, no injected errors
+    if (delayUs > 0) {
+        std::this_thread::sleep_for(std::chrono::microseconds(delayUs));
+    }
+    send(fds[1], frame, BTP_PACKET_SIZE, MSG_NOSIGNAL);
+}
+
+bool KodakStepSimulator::chance(uint8_t percent) {
+    if (percent == 0) {
+        return false;
+    }
+    // xorshift32: repeatable across runs for a given seed
+    rngState ^= rngState << 13;
+    rngState ^= rngState >> 17;
+    rngState ^= rngState << 5;
+    return (rngState % 100) < percent;
+}
+
+// =============================================================================
+// Host stream
+// =============================================================================
+
+KodakSimStream::KodakSimStream(int fd) : fd(fd) {
+}
+
+int KodakSimStream::available() {
+    int count = 0;
+    if (ioctl(fd, FIONREAD, &count) != 0) {
+        return 0;
+    }
+    return count;
+}
+
+int KodakSimStream::read() {
+    uint8_t c;
+    return (recv(fd, &c, 1, 0) == 1) ? c : -1;
+}
+
+size_t KodakSimStream::write(uint8_t c) {
+    return write(&c, 1);
+}
+
+size_t KodakSimStream::write(const uint8_t* buffer, size_t size) {
+    ssize_t sent = send(fd, buffer, size, MSG_NOSIGNAL);
+    if (sent < 0) {
+        return 0;  // EAGAIN: link full
+    }
+    return (size_t)sent;
+}
@@ -0,0 +1,123 @@
+#ifndef KODAK_STEP_SIMULATOR_H
+#define KODAK_STEP_SIMULATOR_H
+
+#include <Arduino.h>
+#include <KodakStepProtocol.h>
+#include <atomic>
+#include <thread>
+
+class KodakSessionReplay;
+
+#define SIM_SOCKET_BUFFER_SIZE 16384    // Per direction; small enough that backpressure shows
+
+struct KodakSimConfig {
+    // Link
+    uint32_t latency_ms;                // Added before every reply
+    uint32_t bandwidth_bytes_per_sec;   // Image data drain rate (0 = unlimited)
+
+    // Printer state reported in replies
+    uint8_t battery_level;
+    bool is_charging;
+    uint16_t print_count;
+    uint8_t auto_power_off_minutes;
+    uint8_t paper_error;                // GET_PAGE_TYPE / PRINT_READY error code
+
+    // Error injection, in percent of replies
+    uint8_t drop_reply_percent;         // Reply never sent
+    uint8_t corrupt_reply_percent;      // One header byte flipped
+    uint32_t seed;
+
+    KodakSimConfig();
+};
+
+struct KodakSimStats {
+    uint32_t commands;
+    uint32_t replies_dropped;
+    uint32_t replies_corrupted;
+    uint32_t image_bytes;               // Image bytes received in total
+    uint32_t prints;                    // Transfers that arrived complete
+    uint32_t image_crc32;               // KodakStepProtocol::crc32 of the last complete image
+    uint32_t replayed;                  // Commands answered from a session trace
+};
+
+/**
+ * Simulated Kodak Step printer for the native test environment
+ *
+ * Runs on its own thread at one end of a UNIX socket pair and answers
+ * 34-byte commands the way the printer does: accessory info, charging
+ * status, page type, print count, auto power off and PRINT_READY followed
+ * by the raw JPEG. The host end is non-blocking and the socket buffers are
+ * small, so write() returns short writes once the simulated link falls
+ * behind, just like the SPP TX queue.
+ *
+ * With setReplay(), commands are answered from a recorded session instead:
+ * the next recorded exchange for the same command supplies the reply and
+ * its latency, images drain at the recorded rate, and END_OF_RECEIVED
+ * follows after the recorded delay. Commands the trace has no more of fall
+ * back to the config.
+ */
+class KodakStepSimulator {
+public:
+    KodakStepSimulator();
+    ~KodakStepSimulator();
+
+    KodakStepSimulator(const KodakStepSimulator&) = delete;
+    KodakStepSimulator& operator=(const KodakStepSimulator&) = delete;
+
+    bool start(const KodakSimConfig& config);
+    void stop();
+    // Before start(); nullptr for none. The replay must outlive the run.
+    void setReplay(const KodakSessionReplay* replay);
+
+    int hostFd() const;                 // Host end of the link; see KodakSimStream
+    KodakSimStats getStats() const;
+
+    // Block until this many transfers have arrived complete (false on timeout)
+    bool waitForPrint(uint32_t prints, uint32_t timeoutMs);
+
+private:
+    KodakSimConfig config;
+    int fds[2];
+    std::thread thread;
+    std::atomic<bool> running;
+    uint32_t rngState;
+    const KodakSessionReplay* replay;
+    size_t replayExchange;              // Next recorded exchange to match
+    size_t replayPrint;                 // Recorded transfer the next image follows
+
+    std::atomic<uint32_t> commands;
+    std::atomic<uint32_t> repliesDropped;
+    std::atomic<uint32_t> repliesCorrupted;
+    std::atomic<uint32_t> imageBytes;
+    std::atomic<uint32_t> prints;
+    std::atomic<uint32_t> imageCrc;
+    std::atomic<uint32_t> replayed;
+
+    void run();
+    // Returns the image size after an accepted PRINT_READY, 0 otherwise
+    uint32_t handleCommand(const uint8_t* command);
+    bool replayCommand(const uint8_t* command, uint32_t* imageSize);
+    void receiveImage(uint32_t size, const uint8_t* early, size_t earlyLen);
+    void initReply(uint8_t* reply, uint8_t type, uint8_t subType, uint8_t errorCode) const;
+    void sendReply(uint8_t* reply);
+    void sendAfter(const uint8_t* frame, uint32_t delayUs);
+    bool chance(uint8_t percent);
+};
+
+/**
+ * Stream over the host end of the simulator, standing in for BluetoothSerial
+ */
+class KodakSimStream : public Stream {
+public:
+    explicit KodakSimStream(int fd);
+
+    int available() override;
+    int read() override;
+    size_t write(uint8_t c) override;
+    size_t write(const uint8_t* buffer, size_t size) override;  // Short when the link is full
+
+private:
+    int fd;
+};
+
+#endif // KODAK_STEP_SIMULATOR_H
@@ -0,0 +1,7 @@
+// The native env ignores the library (KodakStepPrinter.cpp needs BluetoothSerial),
+// so the hardware-independent parts are compiled into the test suite from here.
+#include "../../lib/KodakStepPrinter/src/KodakStepProtocol.cpp"
+#include "../../lib/KodakStepPrinter/src/KodakStepPacing.cpp"
+#include "../../lib/KodakStepPrinter/src/KodakImageSource.cpp"
+#include "../../lib/KodakStepPrinter/src/KodakStepMetrics.cpp"
+#include "../../lib/KodakStepPrinter/src/KodakSessionRecorder.cpp"
@@ -0,0 +1,591 @@
+/**
+ * Host-side tests against the simulated Kodak Step printer
+ *
+ * Run with: pio test -e native
+ *
+ * Exercises KodakStepProtocol, KodakFrameAssembler and KodakStepPacer over a
+ * loopback link with configurable latency, bandwidth and error injection,
+ * so pacing and throughput experiments run in seconds without a board.
+ *
+ * KODAK_SESSION_TRACE=<file> replays a field trace (KodakSessionRecorder
+ * export, binary or a Serial log with the hex block) under both pacing
+ * modes and reports the total time of each against the recorded one.
+ */
+
+#include <Arduino.h>
+#include <unity.h>
+#include <KodakStepProtocol.h>
+#include <KodakStepPacing.h>
+#include <KodakImageSource.h>
+#include <KodakStepMetrics.h>
+#include <KodakSessionRecorder.h>
+#include "KodakStepSimulator.h"
+#include "KodakSessionReplay.h"
+#include <vector>
+
+#define SIM_REPLY_TIMEOUT_MS 500
+
+KodakStepProtocol protocol;
+KodakStepSimulator simulator;
+
+void setUp(void) {
+}
+
+void tearDown(void) {
+    simulator.stop();
+    simulator.setReplay(nullptr);
+}
+
+// =============================================================================
+// Helpers
+// =============================================================================
+
+static bool startSimulator(const KodakSimConfig& config) {
+    return simulator.start(config);
+}
+
+// Wait for the next whole frame; false on timeout
+static bool receiveFrame(KodakSimStream& link, KodakFrameAssembler& frames, uint8_t* frame,
+                         uint32_t timeoutMs, KodakSessionRecorder* recorder = nullptr) {
+    unsigned long start = millis();
+    while (millis() - start < timeoutMs) {
+        int c = link.read();
+        if (c < 0) {
+            delay(1);
+            continue;
+        }
+        uint8_t byte = (uint8_t)c;
+        frames.feed(&byte, 1);
+        if (frames.hasFrame()) {
+            memcpy(frame, frames.frame(), BTP_PACKET_SIZE);
+            if (recorder != nullptr) {
+                recorder->recordFrame(KODAK_SESSION_RX, frame);
+            }
+            return true;
+        }
+    }
+    return false;
+}
+
+// Send one command and wait for its reply; false on timeout
+static bool exchange(KodakSimStream& link, const uint8_t* command, uint8_t* reply,
+                     KodakFrameAssembler* assembler = nullptr,
+                     uint32_t timeoutMs = SIM_REPLY_TIMEOUT_MS,
+                     KodakSessionRecorder* recorder = nullptr) {
+    KodakFrameAssembler local;
+    KodakFrameAssembler& frames = (assembler != nullptr) ? *assembler : local;
+    frames.reset();
+
+    if (recorder != nullptr) {
+        recorder->recordFrame(KODAK_SESSION_TX, command);
+    }
+    if (link.write(command, BTP_PACKET_SIZE) != BTP_PACKET_SIZE) {
+        return false;
+    }
+    return receiveFrame(link, frames, reply, timeoutMs, recorder);
+}
+
+struct TransferResult {
+    uint32_t elapsed_ms;
+    KodakPrinterMetrics metrics;
+};
+
+// Same chunk loop as KodakStepPrinter::transferChunk(), over the simulated link
+static bool transfer(KodakSimStream& link, KodakImageSource& source, KodakPacingMode mode,
+                     TransferResult* result, KodakSessionRecorder* recorder = nullptr) {
+    KodakStepPacer pacer;
+    pacer.reset(mode);
+    result->metrics.reset();
+
+    size_t size = source.size();
+    size_t offset = 0;
+    const uint8_t* pending = nullptr;
+    size_t pendingLen = 0;
+    uint8_t shortWriteRun = 0;
+    unsigned long start = millis();
+
+    while (offset < size) {
+        if (pendingLen == 0) {
+            size_t remaining = size - offset;
+            size_t limit = pacer.getChunkSize();
+            pendingLen = source.next(&pending, (remaining < limit) ? remaining : limit);
+            if (pendingLen == 0) {
+                return false;
+            }
+        }
+
+        unsigned long writeStart = micros();
+        size_t written = link.write(pending, pendingLen);
+        uint32_t writeUs = micros() - writeStart;
+        pacer.onChunkWritten(pendingLen, written, writeUs);
+        result->metrics.recordChunk(pendingLen, written, writeUs);
+        if (recorder != nullptr) {
+            recorder->record(KODAK_SESSION_CHUNK, (uint16_t)pendingLen, written, writeUs);
+        }
+
+        if (written != pendingLen) {
+            if (mode == KODAK_PACING_FIXED || ++shortWriteRun > BTP_PACING_MAX_SHORT_WRITES) {
+                return false;
+            }
+        } else {
+            shortWriteRun = 0;
+        }
+
+        pending += written;
+        pendingLen -= written;
+        offset += written;
+        delay(pacer.getDelayMs());
+    }
+
+    result->elapsed_ms = millis() - start;
+    return true;
+}
+
+// =============================================================================
+// Status Query Tests
+// =============================================================================
+
+void test_sim_status_queries(void) {
+    KodakSimConfig config;
+    config.battery_level = 64;
+    config.is_charging = true;
+    config.print_count = 321;
+    config.auto_power_off_minutes = 10;
+    TEST_ASSERT_TRUE(startSimulator(config));
+    KodakSimStream link(simulator.hostFd());
+
+    uint8_t command[BTP_PACKET_SIZE];
+    uint8_t reply[BTP_PACKET_SIZE];
+    uint8_t errorCode;
+
+    protocol.buildGetAccessoryInfoPacket(command);
+    TEST_ASSERT_TRUE(exchange(link, command, reply));
+    TEST_ASSERT_TRUE(protocol.parseResponse(reply, &errorCode));
+    TEST_ASSERT_EQUAL_HEX8(BTP_RESP_ACCESSORY_INFO, reply[6]);
+    TEST_ASSERT_EQUAL(64, reply[12]);
+
+    protocol.buildGetBatteryLevelPacket(command);
+    TEST_ASSERT_TRUE(exchange(link, command, reply));
+    TEST_ASSERT_EQUAL_HEX8(BTP_RESP_CHARGING_STATUS, reply[6]);
+    TEST_ASSERT_EQUAL(1, reply[8]);
+
+    protocol.buildGetPrintCountPacket(command);
+    TEST_ASSERT_TRUE(exchange(link, command, reply));
+    TEST_ASSERT_EQUAL(321, protocol.parsePrintCount(reply));
+
+    protocol.buildGetAutoPowerOffPacket(command);
+    TEST_ASSERT_TRUE(exchange(link, command, reply));
+    TEST_ASSERT_EQUAL(10, protocol.parseAutoPowerOff(reply));
+
+    TEST_ASSERT_EQUAL(4, simulator.getStats().commands);
+}
+
+void test_sim_paper_error_rejects_print(void) {
+    KodakSimConfig config;
+    config.paper_error = BTP_ERR_NO_PAPER;
+    TEST_ASSERT_TRUE(startSimulator(config));
+    KodakSimStream link(simulator.hostFd());
+
+    uint8_t command[BTP_PACKET_SIZE];
+    uint8_t reply[BTP_PACKET_SIZE];
+    uint8_t errorCode;
+
+    protocol.buildGetPageTypePacket(command);
+    TEST_ASSERT_TRUE(exchange(link, command, reply));
+    TEST_ASSERT_FALSE(protocol.parseResponse(reply, &errorCode));
+    TEST_ASSERT_EQUAL_HEX8(BTP_ERR_NO_PAPER, errorCode);
+
+    protocol.buildPrintReadyPacket(command, 1000, 1);
+    TEST_ASSERT_TRUE(exchange(link, command, reply));
+    TEST_ASSERT_FALSE(protocol.parseResponse(reply, &errorCode));
+    TEST_ASSERT_EQUAL_HEX8(BTP_ERR_NO_PAPER, errorCode);
+}
+
+// =============================================================================
+// Link Behaviour Tests
+// =============================================================================
+
+void test_sim_latency_delays_reply(void) {
+    KodakSimConfig config;
+    config.latency_ms = 50;
+    TEST_ASSERT_TRUE(startSimulator(config));
+    KodakSimStream link(simulator.hostFd());
+
+    uint8_t command[BTP_PACKET_SIZE];
+    uint8_t reply[BTP_PACKET_SIZE];
+    protocol.buildGetAccessoryInfoPacket(command);
+
+    unsigned long start = millis();
+    TEST_ASSERT_TRUE(exchange(link, command, reply));
+    TEST_ASSERT_GREATER_OR_EQUAL(50, millis() - start);
+}
+
+void test_sim_dropped_reply_times_out(void) {
+    KodakSimConfig config;
+    config.drop_reply_percent = 100;
+    TEST_ASSERT_TRUE(startSimulator(config));
+    KodakSimStream link(simulator.hostFd());
+
+    uint8_t command[BTP_PACKET_SIZE];
+    uint8_t reply[BTP_PACKET_SIZE];
+    protocol.buildGetBatteryLevelPacket(command);
+
+    TEST_ASSERT_FALSE(exchange(link, command, reply, nullptr, 200));
+    TEST_ASSERT_EQUAL(1, simulator.getStats().replies_dropped);
+}
+
+void test_sim_corrupted_reply_is_discarded(void) {
+    KodakSimConfig config;
+    config.corrupt_reply_percent = 100;
+    TEST_ASSERT_TRUE(startSimulator(config));
+    KodakSimStream link(simulator.hostFd());
+
+    uint8_t command[BTP_PACKET_SIZE];
+    uint8_t reply[BTP_PACKET_SIZE];
+    protocol.buildGetBatteryLevelPacket(command);
+
+    KodakFrameAssembler assembler;
+    TEST_ASSERT_FALSE(exchange(link, command, reply, &assembler, 200));
+    TEST_ASSERT_GREATER_THAN(0, assembler.getDiscardedBytes());
+}
+
+// =============================================================================
+// Transfer Tests
+// =============================================================================
+
+static void runTransfer(KodakPacingMode mode, uint32_t bandwidth, size_t size) {
+    KodakSimConfig config;
+    config.bandwidth_bytes_per_sec = bandwidth;
+    TEST_ASSERT_TRUE(startSimulator(config));
+    KodakSimStream link(simulator.hostFd());
+
+    uint8_t* image = (uint8_t*)malloc(size);
+    TEST_ASSERT_NOT_NULL(image);
+    for (size_t i = 0; i < size; i++) {
+        image[i] = (uint8_t)(i * 7);
+    }
+
+    uint8_t command[BTP_PACKET_SIZE];
+    uint8_t reply[BTP_PACKET_SIZE];
+    uint8_t errorCode;
+    protocol.buildPrintReadyPacket(command, size, 1);
+    TEST_ASSERT_TRUE(exchange(link, command, reply));
+    TEST_ASSERT_TRUE(protocol.parseResponse(reply, &errorCode));
+
+    KodakMemorySource source(image, size);
+    TransferResult result;
+    bool ok = transfer(link, source, mode, &result);
+    uint32_t crc = KodakStepProtocol::crc32(0, image, size);
+    free(image);
+    TEST_ASSERT_TRUE(ok);
+    TEST_ASSERT_TRUE(simulator.waitForPrint(1, 5000));
+    TEST_ASSERT_EQUAL_UINT32(size, simulator.getStats().image_bytes);
+    TEST_ASSERT_EQUAL_UINT32(crc, simulator.getStats().image_crc32);   // Every byte, in order
+
+    char line[128];
+    snprintf(line, sizeof(line), "%s: %u bytes in %u ms, %u chunks, %u short writes",
+             mode == KODAK_PACING_ADAPTIVE ? "adaptive" : "fixed", (unsigned)size,
+             (unsigned)result.elapsed_ms, (unsigned)result.metrics.chunks_written,
+             (unsigned)result.metrics.chunk_short_writes);
+    TEST_MESSAGE(line);
+}
+
+void test_sim_transfer_fixed_pacing(void) {
+    // Unthrottled: 4 KB chunks always fit the socket buffer
+    runTransfer(KODAK_PACING_FIXED, 0, 64 * 1024);
+}
+
+void test_sim_transfer_adaptive_under_backpressure(void) {
+    // 1 MB/s drains slower than the pacer grows, so it has to back off
+    runTransfer(KODAK_PACING_ADAPTIVE, 1024 * 1024, 256 * 1024);
+}
+
+// =============================================================================
+// Session Replay Tests
+// =============================================================================
+
+// Collects an export in memory
+class BufferPrint : public Print {
+public:
+    std::vector<uint8_t> bytes;
+
+    size_t write(uint8_t c) override {
+        bytes.push_back(c);
+        return 1;
+    }
+    size_t write(const uint8_t* buffer, size_t size) override {
+        bytes.insert(bytes.end(), buffer, buffer + size);
+        return size;
+    }
+};
+
+static bool loadExport(const KodakSessionRecorder& recorder, KodakSessionReplay* replay) {
+    BufferPrint trace;
+    recorder.exportTo(trace);
+    return !trace.bytes.empty() && replay->load(&trace.bytes[0], trace.bytes.size());
+}
+
+// Run the recorded commands again, sending each accepted image with the
+// given pacing; the simulator answers from the same trace
+static bool replaySession(const KodakSessionReplay& replay, KodakPacingMode mode, uint32_t* elapsedMs) {
+    KodakSimConfig config;
+    simulator.setReplay(&replay);
+    if (!startSimulator(config)) {
+        return false;
+    }
+    KodakSimStream link(simulator.hostFd());
+
+    std::vector<uint8_t> image(BTP_MAX_IMAGE_SIZE);
+    for (size_t i = 0; i < image.size(); i++) {
+        image[i] = (uint8_t)(i * 7);
+    }
+
+    size_t printIndex = 0;
+    unsigned long start = millis();
+    for (size_t i = 0; i < replay.getExchangeCount(); i++) {
+        const KodakReplayExchange& recorded = replay.getExchange(i);
+        uint8_t reply[BTP_PACKET_SIZE];
+        uint32_t timeoutMs = recorded.has_reply ? recorded.latency_us / 1000 + SIM_REPLY_TIMEOUT_MS : 0;
+        bool answered = exchange(link, recorded.command, reply, nullptr, timeoutMs);
+        if (!recorded.has_reply) {
+            continue;   // Silent in the field, silent here
+        }
+        if (!answered) {
+            return false;
+        }
+
+        const uint8_t* command = recorded.command;
+        bool printReady = command[6] == BTP_CMD_PRINT_READY && command[7] == 0x00;
+        if (!printReady || reply[8] != BTP_ERR_SUCCESS || printIndex >= replay.getPrintCount()) {
+            continue;
+        }
+
+        size_t size = ((size_t)command[8] << 16) | ((size_t)command[9] << 8) | command[10];
+        KodakMemorySource source(&image[0], (size < image.size()) ? size : image.size());
+        TransferResult result;
+        if (!transfer(link, source, mode, &result) || !simulator.waitForPrint(printIndex + 1, 10000)) {
+            return false;
+        }
+        uint32_t acceptUs = replay.getPrint(printIndex).accept_us;
+        if (acceptUs > 0) {
+            KodakFrameAssembler frames;
+            if (!receiveFrame(link, frames, reply, acceptUs / 1000 + SIM_REPLY_TIMEOUT_MS)) {
+                return false;
+            }
+        }
+        printIndex++;
+    }
+
+    *elapsedMs = millis() - start;
+    return true;
+}
+
+void test_recorder_export_round_trip(void) {
+    KodakSessionRecorder recorder;
+    TEST_ASSERT_TRUE(recorder.begin(4));
+    for (uint32_t i = 0; i < 6; i++) {
+        recorder.record(KODAK_SESSION_CHUNK, 4096, i, 100 + i);
+    }
+    TEST_ASSERT_EQUAL(4, recorder.getCount());
+    TEST_ASSERT_EQUAL(2, recorder.getOverwritten());
+
+    BufferPrint binary;
+    recorder.exportTo(binary);
+    TEST_ASSERT_EQUAL(sizeof(KodakSessionHeader) + 4 * sizeof(KodakSessionRecord), binary.bytes.size());
+
+    KodakSessionReplay replay;
+    TEST_ASSERT_TRUE(replay.load(&binary.bytes[0], binary.bytes.size()));
+    TEST_ASSERT_EQUAL(4, replay.getRecordCount());
+    TEST_ASSERT_EQUAL(2, replay.getOverwritten());
+    TEST_ASSERT_EQUAL(2, replay.getRecord(0).args[0]);     // Oldest kept
+    TEST_ASSERT_EQUAL(105, replay.getRecord(3).args[1]);
+
+    // The Serial form decodes to the same bytes, log noise and all
+    BufferPrint hex;
+    hex.print("boot messages\r\n");
+    recorder.exportHex(hex);
+    hex.bytes.push_back('\0');
+    std::vector<uint8_t> decoded;
+    TEST_ASSERT_TRUE(KodakSessionReplay::decodeHex((const char*)&hex.bytes[0], &decoded));
+    TEST_ASSERT_EQUAL(binary.bytes.size(), decoded.size());
+    TEST_ASSERT_EQUAL_MEMORY(&binary.bytes[0], &decoded[0], decoded.size());
+}
+
+void test_replay_pairs_frames_and_keeps_payload(void) {
+    KodakSessionRecorder recorder;
+    TEST_ASSERT_TRUE(recorder.begin(64));
+
+    uint8_t command[BTP_PACKET_SIZE];
+    uint8_t reply[BTP_PACKET_SIZE];
+    protocol.buildGetAccessoryInfoPacket(command);
+    recorder.recordFrame(KODAK_SESSION_TX, command);
+    memset(reply, 0, sizeof(reply));
+    reply[0] = BTP_START_1;
+    reply[1] = BTP_START_2;
+    reply[2] = BTP_IDENT_1;
+    reply[3] = BTP_IDENT_2;
+    reply[6] = BTP_RESP_ACCESSORY_INFO;
+    reply[7] = 0x02;
+    reply[12] = 42;
+    recorder.recordFrame(KODAK_SESSION_RX, reply);
+
+    KodakSessionReplay replay;
+    TEST_ASSERT_TRUE(loadExport(recorder, &replay));
+    TEST_ASSERT_EQUAL(1, replay.getExchangeCount());
+    const KodakReplayExchange& recorded = replay.getExchange(0);
+    TEST_ASSERT_TRUE(recorded.has_reply);
+    TEST_ASSERT_EQUAL_HEX8(BTP_CMD_GET_ACCESSORY_INFO, recorded.command[6]);
+    TEST_ASSERT_EQUAL_HEX8(BTP_RESP_ACCESSORY_INFO, recorded.reply[6]);
+    TEST_ASSERT_EQUAL(42, recorded.reply[12]);
+}
+
+void test_replay_reproduces_printer_latency(void) {
+    // "Field" session: a slow printer with a low battery
+    KodakSimConfig field;
+    field.latency_ms = 40;
+    field.battery_level = 23;
+    TEST_ASSERT_TRUE(startSimulator(field));
+    KodakSessionRecorder recorder;
+    TEST_ASSERT_TRUE(recorder.begin(64));
+    {
+        KodakSimStream link(simulator.hostFd());
+        uint8_t command[BTP_PACKET_SIZE];
+        uint8_t reply[BTP_PACKET_SIZE];
+        protocol.buildGetAccessoryInfoPacket(command);
+        TEST_ASSERT_TRUE(exchange(link, command, reply, nullptr, SIM_REPLY_TIMEOUT_MS, &recorder));
+    }
+    simulator.stop();
+
+    KodakSessionReplay replay;
+    TEST_ASSERT_TRUE(loadExport(recorder, &replay));
+    TEST_ASSERT_EQUAL(1, replay.getExchangeCount());
+    TEST_ASSERT_GREATER_OR_EQUAL(40000, replay.getExchange(0).latency_us);
+
+    // An instant printer with a full battery, answering from the trace
+    KodakSimConfig desk;
+    simulator.setReplay(&replay);
+    TEST_ASSERT_TRUE(startSimulator(desk));
+    KodakSimStream link(simulator.hostFd());
+    uint8_t command[BTP_PACKET_SIZE];
+    uint8_t reply[BTP_PACKET_SIZE];
+    protocol.buildGetAccessoryInfoPacket(command);
+
+    unsigned long start = millis();
+    TEST_ASSERT_TRUE(exchange(link, command, reply));
+    TEST_ASSERT_GREATER_OR_EQUAL(40, millis() - start);
+    TEST_ASSERT_EQUAL(23, reply[12]);
+    TEST_ASSERT_EQUAL(1, simulator.getStats().replayed);
+
+    // The trace has one; the next falls back to the config
+    TEST_ASSERT_TRUE(exchange(link, command, reply));
+    TEST_ASSERT_EQUAL(80, reply[12]);
+}
+
+void test_replay_session_with_other_pacing(void) {
+    const size_t size = 64 * 1024;
+    KodakSimConfig field;
+    field.bandwidth_bytes_per_sec = 256 * 1024;
+    TEST_ASSERT_TRUE(startSimulator(field));
+
+    std::vector<uint8_t> image(size);
+    KodakSessionRecorder recorder;
+    TEST_ASSERT_TRUE(recorder.begin(1024));
+    {
+        KodakSimStream link(simulator.hostFd());
+        uint8_t command[BTP_PACKET_SIZE];
+        uint8_t reply[BTP_PACKET_SIZE];
+        recorder.record(KODAK_SESSION_PRINT, 0, size, 1);
+        protocol.buildPrintReadyPacket(command, size, 1);
+        TEST_ASSERT_TRUE(exchange(link, command, reply, nullptr, SIM_REPLY_TIMEOUT_MS, &recorder));
+
+        KodakMemorySource source(&image[0], size);
+        TransferResult result;
+        TEST_ASSERT_TRUE(transfer(link, source, KODAK_PACING_ADAPTIVE, &result, &recorder));
+        TEST_ASSERT_TRUE(simulator.waitForPrint(1, 5000));
+        recorder.record(KODAK_SESSION_DONE, 0, 1, BTP_ERR_SUCCESS);
+    }
+    simulator.stop();
+
+    KodakSessionReplay replay;
+    TEST_ASSERT_TRUE(loadExport(recorder, &replay));
+    TEST_ASSERT_EQUAL(1, replay.getPrintCount());
+    const KodakReplayPrint& print = replay.getPrint(0);
+    TEST_ASSERT_EQUAL_UINT32(size, print.bytes_sent);
+    TEST_ASSERT_TRUE(print.success);
+    TEST_ASSERT_GREATER_THAN(0, print.bytes_per_sec);
+
+    uint32_t elapsedMs = 0;
+    TEST_ASSERT_TRUE(replaySession(replay, KODAK_PACING_FIXED, &elapsedMs));
+    TEST_ASSERT_EQUAL(1, simulator.getStats().prints);
+
+    char line[128];
+    snprintf(line, sizeof(line), "recorded %u ms at %u B/s, replayed with fixed pacing in %u ms",
+             (unsigned)(print.transfer_us / 1000), (unsigned)print.bytes_per_sec, (unsigned)elapsedMs);
+    TEST_MESSAGE(line);
+}
+
+void test_replay_field_trace(void) {
+    const char* path = getenv("KODAK_SESSION_TRACE");
+    if (path == nullptr) {
+        TEST_IGNORE_MESSAGE("Set KODAK_SESSION_TRACE to replay a recorded session");
+        return;
+    }
+
+    KodakSessionReplay replay;
+    TEST_ASSERT_TRUE_MESSAGE(replay.loadFile(path), "Not a session trace");
+
+    char line[160];
+    snprintf(line, sizeof(line), "%s: %u records (%u overwritten), %u exchanges, %u prints, %u ms",
+             path, (unsigned)replay.getRecordCount(), (unsigned)replay.getOverwritten(),
+             (unsigned)replay.getExchangeCount(), (unsigned)replay.getPrintCount(),
+             (unsigned)(replay.getDurationUs() / 1000));
+    TEST_MESSAGE(line);
+
+    for (size_t i = 0; i < replay.getPrintCount(); i++) {
+        const KodakReplayPrint& print = replay.getPrint(i);
+        snprintf(line, sizeof(line), "print %u: %u bytes in %u ms, %u chunks, %u short writes, accepted after %u ms",
+                 (unsigned)i, (unsigned)print.bytes_sent, (unsigned)(print.transfer_us / 1000),
+                 (unsigned)print.chunks, (unsigned)print.short_writes, (unsigned)(print.accept_us / 1000));
+        TEST_MESSAGE(line);
+    }
+
+    const KodakPacingMode modes[2] = {KODAK_PACING_FIXED, KODAK_PACING_ADAPTIVE};
+    for (int m = 0; m < 2; m++) {
+        uint32_t elapsedMs = 0;
+        TEST_ASSERT_TRUE(replaySession(replay, modes[m], &elapsedMs));
+        simulator.stop();
+        snprintf(line, sizeof(line), "replayed with %s pacing: %u ms", m == 0 ? "fixed" : "adaptive",
+                 (unsigned)elapsedMs);
+        TEST_MESSAGE(line);
+    }
+}
+
+// =============================================================================
+// Test Runner
+// =============================================================================
+
+int main() {
+    UNITY_BEGIN();
+
+    // Status query tests
+    RUN_TEST(test_sim_status_queries);
+    RUN_TEST(test_sim_paper_error_rejects_print);
+
+    // Link behaviour tests
+    RUN_TEST(test_sim_latency_delays_reply);
+    RUN_TEST(test_sim_dropped_reply_times_out);
+    RUN_TEST(test_sim_corrupted_reply_is_discarded);
+
+    // Transfer tests
+    RUN_TEST(test_sim_transfer_fixed_pacing);
+    RUN_TEST(test_sim_transfer_adaptive_under_backpressure);
+
+    // Session replay tests
+    RUN_TEST(test_recorder_export_round_trip);
+    RUN_TEST(test_replay_pairs_frames_and_keeps_payload);
+    RUN_TEST(test_replay_reproduces_printer_latency);
+    RUN_TEST(test_replay_session_with_other_pacing);
+    RUN_TEST(test_replay_field_trace);
+
+    return UNITY_END();
+}